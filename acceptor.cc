@@ -33,13 +33,13 @@ static int createNonblocking()
 
 Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport)
     : loop_(loop),
-      acceptSocket_(createNonblocking()),
-      acceptChannel_(loop, acceptSocket_.fd()),
+      acceptSocket_(std::make_shared<Socket>(createNonblocking())),
+      acceptChannel_(loop, acceptSocket_->fd()),
       listenning_(false)
 {
-    acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
-    acceptSocket_.bindAddress(listenAddr);
+    acceptSocket_->setReuseAddr(true);
+    acceptSocket_->setReusePort(reuseport);
+    acceptSocket_->bindAddress(listenAddr);
 
     // TcpServer.start() 会启动 Accepter.listen(),
     // Accept 运行起来后, 有新用户的连接, 要执行一个回调操作, 在这个毁掉里面把 connfd 打包成 Channel,
@@ -50,6 +50,16 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
     // 可读事件,
 }
 
+Acceptor::Acceptor(EventLoop *loop, const std::shared_ptr<Socket> &listenSocket)
+    : loop_(loop),
+      acceptSocket_(listenSocket),
+      acceptChannel_(loop, acceptSocket_->fd()),
+      listenning_(false)
+{
+    acceptChannel_.setRegistrationFlags(EPOLLEXCLUSIVE);
+    acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this, std::placeholders::_1));
+}
+
 Acceptor::~Acceptor()
 {
     LOG_INFO("Acceptor::~Acceptor");
@@ -64,7 +74,7 @@ void Acceptor::listen()
         abort();
     }
     listenning_ = true;
-    acceptSocket_.listen();
+    acceptSocket_->listen(); // 共用的 listen socket 重复 listen() 没有关系,
     acceptChannel_.enableReading();
 }
 
@@ -75,7 +85,7 @@ void Acceptor::listen()
 void Acceptor::handleRead(Timestamp receiveTime)
 {
     InetAddress peerAddr;
-    int connfd = acceptSocket_.accept(&peerAddr);
+    int connfd = acceptSocket_->accept(&peerAddr);
     if (connfd >= 0)
     {
         if (newConnectionCallback_)
@@ -87,6 +97,10 @@ void Acceptor::handleRead(Timestamp receiveTime)
             ::close(connfd);
         }
     }
+    else if (EAGAIN == errno || EWOULDBLOCK == errno)
+    {
+        // 共用 listen socket 的时候, 连接已经被别的 loop 拿走了,
+    }
     else
     {
         // $ perror 22  #==> OS error code  22:  Invalid argument
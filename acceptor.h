@@ -1,6 +1,7 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 
 #include "channel.h"
 #include "socket.h"
@@ -18,9 +19,16 @@ public:
 
 public:
     Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
+    /**
+     * 和其他 Acceptor 共用一个已经绑定好的 listen socket, 每个 loop 的 Poller 都注册这个 fd,
+     * 注册时带上 EPOLLEXCLUSIVE, 有新连接的时候内核只唤醒其中一个 (或者少数几个) 等待的 loop, 不会惊群,
+     * 被唤醒但是没有抢到连接的 loop accept() 返回 EAGAIN, 直接忽略,
+     */
+    Acceptor(EventLoop *loop, const std::shared_ptr<Socket> &listenSocket);
     ~Acceptor();
 
 public:
+    const std::shared_ptr<Socket> &socket() const { return acceptSocket_; }
     void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
     bool listenning() const { return listenning_; }
     void listen();
@@ -35,7 +43,7 @@ private:
 
 private:
     EventLoop *loop_; // Acceptor 用户就是用户定义的 baseLoop, 也称作 mainLoop,
-    Socket acceptSocket_;
+    std::shared_ptr<Socket> acceptSocket_; // 多个 Acceptor 可以共用一个 listen socket,
     Channel acceptChannel_;
 
     /**
@@ -4,6 +4,8 @@
 
 #include "buffer.h"
 
+#include "crc32c.h"
+
 ssize_t Buffer::readFd(int fd, int *savedErrno)
 {
     char extrabuf[65536] = {0}; // 64K 的栈上的内存空间,
@@ -31,6 +33,29 @@ ssize_t Buffer::readFd(int fd, int *savedErrno)
         writerIndex_ = buffer_.size();
         append(extrabuf, n - writable);
     }
+    if (crcPending_ && n > 0)
+    {
+        updateCrc32c();
+    }
+    return n;
+}
+
+ssize_t Buffer::readFd(int fd, int *savedErrno, size_t maxBytes)
+{
+    ensureWritableBytes(maxBytes);
+    const ssize_t n = ::read(fd, beginWrite(), maxBytes);
+    if (n < 0)
+    {
+        *savedErrno = errno;
+    }
+    else
+    {
+        writerIndex_ += n;
+        if (crcPending_)
+        {
+            updateCrc32c();
+        }
+    }
     return n;
 }
 
@@ -43,3 +68,31 @@ ssize_t Buffer::writeFd(int fd, int *savedErrno)
     }
     return n;
 }
+
+void Buffer::beginCrc32c(size_t offset, size_t len)
+{
+    crcPending_ = true;
+    crcNext_ = readerIndex_ + offset;
+    crcEnd_ = crcNext_ + len;
+    crc_ = 0;
+    updateCrc32c();
+}
+
+uint32_t Buffer::finishCrc32c()
+{
+    assert(crcPending_ && crcEnd_ <= writerIndex_);
+    // append() 进来的数据没有经过 readFd(), 在这里补上,
+    updateCrc32c();
+    crcPending_ = false;
+    return crc_;
+}
+
+void Buffer::updateCrc32c()
+{
+    size_t end = std::min(writerIndex_, crcEnd_);
+    if (crcNext_ < end)
+    {
+        crc_ = crc32c::extend(crc_, begin() + crcNext_, end - crcNext_);
+        crcNext_ = end;
+    }
+}
@@ -2,9 +2,14 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <endian.h>
+#include <stdint.h>
+#include <string.h>
 #include <string>
 #include <vector>
 
+#include "byte_scan.h"
+
 /**
  * 网络库底层的缓冲区类型定义, 
  *
@@ -30,7 +35,11 @@ public:
     explicit Buffer(size_t initialSize = kInitialSize)
         : buffer_(kCheapPrepend + initialSize),
           readerIndex_(kCheapPrepend),
-          writerIndex_(kCheapPrepend)
+          writerIndex_(kCheapPrepend),
+          crcPending_(false),
+          crcNext_(0),
+          crcEnd_(0),
+          crc_(0)
     {
         assert(readableBytes() == 0);
         assert(writableBytes() == initialSize);
@@ -42,6 +51,13 @@ public:
 public:
     void swap(Buffer &rhs)
     {
+        buffer_.swap(rhs.buffer_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+        std::swap(crcPending_, rhs.crcPending_);
+        std::swap(crcNext_, rhs.crcNext_);
+        std::swap(crcEnd_, rhs.crcEnd_);
+        std::swap(crc_, rhs.crc_);
     }
 
     size_t readableBytes() const
@@ -65,9 +81,89 @@ public:
         return begin() + readerIndex_;
     }
 
+    /**
+     * 在可读区域里面查找分隔符, 找不到返回 nullptr, 找到的指针在下一次修改 Buffer 之前有效,
+     * 带 start 的版本从 start 开始找, start 必须在可读区域里面,
+     */
+    const char *findCRLF() const
+    {
+        return byte_scan::findCRLF(peek(), beginWrite());
+    }
+
+    const char *findCRLF(const char *start) const
+    {
+        assert(peek() <= start && start <= beginWrite());
+        return byte_scan::findCRLF(start, beginWrite());
+    }
+
+    // "\n",
+    const char *findEOL() const
+    {
+        return byte_scan::findByte(peek(), beginWrite(), '\n');
+    }
+
+    const char *findEOL(const char *start) const
+    {
+        assert(peek() <= start && start <= beginWrite());
+        return byte_scan::findByte(start, beginWrite(), '\n');
+    }
+
+    const char *findByte(char c) const
+    {
+        return byte_scan::findByte(peek(), beginWrite(), c);
+    }
+
+    // set[0, setLen) 里面任意一个字节,
+    const char *findAnyOf(const char *set, size_t setLen) const
+    {
+        return byte_scan::findAnyOf(peek(), beginWrite(), set, setLen);
+    }
+
+    /**
+     * 增量查找, 消息还没有收完的时候, 下一次 onMessage() 不需要把已经找过的数据再找一遍,
+     * *scanned 是从 peek() 开始已经确认没有分隔符的字节数, 第一次传 0,
+     * 找不到的时候更新 *scanned, 找到的时候不修改, 调用者 retrieve() 以后要把它清零,
+     * 用偏移而不是指针记录位置, 因为 append() 可能重新分配内存,
+     */
+    const char *findCRLF(size_t *scanned) const
+    {
+        const char *found = findCRLF(peek() + std::min(*scanned, readableBytes()));
+        if (nullptr == found)
+        {
+            // 最后一个字节可能是 '\r', 和下一次收到的 '\n' 组成 "\r\n", 下一次从它开始找,
+            *scanned = readableBytes() > 0 ? readableBytes() - 1 : 0;
+        }
+        return found;
+    }
+
+    const char *findEOL(size_t *scanned) const
+    {
+        return findByte('\n', scanned);
+    }
+
+    const char *findByte(char c, size_t *scanned) const
+    {
+        const char *found = byte_scan::findByte(peek() + std::min(*scanned, readableBytes()), beginWrite(), c);
+        if (nullptr == found)
+        {
+            *scanned = readableBytes();
+        }
+        return found;
+    }
+
+    const char *findAnyOf(const char *set, size_t setLen, size_t *scanned) const
+    {
+        const char *found = byte_scan::findAnyOf(peek() + std::min(*scanned, readableBytes()), beginWrite(), set, setLen);
+        if (nullptr == found)
+        {
+            *scanned = readableBytes();
+        }
+        return found;
+    }
+
     void retrieve(size_t len)
     {
-        if (len <= readableBytes())
+        if (len < readableBytes())
         {
             // 应用值读取了可读缓冲区数据的一部分, 就是 len 长度, 还剩下 readableBytes() - len 的长度没有读取,
             readerIndex_ += len;
@@ -81,6 +177,7 @@ public:
     void retrieveAll()
     {
         readerIndex_ = writerIndex_ = kCheapPrepend;
+        crcPending_ = false;
     }
 
     // 把 onMessage() 函数上报的 Buffer 数据转成 string 类型的数据, 返回给应用,
@@ -110,6 +207,125 @@ public:
         append(static_cast<const char *>(data), len);
     }
 
+    // 整数按照网络字节序 (大端) 追加到可写区域,
+    void appendInt64(int64_t x)
+    {
+        int64_t be64 = htobe64(x);
+        append(&be64, sizeof be64);
+    }
+
+    void appendInt32(int32_t x)
+    {
+        int32_t be32 = htobe32(x);
+        append(&be32, sizeof be32);
+    }
+
+    void appendInt16(int16_t x)
+    {
+        int16_t be16 = htobe16(x);
+        append(&be16, sizeof be16);
+    }
+
+    void appendInt8(int8_t x)
+    {
+        append(&x, sizeof x);
+    }
+
+    // 从可读区域的开头按照网络字节序读出整数, 但是不移动 readerIndex_, 调用者保证可读的字节数足够,
+    int64_t peekInt64() const
+    {
+        assert(readableBytes() >= sizeof(int64_t));
+        int64_t be64 = 0;
+        ::memcpy(&be64, peek(), sizeof be64);
+        return be64toh(be64);
+    }
+
+    int32_t peekInt32() const
+    {
+        assert(readableBytes() >= sizeof(int32_t));
+        int32_t be32 = 0;
+        ::memcpy(&be32, peek(), sizeof be32);
+        return be32toh(be32);
+    }
+
+    int16_t peekInt16() const
+    {
+        assert(readableBytes() >= sizeof(int16_t));
+        int16_t be16 = 0;
+        ::memcpy(&be16, peek(), sizeof be16);
+        return be16toh(be16);
+    }
+
+    int8_t peekInt8() const
+    {
+        assert(readableBytes() >= sizeof(int8_t));
+        return *peek();
+    }
+
+    // 读出整数, 并且移动 readerIndex_,
+    int64_t readInt64()
+    {
+        int64_t result = peekInt64();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    int32_t readInt32()
+    {
+        int32_t result = peekInt32();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    int16_t readInt16()
+    {
+        int16_t result = peekInt16();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    int8_t readInt8()
+    {
+        int8_t result = peekInt8();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    /**
+     * 把数据写到可读区域的前面, 用的是 kCheapPrepend 预留的空间,
+     * 消息体已经写进 Buffer 以后, 再把长度头部放到它前面, 头部和消息体是连续的, 一次 write() 就能发出去,
+     */
+    void prepend(const void *data, size_t len)
+    {
+        assert(len <= prependableBytes());
+        readerIndex_ -= len;
+        const char *d = static_cast<const char *>(data);
+        std::copy(d, d + len, begin() + readerIndex_);
+    }
+
+    void prependInt64(int64_t x)
+    {
+        int64_t be64 = htobe64(x);
+        prepend(&be64, sizeof be64);
+    }
+
+    void prependInt32(int32_t x)
+    {
+        int32_t be32 = htobe32(x);
+        prepend(&be32, sizeof be32);
+    }
+
+    void prependInt16(int16_t x)
+    {
+        int16_t be16 = htobe16(x);
+        prepend(&be16, sizeof be16);
+    }
+
+    void prependInt8(int8_t x)
+    {
+        prepend(&x, sizeof x);
+    }
+
     void ensureWritableBytes(size_t len)
     {
         if (writableBytes() < len)
@@ -128,6 +344,13 @@ public:
         return begin() + writerIndex_;
     }
 
+    // 直接写进 beginWrite() 以后调用, 把写了的 len 个字节变成可读的, 调用之前要 ensureWritableBytes(),
+    void hasWritten(size_t len)
+    {
+        assert(len <= writableBytes());
+        writerIndex_ += len;
+    }
+
     /**
      * 从 fd 读取数据, 放入到 buffer 中, 
      * Poller 是工作在 LT 模式, fd上的数据没有读取完的话, 底层的 Poller 会不断的上报,
@@ -135,8 +358,22 @@ public:
      * 
      */
     ssize_t readFd(int fd, int* savedErrno);
+    // 最多读 maxBytes 个字节, 直接读到可写区域, 不用栈上的 extrabuf, 用来严格限制缓冲区的大小,
+    ssize_t readFd(int fd, int *savedErrno, size_t maxBytes);
 
     ssize_t writeFd(int fd, int* savedErrno);
+
+    /**
+     * 增量计算 CRC32C, 分帧的协议收到帧头就知道要校验的范围, 调用 beginCrc32c() 登记从 peek() + offset 开始的 len 个字节,
+     * 已经在 Buffer 里面的部分马上计算, 之后 readFd() 每读进来一段就顺便把落在范围里的部分算进去, 数据刚写进来还在缓存里面,
+     * 整帧到齐以后 finishCrc32c() 直接得到结果, 不需要再把整帧遍历一遍,
+     * 同一时间只能登记一个范围, finishCrc32c() 之前不能取走范围里的数据, retrieveAll() 会取消登记,
+     */
+    void beginCrc32c(size_t offset, size_t len);
+    bool crc32cPending() const { return crcPending_; }
+    // 范围里的数据全部可读以后调用, 返回 CRC32C 并且取消登记,
+    uint32_t finishCrc32c();
+
 private:
     char *begin()
     {
@@ -152,8 +389,8 @@ private:
     {
         // |  kCheapPrepend  |  readerIndex_  |  writerIndex_  |
         //
-        // if(writableBytes()  + prependableBytes() < len + kCheapPrepend){}
-        if (len - writerIndex_ - (readerIndex_ - kCheapPrepend))
+        // 前面已经读走的空间加上后面可写的空间都不够 len 的时候才扩容, 够的话把可读数据挪到前面,
+        if (writableBytes() + prependableBytes() < len + kCheapPrepend)
         {
             /**
              * writerIndex_ 保证了前面的 readBuf()  len 保证了 writeBuf(), 所以(writerIndex_ + len) 就是整个缓冲区大小,
@@ -166,13 +403,27 @@ private:
         {
             size_t readable = readableBytes();
             std::copy(begin() + readerIndex_, begin() + writerIndex_, begin() + kCheapPrepend);
+            // 登记的 CRC32C 范围跟着数据一起往前挪,
+            if (crcPending_)
+            {
+                crcNext_ -= readerIndex_ - kCheapPrepend;
+                crcEnd_ -= readerIndex_ - kCheapPrepend;
+            }
             readerIndex_ = kCheapPrepend;
             writerIndex_ = readerIndex_ + readable;
         }
     }
 
+    // 把 [crcNext_, min(writerIndex_, crcEnd_)) 算进 crc_,
+    void updateCrc32c();
+
 private:
     std::vector<char> buffer_;
     size_t readerIndex_;
     size_t writerIndex_;
+
+    bool crcPending_;
+    size_t crcNext_; // 下一个要计算的字节在 buffer_ 里面的下标,
+    size_t crcEnd_;  // 登记的范围结束的下标,
+    uint32_t crc_;
 };
@@ -0,0 +1,266 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "byte_scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MYMUDUO_X86_SCAN 1
+#endif
+
+namespace
+{
+    using FindCRLFFunc = const char *(*)(const char *, const char *);
+    using FindAnyOfFunc = const char *(*)(const char *, const char *, const char *, size_t);
+
+    const char *findCRLFScalar(const char *begin, const char *end)
+    {
+        for (const char *p = begin; p + 1 < end; ++p)
+        {
+            if ('\r' == p[0] && '\n' == p[1])
+            {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+    const char *findAnyOfScalar(const char *begin, const char *end, const char *set, size_t setLen)
+    {
+        bool table[256] = {false};
+        for (size_t i = 0; i < setLen; ++i)
+        {
+            table[static_cast<unsigned char>(set[i])] = true;
+        }
+        for (const char *p = begin; p < end; ++p)
+        {
+            if (table[static_cast<unsigned char>(*p)])
+            {
+                return p;
+            }
+        }
+        return nullptr;
+    }
+
+#ifdef MYMUDUO_X86_SCAN
+    /**
+     * 同时加载 p 和 p + 1 开始的 16/32 字节, 前一个和 '\r' 比较, 后一个和 '\n' 比较, 两个结果按位与,
+     * 第 i 位为 1 就说明 p[i] p[i + 1] 是 "\r\n", 跨越块边界的 "\r\n" 也不会漏掉,
+     * 第二次加载读到 p + 16/32, 所以循环到 end 前面一个块就停下, 剩下的逐字节比较,
+     */
+    __attribute__((target("sse2"))) const char *findCRLFSse2(const char *begin, const char *end)
+    {
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        if (end - begin < 17)
+        {
+            return findCRLFScalar(begin, end);
+        }
+        for (const char *p = begin;; p += 16)
+        {
+            // 最后一块和前一块重叠, 对齐到 end, 不再逐字节处理剩下的字节, 前面的块里面已经确认没有 "\r\n",
+            if (end - p < 17)
+            {
+                p = end - 17;
+            }
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+            int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+            if (0 != mask)
+            {
+                return p + __builtin_ctz(mask);
+            }
+            if (end - p == 17)
+            {
+                return nullptr;
+            }
+        }
+    }
+
+    __attribute__((target("avx2"))) const char *findCRLFAvx2(const char *begin, const char *end)
+    {
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i lf = _mm256_set1_epi8('\n');
+        // 不足一块的时候不转到 SSE2 的版本, 这里高 128 位还是脏的, 混用非 VEX 编码的 SSE 指令会有很大的状态切换开销,
+        if (end - begin < 33)
+        {
+            return findCRLFScalar(begin, end);
+        }
+        const char *p = begin;
+        // 主循环一次处理 64 字节, 两块的比较结果合并以后只做一次 movemask 和分支,
+        for (; end - p >= 65; p += 64)
+        {
+            __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1));
+            __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+            __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 33));
+            __m256i hit0 = _mm256_and_si256(_mm256_cmpeq_epi8(a0, cr), _mm256_cmpeq_epi8(b0, lf));
+            __m256i hit1 = _mm256_and_si256(_mm256_cmpeq_epi8(a1, cr), _mm256_cmpeq_epi8(b1, lf));
+            if (!_mm256_testz_si256(_mm256_or_si256(hit0, hit1), _mm256_or_si256(hit0, hit1)))
+            {
+                uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit0)) |
+                                (static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hit1))) << 32);
+                return p + __builtin_ctzll(mask);
+            }
+        }
+        for (;; p += 32)
+        {
+            if (end - p < 33)
+            {
+                p = end - 33;
+            }
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1));
+            uint32_t mask = static_cast<uint32_t>(
+                _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, cr), _mm256_cmpeq_epi8(b, lf))));
+            if (0 != mask)
+            {
+                return p + __builtin_ctz(mask);
+            }
+            if (end - p == 33)
+            {
+                return nullptr;
+            }
+        }
+    }
+
+    // 集合里面的每个字节广播成一个向量, 每个块和它们逐个比较, 结果按位或,
+    __attribute__((target("sse2"))) const char *findAnyOfSse2(const char *begin, const char *end, const char *set, size_t setLen)
+    {
+        if (setLen > byte_scan::kMaxVectorSet)
+        {
+            return findAnyOfScalar(begin, end, set, setLen);
+        }
+        __m128i needles[byte_scan::kMaxVectorSet];
+        for (size_t i = 0; i < setLen; ++i)
+        {
+            needles[i] = _mm_set1_epi8(set[i]);
+        }
+        if (end - begin < 16)
+        {
+            return findAnyOfScalar(begin, end, set, setLen);
+        }
+        for (const char *p = begin;; p += 16)
+        {
+            if (end - p < 16)
+            {
+                p = end - 16;
+            }
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i hit = _mm_setzero_si128();
+            for (size_t i = 0; i < setLen; ++i)
+            {
+                hit = _mm_or_si128(hit, _mm_cmpeq_epi8(a, needles[i]));
+            }
+            int mask = _mm_movemask_epi8(hit);
+            if (0 != mask)
+            {
+                return p + __builtin_ctz(mask);
+            }
+            if (end - p == 16)
+            {
+                return nullptr;
+            }
+        }
+    }
+
+    __attribute__((target("avx2"))) const char *findAnyOfAvx2(const char *begin, const char *end, const char *set, size_t setLen)
+    {
+        if (setLen > byte_scan::kMaxVectorSet)
+        {
+            return findAnyOfScalar(begin, end, set, setLen);
+        }
+        __m256i needles[byte_scan::kMaxVectorSet];
+        for (size_t i = 0; i < setLen; ++i)
+        {
+            needles[i] = _mm256_set1_epi8(set[i]);
+        }
+        if (end - begin < 32)
+        {
+            return findAnyOfScalar(begin, end, set, setLen);
+        }
+        for (const char *p = begin;; p += 32)
+        {
+            if (end - p < 32)
+            {
+                p = end - 32;
+            }
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i hit = _mm256_setzero_si256();
+            for (size_t i = 0; i < setLen; ++i)
+            {
+                hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(a, needles[i]));
+            }
+            uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+            if (0 != mask)
+            {
+                return p + __builtin_ctz(mask);
+            }
+            if (end - p == 32)
+            {
+                return nullptr;
+            }
+        }
+    }
+#endif
+
+    struct ScanImpl
+    {
+        ScanImpl() : findCRLF(findCRLFScalar), findAnyOf(findAnyOfScalar), name("scalar")
+        {
+#ifdef MYMUDUO_X86_SCAN
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+            {
+                findCRLF = findCRLFAvx2;
+                findAnyOf = findAnyOfAvx2;
+                name = "avx2";
+            }
+            else if (__builtin_cpu_supports("sse2"))
+            {
+                findCRLF = findCRLFSse2;
+                findAnyOf = findAnyOfSse2;
+                name = "sse2";
+            }
+#endif
+        }
+
+        FindCRLFFunc findCRLF;
+        FindAnyOfFunc findAnyOf;
+        const char *name;
+    };
+
+    // 函数里面的静态变量, 第一次调用的时候初始化, 不依赖全局对象的初始化顺序,
+    const ScanImpl &scanImpl()
+    {
+        static const ScanImpl impl;
+        return impl;
+    }
+}
+
+namespace byte_scan
+{
+    const char *findCRLF(const char *begin, const char *end)
+    {
+        return scanImpl().findCRLF(begin, end);
+    }
+
+    const char *findByte(const char *begin, const char *end, char c)
+    {
+        return begin < end ? static_cast<const char *>(::memchr(begin, c, end - begin)) : nullptr;
+    }
+
+    const char *findAnyOf(const char *begin, const char *end, const char *set, size_t setLen)
+    {
+        if (1 == setLen)
+        {
+            return findByte(begin, end, set[0]);
+        }
+        return scanImpl().findAnyOf(begin, end, set, setLen);
+    }
+
+    const char *implementation()
+    {
+        return scanImpl().name;
+    }
+}
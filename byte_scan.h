@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * 在 [begin, end) 里面查找分隔符, 找不到返回 nullptr,
+ * 文本协议 (HTTP, RESP, 按行分割) 解析的时候大部分时间花在找 "\r\n" 上面,
+ * x86 上按照 CPU 支持的指令集选择 AVX2 (一次比较 32 字节) 或者 SSE2 (16 字节) 的实现, 其他平台用逐字节比较,
+ * 选择在第一次调用之前完成一次, 之后每次调用只是一次函数指针调用,
+ */
+namespace byte_scan
+{
+    // 第一个 "\r\n", 返回指向 '\r' 的指针,
+    const char *findCRLF(const char *begin, const char *end);
+
+    // 第一个字节 c, glibc 的 memchr() 已经按照 CPU 选择了向量化的实现, 这里直接用它,
+    const char *findByte(const char *begin, const char *end, char c);
+
+    // 第一个属于 set[0, setLen) 的字节, setLen 不超过 kMaxVectorSet 的时候用向量化的实现,
+    const char *findAnyOf(const char *begin, const char *end, const char *set, size_t setLen);
+
+    const size_t kMaxVectorSet = 16;
+
+    // 当前选择的实现, "avx2", "sse2" 或者 "scalar",
+    const char *implementation();
+}
@@ -24,6 +24,12 @@ using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr &, size_
 
 using MessageCallback = std::function<void(const TcpConnectionPtr &, Buffer *, Timestamp)>;
 
+/**
+ * 流式接收的数据消费者, data/len 是 inputBuffer_ 里面还没有消费的全部数据,
+ * 返回这次消费了多少字节, 返回的比 len 少表示暂时处理不了更多的数据 (背压),
+ */
+using BodySink = std::function<size_t(const TcpConnectionPtr &, const char *data, size_t len)>;
+
 void defaultConnectionCallback(const TcpConnectionPtr &conn);
 void defaultMessageCallback(const TcpConnectionPtr &conn, Buffer *buffer, Timestamp receiveTime);
 
@@ -19,7 +19,7 @@ const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
 const int Channel::kWriteEvent = EPOLLOUT;
 
 Channel::Channel(EventLoop *loop, int fd)
-    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(kNew), tied_(false)
+    : loop_(loop), fd_(fd), events_(0), registrationFlags_(0), revents_(0), index_(kNew), tied_(false)
 {
 }
 
@@ -2,10 +2,16 @@
 
 #include <functional>
 #include <memory>
+#include <sys/epoll.h>
 
 #include "noncopyable.h"
 #include "timestamp.h"
 
+// 老版本的 glibc 头文件里面没有, 值和内核保持一致, 内核 4.5 以后支持,
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)
+#endif
+
 class EventLoop;
 
 /**
@@ -52,6 +58,13 @@ public:
 
     int fd() const { return fd_; }
     int events() const { return events_; }                     // 返回 fd 感兴趣事件,
+
+    /**
+     * 注册到 Poller 时附加的标志, 比如 EPOLLEXCLUSIVE, 只在 EPOLL_CTL_ADD 的时候生效, 不算作感兴趣的事件,
+     * 在第一次 enableXxx() 之前设置, PollPoller 忽略这些标志,
+     */
+    void setRegistrationFlags(int flags) { registrationFlags_ = flags; }
+    int registrationFlags() const { return registrationFlags_; }
     void set_revents(int revt) { revents_ = revt; }            // Poller监听的事件,
     bool isNoneEvent() const { return events_ == kNoneEvent; } // 当前的 Channel 底层的 fd 到底有没注册事件,
 
@@ -134,6 +147,7 @@ private:
     EventLoop *loop_;
     const int fd_; // Poller 监听的对象,
     int events_;   // 注册 fd 感兴趣的事件, EPOLLIN | EPOLLOUT,
+    int registrationFlags_; // 注册时附加的标志, EPOLLEXCLUSIVE,
     int revents_;  // Poller 返回的具体发生的事件, EPOLLIN | EPOLLOUT,
     int index_;    //
 
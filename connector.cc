@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "connector.h"
+
+#include "channel.h"
+#include "event_loop.h"
+#include "logger.h"
+#include "sockets_ops.h"
+
+const int Connector::kMaxRetryDelayMs;
+const int Connector::kInitRetryDelayMs;
+
+Connector::Connector(EventLoop *loop, const InetAddress &serverAddr)
+    : loop_(loop),
+      serverAddr_(serverAddr),
+      connect_(false),
+      state_(kDisconnected),
+      retryDelayMs_(kInitRetryDelayMs)
+{
+    LOG_DEBUG("Connector::ctor[%p]", this);
+}
+
+Connector::~Connector()
+{
+    LOG_DEBUG("Connector::dtor[%p]", this);
+    assert(!channel_);
+}
+
+void Connector::start()
+{
+    connect_ = true;
+    loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop()
+{
+    loop_->assertInLoopThread();
+    assert(state_ == kDisconnected);
+    if (connect_)
+    {
+        connect();
+    }
+    else
+    {
+        LOG_DEBUG("Connector::startInLoop do not connect");
+    }
+}
+
+void Connector::restart()
+{
+    loop_->assertInLoopThread();
+    setState(kDisconnected);
+    retryDelayMs_ = kInitRetryDelayMs;
+    connect_ = true;
+    startInLoop();
+}
+
+void Connector::stop()
+{
+    connect_ = false;
+    loop_->queueInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::stopInLoop()
+{
+    loop_->assertInLoopThread();
+    loop_->cancel(retryTimer_);
+    if (state_ == kConnecting)
+    {
+        setState(kDisconnected);
+        int sockfd = removeAndResetChannel();
+        ::close(sockfd);
+    }
+}
+
+void Connector::connect()
+{
+    int sockfd = sockets_ops::createNonblockingOrDie();
+    int ret = sockets_ops::connect(sockfd, *serverAddr_.getSockAddr());
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch (savedErrno)
+    {
+    // 非阻塞 connect(), 正在连接, 等待 sockfd 可写,
+    case 0:
+    case EINPROGRESS:
+    case EINTR:
+    case EISCONN:
+        connecting(sockfd);
+        break;
+
+    // 暂时的错误, 比如临时端口用完了, 重试,
+    case EAGAIN:
+    case EADDRINUSE:
+    case EADDRNOTAVAIL:
+    case ECONNREFUSED:
+    case ENETUNREACH:
+        retry(sockfd);
+        break;
+
+    // 参数或者权限错误, 重试也没有用,
+    case EACCES:
+    case EPERM:
+    case EAFNOSUPPORT:
+    case EALREADY:
+    case EBADF:
+    case EFAULT:
+    case ENOTSOCK:
+        LOG_ERROR("Connector::connect error %d to %s \n", savedErrno, serverAddr_.toIpPort().c_str());
+        ::close(sockfd);
+        break;
+
+    default:
+        LOG_ERROR("Connector::connect unexpected error %d to %s \n", savedErrno, serverAddr_.toIpPort().c_str());
+        ::close(sockfd);
+        break;
+    }
+}
+
+void Connector::connecting(int sockfd)
+{
+    setState(kConnecting);
+    assert(!channel_);
+    channel_.reset(new Channel(loop_, sockfd));
+    // channel_ 只在连接过程中存在, 连接成功或者失败都会先 removeAndResetChannel(), 回调里面用 this 就可以,
+    channel_->setWriteCallback([this]() { handleWrite(); });
+    channel_->setErrorCallback([this]() { handleError(); });
+    channel_->enableWriting();
+}
+
+int Connector::removeAndResetChannel()
+{
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    // 现在可能还在 Channel::handleEvent() 里面, 不能直接释放 channel_,
+    loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+    return sockfd;
+}
+
+void Connector::resetChannel()
+{
+    channel_.reset();
+}
+
+void Connector::handleWrite()
+{
+    LOG_DEBUG("Connector::handleWrite state=%d", static_cast<int>(state_));
+    if (state_ != kConnecting)
+    {
+        // stop() 以后的事件, 什么也不做,
+        assert(state_ == kDisconnected);
+        return;
+    }
+
+    int sockfd = removeAndResetChannel();
+    int err = sockets_ops::getSocketError(sockfd);
+    if (err)
+    {
+        LOG_WARNNING("Connector::handleWrite - SO_ERROR = %d \n", err);
+        retry(sockfd);
+    }
+    else if (sockets_ops::isSelfConnect(sockfd))
+    {
+        LOG_WARNNING("Connector::handleWrite - Self connect \n");
+        retry(sockfd);
+    }
+    else
+    {
+        setState(kConnected);
+        if (connect_ && newConnectionCallback_)
+        {
+            newConnectionCallback_(sockfd);
+        }
+        else
+        {
+            ::close(sockfd);
+        }
+    }
+}
+
+void Connector::handleError()
+{
+    LOG_ERROR("Connector::handleError state=%d \n", static_cast<int>(state_));
+    if (state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        LOG_DEBUG("SO_ERROR = %d", sockets_ops::getSocketError(sockfd));
+        retry(sockfd);
+    }
+}
+
+void Connector::retry(int sockfd)
+{
+    ::close(sockfd);
+    setState(kDisconnected);
+    if (connect_)
+    {
+        LOG_INFO("Connector::retry - Retry connecting to %s in %d milliseconds. \n",
+                 serverAddr_.toIpPort().c_str(), retryDelayMs_);
+        // 定时器只持有弱引用, Connector 已经释放的话就不再重试,
+        std::weak_ptr<Connector> weakSelf(shared_from_this());
+        retryTimer_ = loop_->runAfter(retryDelayMs_ / 1000.0,
+                                      [weakSelf]()
+                                      {
+                                          std::shared_ptr<Connector> self(weakSelf.lock());
+                                          if (self)
+                                          {
+                                              self->startInLoop();
+                                          }
+                                      });
+        retryDelayMs_ = std::min(retryDelayMs_ * 2, kMaxRetryDelayMs);
+    }
+    else
+    {
+        LOG_DEBUG("do not connect");
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "inet_address.h"
+#include "noncopyable.h"
+#include "timer_id.h"
+
+class Channel;
+class EventLoop;
+
+/**
+ * 客户端主动发起连接, 和 Acceptor 对应, Acceptor 被动接受连接, Connector 主动连接,
+ * 非阻塞 connect() 返回 EINPROGRESS 以后, 把 sockfd 封装成 Channel 注册 EPOLLOUT,
+ * 可写的时候用 getsockopt(SO_ERROR) 判断连接是否真正建立, 成功以后把 sockfd 交给 newConnectionCallback_,
+ * 失败以后按照指数退避 (500ms 开始, 每次翻倍, 最多 30s) 用定时器重试,
+ *
+ * Connector 只负责拿到一个已连接的 sockfd, 不负责 TcpConnection, 由 TcpClient 封装,
+ * 所有的状态都只在 loop 线程里面修改, start()/stop() 可以在任意线程调用,
+ */
+class Connector : noncopyable,
+                  public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+
+public:
+    Connector(EventLoop *loop, const InetAddress &serverAddr);
+    ~Connector();
+
+public:
+    void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+    const InetAddress &serverAddress() const { return serverAddr_; }
+
+    // 开始连接, 可以在任意线程调用,
+    void start();
+    // 连接断开以后重新连接, 重试间隔恢复成初始值, 必须在 loop 线程调用,
+    void restart();
+    // 停止连接, 取消还没执行的重试, 可以在任意线程调用,
+    void stop();
+
+private:
+    enum StateE
+    {
+        kDisconnected,
+        kConnecting,
+        kConnected,
+    };
+
+    static const int kMaxRetryDelayMs = 30 * 1000;
+    static const int kInitRetryDelayMs = 500;
+
+    void setState(StateE s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    // connect() 返回 EINPROGRESS, 等待 sockfd 可写,
+    void connecting(int sockfd);
+    // sockfd 可写或者出错了, 检查 SO_ERROR,
+    void handleWrite();
+    void handleError();
+    // 关闭 sockfd, retryDelayMs_ 以后重新 connect(), 然后 retryDelayMs_ 翻倍,
+    void retry(int sockfd);
+    // 把 channel_ 从 Poller 里面删除, 返回 sockfd, 现在还在 channel_ 的回调里面, channel_ 放到下一轮再释放,
+    int removeAndResetChannel();
+    void resetChannel();
+
+private:
+    EventLoop *loop_;
+    InetAddress serverAddr_;
+    std::atomic_bool connect_; // 用户是否希望连接, stop() 以后为 false,
+    std::atomic_int state_;
+    std::unique_ptr<Channel> channel_; // 只在连接过程中存在,
+    NewConnectionCallback newConnectionCallback_;
+    int retryDelayMs_;
+    TimerId retryTimer_;
+};
@@ -0,0 +1,254 @@
+#include <endian.h>
+#include <string.h>
+
+#include "crc32c.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define MYMUDUO_X86_CRC32C 1
+#endif
+
+namespace
+{
+    using ExtendFunc = uint32_t (*)(uint32_t, const void *, size_t);
+
+    const uint32_t kPoly = 0x82f63b78; // 0x1EDC6F41 按位反转,
+
+    // 硬件实现三段交错的时候每段的长度, 长段处理大块数据, 短段处理剩下的部分,
+    const size_t kLongBlock = 8192;
+    const size_t kShortBlock = 256;
+
+    uint64_t loadUint64(const unsigned char *p)
+    {
+        uint64_t word = 0;
+        ::memcpy(&word, p, sizeof word);
+        return le64toh(word);
+    }
+
+    /**
+     * GF(2) 上的 32x32 矩阵, mat[i] 是第 i 列, 用来构造 "在 crc 后面追加 n 个 0 字节" 的线性变换,
+     * 三段交错计算的时候, 前一段的 crc 追加后一段长度的 0 以后和后一段的 crc 异或, 就是两段连起来的 crc,
+     */
+    uint32_t gf2MatrixTimes(const uint32_t *mat, uint32_t vec)
+    {
+        uint32_t sum = 0;
+        while (vec)
+        {
+            if (vec & 1)
+            {
+                sum ^= *mat;
+            }
+            vec >>= 1;
+            ++mat;
+        }
+        return sum;
+    }
+
+    void gf2MatrixSquare(uint32_t *square, const uint32_t *mat)
+    {
+        for (int n = 0; n < 32; ++n)
+        {
+            square[n] = gf2MatrixTimes(mat, mat[n]);
+        }
+    }
+
+    // 追加 len 个 0 字节的变换, len 是 2 的幂,
+    void zerosOperator(uint32_t *even, size_t len)
+    {
+        uint32_t odd[32];
+        odd[0] = kPoly; // 追加一个 0 比特,
+        uint32_t row = 1;
+        for (int n = 1; n < 32; ++n)
+        {
+            odd[n] = row;
+            row <<= 1;
+        }
+        gf2MatrixSquare(even, odd); // 2 个比特,
+        gf2MatrixSquare(odd, even); // 4 个比特,
+        // 每平方一次长度翻倍, 第一次进入循环的时候得到 1 个字节,
+        for (;;)
+        {
+            gf2MatrixSquare(even, odd);
+            len >>= 1;
+            if (0 == len)
+            {
+                return;
+            }
+            gf2MatrixSquare(odd, even);
+            len >>= 1;
+            if (0 == len)
+            {
+                ::memcpy(even, odd, sizeof odd);
+                return;
+            }
+        }
+    }
+
+    // 查表用的常量, 表驱动的实现和硬件实现合并三段的时候都要用,
+    struct Crc32cImpl
+    {
+        Crc32cImpl()
+        {
+            // slicing-by-8 的表, table[k][n] 是字节 n 后面再跟 k 个 0 字节的 crc,
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                uint32_t crc = n;
+                for (int k = 0; k < 8; ++k)
+                {
+                    crc = (crc & 1) ? (crc >> 1) ^ kPoly : crc >> 1;
+                }
+                table[0][n] = crc;
+            }
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                for (int k = 1; k < 8; ++k)
+                {
+                    table[k][n] = (table[k - 1][n] >> 8) ^ table[0][table[k - 1][n] & 0xff];
+                }
+            }
+            buildShiftTable(longShift, kLongBlock);
+            buildShiftTable(shortShift, kShortBlock);
+        }
+
+        // 把追加 len 个 0 字节的变换按照 crc 的 4 个字节拆成 4 张表, 合并的时候查 4 次表,
+        static void buildShiftTable(uint32_t shift[4][256], size_t len)
+        {
+            uint32_t op[32];
+            zerosOperator(op, len);
+            for (uint32_t n = 0; n < 256; ++n)
+            {
+                shift[0][n] = gf2MatrixTimes(op, n);
+                shift[1][n] = gf2MatrixTimes(op, n << 8);
+                shift[2][n] = gf2MatrixTimes(op, n << 16);
+                shift[3][n] = gf2MatrixTimes(op, n << 24);
+            }
+        }
+
+        uint32_t table[8][256];
+        uint32_t longShift[4][256];
+        uint32_t shortShift[4][256];
+    };
+
+    const Crc32cImpl &crc32cImpl();
+
+    uint32_t extendTable(uint32_t crc, const void *data, size_t len)
+    {
+        const uint32_t(*table)[256] = crc32cImpl().table;
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        uint32_t c = ~crc;
+        for (; len >= 8; p += 8, len -= 8)
+        {
+            uint64_t word = loadUint64(p) ^ c;
+            c = table[7][word & 0xff] ^ table[6][(word >> 8) & 0xff] ^ table[5][(word >> 16) & 0xff] ^
+                table[4][(word >> 24) & 0xff] ^ table[3][(word >> 32) & 0xff] ^ table[2][(word >> 40) & 0xff] ^
+                table[1][(word >> 48) & 0xff] ^ table[0][word >> 56];
+        }
+        for (; len > 0; ++p, --len)
+        {
+            c = (c >> 8) ^ table[0][(c ^ *p) & 0xff];
+        }
+        return ~c;
+    }
+
+#ifdef MYMUDUO_X86_CRC32C
+    inline uint32_t shiftCrc(const uint32_t shift[4][256], uint32_t crc)
+    {
+        return shift[0][crc & 0xff] ^ shift[1][(crc >> 8) & 0xff] ^ shift[2][(crc >> 16) & 0xff] ^ shift[3][crc >> 24];
+    }
+
+    // 三段各 block 字节同时计算, 三条 crc32 指令互不依赖, 可以流水起来,
+    __attribute__((target("sse4.2"))) inline uint64_t interleave3(uint64_t crc0, const unsigned char *p, size_t block,
+                                                                  const uint32_t shift[4][256])
+    {
+        uint64_t crc1 = 0;
+        uint64_t crc2 = 0;
+        const unsigned char *end = p + block;
+        do
+        {
+            crc0 = _mm_crc32_u64(crc0, loadUint64(p));
+            crc1 = _mm_crc32_u64(crc1, loadUint64(p + block));
+            crc2 = _mm_crc32_u64(crc2, loadUint64(p + 2 * block));
+            p += 8;
+        } while (p < end);
+        crc0 = shiftCrc(shift, static_cast<uint32_t>(crc0)) ^ crc1;
+        return shiftCrc(shift, static_cast<uint32_t>(crc0)) ^ crc2;
+    }
+
+    __attribute__((target("sse4.2"))) uint32_t extendSse42(uint32_t crc, const void *data, size_t len)
+    {
+        const Crc32cImpl &impl = crc32cImpl();
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        uint64_t c = ~crc;
+        for (; len > 0 && 0 != (reinterpret_cast<uintptr_t>(p) & 7); ++p, --len)
+        {
+            c = _mm_crc32_u8(static_cast<uint32_t>(c), *p);
+        }
+        for (; len >= 3 * kLongBlock; p += 3 * kLongBlock, len -= 3 * kLongBlock)
+        {
+            c = interleave3(c, p, kLongBlock, impl.longShift);
+        }
+        for (; len >= 3 * kShortBlock; p += 3 * kShortBlock, len -= 3 * kShortBlock)
+        {
+            c = interleave3(c, p, kShortBlock, impl.shortShift);
+        }
+        for (; len >= 8; p += 8, len -= 8)
+        {
+            c = _mm_crc32_u64(c, loadUint64(p));
+        }
+        for (; len > 0; ++p, --len)
+        {
+            c = _mm_crc32_u8(static_cast<uint32_t>(c), *p);
+        }
+        return ~static_cast<uint32_t>(c);
+    }
+#endif
+
+    // 函数里面的静态变量, 第一次调用的时候初始化, 不依赖全局对象的初始化顺序,
+    const Crc32cImpl &crc32cImpl()
+    {
+        static const Crc32cImpl impl;
+        return impl;
+    }
+
+    struct Dispatch
+    {
+        Dispatch() : extend(extendTable), name("table")
+        {
+#ifdef MYMUDUO_X86_CRC32C
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("sse4.2"))
+            {
+                extend = extendSse42;
+                name = "sse4.2";
+            }
+#endif
+        }
+
+        ExtendFunc extend;
+        const char *name;
+    };
+
+    const Dispatch &dispatch()
+    {
+        static const Dispatch d;
+        return d;
+    }
+}
+
+namespace crc32c
+{
+    uint32_t extend(uint32_t crc, const void *data, size_t len)
+    {
+        return dispatch().extend(crc, data, len);
+    }
+
+    uint32_t extendPortable(uint32_t crc, const void *data, size_t len)
+    {
+        return extendTable(crc, data, len);
+    }
+
+    const char *implementation()
+    {
+        return dispatch().name;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * CRC32C (Castagnoli, 多项式 0x1EDC6F41), 和 iSCSI/ext4/LevelDB 用的是同一个校验和,
+ * x86 上 CPU 支持 SSE4.2 的时候用 crc32 指令, 长数据分成三段交错计算, 隐藏指令 3 个周期的延迟, 最后用查表把三段合并,
+ * 其他情况用表驱动的 slicing-by-8, 一次处理 8 个字节,
+ * 选择在第一次调用之前完成一次, 之后每次调用只是一次函数指针调用,
+ */
+namespace crc32c
+{
+    // 在 crc 的基础上继续计算 data[0, len), 第一段传 0, 分段计算的结果和一次计算整段的结果相同,
+    uint32_t extend(uint32_t crc, const void *data, size_t len);
+
+    inline uint32_t value(const void *data, size_t len)
+    {
+        return extend(0, data, len);
+    }
+
+    // 表驱动的实现, 没有 SSE4.2 的时候 extend() 用的就是它,
+    uint32_t extendPortable(uint32_t crc, const void *data, size_t len);
+
+    // 当前选择的实现, "sse4.2" 或者 "table",
+    const char *implementation();
+}
@@ -146,6 +146,12 @@ void EPollPoller::updateChannel(Channel *channel)
             update(EPOLL_CTL_DEL, channel);
             channel->set_index(kDeleted);
         }
+        else if (channel->registrationFlags() & EPOLLEXCLUSIVE)
+        {
+            // EPOLLEXCLUSIVE 的注册不能 EPOLL_CTL_MOD, 删除以后重新添加,
+            update(EPOLL_CTL_DEL, channel);
+            update(EPOLL_CTL_ADD, channel);
+        }
         else
         {
             update(EPOLL_CTL_MOD, channel);
@@ -193,6 +199,14 @@ void EPollPoller::update(int operation, Channel *channel)
     bzero(&event, sizeof(event));
     int fd = channel->fd();
     event.events = channel->events();
+    if (EPOLL_CTL_ADD == operation)
+    {
+        event.events |= channel->registrationFlags(); // EPOLLEXCLUSIVE 只能在 EPOLL_CTL_ADD 的时候设置,
+    }
+    if (event.events & EPOLLEXCLUSIVE)
+    {
+        event.events &= ~EPOLLPRI; // 内核不允许 EPOLLEXCLUSIVE 和 EPOLLPRI 一起使用, listen socket 也没有带外数据,
+    }
     event.data.ptr = channel; // 调试崩溃, 定位到 channel* 地址问题,
     // event.data 是一个 union 联合体,  所以这里设置了  event.data.ptr = channel; 之后, 
     // 就不要再设置 event.data.fd = fd; 否则非法地址访问段错误,
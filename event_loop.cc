@@ -8,6 +8,7 @@
 
 #include "channel.h"
 #include "logger.h"
+#include "timer_queue.h"
 
 namespace
 {
@@ -37,6 +38,7 @@ EventLoop::EventLoop()
       poller_(Poller::newDefaultPoller(this)), // 智能指针自动析构,
       wakeupFd_(createEventFd()),
       wakeupChannel_(new Channel(this, wakeupFd_)), // 智能指针自动析构,
+      timerQueue_(new TimerQueue(this)),
                                                     //   currentActiveChannel_(nullptr),
       callingPendingFunctors_(false)
 {
@@ -148,6 +150,26 @@ void EventLoop::queueInLoop(Functor cb)
     }
 }
 
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    return runAt(addTime(Timestamp::now(), delay), std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), addTime(Timestamp::now(), interval), interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
 // 唤醒 loop 所在的线程, 向 wakeupFd 写一个数据, 来唤醒 wakeup,
 // 那么 wakeupChannel 就发生读事件,当前 loop 线程就会被唤醒,
 void EventLoop::wakeup()
@@ -8,11 +8,14 @@
 
 #include "current_thread.h"
 #include "noncopyable.h"
+#include "callbacks.h"
 #include "poller.h"
+#include "timer_id.h"
 #include "timestamp.h"
 
 class Channel;
 class Poller;
+class TimerQueue;
 
 // 事件循环类, Channel 、 Poller(epoll的抽象),
 class EventLoop : noncopyable
@@ -41,6 +44,16 @@ public:
     // 把 cb 返给到队列中, 唤醒 loop 所在的线程, 执行 cb, 如 subLoop2 里面去执行了 subLoop3 的 cb,
     void queueInLoop(Functor cb);
 
+    /**
+     * 定时器, 回调在 loop 线程里面执行, 可以在任意线程调用,
+     * runAt() 在 time 执行一次, runAfter() 在 delay 秒以后执行一次, runEvery() 每隔 interval 秒执行一次,
+     */
+    TimerId runAt(Timestamp time, TimerCallback cb);
+    TimerId runAfter(double delay, TimerCallback cb);
+    TimerId runEvery(double interval, TimerCallback cb);
+    // 取消定时器, 已经执行过的一次性定时器取消了也没有关系,
+    void cancel(TimerId timerId);
+
     // 唤醒 loop 所在的线程, 向 wakeupFd 写一个数据, 来唤醒 wakeup,
     void wakeup();
 
@@ -82,6 +95,7 @@ private:
     // muduo 采用的比较新, linux 内核比较新的, eventfd(unsigned int initval, int flags) 来完成 mainReactor 给 subReactor,
     int wakeupFd_;                           // 当 mianloop 获取一个新用户的channel, 通过轮询算法获取一个 subloop, 通过该成员变量 唤醒 subloop, 处理 channel,
     std::unique_ptr<Channel> wakeupChannel_; // 封装 wakeupFd_ 和 感兴趣的事件, 这样就把 wakeupFd_ 给到了 Channel,
+    std::unique_ptr<TimerQueue> timerQueue_; // timerfd 也注册到 poller_ 里面, 要在 poller_ 后面构造,
 
     ChannelList activeChannels_;
     // Channel *currentActiveChannel_;
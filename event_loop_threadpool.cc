@@ -1,14 +1,53 @@
+#include <errno.h>
+#include <sched.h>
+
 #include "event_loop_threadpool.h"
 
 #include "event_loop.h"
 #include "event_loop_thread.h"
+#include "logger.h"
+
+namespace
+{
+    // 进程可以使用的 CPU, 可能被 taskset/cgroup 限制, 不一定是 0 ~ n-1,
+    std::vector<int> allowedCpus()
+    {
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (0 == ::sched_getaffinity(0, sizeof(set), &set))
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &set))
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+        return cpus;
+    }
+
+    // 在 subLoop 线程里面调用, 把当前线程绑定到 cpu 上,
+    void pinCurrentThread(int cpu)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (0 != ::sched_setaffinity(0, sizeof(set), &set))
+        {
+            LOG_ERROR("sched_setaffinity cpu %d error:%d \n", cpu, errno);
+        }
+    }
+}
 
 EventLoopThreadpool::EventLoopThreadpool(EventLoop *baseLoop, const std::string &nameArg)
     : baseLoop_(baseLoop),
       name_(nameArg),
       started_(false),
       numThreads_(0),
-      next_(0)
+      next_(0),
+      cpuAffinity_(false)
 {
 }
 
@@ -25,11 +64,32 @@ void EventLoopThreadpool::start(const ThreadInitCallback &cb)
     }
     started_ = true;
 
+    std::vector<int> cpus;
+    if (cpuAffinity_)
+    {
+        cpus = allowedCpus();
+    }
+
     for (int i = 0; i < numThreads_; ++i)
     {
         char buf[name_.size() + 32] = {0};
         snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), i);
-        EventLoopThread *t = new EventLoopThread(cb, buf);
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        loopCpus_.push_back(cpu);
+        // 绑定 CPU 在 subLoop 线程里面做, 在用户的 ThreadInitCallback 之前,
+        ThreadInitCallback initCallback = cb;
+        if (cpu >= 0)
+        {
+            initCallback = [cpu, cb](EventLoop *loop)
+            {
+                pinCurrentThread(cpu);
+                if (cb)
+                {
+                    cb(loop);
+                }
+            };
+        }
+        EventLoopThread *t = new EventLoopThread(initCallback, buf);
         threads_.emplace_back(std::unique_ptr<EventLoopThread>(t));
         loops_.emplace_back(t->startLoop()); // t->startLoop() 底层创建线程, 绑定一个新的 EventLoop, 并返回该 loop 的地址,
     }
@@ -71,3 +131,24 @@ std::vector<EventLoop *> EventLoopThreadpool::getAllLoops()
         return loops_;
     }
 }
+
+EventLoop *EventLoopThreadpool::getLoopForCpu(int cpu) const
+{
+    for (size_t i = 0; i < loopCpus_.size(); ++i)
+    {
+        if (loopCpus_[i] == cpu)
+        {
+            return loops_[i];
+        }
+    }
+    return nullptr;
+}
+
+std::vector<int> EventLoopThreadpool::getLoopCpus() const
+{
+    if (loops_.empty())
+    {
+        return std::vector<int>(1, -1);
+    }
+    return loopCpus_;
+}
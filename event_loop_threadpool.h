@@ -21,6 +21,14 @@ public:
 
 public:
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+
+    /**
+     * 把第 i 个 subLoop 线程绑定到进程可以使用的第 i 个 CPU 上 (subLoop 比 CPU 多的时候循环使用), 在 start() 之前调用,
+     * 只有 subLoop 会绑定, setThreadNum(0) 的时候 baseLoop_ 是用户的线程, 不会绑定,
+     */
+    void setCpuAffinity(bool on) { cpuAffinity_ = on; }
+    bool cpuAffinity() const { return cpuAffinity_; }
+
     void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
     /**
@@ -30,6 +38,11 @@ public:
 
     std::vector<EventLoop *> getAllLoops();
 
+    // 绑定在 cpu 上的 subLoop, 没有的话返回 nullptr, 多个 subLoop 绑定在同一个 CPU 上的时候返回第一个,
+    EventLoop *getLoopForCpu(int cpu) const;
+    // getAllLoops() 里面每个 loop 绑定的 CPU, 没有绑定是 -1,
+    std::vector<int> getLoopCpus() const;
+
     bool started() const { return started_; }
     const std::string &name() const { return name_; }
 
@@ -46,4 +59,6 @@ private:
     int next_;
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop *> loops_;
+    bool cpuAffinity_;
+    std::vector<int> loopCpus_; // loops_[i] 绑定的 CPU,
 };
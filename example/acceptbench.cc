@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/tcp_server.h>
+
+/**
+ * 接受连接的速率: 服务器有 loops 个 subLoop, 连接建立以后发送 1 个字节,
+ * threads 个客户端线程, 每个线程循环 connects 次: connect(), 读到这个字节为止, close(),
+ * 打印每秒接受的连接数, 以及从 connect() 到读到数据的延迟分布,
+ * single    TcpServer::kSingleAcceptor, mainLoop accept() 以后交给 subLoop,
+ * reuseport TcpServer::kReusePortPerLoop, 每个 subLoop 自己的 SO_REUSEPORT listen socket,
+ * exclusive TcpServer::kExclusiveSharedListen, 共享一个 listen socket, 每个 subLoop 用 EPOLLEXCLUSIVE 注册,
+ * ./acceptbench [single|reuseport|exclusive] [threads] [connects] [loops] [port]
+ */
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // 返回 connect() 到读到数据的耗时 (微秒), 失败返回 -1,
+    double connectOnce(uint16_t port)
+    {
+        Clock::time_point start = Clock::now();
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        ::memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        char byte = 0;
+        bool ok = 0 == ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) &&
+                  1 == ::read(fd, &byte, 1);
+        ::close(fd);
+        return ok ? std::chrono::duration<double, std::micro>(Clock::now() - start).count() : -1;
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    TcpServer::AcceptMode mode = TcpServer::kSingleAcceptor;
+    const char *modeName = "single";
+    if (argc > 1 && 0 == ::strcmp(argv[1], "reuseport"))
+    {
+        mode = TcpServer::kReusePortPerLoop;
+        modeName = "reuseport";
+    }
+    else if (argc > 1 && 0 == ::strcmp(argv[1], "exclusive"))
+    {
+        mode = TcpServer::kExclusiveSharedListen;
+        modeName = "exclusive";
+    }
+    int threads = argc > 2 ? atoi(argv[2]) : 8;
+    int connects = argc > 3 ? atoi(argv[3]) : 1500;
+    int loops = argc > 4 ? atoi(argv[4]) : 4;
+    uint16_t port = argc > 5 ? static_cast<uint16_t>(atoi(argv[5])) : 7409;
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "AcceptServer");
+    server.setThreadNum(loops);
+    server.setAcceptMode(mode);
+    server.setConnectionCallback([](const TcpConnectionPtr &conn)
+                                 {
+                                     if (conn->connected())
+                                     {
+                                         conn->send("x");
+                                     }
+                                 });
+    server.start();
+
+    std::atomic<int> failures(0);
+    std::thread driver([&]
+                       {
+                           // subLoop 的 Acceptor 在各自的线程里面 listen(), 等它们都准备好,
+                           ::usleep(200 * 1000);
+                           std::vector<std::vector<double>> latencies(threads);
+                           Clock::time_point start = Clock::now();
+                           std::vector<std::thread> workers;
+                           for (int t = 0; t < threads; ++t)
+                           {
+                               workers.emplace_back([&, t]
+                                                    {
+                                                        for (int i = 0; i < connects; ++i)
+                                                        {
+                                                            double us = connectOnce(port);
+                                                            if (us < 0)
+                                                            {
+                                                                ++failures;
+                                                            }
+                                                            else
+                                                            {
+                                                                latencies[t].push_back(us);
+                                                            }
+                                                        }
+                                                    });
+                           }
+                           for (std::thread &w : workers)
+                           {
+                               w.join();
+                           }
+                           double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+                           std::vector<double> all;
+                           for (const std::vector<double> &v : latencies)
+                           {
+                               all.insert(all.end(), v.begin(), v.end());
+                           }
+                           std::sort(all.begin(), all.end());
+                           if (!all.empty())
+                           {
+                               printf("%-9s %d threads x %d connects, %d loops: %.0f conn/s, p50 %.0f us, p99 %.0f us, %d failed\n",
+                                      modeName, threads, connects, loops, all.size() / seconds, all[all.size() / 2],
+                                      all[all.size() * 99 / 100], failures.load());
+                           }
+                           loop.runInLoop([&loop] { loop.quit(); });
+                       });
+    loop.loop();
+    driver.join();
+
+    return 0;
+}
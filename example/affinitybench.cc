@@ -0,0 +1,152 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <netinet/in.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+
+/**
+ * CPU 亲和的效果: 三种接受连接的方式各跑两遍, TcpServer::setCpuAffinity() 打开和关闭,
+ * 服务器有 loops 个 subLoop, 收到什么回显什么, threads 个客户端线程, 每个线程循环 connects 次:
+ * connect(), 发送并读回 rounds 个 64 字节的请求, close(),
+ * 每个连接建立的时候在 subLoop 线程里面比较连接的 SO_INCOMING_CPU 和 subLoop 当前所在的 CPU (sched_getcpu()),
+ * 打印相同的连接数, 以及每秒的连接数和请求数,
+ * ./affinitybench [threads] [connects] [rounds] [loops] [port]
+ */
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const size_t kRequestSize = 64;
+
+    // 建立一个连接, 发送并读回 rounds 个请求, 成功返回 true,
+    bool runConnection(uint16_t port, int rounds)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        ::memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bool ok = 0 == ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr);
+        char request[kRequestSize];
+        ::memset(request, 'a', sizeof request);
+        char reply[kRequestSize];
+        for (int i = 0; ok && i < rounds; ++i)
+        {
+            ok = kRequestSize == static_cast<size_t>(::write(fd, request, sizeof request));
+            size_t got = 0;
+            while (ok && got < kRequestSize)
+            {
+                ssize_t n = ::read(fd, reply + got, sizeof reply - got);
+                ok = n > 0;
+                got += ok ? n : 0;
+            }
+        }
+        ::close(fd);
+        return ok;
+    }
+
+    struct Options
+    {
+        int threads;
+        int connects;
+        int rounds;
+        int loops;
+    };
+
+    void runOnce(TcpServer::AcceptMode mode, const char *modeName, bool affinity, const Options &options,
+                 uint16_t port)
+    {
+        EventLoop loop;
+        TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "AffinityServer");
+        server.setThreadNum(options.loops);
+        server.setAcceptMode(mode);
+        server.setCpuAffinity(affinity);
+        std::atomic<int> accepted(0);
+        std::atomic<int> matched(0);
+        server.setConnectionCallback([&](const TcpConnectionPtr &conn)
+                                     {
+                                         if (conn->connected())
+                                         {
+                                             // 连接回调在处理这个连接的 subLoop 线程里面,
+                                             ++accepted;
+                                             if (conn->incomingCpu() == ::sched_getcpu())
+                                             {
+                                                 ++matched;
+                                             }
+                                         }
+                                     });
+        server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) { conn->send(buf); });
+        server.start();
+
+        std::atomic<int> failures(0);
+        std::thread driver([&]
+                           {
+                               // subLoop 的 Acceptor 在各自的线程里面 listen(), 等它们都准备好,
+                               ::usleep(200 * 1000);
+                               Clock::time_point start = Clock::now();
+                               std::vector<std::thread> workers;
+                               for (int t = 0; t < options.threads; ++t)
+                               {
+                                   workers.emplace_back([&]
+                                                        {
+                                                            for (int i = 0; i < options.connects; ++i)
+                                                            {
+                                                                if (!runConnection(port, options.rounds))
+                                                                {
+                                                                    ++failures;
+                                                                }
+                                                            }
+                                                        });
+                               }
+                               for (std::thread &w : workers)
+                               {
+                                   w.join();
+                               }
+                               double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                               int total = options.threads * options.connects;
+                               printf("%-9s affinity %-3s: %.0f conn/s, %.0f requests/s, SO_INCOMING_CPU matched the loop's CPU "
+                                      "on %d/%d connections, %d failed\n",
+                                      modeName, affinity ? "on" : "off", total / seconds,
+                                      static_cast<double>(total) * options.rounds / seconds, matched.load(),
+                                      accepted.load(), failures.load());
+                               loop.runInLoop([&loop] { loop.quit(); });
+                           });
+        loop.loop();
+        driver.join();
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    Options options;
+    options.threads = argc > 1 ? atoi(argv[1]) : 4;
+    options.connects = argc > 2 ? atoi(argv[2]) : 500;
+    options.rounds = argc > 3 ? atoi(argv[3]) : 20;
+    options.loops = argc > 4 ? atoi(argv[4]) : static_cast<int>(std::thread::hardware_concurrency());
+    uint16_t port = argc > 5 ? static_cast<uint16_t>(atoi(argv[5])) : 7413;
+
+    const TcpServer::AcceptMode modes[] = {TcpServer::kSingleAcceptor, TcpServer::kReusePortPerLoop,
+                                           TcpServer::kExclusiveSharedListen};
+    const char *const names[] = {"single", "reuseport", "exclusive"};
+    // 每一遍用不同的端口, 上一遍的连接还在 TIME_WAIT,
+    for (int i = 0; i < 3; ++i)
+    {
+        runOnce(modes[i], names[i], true, options, static_cast<uint16_t>(port + 2 * i));
+        runOnce(modes[i], names[i], false, options, static_cast<uint16_t>(port + 2 * i + 1));
+    }
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <netinet/in.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+
+/**
+ * 每个连接的堆分配次数: 替换全局的 operator new 计数, 服务器有 loops 个 subLoop, 收到 1 个字节回复 1 个字节,
+ * 一个客户端线程用原始的 socket 循环 connect(), 写 1 个字节, 读回复, close(), 客户端自己不分配内存,
+ * 先跑 warmup 个连接让对象池、注册表和日志缓冲区达到稳定状态, 再统计 cycles 个连接期间的分配次数,
+ * 等服务器销毁完所有连接以后才读计数器, 所以包括连接建立、收发和关闭的整个生命周期,
+ * ./allocbench [cycles] [warmup] [loops] [port]
+ */
+
+namespace
+{
+    std::atomic<long> gAllocations(0);
+
+    bool churnOnce(uint16_t port)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        ::memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        char byte = 'c';
+        bool ok = 0 == ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) &&
+                  1 == ::write(fd, &byte, 1) && 1 == ::read(fd, &byte, 1);
+        ::close(fd);
+        return ok;
+    }
+}
+
+void *operator new(size_t size)
+{
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = ::malloc(size);
+    if (nullptr == p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { ::free(p); }
+void operator delete[](void *p) noexcept { ::free(p); }
+void operator delete(void *p, size_t) noexcept { ::free(p); }
+void operator delete[](void *p, size_t) noexcept { ::free(p); }
+
+int main(int argc, char const *argv[])
+{
+    int cycles = argc > 1 ? atoi(argv[1]) : 10000;
+    int warmup = argc > 2 ? atoi(argv[2]) : 1000;
+    int loops = argc > 3 ? atoi(argv[3]) : 1;
+    uint16_t port = argc > 4 ? static_cast<uint16_t>(atoi(argv[4])) : 7419;
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "AllocServer");
+    server.setThreadNum(loops);
+    std::atomic<int> closed(0);
+    server.setConnectionCallback([&closed](const TcpConnectionPtr &conn)
+                                 {
+                                     if (!conn->connected())
+                                     {
+                                         ++closed;
+                                     }
+                                 });
+    // 1 个字节的 std::string 在 SSO 里面, 回显本身不分配内存,
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+                              {
+                                  conn->send(buf->retrieveAllAsString());
+                              });
+    server.start();
+
+    std::thread driver([&]
+                       {
+                           ::usleep(200 * 1000);
+                           int failures = 0;
+                           for (int i = 0; i < warmup + cycles; ++i)
+                           {
+                               if (warmup == i)
+                               {
+                                   // 等预热的连接都关闭并且销毁 (connectDestroyed() 在关闭回调之后排队执行),
+                                   while (closed.load() < warmup)
+                                   {
+                                       ::usleep(1000);
+                                   }
+                                   ::usleep(100 * 1000);
+                                   gAllocations.store(0);
+                               }
+                               failures += churnOnce(port) ? 0 : 1;
+                           }
+                           while (closed.load() < warmup + cycles - failures)
+                           {
+                               ::usleep(1000);
+                           }
+                           ::usleep(100 * 1000);
+                           long allocations = gAllocations.load();
+                           printf("%d connections, %d loops: %ld allocations, %.1f per connection, %d failed\n",
+                                  cycles, loops, allocations, static_cast<double>(allocations) / cycles, failures);
+                           loop.runInLoop([&loop] { loop.quit(); });
+                       });
+    loop.loop();
+    driver.join();
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <mymuduo/timestamp.h>
+
+/**
+ * 压测程序共用的测量函数, 只有头文件, 每个压测程序 #include "bench_util.h" 就行, 不用改 Makefile,
+ */
+namespace bench_util
+{
+    // 进程到现在为止用掉的 CPU 时间 (秒), user/sys 不为空的时候分别给出用户态和内核态的部分,
+    inline double cpuSeconds(double *user = nullptr, double *sys = nullptr)
+    {
+        struct rusage usage;
+        ::getrusage(RUSAGE_SELF, &usage);
+        double userSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+        double sysSeconds = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+        if (nullptr != user)
+        {
+            *user = userSeconds;
+        }
+        if (nullptr != sys)
+        {
+            *sys = sysSeconds;
+        }
+        return userSeconds + sysSeconds;
+    }
+
+    // 进程当前的 RSS (KB), 读 /proc/self/status 的 VmRSS, 读不到返回 0,
+    inline long rssKb()
+    {
+        FILE *fp = ::fopen("/proc/self/status", "r");
+        if (nullptr == fp)
+        {
+            return 0;
+        }
+        char line[256];
+        long kb = 0;
+        while (nullptr != ::fgets(line, sizeof line, fp))
+        {
+            if (0 == ::strncmp(line, "VmRSS:", 6))
+            {
+                kb = atol(line + 6);
+                break;
+            }
+        }
+        ::fclose(fp);
+        return kb;
+    }
+
+    // 进程到现在为止 RSS 的峰值 (KB),
+    inline long peakRssKb()
+    {
+        struct rusage usage;
+        ::getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    // 从 start 到现在的秒数,
+    inline double secondsSince(Timestamp start)
+    {
+        return static_cast<double>(Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch()) /
+               Timestamp::kMicroSecondsPerSecond;
+    }
+}
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/payload.h>
+#include <mymuduo/tcp_client.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+
+#include "bench_util.h"
+
+/**
+ * 广播的内存和延迟: 服务器把 messages 条 messageSize 字节的消息广播给 subscribers 个连接,
+ * 订阅者先暂停读, 内核缓冲区满了以后剩下的数据都排在 TcpConnection 的发送队列里面,
+ * copy 每个连接 send(std::string), 没写完的部分拷贝进 outputBuffer_, payload 用同一个 PayloadPtr, 只记录偏移,
+ * 打印每次广播 (遍历所有连接调用 send) 的耗时, 排队的字节数和进程 RSS 的增长,
+ * 然后订阅者恢复读, 打印所有数据送达的时间,
+ * 订阅者和服务器在同一个进程里面, 每个订阅者占两个文件描述符, 个数受进程的文件描述符上限限制,
+ * ./broadcastbench [copy|payload] [subscribers] [messages] [messageSize] [port]
+ */
+
+namespace
+{
+    int64_t nowUs()
+    {
+        return Timestamp::now().microSecondsSinceEpoch();
+    }
+}
+
+class BroadcastBench
+{
+public:
+    BroadcastBench(EventLoop *loop, const InetAddress &addr, bool payload, int subscribers, int messages,
+                   int messageSize)
+        : loop_(loop),
+          payload_(payload),
+          subscribers_(subscribers),
+          messages_(messages),
+          messageSize_(messageSize),
+          addr_(addr),
+          server_(loop, addr, "BroadcastServer"),
+          connected_(0),
+          received_(0),
+          drainStartUs_(0)
+    {
+        // 内核发送缓冲区尽量小, 让数据排在用户态的发送队列里面,
+        TcpServer::SocketOptions options;
+        options.sendBufferSize = 4096;
+        server_.setSocketOptions(options);
+        server_.setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                      {
+                                          if (conn->connected())
+                                          {
+                                              serverConns_.push_back(conn);
+                                              onConnected();
+                                              connectMore();
+                                          }
+                                      });
+        server_.start();
+        connectMore();
+    }
+
+private:
+    // 一次发起太多 connect() 会把 listen 的队列挤满, 被丢掉的连接客户端以为建立了, 服务器却永远收不到,
+    // 所以服务器每 accept 一批再发起下一批,
+    void connectMore()
+    {
+        const int kBatch = 256;
+        while (static_cast<int>(clients_.size()) < std::min(subscribers_, static_cast<int>(serverConns_.size()) + kBatch))
+        {
+            std::unique_ptr<TcpClient> client(new TcpClient(loop_, addr_, "BroadcastSubscriber"));
+            client->setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                          {
+                                              if (conn->connected())
+                                              {
+                                                  conn->stopRead();
+                                                  clientConns_.push_back(conn);
+                                                  onConnected();
+                                              }
+                                          });
+            client->setMessageCallback([this](const TcpConnectionPtr &, Buffer *buf, Timestamp)
+                                       {
+                                           received_ += buf->readableBytes();
+                                           buf->retrieveAll();
+                                           if (received_ == expected())
+                                           {
+                                               report();
+                                           }
+                                       });
+            client->connect();
+            clients_.push_back(std::move(client));
+        }
+    }
+
+    long expected() const { return static_cast<long>(subscribers_) * messages_ * messageSize_; }
+
+    void onConnected()
+    {
+        // 两端各 subscribers_ 个连接都建立好了,
+        if (++connected_ == 2 * subscribers_)
+        {
+            loop_->queueInLoop(std::bind(&BroadcastBench::broadcast, this));
+        }
+    }
+
+    void broadcast()
+    {
+        std::string message(messageSize_, 'x');
+        long rssBefore = bench_util::rssKb();
+        std::vector<int64_t> costUs;
+        for (int m = 0; m < messages_; ++m)
+        {
+            int64_t start = nowUs();
+            if (payload_)
+            {
+                // 编码一次, 所有连接共享,
+                PayloadPtr payload = Payload::copyFrom(message.data(), message.size());
+                for (const TcpConnectionPtr &conn : serverConns_)
+                {
+                    conn->send(payload);
+                }
+            }
+            else
+            {
+                for (const TcpConnectionPtr &conn : serverConns_)
+                {
+                    conn->send(message);
+                }
+            }
+            costUs.push_back(nowUs() - start);
+        }
+        long rssAfter = bench_util::rssKb();
+
+        size_t queued = 0;
+        for (const TcpConnectionPtr &conn : serverConns_)
+        {
+            queued += conn->outputBytes();
+        }
+        std::sort(costUs.begin(), costUs.end());
+        printf("%s, %d subscribers, %d messages of %d bytes\n", payload_ ? "payload" : "copy", subscribers_,
+               messages_, messageSize_);
+        printf("broadcast call (ms): p50 %.2f  max %.2f\n", costUs[costUs.size() / 2] / 1000.0,
+               costUs.back() / 1000.0);
+        printf("queued in user space %.1f MB, RSS grew %.1f MB\n", queued / 1048576.0,
+               (rssAfter - rssBefore) / 1024.0);
+
+        drainStartUs_ = nowUs();
+        for (const TcpConnectionPtr &conn : clientConns_)
+        {
+            conn->startRead();
+        }
+    }
+
+    void report()
+    {
+        printf("all %.1f MB delivered %.1f ms after readers resumed\n", expected() / 1048576.0,
+               (nowUs() - drainStartUs_) / 1000.0);
+        loop_->quit();
+    }
+
+private:
+    EventLoop *loop_;
+    const bool payload_;
+    const int subscribers_;
+    const int messages_;
+    const int messageSize_;
+    const InetAddress addr_;
+    TcpServer server_;
+    std::vector<std::unique_ptr<TcpClient>> clients_;
+    std::vector<TcpConnectionPtr> serverConns_;
+    std::vector<TcpConnectionPtr> clientConns_;
+    int connected_;
+    long received_;
+    int64_t drainStartUs_;
+};
+
+int main(int argc, char const *argv[])
+{
+    bool payload = argc > 1 ? 0 == ::strcmp(argv[1], "payload") : true;
+    int subscribers = argc > 2 ? atoi(argv[2]) : 5000;
+    int messages = argc > 3 ? atoi(argv[3]) : 32;
+    int messageSize = argc > 4 ? atoi(argv[4]) : 4096;
+    uint16_t port = argc > 5 ? static_cast<uint16_t>(atoi(argv[5])) : 7400;
+
+    EventLoop loop;
+    BroadcastBench bench(&loop, InetAddress(port, "127.0.0.1"), payload, subscribers, messages, messageSize);
+    loop.loop();
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/tcp_server.h>
+
+/**
+ * 连接的建立/关闭速率: 服务器有 loops 个 subLoop, 收到 1 个字节回复 1 个字节,
+ * threads 个客户端线程, 每个线程循环 cycles 次: connect(), 写 1 个字节, 读回复, close(),
+ * 打印每秒完成的周期数, 以及一个周期的延迟分布, 服务器的注册表、名字和关闭路径都在这个循环里面,
+ * ./churnbench [threads] [cycles] [loops] [port]
+ */
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // 一个完整的周期, 返回耗时 (微秒), 失败返回 -1,
+    double churnOnce(uint16_t port)
+    {
+        Clock::time_point start = Clock::now();
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        ::memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        char byte = 'c';
+        bool ok = 0 == ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr) &&
+                  1 == ::write(fd, &byte, 1) && 1 == ::read(fd, &byte, 1);
+        ::close(fd);
+        return ok ? std::chrono::duration<double, std::micro>(Clock::now() - start).count() : -1;
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 8;
+    int cycles = argc > 2 ? atoi(argv[2]) : 1500;
+    int loops = argc > 3 ? atoi(argv[3]) : 4;
+    uint16_t port = argc > 4 ? static_cast<uint16_t>(atoi(argv[4])) : 7407;
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "ChurnServer");
+    server.setThreadNum(loops);
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+                              {
+                                  conn->send(buf->retrieveAllAsString());
+                              });
+    server.start();
+
+    std::atomic<int> failures(0);
+    std::thread driver([&]
+                       {
+                           std::vector<std::vector<double>> latencies(threads);
+                           Clock::time_point start = Clock::now();
+                           std::vector<std::thread> workers;
+                           for (int t = 0; t < threads; ++t)
+                           {
+                               workers.emplace_back([&, t]
+                                                    {
+                                                        for (int i = 0; i < cycles; ++i)
+                                                        {
+                                                            double us = churnOnce(port);
+                                                            if (us < 0)
+                                                            {
+                                                                ++failures;
+                                                            }
+                                                            else
+                                                            {
+                                                                latencies[t].push_back(us);
+                                                            }
+                                                        }
+                                                    });
+                           }
+                           for (std::thread &w : workers)
+                           {
+                               w.join();
+                           }
+                           double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+                           std::vector<double> all;
+                           for (const std::vector<double> &v : latencies)
+                           {
+                               all.insert(all.end(), v.begin(), v.end());
+                           }
+                           std::sort(all.begin(), all.end());
+                           if (!all.empty())
+                           {
+                               printf("%d threads x %d cycles, %d loops: %.0f conn/s, p50 %.0f us, p99 %.0f us, %d failed\n",
+                                      threads, cycles, loops, all.size() / seconds, all[all.size() / 2],
+                                      all[all.size() * 99 / 100], failures.load());
+                           }
+                           loop.runInLoop([&loop] { loop.quit(); });
+                       });
+    loop.loop();
+    driver.join();
+
+    return 0;
+}
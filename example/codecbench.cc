@@ -0,0 +1,193 @@
+#include <arpa/inet.h>
+#include <functional>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/length_header_codec.h>
+#include <mymuduo/tcp_client.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+
+#include "bench_util.h"
+
+/**
+ * 长度头部分帧的回显: 客户端保持 16 帧在路上, 服务器收到一帧就原样发回去, 一共 frames 帧, 打印每秒的帧数,
+ * codec 用 LengthHeaderCodec, 收的时候回调直接指向 inputBuffer_, 发的时候头部和消息体用 writev() 一次发出去,
+ * naive 手写的做法: memcpy() 读出长度头部, retrieveAsString() 拷贝出消息体, 再拼一个 "头部 + 消息体" 的 std::string 发送,
+ * 客户端和服务器在同一个 loop 里面,
+ * ./codecbench [codec|naive] [frameSize] [frames] [port]
+ */
+
+namespace
+{
+    const int kInFlight = 16;
+    const size_t kHeaderLen = sizeof(int32_t);
+
+    using FrameCallback = std::function<void(const TcpConnectionPtr &, const char *, size_t)>;
+
+    // naive 模式的收: 每一帧拷贝成 std::string 再回调,
+    void naiveOnMessage(const TcpConnectionPtr &conn, Buffer *buf, const FrameCallback &cb)
+    {
+        while (buf->readableBytes() >= kHeaderLen)
+        {
+            int32_t be32 = 0;
+            ::memcpy(&be32, buf->peek(), sizeof be32);
+            size_t len = static_cast<size_t>(ntohl(be32));
+            if (buf->readableBytes() < kHeaderLen + len)
+            {
+                break;
+            }
+            buf->retrieve(kHeaderLen);
+            std::string body = buf->retrieveAsString(len);
+            cb(conn, body.data(), body.size());
+        }
+    }
+
+    // naive 模式的发: 头部和消息体拼成一个 std::string,
+    void naiveSend(const TcpConnectionPtr &conn, const char *data, size_t len)
+    {
+        int32_t be32 = htonl(static_cast<int32_t>(len));
+        std::string frame(reinterpret_cast<const char *>(&be32), sizeof be32);
+        frame.append(data, len);
+        conn->send(frame);
+    }
+}
+
+class CodecBench
+{
+public:
+    CodecBench(EventLoop *loop, const InetAddress &addr, bool codec, size_t frameSize, int frames)
+        : loop_(loop),
+          codec_(codec),
+          frames_(frames),
+          sent_(0),
+          received_(0),
+          body_(frameSize, 'x'),
+          serverCodec_(std::bind(&CodecBench::onServerFrame, this, std::placeholders::_1, std::placeholders::_2,
+                                 std::placeholders::_3)),
+          clientCodec_(std::bind(&CodecBench::onClientFrame, this, std::placeholders::_1, std::placeholders::_2,
+                                 std::placeholders::_3)),
+          server_(loop, addr, "CodecServer"),
+          client_(loop, addr, "CodecClient")
+    {
+        server_.setMessageCallback([this](const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+                                   {
+                                       if (codec_)
+                                       {
+                                           serverCodec_.onMessage(conn, buf, receiveTime);
+                                       }
+                                       else
+                                       {
+                                           naiveOnMessage(conn, buf, std::bind(&CodecBench::onServerFrame, this,
+                                                                               std::placeholders::_1, std::placeholders::_2,
+                                                                               std::placeholders::_3));
+                                       }
+                                   });
+        server_.start();
+
+        client_.setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                      {
+                                          if (conn->connected())
+                                          {
+                                              start_ = Timestamp::now();
+                                              for (int i = 0; i < kInFlight && sent_ < frames_; ++i)
+                                              {
+                                                  sendFrame(conn);
+                                              }
+                                          }
+                                      });
+        client_.setMessageCallback([this](const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+                                   {
+                                       if (codec_)
+                                       {
+                                           clientCodec_.onMessage(conn, buf, receiveTime);
+                                       }
+                                       else
+                                       {
+                                           naiveOnMessage(conn, buf, std::bind(&CodecBench::onClientFrame, this,
+                                                                               std::placeholders::_1, std::placeholders::_2,
+                                                                               std::placeholders::_3));
+                                       }
+                                   });
+        client_.connect();
+    }
+
+private:
+    void onServerFrame(const TcpConnectionPtr &conn, const char *data, size_t len)
+    {
+        if (codec_)
+        {
+            serverCodec_.send(conn, data, len);
+        }
+        else
+        {
+            naiveSend(conn, data, len);
+        }
+    }
+
+    void onClientFrame(const TcpConnectionPtr &conn, const char *data, size_t len)
+    {
+        if (len != body_.size() || 'x' != data[0])
+        {
+            printf("bad frame of %zu bytes\n", len);
+        }
+        if (++received_ == frames_)
+        {
+            double seconds = bench_util::secondsSince(start_);
+            printf("%-5s %zu byte frames: %d frames in %.2f s, %.0f frames/s\n", codec_ ? "codec" : "naive",
+                   body_.size(), frames_, seconds, frames_ / seconds);
+            loop_->quit();
+        }
+        else if (sent_ < frames_)
+        {
+            sendFrame(conn);
+        }
+    }
+
+    // 消息体每次都从头放进 Buffer, 和业务代码先把消息序列化到 Buffer 里面再发送一样,
+    void sendFrame(const TcpConnectionPtr &conn)
+    {
+        ++sent_;
+        if (codec_)
+        {
+            Buffer body;
+            body.append(body_.data(), body_.size());
+            clientCodec_.send(conn, &body);
+        }
+        else
+        {
+            naiveSend(conn, body_.data(), body_.size());
+        }
+    }
+
+private:
+    EventLoop *loop_;
+    const bool codec_;
+    const int frames_;
+    int sent_;
+    int received_;
+    const std::string body_;
+    Timestamp start_;
+    LengthHeaderCodec serverCodec_;
+    LengthHeaderCodec clientCodec_;
+    TcpServer server_;
+    TcpClient client_;
+};
+
+int main(int argc, char const *argv[])
+{
+    bool codec = argc > 1 ? 0 == ::strcmp(argv[1], "codec") : true;
+    size_t frameSize = argc > 2 ? static_cast<size_t>(atol(argv[2])) : 64;
+    int frames = argc > 3 ? atoi(argv[3]) : 1000000;
+    uint16_t port = argc > 4 ? static_cast<uint16_t>(atoi(argv[4])) : 7411;
+
+    EventLoop loop;
+    CodecBench bench(&loop, InetAddress(port, "127.0.0.1"), codec, frameSize, frames);
+    loop.loop();
+
+    return 0;
+}
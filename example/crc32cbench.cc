@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <chrono>
+#include <endian.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include <mymuduo/buffer.h>
+#include <mymuduo/crc32c.h>
+
+/**
+ * CRC32C 的吞吐 (GB/s):
+ *   1. 不同长度的数据上表驱动实现和当前选择的实现 (SSE4.2) 的吞吐,
+ *   2. 按 LengthHeaderCodec 的方式收帧: 数据经过 socketpair 和 Buffer::readFd(), 比较不校验、
+ *      readFd() 里面边读边算 (Buffer::beginCrc32c()) 和整帧到齐以后再遍历一遍计算三种方式,
+ * ./crc32cbench [frameSize] [totalMB]
+ */
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double secondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // 长度为 len 的数据反复计算, 总共大约 totalBytes 字节,
+    double measure(uint32_t (*extend)(uint32_t, const void *, size_t), const std::vector<char> &data, size_t len,
+                   size_t totalBytes)
+    {
+        size_t rounds = totalBytes / len + 1;
+        uint32_t crc = 0;
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < rounds; ++i)
+        {
+            crc = extend(crc, data.data(), len);
+        }
+        double seconds = secondsSince(start);
+        if (0x12345678 == crc)
+        {
+            printf(" ");
+        }
+        return rounds * len / seconds / 1e9;
+    }
+
+    enum Mode
+    {
+        kNone,
+        kIncremental,
+        kSecondPass,
+    };
+
+    /**
+     * 发送端每次写 64K, 接收端 readFd() 以后像 LengthHeaderCodec 一样解析: 4 字节长度 + 消息体 + 4 字节 CRC32C,
+     * 一个线程里面交替写和读, 测的是接收端处理的字节数除以总时间, 所以发送端的 write() 也算在里面,
+     */
+    double receiveFrames(Mode mode, size_t frameSize, size_t totalBytes)
+    {
+        int fds[2];
+        if (0 != ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds))
+        {
+            perror("socketpair");
+            exit(1);
+        }
+
+        // 构造一帧, 后面的帧都一样,
+        std::string frame;
+        uint32_t be32 = htobe32(static_cast<uint32_t>(frameSize));
+        frame.append(reinterpret_cast<const char *>(&be32), sizeof be32);
+        for (size_t i = 0; i < frameSize; ++i)
+        {
+            frame.push_back(static_cast<char>(i * 131 + 7));
+        }
+        uint32_t crcBe32 = htobe32(crc32c::value(frame.data(), frame.size()));
+        frame.append(reinterpret_cast<const char *>(&crcBe32), sizeof crcBe32);
+
+        const size_t kChunk = 64 * 1024;
+        size_t frames = totalBytes / frame.size() + 1;
+        size_t sent = 0;
+        size_t received = 0;
+        size_t bad = 0;
+        Buffer buf;
+        int savedErrno = 0;
+
+        Clock::time_point start = Clock::now();
+        while (received < frames)
+        {
+            if (sent < frames * frame.size())
+            {
+                size_t offset = sent % frame.size();
+                size_t n = std::min(kChunk, frame.size() - offset);
+                ssize_t nw = ::write(fds[1], frame.data() + offset, n);
+                sent += nw > 0 ? nw : 0;
+            }
+            buf.readFd(fds[0], &savedErrno);
+
+            while (buf.readableBytes() >= 4)
+            {
+                size_t len = static_cast<size_t>(buf.peekInt32());
+                if (kIncremental == mode && !buf.crc32cPending())
+                {
+                    buf.beginCrc32c(0, 4 + len);
+                }
+                if (buf.readableBytes() < 4 + len + 4)
+                {
+                    break;
+                }
+                uint32_t expected = 0;
+                ::memcpy(&expected, buf.peek() + 4 + len, sizeof expected);
+                expected = be32toh(expected);
+                if (kIncremental == mode && buf.finishCrc32c() != expected)
+                {
+                    ++bad;
+                }
+                else if (kSecondPass == mode && crc32c::value(buf.peek(), 4 + len) != expected)
+                {
+                    ++bad;
+                }
+                buf.retrieve(4 + len + 4);
+                ++received;
+            }
+        }
+        double seconds = secondsSince(start);
+        ::close(fds[0]);
+        ::close(fds[1]);
+        if (bad > 0)
+        {
+            printf("%zu bad frames\n", bad);
+        }
+        return frames * frame.size() / seconds / 1e9;
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    size_t frameSize = argc > 1 ? static_cast<size_t>(atol(argv[1])) : 4 * 1024 * 1024;
+    size_t totalBytes = (argc > 2 ? static_cast<size_t>(atol(argv[2])) : 2048) * 1024 * 1024;
+
+    std::vector<char> data(1024 * 1024);
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        data[i] = static_cast<char>(rand());
+    }
+
+    printf("crc32c implementation: %s\n", crc32c::implementation());
+    printf("%10s %12s %12s\n", "bytes", "table GB/s", "extend GB/s");
+    const size_t lengths[] = {64, 512, 4096, 65536, 1024 * 1024};
+    for (size_t len : lengths)
+    {
+        double table = measure(crc32c::extendPortable, data, len, totalBytes / 4);
+        double selected = measure(crc32c::extend, data, len, totalBytes);
+        printf("%10zu %12.2f %12.2f\n", len, table, selected);
+    }
+
+    printf("\nreceive %zu byte frames through socketpair + Buffer::readFd():\n", frameSize);
+    printf("  no checksum          %.2f GB/s\n", receiveFrames(kNone, frameSize, totalBytes));
+    printf("  crc32c in readFd()   %.2f GB/s\n", receiveFrames(kIncremental, frameSize, totalBytes));
+    printf("  crc32c second pass   %.2f GB/s\n", receiveFrames(kSecondPass, frameSize, totalBytes));
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <stdlib.h>
+#include <string>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/http_request.h>
+#include <mymuduo/http_response.h>
+#include <mymuduo/http_server.h>
+#include <mymuduo/logger.h>
+
+/**
+ * HTTP 的基准测试服务器,
+ * GET /hello 回复 "hello, world!\n", POST /echo 把请求体原样返回, 其他路径 404,
+ * ./httpserver [port] [threads]
+ * wrk -t4 -c100 -d10s http://127.0.0.1:8000/hello
+ */
+void onRequest(const HttpRequest &req, HttpResponse *resp)
+{
+    if (req.path() == "/hello")
+    {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setContentType("text/plain");
+        resp->setBody("hello, world!\n");
+    }
+    else if (req.path() == "/echo" && HttpRequest::kPost == req.method())
+    {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setContentType("application/octet-stream");
+        resp->setBody(req.body().asString());
+    }
+    else
+    {
+        resp->setStatusCode(HttpResponse::k404NotFound);
+        resp->setCloseConnection(true);
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 8000;
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    EventLoop loop;
+    HttpServer server(&loop, InetAddress(port, "0.0.0.0"), "HttpServer");
+    TcpServer::SocketOptions options;
+    options.tcpNoDelay = true;
+    server.tcpServer().setSocketOptions(options);
+    server.setHttpCallback(onRequest);
+    server.setThreadNum(threads);
+    server.start();
+    loop.loop();
+
+    return 0;
+}
@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/uio.h>
+#include <vector>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/lz4_block.h>
+#include <mymuduo/lz4_transform.h>
+#include <mymuduo/tcp_client.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+
+/**
+ * 1. LZ4 块压缩/解压的吞吐和压缩率, 数据是 JSON 日志、随机字节和重复文本,
+ * 2. 端到端: 同一个 loop 里面的客户端不停地发送 messageSize 字节的 JSON 日志, 服务器收下丢掉,
+ *    raw 不设置变换, lz4 两端设置 Lz4Transform, 打印应用层的吞吐和实际写到 socket 的字节数,
+ * ./lz4bench [raw|lz4] [messageSize] [seconds] [threshold] [port]
+ */
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double secondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // 服务之间常见的 JSON 日志, 字段名重复, 值有一定的随机性,
+    std::string jsonLogs(size_t len)
+    {
+        static const char *const kLevels[] = {"INFO", "WARN", "DEBUG", "ERROR"};
+        static const char *const kPaths[] = {"/api/v1/orders", "/api/v1/users", "/api/v2/cart/items", "/healthz"};
+        std::string out;
+        char line[512];
+        unsigned seed = 12345;
+        while (out.size() < len)
+        {
+            seed = seed * 1103515245 + 12345;
+            int n = snprintf(line, sizeof line,
+                             "{\"ts\":\"2024-05-%02u T%02u:%02u:%02u.%03uZ\",\"level\":\"%s\",\"service\":\"order-gateway\","
+                             "\"path\":\"%s\",\"status\":%u,\"latency_ms\":%u,\"request_id\":\"%08x-%04x\","
+                             "\"user_id\":%u,\"region\":\"us-east-1\"}\n",
+                             seed % 28 + 1, seed % 24, (seed >> 5) % 60, (seed >> 11) % 60, (seed >> 3) % 1000,
+                             kLevels[(seed >> 7) % 4], kPaths[(seed >> 9) % 4], 200 + (seed >> 13) % 3 * 100,
+                             (seed >> 4) % 250, seed, (seed >> 16) & 0xffff, (seed >> 8) % 100000);
+            out.append(line, n);
+        }
+        out.resize(len);
+        return out;
+    }
+
+    std::string randomBytes(size_t len)
+    {
+        std::string out(len, 0);
+        for (size_t i = 0; i < len; ++i)
+        {
+            out[i] = static_cast<char>(rand());
+        }
+        return out;
+    }
+
+    std::string repeatedText(size_t len)
+    {
+        std::string out;
+        while (out.size() < len)
+        {
+            out.append("The quick brown fox jumps over the lazy dog. ");
+        }
+        out.resize(len);
+        return out;
+    }
+
+    void benchBlock(const char *name, const std::string &data)
+    {
+        const size_t kChunk = Lz4Transform::kMaxChunk;
+        std::vector<char> compressed(lz4::compressBound(kChunk));
+        std::vector<char> restored(kChunk);
+        size_t rounds = 200 * 1024 * 1024 / data.size() + 1;
+
+        size_t compressedBytes = 0;
+        Clock::time_point start = Clock::now();
+        for (size_t r = 0; r < rounds; ++r)
+        {
+            for (size_t off = 0; off < data.size(); off += kChunk)
+            {
+                compressedBytes += lz4::compress(data.data() + off, std::min(kChunk, data.size() - off), compressed.data());
+            }
+        }
+        double compressSeconds = secondsSince(start);
+
+        // 只解压第一块, 反复解压, 压缩以后的数据在上面的循环里面已经覆盖了, 这里重新压一次,
+        size_t firstLen = std::min(kChunk, data.size());
+        size_t firstCompressed = lz4::compress(data.data(), firstLen, compressed.data());
+        size_t decompressRounds = rounds * data.size() / firstLen;
+        bool ok = true;
+        start = Clock::now();
+        for (size_t r = 0; r < decompressRounds; ++r)
+        {
+            ok = lz4::decompress(compressed.data(), firstCompressed, restored.data(), firstLen) && ok;
+        }
+        double decompressSeconds = secondsSince(start);
+        ok = ok && 0 == ::memcmp(restored.data(), data.data(), firstLen);
+
+        double total = static_cast<double>(rounds) * data.size();
+        printf("%-8s ratio %5.2f  compress %7.1f MB/s  decompress %7.1f MB/s%s\n", name, total / compressedBytes,
+               total / compressSeconds / 1e6, static_cast<double>(decompressRounds) * firstLen / decompressSeconds / 1e6,
+               ok ? "" : "  ROUND TRIP FAILED");
+    }
+}
+
+class TransformBench
+{
+public:
+    TransformBench(EventLoop *loop, const InetAddress &addr, bool lz4, size_t messageSize, double seconds,
+                   size_t threshold)
+        : loop_(loop),
+          lz4_(lz4),
+          threshold_(threshold),
+          seconds_(seconds),
+          corpus_(jsonLogs(16 * 1024 * 1024)),
+          messageSize_(messageSize),
+          corpusOffset_(0),
+          received_(0),
+          sentRaw_(0),
+          running_(true),
+          server_(loop, addr, "Lz4BenchServer"),
+          client_(loop, addr, "Lz4BenchClient")
+    {
+        server_.setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                      {
+                                          if (conn->connected() && lz4_)
+                                          {
+                                              conn->setTransform(std::make_shared<Lz4Transform>(threshold_));
+                                          }
+                                      });
+        server_.setMessageCallback([this](const TcpConnectionPtr &, Buffer *buf, Timestamp)
+                                   {
+                                       received_ += buf->readableBytes();
+                                       buf->retrieveAll();
+                                   });
+        server_.start();
+
+        client_.setConnectionCallback(std::bind(&TransformBench::onConnection, this, std::placeholders::_1));
+        client_.setWriteCompleteCallback([this](const TcpConnectionPtr &conn) { sendBatch(conn); });
+        client_.connect();
+    }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if (!conn->connected())
+        {
+            return;
+        }
+        if (lz4_)
+        {
+            transform_ = std::make_shared<Lz4Transform>(threshold_);
+            conn->setTransform(transform_);
+        }
+        start_ = Clock::now();
+        loop_->runAfter(seconds_, std::bind(&TransformBench::report, this));
+        sendBatch(conn);
+    }
+
+    // 一直发送到积压了 1MB 为止, 发送缓冲区清空以后 (WriteCompleteCallback) 再继续,
+    void sendBatch(const TcpConnectionPtr &conn)
+    {
+        while (running_ && conn->connected() && conn->outputBytes() < 1024 * 1024)
+        {
+            if (corpusOffset_ + messageSize_ > corpus_.size())
+            {
+                corpusOffset_ = 0;
+            }
+            struct iovec vec;
+            vec.iov_base = const_cast<char *>(corpus_.data() + corpusOffset_);
+            vec.iov_len = messageSize_;
+            conn->send(&vec, 1);
+            corpusOffset_ += messageSize_;
+            sentRaw_ += messageSize_;
+        }
+    }
+
+    void report()
+    {
+        running_ = false;
+        double seconds = secondsSince(start_);
+        uint64_t wire = transform_ ? transform_->encodedWireBytes() : sentRaw_;
+        uint64_t raw = transform_ ? transform_->encodedRawBytes() : sentRaw_;
+        printf("%s, %zu byte messages: delivered %.1f MB/s to the application, wrote %.1f MB for %.1f MB sent "
+               "(%.1f%% of the raw bytes on the wire)\n",
+               lz4_ ? "lz4" : "raw", messageSize_, received_ / seconds / 1e6, wire / 1e6, raw / 1e6,
+               100.0 * wire / raw);
+        loop_->quit();
+    }
+
+private:
+    EventLoop *loop_;
+    const bool lz4_;
+    const size_t threshold_;
+    const double seconds_;
+    const std::string corpus_;
+    const size_t messageSize_;
+    size_t corpusOffset_;
+    uint64_t received_;
+    uint64_t sentRaw_;
+    bool running_;
+    Clock::time_point start_;
+    std::shared_ptr<Lz4Transform> transform_;
+    TcpServer server_;
+    TcpClient client_;
+};
+
+int main(int argc, char const *argv[])
+{
+    bool lz4 = argc > 1 ? 0 == ::strcmp(argv[1], "lz4") : true;
+    size_t messageSize = argc > 2 ? static_cast<size_t>(atol(argv[2])) : 4096;
+    double seconds = argc > 3 ? atof(argv[3]) : 5;
+    size_t threshold = argc > 4 ? static_cast<size_t>(atol(argv[4])) : Lz4Transform::kDefaultThreshold;
+    uint16_t port = argc > 5 ? static_cast<uint16_t>(atoi(argv[5])) : 7300;
+
+    benchBlock("json", jsonLogs(4 * 1024 * 1024));
+    benchBlock("text", repeatedText(4 * 1024 * 1024));
+    benchBlock("random", randomBytes(4 * 1024 * 1024));
+
+    EventLoop loop;
+    TransformBench bench(&loop, InetAddress(port, "127.0.0.1"), lz4, messageSize, seconds, threshold);
+    loop.loop();
+
+    return 0;
+}
@@ -0,0 +1,242 @@
+#include <functional>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/logger.h>
+#include <mymuduo/mux_session.h>
+#include <mymuduo/mux_stream.h>
+#include <mymuduo/tcp_client.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+
+/**
+ * 比较 1 个 TCP 连接上面 N 个 MuxStream 和 N 个 TCP 连接, 服务器和客户端在同一个 loop 里面,
+ * 每个流 (或者连接) 发送 messageSize 字节, 服务器原样送回, 收齐以后再发下一个,
+ * 跑 seconds 秒以后打印回显的吞吐, 进程的 RSS 和内核 TCP 缓冲区占用的内存 (/proc/net/sockstat) 的增量,
+ * ./muxbench [mux|tcp] [streams] [seconds] [messageSize] [port]
+ */
+
+namespace
+{
+    long residentKb()
+    {
+        long pages = 0;
+        long resident = 0;
+        FILE *fp = ::fopen("/proc/self/statm", "r");
+        if (fp)
+        {
+            if (2 != ::fscanf(fp, "%ld %ld", &pages, &resident))
+            {
+                resident = 0;
+            }
+            ::fclose(fp);
+        }
+        return resident * (::sysconf(_SC_PAGESIZE) / 1024);
+    }
+
+    // /proc/net/sockstat 里面 "TCP: ... mem N" 的 N, 单位是页,
+    long tcpMemKb()
+    {
+        long mem = 0;
+        char line[256];
+        FILE *fp = ::fopen("/proc/net/sockstat", "r");
+        if (fp)
+        {
+            while (::fgets(line, sizeof line, fp))
+            {
+                const char *p = ::strstr(line, " mem ");
+                if (0 == ::strncmp(line, "TCP:", 4) && p)
+                {
+                    mem = ::atol(p + 5);
+                }
+            }
+            ::fclose(fp);
+        }
+        return mem * (::sysconf(_SC_PAGESIZE) / 1024);
+    }
+}
+
+class MuxBench
+{
+public:
+    struct Options
+    {
+        bool mux;
+        int streams;
+        double seconds;
+        int messageSize;
+    };
+
+    MuxBench(EventLoop *loop, const InetAddress &addr, const Options &options)
+        : loop_(loop),
+          options_(options),
+          server_(loop, addr, "MuxBenchServer"),
+          message_(options.messageSize, 'm'),
+          transferred_(0),
+          running_(false),
+          baseRss_(residentKb()),
+          baseTcpMem_(tcpMemKb())
+    {
+        server_.setConnectionCallback(std::bind(&MuxBench::onServerConnection, this, std::placeholders::_1));
+        server_.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) { conn->send(buf); });
+        server_.start();
+
+        int clients = options_.mux ? 1 : options_.streams;
+        for (int i = 0; i < clients; ++i)
+        {
+            std::unique_ptr<TcpClient> client(new TcpClient(loop, addr, "MuxBenchClient"));
+            client->setConnectionCallback(std::bind(&MuxBench::onClientConnection, this, std::placeholders::_1));
+            client->setMessageCallback([this](const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+                                       { onEcho(conn.get(), buf); });
+            client->connect();
+            clients_.push_back(std::move(client));
+        }
+    }
+
+private:
+    // 一个流或者一个连接上面还没有收齐的字节数,
+    struct Flow
+    {
+        size_t remaining;
+        MuxStreamPtr stream;
+        TcpConnection *conn;
+    };
+
+    void onServerConnection(const TcpConnectionPtr &conn)
+    {
+        if (!options_.mux || !conn->connected())
+        {
+            return;
+        }
+        MuxSessionPtr session = MuxSession::attach(conn, MuxSession::kServer);
+        session->setNewStreamCallback([](const MuxStreamPtr &stream)
+                                      {
+                                          stream->setMessageCallback([](const MuxStreamPtr &s, Buffer *buf)
+                                                                     { s->send(buf); });
+                                      });
+    }
+
+    void onClientConnection(const TcpConnectionPtr &conn)
+    {
+        if (!conn->connected())
+        {
+            return;
+        }
+        if (!options_.mux)
+        {
+            flows_.push_back(Flow{0, MuxStreamPtr(), conn.get()});
+            conn->setContext(std::make_shared<size_t>(flows_.size() - 1));
+            if (static_cast<int>(flows_.size()) == options_.streams)
+            {
+                start();
+            }
+            return;
+        }
+
+        session_ = MuxSession::attach(conn, MuxSession::kClient);
+        flows_.reserve(options_.streams);
+        for (int i = 0; i < options_.streams; ++i)
+        {
+            MuxStreamPtr stream = session_->openStream();
+            size_t index = flows_.size();
+            flows_.push_back(Flow{0, stream, nullptr});
+            stream->setMessageCallback([this, index](const MuxStreamPtr &, Buffer *buf) { onData(index, buf); });
+        }
+        start();
+    }
+
+    void start()
+    {
+        running_ = true;
+        start_ = Timestamp::now();
+        loop_->runAfter(options_.seconds, std::bind(&MuxBench::report, this));
+        for (size_t i = 0; i < flows_.size(); ++i)
+        {
+            sendMessage(i);
+        }
+    }
+
+    void sendMessage(size_t index)
+    {
+        Flow &flow = flows_[index];
+        flow.remaining = message_.size();
+        if (flow.stream)
+        {
+            flow.stream->send(message_);
+        }
+        else
+        {
+            flow.conn->send(message_);
+        }
+    }
+
+    void onEcho(TcpConnection *conn, Buffer *buf)
+    {
+        if (options_.mux)
+        {
+            return; // MuxSession 接管了连接的回调, 不会走到这里,
+        }
+        onData(*static_cast<size_t *>(conn->getContext().get()), buf);
+    }
+
+    void onData(size_t index, Buffer *buf)
+    {
+        Flow &flow = flows_[index];
+        size_t n = buf->readableBytes();
+        buf->retrieveAll();
+        transferred_ += n;
+        flow.remaining = n >= flow.remaining ? 0 : flow.remaining - n;
+        if (0 == flow.remaining && running_)
+        {
+            sendMessage(index);
+        }
+    }
+
+    void report()
+    {
+        running_ = false;
+        double seconds = static_cast<double>(Timestamp::now().microSecondsSinceEpoch() - start_.microSecondsSinceEpoch()) /
+                         Timestamp::kMicroSecondsPerSecond;
+        printf("%s: %d %s, %d byte messages\n", options_.mux ? "mux" : "tcp", options_.streams,
+               options_.mux ? "streams over 1 connection" : "connections", options_.messageSize);
+        printf("echoed %.1f MB/s, rss +%ld KB, kernel tcp mem +%ld KB\n",
+               transferred_ / seconds / 1e6, residentKb() - baseRss_, tcpMemKb() - baseTcpMem_);
+        loop_->quit();
+    }
+
+private:
+    EventLoop *loop_;
+    const Options options_;
+    TcpServer server_;
+    const std::string message_;
+    std::vector<std::unique_ptr<TcpClient>> clients_;
+    MuxSessionPtr session_;
+    std::vector<Flow> flows_;
+    long transferred_;
+    bool running_;
+    Timestamp start_;
+    long baseRss_;
+    long baseTcpMem_;
+};
+
+int main(int argc, char const *argv[])
+{
+    MuxBench::Options options;
+    options.mux = argc > 1 ? 0 == ::strcmp(argv[1], "mux") : true;
+    options.streams = argc > 2 ? atoi(argv[2]) : 500;
+    options.seconds = argc > 3 ? atof(argv[3]) : 10;
+    options.messageSize = argc > 4 ? atoi(argv[4]) : 4096;
+    uint16_t port = argc > 5 ? static_cast<uint16_t>(atoi(argv[5])) : 7100;
+
+    EventLoop loop;
+    MuxBench bench(&loop, InetAddress(port, "127.0.0.1"), options);
+    loop.loop();
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <functional>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+#include <mymuduo/upstream_pool.h>
+
+/**
+ * 上游连接池的请求延迟: 一个请求是 acquire() 一个到后端的连接, 发送 4 字节, 收到回显以后 release(),
+ * 请求一个接一个地发, 一共 requests 个, 打印平均值、p50 和 p99,
+ * fresh  maxIdlePerBackend = 0, release() 以后连接就关闭, 每个请求都要重新建立连接,
+ * pooled 默认的 Options, 连接放回空闲列表, 下一个请求直接复用,
+ * 回显的后端在 fork() 出来的子进程里面,
+ * ./poolbench [fresh|pooled] [requests] [port]
+ */
+
+namespace
+{
+    const size_t kRequestSize = 4;
+
+    double microSecondsSince(Timestamp start)
+    {
+        return static_cast<double>(Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch());
+    }
+
+    void runBackend(const InetAddress &addr)
+    {
+        EventLoop loop;
+        TcpServer server(&loop, addr, "PoolBackend");
+        server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+                                  {
+                                      conn->send(buf->retrieveAllAsString());
+                                  });
+        server.start();
+        loop.loop();
+    }
+}
+
+class PoolBench
+{
+public:
+    PoolBench(EventLoop *loop, const InetAddress &backend, bool pooled, int requests)
+        : loop_(loop),
+          backend_(backend),
+          pooled_(pooled),
+          requests_(requests),
+          pool_(loop, makeOptions(pooled))
+    {
+        latencies_.reserve(requests);
+        pool_.setMessageCallback(std::bind(&PoolBench::onMessage, this, std::placeholders::_1,
+                                           std::placeholders::_2));
+        // 后端可能还没有 listen(), 等它一下,
+        loop_->runAfter(0.2, std::bind(&PoolBench::next, this));
+    }
+
+private:
+    static UpstreamPool::Options makeOptions(bool pooled)
+    {
+        UpstreamPool::Options options;
+        if (!pooled)
+        {
+            options.maxIdlePerBackend = 0;
+        }
+        return options;
+    }
+
+    void next()
+    {
+        start_ = Timestamp::now();
+        pool_.acquire(backend_, [this](const TcpConnectionPtr &conn)
+                      {
+                          if (!conn)
+                          {
+                              printf("acquire failed after %zu requests\n", latencies_.size());
+                              loop_->quit();
+                              return;
+                          }
+                          conn->send(std::string(kRequestSize, 'p'));
+                      });
+    }
+
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf)
+    {
+        if (buf->readableBytes() < kRequestSize)
+        {
+            return;
+        }
+        buf->retrieve(kRequestSize);
+        pool_.release(conn);
+        latencies_.push_back(microSecondsSince(start_));
+        if (static_cast<int>(latencies_.size()) < requests_)
+        {
+            next();
+        }
+        else
+        {
+            report();
+        }
+    }
+
+    void report()
+    {
+        double sum = 0;
+        for (double us : latencies_)
+        {
+            sum += us;
+        }
+        std::vector<double> sorted(latencies_);
+        std::sort(sorted.begin(), sorted.end());
+        printf("%-6s %d requests: avg %.1f us, p50 %.1f us, p99 %.1f us, %zu connections left open\n",
+               pooled_ ? "pooled" : "fresh", requests_, sum / sorted.size(), sorted[sorted.size() / 2],
+               sorted[sorted.size() * 99 / 100], pool_.totalConnections());
+        loop_->quit();
+    }
+
+private:
+    EventLoop *loop_;
+    const InetAddress backend_;
+    const bool pooled_;
+    const int requests_;
+    Timestamp start_;
+    std::vector<double> latencies_;
+    UpstreamPool pool_;
+};
+
+int main(int argc, char const *argv[])
+{
+    bool pooled = argc > 1 ? 0 == ::strcmp(argv[1], "pooled") : true;
+    int requests = argc > 2 ? atoi(argv[2]) : 10000;
+    uint16_t port = argc > 3 ? static_cast<uint16_t>(atoi(argv[3])) : 7408;
+    InetAddress addr(port, "127.0.0.1");
+
+    // 每个线程只能有一个 EventLoop, 所以先 fork 再创建,
+    pid_t pid = ::fork();
+    if (0 == pid)
+    {
+        runBackend(addr);
+        return 0;
+    }
+    {
+        EventLoop loop;
+        PoolBench bench(&loop, addr, pooled, requests);
+        loop.loop();
+    }
+    ::kill(pid, SIGTERM);
+    ::waitpid(pid, nullptr, 0);
+
+    return 0;
+}
@@ -0,0 +1,289 @@
+#include <functional>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/tcp_client.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_relay.h>
+#include <mymuduo/tcp_server.h>
+
+#include "bench_util.h"
+
+/**
+ * L4 代理的吞吐: 发送端 ==> 代理 ==> 接收端, 发送端发送 totalMB 数据以后关闭写端,
+ * splice 代理用 TcpRelay, 数据经过管道在两个 socket 之间移动, 不进用户态,
+ * copy   原来的做法: 数据读到 inputBuffer_, 再 send() 到对端的 outputBuffer_, 对端积压超过 1MB 暂停读,
+ * 发送端和接收端在 fork() 出来的子进程里面, 子进程打印端到端的吞吐, 父进程 (代理) 打印自己每 GB 的 CPU 时间,
+ * ./proxybench [splice|copy] [totalMB] [connections] [proxyPort] [backendPort]
+ */
+
+namespace
+{
+    const size_t kMaxBacklog = 1024 * 1024;
+
+    // copy 模式的转发, 对端积压太多的时候暂停读, 对端发送完以后 (WriteCompleteCallback) 恢复,
+    void forward(const TcpConnectionPtr &from, Buffer *buf, const std::weak_ptr<TcpConnection> &weakTo)
+    {
+        TcpConnectionPtr to = weakTo.lock();
+        if (!to)
+        {
+            buf->retrieveAll();
+            return;
+        }
+        to->send(buf);
+        if (to->outputBytes() > kMaxBacklog)
+        {
+            from->stopRead();
+        }
+    }
+}
+
+// 子进程: 接收端收下数据丢掉, 发送端连接代理, 发送完 total 字节以后关闭写端,
+class ProxyEnds
+{
+public:
+    ProxyEnds(EventLoop *loop, const InetAddress &proxyAddr, const InetAddress &backendAddr, size_t total,
+              int connections)
+        : loop_(loop),
+          total_(total),
+          connections_(connections),
+          chunk_(64 * 1024, 'p'),
+          received_(0),
+          finished_(0),
+          started_(false),
+          backend_(loop, backendAddr, "ProxyBackend")
+    {
+        backend_.setMessageCallback([this](const TcpConnectionPtr &, Buffer *buf, Timestamp)
+                                    {
+                                        received_ += buf->readableBytes();
+                                        buf->retrieveAll();
+                                    });
+        backend_.setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                       {
+                                           if (!conn->connected() && ++finished_ == connections_)
+                                           {
+                                               report();
+                                           }
+                                       });
+        backend_.start();
+
+        for (int i = 0; i < connections_; ++i)
+        {
+            std::unique_ptr<TcpClient> client(new TcpClient(loop, proxyAddr, "ProxySource"));
+            client->setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                          {
+                                              if (conn->connected())
+                                              {
+                                                  if (!started_)
+                                                  {
+                                                      started_ = true;
+                                                      start_ = Timestamp::now();
+                                                  }
+                                                  conn->setContext(std::make_shared<size_t>(0));
+                                                  sendMore(conn);
+                                              }
+                                          });
+            client->setWriteCompleteCallback(std::bind(&ProxyEnds::sendMore, this, std::placeholders::_1));
+            client->connect();
+            sources_.push_back(std::move(client));
+        }
+    }
+
+private:
+    void sendMore(const TcpConnectionPtr &conn)
+    {
+        size_t *sent = static_cast<size_t *>(conn->getContext().get());
+        size_t quota = total_ / connections_;
+        while (*sent < quota && conn->outputBytes() < kMaxBacklog)
+        {
+            struct iovec vec;
+            vec.iov_base = const_cast<char *>(chunk_.data());
+            vec.iov_len = std::min(chunk_.size(), quota - *sent);
+            conn->send(&vec, 1);
+            *sent += vec.iov_len;
+        }
+        if (*sent >= quota && 0 == conn->outputBytes())
+        {
+            conn->shutdown();
+        }
+    }
+
+    void report()
+    {
+        double seconds = bench_util::secondsSince(start_);
+        printf("end to end: %.1f MB through the proxy in %.2f s, %.1f MB/s\n", received_ / 1e6, seconds,
+               received_ / seconds / 1e6);
+        loop_->quit();
+    }
+
+private:
+    EventLoop *loop_;
+    const size_t total_;
+    const int connections_;
+    const std::string chunk_;
+    size_t received_;
+    int finished_;
+    bool started_;
+    Timestamp start_;
+    TcpServer backend_;
+    std::vector<std::unique_ptr<TcpClient>> sources_;
+};
+
+// 父进程: 代理, 每个客户端连接建立一个到接收端的上游连接,
+class Proxy
+{
+public:
+    Proxy(EventLoop *loop, const InetAddress &proxyAddr, const InetAddress &backendAddr, bool splice,
+          int connections)
+        : loop_(loop),
+          backendAddr_(backendAddr),
+          splice_(splice),
+          connections_(connections),
+          finished_(0),
+          started_(false),
+          startCpu_(0),
+          server_(loop, proxyAddr, "Proxy")
+    {
+        server_.setConnectionCallback(std::bind(&Proxy::onClientConnection, this, std::placeholders::_1));
+        server_.start();
+    }
+
+private:
+    void onClientConnection(const TcpConnectionPtr &client)
+    {
+        if (!client->connected())
+        {
+            // copy 模式下把客户端的 EOF 转发给上游, 上游的发送缓冲区发完以后才关闭写端,
+            std::shared_ptr<void> context = client->getContext();
+            if (context)
+            {
+                TcpConnectionPtr upstream = static_cast<std::weak_ptr<TcpConnection> *>(context.get())->lock();
+                if (upstream)
+                {
+                    upstream->shutdown();
+                }
+            }
+            return;
+        }
+        if (!started_)
+        {
+            started_ = true;
+            start_ = Timestamp::now();
+            startCpu_ = bench_util::cpuSeconds();
+        }
+        // 上游连接建立之前不读客户端的数据,
+        client->stopRead();
+        std::weak_ptr<TcpConnection> weakClient(client);
+        std::unique_ptr<TcpClient> upstream(new TcpClient(loop_, backendAddr_, "ProxyUpstream"));
+        upstream->setConnectionCallback([this, weakClient](const TcpConnectionPtr &up)
+                                        {
+                                            onUpstreamConnection(weakClient.lock(), up);
+                                        });
+        upstream->connect();
+        upstreams_.push_back(std::move(upstream));
+    }
+
+    void onUpstreamConnection(const TcpConnectionPtr &client, const TcpConnectionPtr &up)
+    {
+        if (!up->connected())
+        {
+            if (++finished_ == connections_)
+            {
+                report();
+            }
+            return;
+        }
+        if (!client)
+        {
+            up->shutdown();
+            return;
+        }
+        client->startRead();
+        if (splice_)
+        {
+            std::make_shared<TcpRelay>(client, up)->start();
+            return;
+        }
+        std::weak_ptr<TcpConnection> weakClient(client);
+        std::weak_ptr<TcpConnection> weakUp(up);
+        client->setContext(std::make_shared<std::weak_ptr<TcpConnection>>(weakUp));
+        client->setMessageCallback([weakUp](const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+                                   {
+                                       forward(conn, buf, weakUp);
+                                   });
+        up->setMessageCallback([weakClient](const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+                               {
+                                   forward(conn, buf, weakClient);
+                               });
+        up->setWriteCompleteCallback([weakClient](const TcpConnectionPtr &)
+                                     {
+                                         TcpConnectionPtr from = weakClient.lock();
+                                         if (from && from->connected())
+                                         {
+                                             from->startRead();
+                                         }
+                                     });
+        client->setWriteCompleteCallback([weakUp](const TcpConnectionPtr &)
+                                         {
+                                             TcpConnectionPtr from = weakUp.lock();
+                                             if (from && from->connected())
+                                             {
+                                                 from->startRead();
+                                             }
+                                         });
+    }
+
+    void report()
+    {
+        printf("proxy (%s, %d connections): %.2f s, %.2f CPU seconds\n", splice_ ? "splice" : "copy",
+               connections_, bench_util::secondsSince(start_), bench_util::cpuSeconds() - startCpu_);
+        loop_->runAfter(0.1, [this] { loop_->quit(); });
+    }
+
+private:
+    EventLoop *loop_;
+    const InetAddress backendAddr_;
+    const bool splice_;
+    const int connections_;
+    int finished_;
+    bool started_;
+    Timestamp start_;
+    double startCpu_;
+    TcpServer server_;
+    std::vector<std::unique_ptr<TcpClient>> upstreams_;
+};
+
+int main(int argc, char const *argv[])
+{
+    bool splice = argc > 1 ? 0 == ::strcmp(argv[1], "splice") : true;
+    size_t total = (argc > 2 ? static_cast<size_t>(atol(argv[2])) : 4096) << 20;
+    int connections = argc > 3 ? atoi(argv[3]) : 1;
+    uint16_t proxyPort = argc > 4 ? static_cast<uint16_t>(atoi(argv[4])) : 7404;
+    uint16_t backendPort = argc > 5 ? static_cast<uint16_t>(atoi(argv[5])) : 7405;
+    InetAddress proxyAddr(proxyPort, "127.0.0.1");
+    InetAddress backendAddr(backendPort, "127.0.0.1");
+
+    // 每个线程只能有一个 EventLoop, 所以先 fork 再创建, 发送端比代理先 connect() 的话 Connector 会重试,
+    pid_t pid = ::fork();
+    if (0 == pid)
+    {
+        EventLoop loop;
+        ProxyEnds ends(&loop, proxyAddr, backendAddr, total, connections);
+        loop.loop();
+        return 0;
+    }
+    EventLoop loop;
+    Proxy proxy(&loop, proxyAddr, backendAddr, splice, connections);
+    loop.loop();
+    ::waitpid(pid, nullptr, 0);
+
+    return 0;
+}
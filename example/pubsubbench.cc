@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <mymuduo/buffer.h>
+#include <mymuduo/event_loop.h>
+#include <mymuduo/logger.h>
+#include <mymuduo/tcp_client.h>
+#include <mymuduo/tcp_connection.h>
+
+/**
+ * pubsubserver 的扇出延迟测试: 1 个发布者, subscribers 个订阅者订阅同一个主题,
+ * 所有订阅者的订阅都确认以后开始计时, 发布者每 intervalMs 发布一条带发送时间的消息, 一共 messages 条,
+ * 打印每次投递的延迟分布, 以及每条消息送达最后一个订阅者的延迟分布 (扇出完成的时间),
+ * 订阅者的个数受进程的文件描述符上限限制, 更多的订阅者可以同时运行几个 pubsubbench,
+ * ./pubsubbench [subscribers] [messages] [intervalMs] [messageSize] [port] [ip]
+ */
+
+namespace
+{
+    const char kTopic[] = "bench";
+
+    int64_t nowUs()
+    {
+        return Timestamp::now().microSecondsSinceEpoch();
+    }
+
+    void printDistribution(const char *name, std::vector<int64_t> *samples)
+    {
+        if (samples->empty())
+        {
+            printf("%s: no samples\n", name);
+            return;
+        }
+        std::sort(samples->begin(), samples->end());
+        auto percentile = [samples](double p) -> double
+        {
+            size_t index = static_cast<size_t>(p / 100 * (samples->size() - 1));
+            return (*samples)[index] / 1000.0;
+        };
+        printf("%s (ms, %zu samples): p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  max %.2f\n", name, samples->size(),
+               percentile(50), percentile(90), percentile(99), percentile(99.9), samples->back() / 1000.0);
+    }
+}
+
+class PubSubBench
+{
+public:
+    struct Options
+    {
+        int subscribers;
+        int messages;
+        int intervalMs;
+        int messageSize;
+    };
+
+    PubSubBench(EventLoop *loop, const InetAddress &addr, const Options &options)
+        : loop_(loop),
+          options_(options),
+          addr_(addr),
+          publisher_(loop, addr, "PubSubPublisher"),
+          subscribed_(0),
+          published_(0),
+          delivered_(0),
+          sentUs_(options.messages + 1, 0),
+          received_(options.messages + 1, 0)
+    {
+        deliveryUs_.reserve(static_cast<size_t>(options.subscribers) * options.messages);
+        publisher_.setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                         {
+                                             if (conn->connected())
+                                             {
+                                                 connectSubscribers();
+                                             }
+                                         });
+        publisher_.connect();
+    }
+
+private:
+    void connectSubscribers()
+    {
+        for (int i = 0; i < options_.subscribers; ++i)
+        {
+            std::unique_ptr<TcpClient> client(new TcpClient(loop_, addr_, "PubSubSubscriber"));
+            client->setConnectionCallback(std::bind(&PubSubBench::onSubscriberConnection, this, std::placeholders::_1));
+            client->setMessageCallback(std::bind(&PubSubBench::onMessage, this, std::placeholders::_2));
+            client->connect();
+            subscribers_.push_back(std::move(client));
+        }
+    }
+
+    void onSubscriberConnection(const TcpConnectionPtr &conn)
+    {
+        if (!conn->connected())
+        {
+            return;
+        }
+        conn->send(std::string("sub ") + kTopic + "\r\n");
+    }
+
+    void onSubscribed()
+    {
+        if (++subscribed_ == options_.subscribers)
+        {
+            printf("%d subscribers subscribed, publishing %d messages every %d ms\n", subscribed_,
+                   options_.messages, options_.intervalMs);
+            loop_->runEvery(options_.intervalMs / 1000.0, std::bind(&PubSubBench::onTick, this));
+        }
+    }
+
+    // 消息格式: pub bench <seq> <padding>\r\n, 发布者和订阅者在同一个进程里面, 发送时间记在 sentUs_ 里面,
+    void publish(int seq)
+    {
+        char head[64];
+        int n = snprintf(head, sizeof head, "pub %s %d ", kTopic, seq);
+        std::string message(head, n);
+        if (static_cast<int>(message.size()) + 2 < options_.messageSize)
+        {
+            message.append(options_.messageSize - message.size() - 2, 'x');
+        }
+        message.append("\r\n", 2);
+        sentUs_[seq] = nowUs();
+        publisher_.connection()->send(message);
+    }
+
+    void onMessage(Buffer *buf)
+    {
+        const char *crlf = nullptr;
+        while (nullptr != (crlf = buf->findCRLF()))
+        {
+            // +OK 或者 msg bench <seq> ...
+            if ('+' == *buf->peek())
+            {
+                onSubscribed();
+            }
+            else
+            {
+                onDelivery(atoi(buf->peek() + 4 + sizeof kTopic));
+            }
+            buf->retrieve(crlf + 2 - buf->peek());
+        }
+    }
+
+    void onDelivery(int seq)
+    {
+        int64_t latency = nowUs() - sentUs_[seq];
+        deliveryUs_.push_back(latency);
+        ++delivered_;
+        if (++received_[seq] == options_.subscribers)
+        {
+            fanoutUs_.push_back(latency);
+        }
+    }
+
+    void onTick()
+    {
+        if (published_ < options_.messages)
+        {
+            publish(++published_);
+        }
+        else if (delivered_ == static_cast<long>(options_.subscribers) * options_.messages ||
+                 nowUs() - sentUs_[published_] > 10 * 1000 * 1000)
+        {
+            report();
+        }
+    }
+
+    void report()
+    {
+        printf("1 publisher, %d subscribers, %d messages of %d bytes, delivered %ld/%ld\n", options_.subscribers,
+               options_.messages, options_.messageSize, delivered_,
+               static_cast<long>(options_.subscribers) * options_.messages);
+        printDistribution("delivery latency", &deliveryUs_);
+        printDistribution("fan-out completion", &fanoutUs_);
+        loop_->quit();
+    }
+
+private:
+    EventLoop *loop_;
+    const Options options_;
+    const InetAddress addr_;
+    TcpClient publisher_;
+    std::vector<std::unique_ptr<TcpClient>> subscribers_;
+    int subscribed_;
+    int published_;
+    long delivered_;
+    std::vector<int64_t> sentUs_;
+    std::vector<int> received_;
+    std::vector<int64_t> deliveryUs_; // 每次投递的延迟,
+    std::vector<int64_t> fanoutUs_;   // 每条消息送达最后一个订阅者的延迟,
+};
+
+int main(int argc, char const *argv[])
+{
+    PubSubBench::Options options;
+    options.subscribers = argc > 1 ? atoi(argv[1]) : 1000;
+    options.messages = argc > 2 ? atoi(argv[2]) : 100;
+    options.intervalMs = argc > 3 ? atoi(argv[3]) : 100;
+    options.messageSize = argc > 4 ? atoi(argv[4]) : 128;
+    uint16_t port = argc > 5 ? static_cast<uint16_t>(atoi(argv[5])) : 7200;
+    const char *ip = argc > 6 ? argv[6] : "127.0.0.1";
+
+    EventLoop loop;
+    PubSubBench bench(&loop, InetAddress(port, ip), options);
+    loop.loop();
+
+    return 0;
+}
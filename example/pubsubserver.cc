@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <functional>
+#include <stdlib.h>
+#include <string>
+
+#include <mymuduo/buffer.h>
+#include <mymuduo/event_loop.h>
+#include <mymuduo/logger.h>
+#include <mymuduo/payload.h>
+#include <mymuduo/pubsub_hub.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+
+/**
+ * 按行的发布/订阅服务器, 订阅表由 PubSubHub 按 subLoop 分片,
+ *   sub <topic>\r\n             订阅, 回复 +OK\r\n, 收到回复以后的发布一定能收到
+ *   unsub <topic>\r\n           退订, 回复 +OK\r\n
+ *   pub <topic> <body>\r\n      发布, 订阅者收到 msg <topic> <body>\r\n
+ * 一次发布只编码一个 Payload, 每个 subLoop 投递一次, 所有的订阅者共享同一块内存,
+ * ./pubsubserver [port] [threads]
+ */
+
+class PubSubServer
+{
+public:
+    PubSubServer(EventLoop *loop, const InetAddress &addr, int threads)
+        : server_(loop, addr, "PubSubServer")
+    {
+        server_.setThreadNum(threads);
+        server_.setThreadInitCallback([this](EventLoop *subLoop) { hub_.addLoop(subLoop); });
+        server_.setConnectionCallback(std::bind(&PubSubServer::onConnection, this, std::placeholders::_1));
+        server_.setMessageCallback(std::bind(&PubSubServer::onMessage, this, std::placeholders::_1,
+                                             std::placeholders::_2, std::placeholders::_3));
+    }
+
+    void start() { server_.start(); }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if (!conn->connected())
+        {
+            hub_.unsubscribeAll(conn);
+        }
+    }
+
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+    {
+        const char *crlf = nullptr;
+        while (nullptr != (crlf = buf->findCRLF()))
+        {
+            const char *start = buf->peek();
+            if (!handleLine(conn, start, crlf))
+            {
+                conn->send("-ERR bad command\r\n");
+                conn->shutdown();
+                buf->retrieveAll();
+                return;
+            }
+            buf->retrieve(crlf + 2 - start);
+        }
+    }
+
+    bool handleLine(const TcpConnectionPtr &conn, const char *start, const char *end)
+    {
+        const char *space = std::find(start, end, ' ');
+        std::string command(start, space);
+        if (space == end)
+        {
+            return false;
+        }
+        const char *topicStart = space + 1;
+        const char *topicEnd = std::find(topicStart, end, ' ');
+        std::string topic(topicStart, topicEnd);
+        if (topic.empty())
+        {
+            return false;
+        }
+
+        if ("sub" == command)
+        {
+            hub_.subscribe(topic, conn);
+            conn->send("+OK\r\n");
+        }
+        else if ("unsub" == command)
+        {
+            hub_.unsubscribe(topic, conn);
+            conn->send("+OK\r\n");
+        }
+        else if ("pub" == command && topicEnd != end)
+        {
+            // 编码一次, 所有 subLoop 上的所有订阅者共享,
+            std::string message;
+            message.reserve(4 + (end - topicStart) + 2);
+            message.append("msg ", 4);
+            message.append(topicStart, end);
+            message.append("\r\n", 2);
+            hub_.publish(topic, Payload::fromString(std::move(message)));
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // hub_ 要比 server_ 后析构, server_ 析构的时候关闭连接会回调 onConnection(),
+    PubSubHub hub_;
+    TcpServer server_;
+};
+
+int main(int argc, char const *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 7200;
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    EventLoop loop;
+    PubSubServer server(&loop, InetAddress(port, "0.0.0.0"), threads);
+    server.start();
+    loop.loop();
+
+    return 0;
+}
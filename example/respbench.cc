@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <mymuduo/buffer.h>
+#include <mymuduo/event_loop.h>
+#include <mymuduo/logger.h>
+#include <mymuduo/tcp_client.h>
+#include <mymuduo/tcp_connection.h>
+
+/**
+ * respserver 的压测客户端, 一个 loop 上面 connections 个连接, 每个连接保持 pipeline 个命令在途,
+ * 随机的 key, getPercent% 的命令是 GET, 其余是 SET, 跑 seconds 秒以后打印 ops/s 和延迟的分位数,
+ * 延迟是一个命令从发送到收到回复的时间, 流水线的时候包括在服务器上排队的时间,
+ * ./respbench [port] [connections] [pipeline] [seconds] [keys] [valueSize] [getPercent]
+ */
+class RespBench
+{
+public:
+    struct Options
+    {
+        int connections;
+        int pipeline;
+        double seconds;
+        int keys;
+        int valueSize;
+        int getPercent;
+    };
+
+    RespBench(EventLoop *loop, const InetAddress &serverAddr, const Options &options)
+        : loop_(loop), options_(options), value_(options.valueSize, 'v'), connected_(0), completed_(0), running_(false)
+    {
+        for (int i = 0; i < options_.connections; ++i)
+        {
+            std::unique_ptr<Client> client(new Client(loop, serverAddr));
+            Client *c = client.get();
+            c->tcp.setConnectionCallback([this, c](const TcpConnectionPtr &conn) { onConnection(c, conn); });
+            c->tcp.setMessageCallback([this, c](const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+                                      { onMessage(c, conn, buf); });
+            clients_.push_back(std::move(client));
+        }
+    }
+
+    void start()
+    {
+        for (auto &c : clients_)
+        {
+            c->tcp.connect();
+        }
+    }
+
+private:
+    struct Client
+    {
+        Client(EventLoop *loop, const InetAddress &addr) : tcp(loop, addr, "RespBench") {}
+
+        TcpClient tcp;
+        std::deque<int64_t> sentAt; // 在途命令的发送时间, 回复按顺序到达,
+    };
+
+    void onConnection(Client *, const TcpConnectionPtr &conn)
+    {
+        if (!conn->connected())
+        {
+            return;
+        }
+        conn->setTcpNoDelay(true);
+        if (++connected_ == options_.connections)
+        {
+            // 全部连上以后一起开始, 到时间以后统计,
+            running_ = true;
+            start_ = Timestamp::now();
+            loop_->runAfter(options_.seconds, std::bind(&RespBench::report, this));
+            for (auto &client : clients_)
+            {
+                TcpConnectionPtr cc = client->tcp.connection();
+                if (cc)
+                {
+                    sendCommands(client.get(), cc, options_.pipeline);
+                }
+            }
+        }
+    }
+
+    void sendCommands(Client *c, const TcpConnectionPtr &conn, int count)
+    {
+        Buffer out;
+        int64_t now = Timestamp::now().microSecondsSinceEpoch();
+        for (int i = 0; i < count; ++i)
+        {
+            std::string key = "key:" + std::to_string(::rand() % options_.keys);
+            if (::rand() % 100 < options_.getPercent)
+            {
+                appendCommand(&out, {"GET", key});
+            }
+            else
+            {
+                appendCommand(&out, {"SET", key, value_});
+            }
+            c->sentAt.push_back(now);
+        }
+        conn->send(&out);
+    }
+
+    static void appendCommand(Buffer *out, std::initializer_list<std::string> args)
+    {
+        std::string header = "*" + std::to_string(args.size()) + "\r\n";
+        out->append(header.data(), header.size());
+        for (const std::string &arg : args)
+        {
+            std::string len = "$" + std::to_string(arg.size()) + "\r\n";
+            out->append(len.data(), len.size());
+            out->append(arg.data(), arg.size());
+            out->append("\r\n", 2);
+        }
+    }
+
+    // 一条完整回复的长度, 不完整返回 0, 只处理 respserver 会返回的 + - : $ 几种类型,
+    static size_t replyLength(const Buffer *buf)
+    {
+        const char *crlf = buf->findCRLF();
+        if (nullptr == crlf)
+        {
+            return 0;
+        }
+        size_t lineLen = crlf + 2 - buf->peek();
+        if ('$' != *buf->peek())
+        {
+            return lineLen;
+        }
+        long len = ::strtol(buf->peek() + 1, nullptr, 10);
+        if (len < 0)
+        {
+            return lineLen;
+        }
+        size_t total = lineLen + len + 2;
+        return buf->readableBytes() >= total ? total : 0;
+    }
+
+    void onMessage(Client *c, const TcpConnectionPtr &conn, Buffer *buf)
+    {
+        int64_t now = Timestamp::now().microSecondsSinceEpoch();
+        int replies = 0;
+        size_t len = 0;
+        while ((len = replyLength(buf)) > 0)
+        {
+            buf->retrieve(len);
+            if (!c->sentAt.empty())
+            {
+                if (running_)
+                {
+                    latencies_.push_back(static_cast<int>(now - c->sentAt.front()));
+                }
+                c->sentAt.pop_front();
+            }
+            ++replies;
+        }
+        if (running_)
+        {
+            completed_ += replies;
+            sendCommands(c, conn, replies);
+        }
+    }
+
+    void report()
+    {
+        running_ = false;
+        double seconds = static_cast<double>(Timestamp::now().microSecondsSinceEpoch() - start_.microSecondsSinceEpoch()) /
+                         Timestamp::kMicroSecondsPerSecond;
+        std::sort(latencies_.begin(), latencies_.end());
+        auto percentile = [this](double p)
+        {
+            return latencies_.empty() ? 0 : latencies_[static_cast<size_t>(p * (latencies_.size() - 1))];
+        };
+        printf("%d connections, pipeline %d, %d%% GET, %d byte values\n",
+               options_.connections, options_.pipeline, options_.getPercent, options_.valueSize);
+        printf("%ld ops in %.2f s, %.0f ops/s, latency us p50 %d p99 %d p99.9 %d max %d\n",
+               completed_, seconds, completed_ / seconds, percentile(0.5), percentile(0.99), percentile(0.999),
+               latencies_.empty() ? 0 : latencies_.back());
+        for (auto &c : clients_)
+        {
+            c->tcp.disconnect();
+        }
+        loop_->runAfter(0.1, [this]() { loop_->quit(); });
+    }
+
+private:
+    EventLoop *loop_;
+    const Options options_;
+    const std::string value_;
+    std::vector<std::unique_ptr<Client>> clients_;
+    std::vector<int> latencies_;
+    int connected_;
+    long completed_;
+    bool running_;
+    Timestamp start_;
+};
+
+int main(int argc, char const *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 6380;
+    RespBench::Options options;
+    options.connections = argc > 2 ? atoi(argv[2]) : 50;
+    options.pipeline = argc > 3 ? atoi(argv[3]) : 16;
+    options.seconds = argc > 4 ? atof(argv[4]) : 10;
+    options.keys = argc > 5 ? atoi(argv[5]) : 100000;
+    options.valueSize = argc > 6 ? atoi(argv[6]) : 32;
+    options.getPercent = argc > 7 ? atoi(argv[7]) : 90;
+
+    EventLoop loop;
+    RespBench bench(&loop, InetAddress(port, "127.0.0.1"), options);
+    bench.start();
+    loop.loop();
+
+    return 0;
+}
@@ -0,0 +1,539 @@
+#include <ctype.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdlib.h>
+#include <string>
+#include <strings.h>
+#include <unordered_map>
+#include <vector>
+
+#include <mymuduo/buffer.h>
+#include <mymuduo/event_loop.h>
+#include <mymuduo/logger.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+
+/**
+ * Redis RESP 协议的一个子集 (GET SET DEL MGET EXPIRE PING), 用来做端到端的基准测试, 覆盖解析、分发和发送,
+ * 数据按照 key 的哈希分片, 每个 subLoop 一个分片, 分片只在自己的 loop 线程里面访问, 没有锁,
+ * 连接所在的 loop 不是 key 的所有者的时候, 把命令 runInLoop() 转给所有者执行, 结果再 runInLoop() 送回连接所在的 loop,
+ * 流水线上的命令每个占一个回复槽位, 回复按照命令的顺序发送, 先完成的远端命令等前面的命令完成以后一起发送,
+ * ./respserver [port] [threads]
+ * redis-benchmark -p 6380 -t get,set -P 16   或者   ./respbench
+ */
+
+namespace
+{
+    using Args = std::vector<std::string>;
+
+    void appendBulk(std::string *out, const std::string &value)
+    {
+        out->push_back('$');
+        out->append(std::to_string(value.size()));
+        out->append("\r\n", 2);
+        out->append(value);
+        out->append("\r\n", 2);
+    }
+
+    void appendInteger(std::string *out, int64_t n)
+    {
+        out->push_back(':');
+        out->append(std::to_string(n));
+        out->append("\r\n", 2);
+    }
+
+    const char kNil[] = "$-1\r\n";
+    const char kOk[] = "+OK\r\n";
+
+    int64_t nowMs()
+    {
+        return Timestamp::now().microSecondsSinceEpoch() / 1000;
+    }
+
+    /**
+     * 一个 subLoop 的分片, 只在所属的 loop 线程里面访问,
+     * 过期: 访问的时候检查, 另外每 100ms 扫描一部分桶, 删除没有人访问的过期 key,
+     */
+    class Shard
+    {
+    public:
+        explicit Shard(EventLoop *loop) : loop_(loop), cursor_(0) {}
+
+        EventLoop *loop() const { return loop_; }
+
+        const std::string *get(const std::string &key)
+        {
+            auto it = table_.find(key);
+            if (it == table_.end())
+            {
+                return nullptr;
+            }
+            if (expired(it->second))
+            {
+                table_.erase(it);
+                return nullptr;
+            }
+            return &it->second.value;
+        }
+
+        void set(const std::string &key, const std::string &value, int64_t expireAtMs)
+        {
+            Entry &e = table_[key];
+            e.value = value;
+            e.expireAtMs = expireAtMs;
+        }
+
+        bool del(const std::string &key)
+        {
+            auto it = table_.find(key);
+            if (it == table_.end())
+            {
+                return false;
+            }
+            bool live = !expired(it->second);
+            table_.erase(it);
+            return live;
+        }
+
+        bool expire(const std::string &key, int64_t expireAtMs)
+        {
+            auto it = table_.find(key);
+            if (it == table_.end() || expired(it->second))
+            {
+                return false;
+            }
+            it->second.expireAtMs = expireAtMs;
+            return true;
+        }
+
+        // 每次扫描 kScanBuckets 个桶, 下一次从上次停下的地方接着扫,
+        void evictExpired()
+        {
+            static const size_t kScanBuckets = 256;
+            size_t buckets = table_.bucket_count();
+            std::vector<std::string> dead;
+            for (size_t i = 0; i < kScanBuckets && buckets > 0; ++i)
+            {
+                size_t b = cursor_++ % buckets;
+                for (auto it = table_.begin(b); it != table_.end(b); ++it)
+                {
+                    if (expired(it->second))
+                    {
+                        dead.push_back(it->first);
+                    }
+                }
+            }
+            for (const std::string &key : dead)
+            {
+                table_.erase(key);
+            }
+        }
+
+    private:
+        struct Entry
+        {
+            std::string value;
+            int64_t expireAtMs; // 0 表示不过期,
+        };
+
+        static bool expired(const Entry &e) { return e.expireAtMs > 0 && e.expireAtMs <= nowMs(); }
+
+        EventLoop *loop_;
+        std::unordered_map<std::string, Entry> table_;
+        size_t cursor_;
+    };
+
+    thread_local Shard *t_shard = nullptr;
+
+    // 一条命令的回复槽位, pending 是还没有完成的部分 (MGET 可能分散在几个分片上),
+    struct Slot
+    {
+        std::string reply;
+        int pending;
+        std::vector<std::string> parts; // MGET 每个 key 的回复, 按照 key 的顺序,
+    };
+
+    // 连接的状态, 只在连接所在的 loop 线程里面访问,
+    struct Session
+    {
+        Session() : headSeq(0) {}
+
+        std::deque<Slot> slots;
+        uint64_t headSeq; // slots.front() 的序号,
+        Args args;        // 解析命令用的, 重复使用,
+    };
+}
+
+class RespServer
+{
+public:
+    RespServer(EventLoop *loop, const InetAddress &addr, int threads)
+        : loop_(loop), server_(loop, addr, "RespServer")
+    {
+        server_.setThreadNum(threads);
+        // 每个 loop 线程启动的时候创建自己的分片, start() 返回的时候所有分片都已经注册了,
+        server_.setThreadInitCallback([this](EventLoop *ioLoop)
+                                      {
+                                          std::unique_ptr<Shard> shard(new Shard(ioLoop));
+                                          t_shard = shard.get();
+                                          ioLoop->runEvery(0.1, []() { t_shard->evictExpired(); });
+                                          std::lock_guard<std::mutex> lock(mutex_);
+                                          shards_.push_back(std::move(shard)); });
+        server_.setConnectionCallback([](const TcpConnectionPtr &conn)
+                                      {
+                                          if (conn->connected())
+                                          {
+                                              conn->setTcpNoDelay(true);
+                                              conn->setContext(std::make_shared<Session>());
+                                          } });
+        server_.setMessageCallback(std::bind(&RespServer::onMessage, this,
+                                             std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    }
+
+    void start() { server_.start(); }
+
+private:
+    enum ParseResult
+    {
+        kIncomplete,
+        kCommand,
+        kProtocolError,
+    };
+
+    Shard *ownerOf(const std::string &key) const
+    {
+        return shards_[std::hash<std::string>()(key) % shards_.size()].get();
+    }
+
+    // 解析一条命令到 args, 支持 RESP 数组和 redis-cli 的内联命令, 数据不完整的时候不取走,
+    static ParseResult parseCommand(Buffer *buf, Args *args)
+    {
+        args->clear();
+        const char *begin = buf->peek();
+        const char *end = buf->beginWrite();
+        if (begin == end)
+        {
+            return kIncomplete;
+        }
+        if ('*' != *begin)
+        {
+            const char *crlf = buf->findCRLF();
+            if (nullptr == crlf)
+            {
+                return kIncomplete;
+            }
+            const char *p = begin;
+            while (p < crlf)
+            {
+                while (p < crlf && ' ' == *p)
+                {
+                    ++p;
+                }
+                const char *word = p;
+                while (p < crlf && ' ' != *p)
+                {
+                    ++p;
+                }
+                if (p > word)
+                {
+                    args->emplace_back(word, p);
+                }
+            }
+            buf->retrieve(crlf + 2 - begin);
+            return kCommand;
+        }
+
+        const char *crlf = buf->findCRLF(begin);
+        if (nullptr == crlf)
+        {
+            return kIncomplete;
+        }
+        long count = ::strtol(begin + 1, nullptr, 10);
+        if (count <= 0 || count > 1024 * 1024)
+        {
+            return kProtocolError;
+        }
+        const char *p = crlf + 2;
+        for (long i = 0; i < count; ++i)
+        {
+            if (p >= end)
+            {
+                return kIncomplete;
+            }
+            if ('$' != *p)
+            {
+                return kProtocolError;
+            }
+            crlf = buf->findCRLF(p);
+            if (nullptr == crlf)
+            {
+                return kIncomplete;
+            }
+            long len = ::strtol(p + 1, nullptr, 10);
+            if (len < 0 || len > 512 * 1024 * 1024)
+            {
+                return kProtocolError;
+            }
+            p = crlf + 2;
+            if (end - p < len + 2)
+            {
+                return kIncomplete;
+            }
+            args->emplace_back(p, p + len);
+            p += len + 2;
+        }
+        buf->retrieve(p - begin);
+        return kCommand;
+    }
+
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+    {
+        Session *session = static_cast<Session *>(conn->getContext().get());
+        if (nullptr == session)
+        {
+            buf->retrieveAll();
+            return;
+        }
+        while (true)
+        {
+            ParseResult result = parseCommand(buf, &session->args);
+            if (kIncomplete == result)
+            {
+                break;
+            }
+            if (kProtocolError == result)
+            {
+                session->slots.push_back(Slot{"-ERR Protocol error\r\n", 0, {}});
+                flushReplies(conn, session);
+                conn->setContext(std::shared_ptr<void>());
+                buf->retrieveAll();
+                conn->shutdown();
+                return;
+            }
+            if (!session->args.empty())
+            {
+                dispatch(conn, session);
+            }
+        }
+        flushReplies(conn, session);
+    }
+
+    // 给命令分配一个槽位, 本地能完成的直接写回复, 否则转给所有者的 loop,
+    void dispatch(const TcpConnectionPtr &conn, Session *session)
+    {
+        Args &args = session->args;
+        std::string &cmd = args[0];
+        for (char &c : cmd)
+        {
+            c = static_cast<char>(::toupper(static_cast<unsigned char>(c)));
+        }
+
+        uint64_t seq = session->headSeq + session->slots.size();
+        session->slots.push_back(Slot{std::string(), 0, {}});
+        Slot &slot = session->slots.back();
+
+        if ("PING" == cmd)
+        {
+            slot.reply = "+PONG\r\n";
+        }
+        else if ("CONFIG" == cmd || "COMMAND" == cmd)
+        {
+            // redis-benchmark 启动的时候会发 CONFIG GET, 回复空数组,
+            slot.reply = "*0\r\n";
+        }
+        else if (("GET" == cmd && 2 == args.size()) || ("SET" == cmd && args.size() >= 3) ||
+                 ("EXPIRE" == cmd && 3 == args.size()))
+        {
+            Shard *owner = ownerOf(args[1]);
+            if (owner == t_shard)
+            {
+                slot.reply = execute(owner, args);
+            }
+            else
+            {
+                slot.pending = 1;
+                forward(conn, owner, seq, 0, std::move(args));
+            }
+        }
+        else if (("DEL" == cmd || "MGET" == cmd) && args.size() >= 2)
+        {
+            // 每个 key 单独一个部分, 各自到所有者的 loop 上执行, 全部完成以后合并,
+            size_t keys = args.size() - 1;
+            slot.parts.resize(keys);
+            for (size_t i = 0; i < keys; ++i)
+            {
+                Args single{"GET" == cmd || "MGET" == cmd ? std::string("GET") : std::string("DEL"), args[i + 1]};
+                Shard *owner = ownerOf(single[1]);
+                if (owner == t_shard)
+                {
+                    slot.parts[i] = execute(owner, single);
+                }
+                else
+                {
+                    ++slot.pending;
+                    forward(conn, owner, seq, i, std::move(single));
+                }
+            }
+            if (0 == slot.pending)
+            {
+                mergeParts(cmd, &slot);
+            }
+            else
+            {
+                // 合并的时候还要知道是哪个命令,
+                slot.reply = cmd;
+            }
+        }
+        else
+        {
+            slot.reply = "-ERR unknown command or wrong number of arguments for '" + args[0] + "'\r\n";
+        }
+    }
+
+    // 在所有者的 loop 线程里面执行, 返回回复,
+    static std::string execute(Shard *shard, const Args &args)
+    {
+        const std::string &cmd = args[0];
+        std::string reply;
+        if ("GET" == cmd)
+        {
+            const std::string *value = shard->get(args[1]);
+            if (nullptr == value)
+            {
+                reply.assign(kNil, sizeof(kNil) - 1);
+            }
+            else
+            {
+                appendBulk(&reply, *value);
+            }
+        }
+        else if ("SET" == cmd)
+        {
+            int64_t expireAtMs = 0;
+            if (5 == args.size() && (0 == ::strcasecmp(args[3].c_str(), "EX") || 0 == ::strcasecmp(args[3].c_str(), "PX")))
+            {
+                int64_t n = ::atoll(args[4].c_str());
+                expireAtMs = nowMs() + (0 == ::strcasecmp(args[3].c_str(), "EX") ? n * 1000 : n);
+            }
+            else if (3 != args.size())
+            {
+                return "-ERR syntax error\r\n";
+            }
+            shard->set(args[1], args[2], expireAtMs);
+            reply.assign(kOk, sizeof(kOk) - 1);
+        }
+        else if ("DEL" == cmd)
+        {
+            appendInteger(&reply, shard->del(args[1]) ? 1 : 0);
+        }
+        else if ("EXPIRE" == cmd)
+        {
+            appendInteger(&reply, shard->expire(args[1], nowMs() + ::atoll(args[2].c_str()) * 1000) ? 1 : 0);
+        }
+        return reply;
+    }
+
+    // 转给 owner 的 loop 执行, 结果送回连接所在的 loop, 填进 seq 号槽位的第 part 部分,
+    void forward(const TcpConnectionPtr &conn, Shard *owner, uint64_t seq, size_t part, Args args)
+    {
+        EventLoop *home = conn->getLoop();
+        auto task = std::make_shared<Args>(std::move(args));
+        owner->loop()->queueInLoop([this, conn, owner, home, seq, part, task]()
+                                   {
+                                       std::string reply = execute(owner, *task);
+                                       home->queueInLoop([this, conn, seq, part, reply]()
+                                                         { complete(conn, seq, part, reply); }); });
+    }
+
+    void complete(const TcpConnectionPtr &conn, uint64_t seq, size_t part, const std::string &reply)
+    {
+        Session *session = static_cast<Session *>(conn->getContext().get());
+        if (nullptr == session || !conn->connected())
+        {
+            return;
+        }
+        Slot &slot = session->slots[seq - session->headSeq];
+        if (slot.parts.empty())
+        {
+            slot.reply = reply;
+        }
+        else
+        {
+            slot.parts[part] = reply;
+        }
+        if (0 == --slot.pending)
+        {
+            if (!slot.parts.empty())
+            {
+                std::string cmd;
+                cmd.swap(slot.reply);
+                mergeParts(cmd, &slot);
+            }
+            flushReplies(conn, session);
+        }
+    }
+
+    // DEL 返回删除的个数, MGET 返回数组,
+    static void mergeParts(const std::string &cmd, Slot *slot)
+    {
+        slot->reply.clear();
+        if ("DEL" == cmd)
+        {
+            int64_t deleted = 0;
+            for (const std::string &part : slot->parts)
+            {
+                deleted += (":1\r\n" == part) ? 1 : 0;
+            }
+            appendInteger(&slot->reply, deleted);
+        }
+        else
+        {
+            slot->reply.push_back('*');
+            slot->reply.append(std::to_string(slot->parts.size()));
+            slot->reply.append("\r\n", 2);
+            for (const std::string &part : slot->parts)
+            {
+                slot->reply.append(part);
+            }
+        }
+        slot->parts.clear();
+    }
+
+    // 从队头开始, 把已经完成的槽位的回复一起发送, 遇到没有完成的就停下, 保证回复的顺序,
+    static void flushReplies(const TcpConnectionPtr &conn, Session *session)
+    {
+        Buffer out;
+        while (!session->slots.empty() && 0 == session->slots.front().pending)
+        {
+            const std::string &reply = session->slots.front().reply;
+            out.append(reply.data(), reply.size());
+            session->slots.pop_front();
+            ++session->headSeq;
+        }
+        if (out.readableBytes() > 0)
+        {
+            conn->send(&out);
+        }
+    }
+
+private:
+    EventLoop *loop_;
+    TcpServer server_;
+    std::mutex mutex_; // 只在 loop 线程启动的时候保护 shards_,
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+int main(int argc, char const *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 6380;
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    EventLoop loop;
+    RespServer server(&loop, InetAddress(port, "0.0.0.0"), threads);
+    server.start();
+    loop.loop();
+
+    return 0;
+}
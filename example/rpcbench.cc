@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/logger.h>
+#include <mymuduo/rpc_client.h>
+#include <mymuduo/tcp_connection.h>
+
+/**
+ * rpcserver 的压测客户端, 一个 loop 上面 connections 个 RpcClient, 一共保持 concurrency 个调用在途,
+ * 每个调用完成以后立即在同一个连接上发出下一个, 跑 seconds 秒以后打印 calls/s 和延迟的分位数,
+ * method 是 rpcserver 的方法号, asyncAdd (3) 的时候每个调用随机等待 [0, delayUs] 微秒, 响应乱序返回,
+ * ./rpcbench [port] [concurrency] [seconds] [method] [connections] [delayUs] [timeoutMs]
+ */
+
+// 消息的定义和 rpcserver.cc 一致,
+struct AddRequest
+{
+    int64_t a;
+    int64_t b;
+    int32_t delayUs;
+    int32_t reserved;
+};
+
+struct AddResponse
+{
+    int64_t sum;
+};
+
+class RpcBench
+{
+public:
+    struct Options
+    {
+        int concurrency;
+        double seconds;
+        int method;
+        int connections;
+        int delayUs;
+        int timeoutMs;
+    };
+
+    RpcBench(EventLoop *loop, const InetAddress &serverAddr, const Options &options)
+        : loop_(loop), options_(options), echo_(32, 'x'), connected_(0), completed_(0), running_(false)
+    {
+        for (int i = 0; i < options_.connections; ++i)
+        {
+            std::unique_ptr<RpcClient> client(new RpcClient(loop, serverAddr, "RpcBench"));
+            client->setConnectionCallback(std::bind(&RpcBench::onConnection, this, std::placeholders::_1));
+            clients_.push_back(std::move(client));
+        }
+    }
+
+    void start()
+    {
+        for (auto &c : clients_)
+        {
+            c->connect();
+        }
+    }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if (!conn->connected())
+        {
+            return;
+        }
+        conn->setTcpNoDelay(true);
+        if (++connected_ == options_.connections)
+        {
+            // 全部连上以后一起开始, 到时间以后统计,
+            running_ = true;
+            start_ = Timestamp::now();
+            loop_->runAfter(options_.seconds, std::bind(&RpcBench::report, this));
+            for (int i = 0; i < options_.concurrency; ++i)
+            {
+                issue(clients_[i % clients_.size()].get());
+            }
+        }
+    }
+
+    void issue(RpcClient *client)
+    {
+        if (!running_)
+        {
+            return;
+        }
+        int64_t sentAt = Timestamp::now().microSecondsSinceEpoch();
+        double timeout = options_.timeoutMs / 1000.0;
+        if (kEcho == options_.method)
+        {
+            client->call<std::string, std::string>(kEcho, echo_, timeout,
+                                                   [this, client, sentAt](RpcStatus status, const std::string &)
+                                                   { complete(client, sentAt, status); });
+            return;
+        }
+        AddRequest req = {::rand(), ::rand(), options_.delayUs > 0 ? ::rand() % (options_.delayUs + 1) : 0, 0};
+        client->call<AddRequest, AddResponse>(options_.method, req, timeout,
+                                              [this, client, sentAt, req](RpcStatus status, const AddResponse &resp)
+                                              {
+                                                  if (kRpcOk == status && resp.sum != req.a + req.b)
+                                                  {
+                                                      LOG_ERROR("rpcbench wrong sum \n");
+                                                  }
+                                                  complete(client, sentAt, status);
+                                              });
+    }
+
+    void complete(RpcClient *client, int64_t sentAt, RpcStatus status)
+    {
+        if (!running_)
+        {
+            return;
+        }
+        if (kRpcOk == status)
+        {
+            latencies_.push_back(static_cast<int>(Timestamp::now().microSecondsSinceEpoch() - sentAt));
+            ++completed_;
+        }
+        else
+        {
+            ++errors_[status];
+        }
+        issue(client);
+    }
+
+    void report()
+    {
+        running_ = false;
+        double seconds = static_cast<double>(Timestamp::now().microSecondsSinceEpoch() - start_.microSecondsSinceEpoch()) /
+                         Timestamp::kMicroSecondsPerSecond;
+        std::sort(latencies_.begin(), latencies_.end());
+        auto percentile = [this](double p)
+        {
+            return latencies_.empty() ? 0 : latencies_[static_cast<size_t>(p * (latencies_.size() - 1))];
+        };
+        printf("method %d, %d connections, concurrency %d, delay <= %d us\n",
+               options_.method, options_.connections, options_.concurrency, options_.delayUs);
+        printf("%ld calls in %.2f s, %.0f calls/s, latency us p50 %d p99 %d p99.9 %d max %d\n",
+               completed_, seconds, completed_ / seconds, percentile(0.5), percentile(0.99), percentile(0.999),
+               latencies_.empty() ? 0 : latencies_.back());
+        for (const auto &e : errors_)
+        {
+            printf("%ld calls failed: %s\n", e.second, rpcStatusString(e.first));
+        }
+        for (auto &c : clients_)
+        {
+            c->disconnect();
+        }
+        loop_->runAfter(0.1, [this]() { loop_->quit(); });
+    }
+
+private:
+    enum
+    {
+        kEcho = 1,
+    };
+
+    EventLoop *loop_;
+    const Options options_;
+    const std::string echo_;
+    std::vector<std::unique_ptr<RpcClient>> clients_;
+    std::vector<int> latencies_;
+    std::map<RpcStatus, long> errors_;
+    int connected_;
+    long completed_;
+    bool running_;
+    Timestamp start_;
+};
+
+int main(int argc, char const *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 7000;
+    RpcBench::Options options;
+    options.concurrency = argc > 2 ? atoi(argv[2]) : 64;
+    options.seconds = argc > 3 ? atof(argv[3]) : 10;
+    options.method = argc > 4 ? atoi(argv[4]) : 2;
+    options.connections = argc > 5 ? atoi(argv[5]) : 1;
+    options.delayUs = argc > 6 ? atoi(argv[6]) : 0;
+    options.timeoutMs = argc > 7 ? atoi(argv[7]) : 1000;
+
+    EventLoop loop;
+    RpcBench bench(&loop, InetAddress(port, "127.0.0.1"), options);
+    bench.start();
+    loop.loop();
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/logger.h>
+#include <mymuduo/rpc_server.h>
+#include <mymuduo/thread.h>
+
+/**
+ * RpcServer 的示例, 和 rpcbench 一起做基准测试, 三个方法:
+ *     1 echo:      请求和响应都是 std::string, 在 subLoop 线程里面同步回复,
+ *     2 add:       固定布局的 AddRequest/AddResponse, 同步回复,
+ *     3 asyncAdd:  交给工作线程, 等 delayUs 微秒以后在工作线程里面回复, delayUs 不同的调用乱序完成,
+ * ./rpcserver [port] [threads] [workers]
+ */
+
+// 消息的定义和 rpcbench.cc 一致, 固定布局, 默认的 RpcSerializer 直接 memcpy,
+struct AddRequest
+{
+    int64_t a;
+    int64_t b;
+    int32_t delayUs;
+    int32_t reserved;
+};
+
+struct AddResponse
+{
+    int64_t sum;
+};
+
+enum Method
+{
+    kEcho = 1,
+    kAdd = 2,
+    kAsyncAdd = 3,
+};
+
+// 最简单的工作线程池, 任务在任意一个工作线程里面执行,
+class WorkerPool
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkerPool(int numThreads)
+    {
+        for (int i = 0; i < numThreads; ++i)
+        {
+            threads_.emplace_back(new Thread(std::bind(&WorkerPool::run, this), "worker" + std::to_string(i)));
+            threads_.back()->start();
+        }
+    }
+
+    void submit(Task task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.push_back(std::move(task));
+        }
+        cond_.notify_one();
+    }
+
+private:
+    void run()
+    {
+        while (true)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this]() { return !tasks_.empty(); });
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            task();
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<Thread>> threads_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<Task> tasks_;
+};
+
+int main(int argc, char const *argv[])
+{
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 7000;
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    int workers = argc > 3 ? atoi(argv[3]) : 4;
+
+    EventLoop loop;
+    WorkerPool pool(workers);
+    RpcServer server(&loop, InetAddress(port, "0.0.0.0"), "RpcServer");
+    server.setThreadNum(threads);
+
+    server.registerMethod<std::string>(kEcho, [](const std::string &req, const RpcResponder &responder)
+                                       { responder.reply(req); });
+
+    server.registerMethod<AddRequest>(kAdd, [](const AddRequest &req, const RpcResponder &responder)
+                                      {
+                                          AddResponse resp = {req.a + req.b};
+                                          responder.reply(resp);
+                                      });
+
+    // RpcResponder 拷贝到工作线程里面, 在那里回复,
+    server.registerMethod<AddRequest>(kAsyncAdd, [&pool](const AddRequest &req, const RpcResponder &responder)
+                                      {
+                                          pool.submit([req, responder]()
+                                                      {
+                                                          // 在队列里面等到超过了截止时间, 客户端已经放弃, 不用再算,
+                                                          if (responder.expired())
+                                                          {
+                                                              return;
+                                                          }
+                                                          if (req.delayUs > 0)
+                                                          {
+                                                              ::usleep(req.delayUs);
+                                                          }
+                                                          AddResponse resp = {req.a + req.b};
+                                                          responder.reply(resp);
+                                                      });
+                                      });
+
+    server.start();
+    loop.loop();
+
+    return 0;
+}
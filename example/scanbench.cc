@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include <mymuduo/byte_scan.h>
+
+/**
+ * 分隔符查找的吞吐: 一段长度为 len 的数据, 分隔符在最后, 每种实现反复查找, 打印 GB/s,
+ * findCRLF  byte_scan::findCRLF(), 和直接用 std::search() 查找 "\r\n" 的写法比较, memchr() 作为参考上限,
+ * findAnyOf byte_scan::findAnyOf() 查找 4 个字符的集合, 和 std::find_first_of() 比较,
+ * ./scanbench [totalMB]
+ */
+
+namespace
+{
+    const char kCRLF[] = "\r\n";
+    const char kSet[] = " ;:=";
+    const size_t kSetLen = 4;
+
+    __attribute__((noinline)) const char *searchCRLF(const char *begin, const char *end)
+    {
+        const char *crlf = std::search(begin, end, kCRLF, kCRLF + 2);
+        return crlf == end ? nullptr : crlf;
+    }
+
+    __attribute__((noinline)) const char *memchrCR(const char *begin, const char *end)
+    {
+        return static_cast<const char *>(::memchr(begin, '\r', end - begin));
+    }
+
+    __attribute__((noinline)) const char *findFirstOf(const char *begin, const char *end)
+    {
+        const char *found = std::find_first_of(begin, end, kSet, kSet + kSetLen);
+        return found == end ? nullptr : found;
+    }
+
+    const char *scanCRLF(const char *begin, const char *end) { return byte_scan::findCRLF(begin, end); }
+
+    const char *scanAnyOf(const char *begin, const char *end)
+    {
+        return byte_scan::findAnyOf(begin, end, kSet, kSetLen);
+    }
+
+    // 反复查找, 直到扫描的数据量达到 total, 返回 GB/s, 找到的位置累加起来防止被优化掉,
+    double measure(const char *(*find)(const char *, const char *), const std::string &data, size_t total)
+    {
+        const char *begin = data.data();
+        const char *end = begin + data.size();
+        size_t iterations = std::max<size_t>(1, total / data.size());
+        size_t sum = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            sum += find(begin, end) - begin;
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (sum != iterations * (data.size() - 2))
+        {
+            printf("wrong result\n");
+        }
+        return static_cast<double>(iterations) * data.size() / ns;
+    }
+}
+
+int main(int argc, char const *argv[])
+{
+    size_t total = (argc > 1 ? static_cast<size_t>(atol(argv[1])) : 1024) << 20;
+
+    printf("byte_scan implementation: %s\n", byte_scan::implementation());
+    const size_t lengths[] = {64, 1024, 65536};
+    for (size_t len : lengths)
+    {
+        // "\r\n" 和集合里面的 ';' 都在倒数第二个字节,
+        std::string line(len, 'a');
+        line[len - 2] = '\r';
+        line[len - 1] = '\n';
+        std::string field(len, 'a');
+        field[len - 2] = ';';
+
+        printf("len %5zu: findCRLF %6.2f GB/s, std::search %5.2f, memchr %6.2f | findAnyOf %6.2f GB/s, "
+               "std::find_first_of %5.2f\n",
+               len, measure(scanCRLF, line, total), measure(searchCRLF, line, total),
+               measure(memchrCR, line, total), measure(scanAnyOf, field, total), measure(findFirstOf, field, total));
+    }
+
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <fcntl.h>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/tcp_client.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+
+#include "bench_util.h"
+
+/**
+ * 通过 loopback 发送一个大文件 (默认 1GB), 客户端在同一个 loop 里面收下丢掉,
+ * sendfile 调用 TcpConnection::sendFile(), 文件的数据不经过用户态, 内存占用是常数,
+ * read     原来的做法: 把整个文件 read() 到一个 std::string 里面再 send(),
+ * chunked  每次 read() 64KB 再 send(), 发送缓冲区清空以后 (WriteCompleteCallback) 再读下一块,
+ * 文件不存在或者大小不对的时候先生成, 第一次运行会从磁盘读, 之后在 page cache 里面,
+ * 打印耗时、吞吐、CPU 时间和进程的 RSS 峰值,
+ * ./sendfilebench [sendfile|read|chunked] [file] [sizeMB] [port]
+ */
+
+namespace
+{
+    bool prepareFile(const char *path, size_t size)
+    {
+        struct stat st;
+        if (0 == ::stat(path, &st) && static_cast<size_t>(st.st_size) == size)
+        {
+            return true;
+        }
+        int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+        std::string block(1024 * 1024, 'f');
+        for (size_t written = 0; written < size; written += block.size())
+        {
+            if (::write(fd, block.data(), std::min(block.size(), size - written)) < 0)
+            {
+                ::close(fd);
+                return false;
+            }
+        }
+        ::close(fd);
+        return true;
+    }
+}
+
+class SendfileBench
+{
+public:
+    enum Mode
+    {
+        kSendfile,
+        kRead,
+        kChunked,
+    };
+
+    SendfileBench(EventLoop *loop, const InetAddress &addr, Mode mode, const char *path, size_t size)
+        : loop_(loop),
+          mode_(mode),
+          size_(size),
+          fd_(::open(path, O_RDONLY)),
+          offset_(0),
+          received_(0),
+          startCpu_(0),
+          server_(loop, addr, "SendfileServer"),
+          client_(loop, addr, "SendfileClient")
+    {
+        server_.setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                      {
+                                          if (conn->connected())
+                                          {
+                                              start_ = Timestamp::now();
+                                              startCpu_ = bench_util::cpuSeconds();
+                                              serve(conn);
+                                          }
+                                      });
+        if (kChunked == mode_)
+        {
+            server_.setWriteCompleteCallback(std::bind(&SendfileBench::sendChunk, this, std::placeholders::_1));
+        }
+        server_.start();
+
+        client_.setMessageCallback([this](const TcpConnectionPtr &, Buffer *buf, Timestamp)
+                                   {
+                                       received_ += buf->readableBytes();
+                                       buf->retrieveAll();
+                                       if (received_ == size_)
+                                       {
+                                           report();
+                                       }
+                                   });
+        client_.connect();
+    }
+
+    ~SendfileBench()
+    {
+        ::close(fd_);
+    }
+
+private:
+    void serve(const TcpConnectionPtr &conn)
+    {
+        if (kSendfile == mode_)
+        {
+            conn->sendFile(fd_, 0, size_);
+        }
+        else if (kRead == mode_)
+        {
+            std::string content(size_, 0);
+            size_t n = 0;
+            while (n < size_)
+            {
+                ssize_t r = ::read(fd_, &content[n], size_ - n);
+                if (r <= 0)
+                {
+                    break;
+                }
+                n += r;
+            }
+            conn->send(content);
+        }
+        else
+        {
+            sendChunk(conn);
+        }
+    }
+
+    void sendChunk(const TcpConnectionPtr &conn)
+    {
+        char chunk[64 * 1024];
+        while (offset_ < size_ && conn->outputBytes() < sizeof chunk)
+        {
+            ssize_t n = ::pread(fd_, chunk, sizeof chunk, offset_);
+            if (n <= 0)
+            {
+                break;
+            }
+            offset_ += n;
+            struct iovec vec;
+            vec.iov_base = chunk;
+            vec.iov_len = n;
+            conn->send(&vec, 1);
+        }
+    }
+
+    void report()
+    {
+        double seconds = bench_util::secondsSince(start_);
+        static const char *const kNames[] = {"sendfile", "read", "chunked"};
+        printf("%-8s %zu MB in %.2f s: %.1f MB/s, %.2f CPU seconds, peak RSS %.1f MB\n", kNames[mode_],
+               size_ >> 20, seconds, size_ / seconds / 1e6, bench_util::cpuSeconds() - startCpu_,
+               bench_util::peakRssKb() / 1024.0);
+        loop_->quit();
+    }
+
+private:
+    EventLoop *loop_;
+    const Mode mode_;
+    const size_t size_;
+    const int fd_;
+    size_t offset_;
+    size_t received_;
+    Timestamp start_;
+    double startCpu_;
+    TcpServer server_;
+    TcpClient client_;
+};
+
+int main(int argc, char const *argv[])
+{
+    SendfileBench::Mode mode = SendfileBench::kSendfile;
+    if (argc > 1 && 0 == ::strcmp(argv[1], "read"))
+    {
+        mode = SendfileBench::kRead;
+    }
+    else if (argc > 1 && 0 == ::strcmp(argv[1], "chunked"))
+    {
+        mode = SendfileBench::kChunked;
+    }
+    const char *path = argc > 2 ? argv[2] : "/tmp/sendfilebench.dat";
+    size_t size = (argc > 3 ? static_cast<size_t>(atol(argv[3])) : 1024) << 20;
+    uint16_t port = argc > 4 ? static_cast<uint16_t>(atoi(argv[4])) : 7402;
+
+    if (!prepareFile(path, size))
+    {
+        fprintf(stderr, "cannot create %s\n", path);
+        return 1;
+    }
+
+    EventLoop loop;
+    SendfileBench bench(&loop, InetAddress(port, "127.0.0.1"), mode, path, size);
+    loop.loop();
+
+    return 0;
+}
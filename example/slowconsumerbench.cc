@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <functional>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/tcp_client.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+
+#include "bench_util.h"
+
+/**
+ * 慢消费者: 客户端全速流水线发送 64 字节的请求, 每个请求服务器回复 640 字节, 但是客户端每秒只读 readMBps,
+ * none       不设置水位线, 回复全部堆在服务器的发送队列里面,
+ * watermarks setReadPauseWatermarks(4MB, 1MB), 积压达到 4MB 停止读请求, TCP 的流量控制让客户端停下来,
+ * 客户端在 fork() 出来的子进程里面, 服务器每秒打印一次发送队列的积压和进程的 RSS, 运行 seconds 秒,
+ * 积压超过 1GB 的时候提前结束, 不然会一直涨到内存耗尽,
+ * ./slowconsumerbench [none|watermarks] [seconds] [readMBps] [port]
+ */
+
+namespace
+{
+    const size_t kRequestSize = 64;
+    const size_t kReplySize = 640;
+    const size_t kHighMark = 4 * 1024 * 1024;
+    const size_t kLowMark = 1024 * 1024;
+    const size_t kGiveUpBytes = 1024 * 1024 * 1024;
+}
+
+// 子进程: 全速发送请求, 按照 readMBps 限速读取回复,
+class SlowConsumer
+{
+public:
+    SlowConsumer(EventLoop *loop, const InetAddress &addr, double readMBps)
+        : loop_(loop),
+          request_(kRequestSize - 1, 'q'),
+          budgetPerTick_(static_cast<size_t>(readMBps * 1e6 / 100)),
+          budget_(budgetPerTick_),
+          client_(loop, addr, "SlowConsumer")
+    {
+        request_ += '\n';
+        batch_.reserve(64 * 1024);
+        while (batch_.size() + request_.size() <= 64 * 1024)
+        {
+            batch_ += request_;
+        }
+        client_.setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                      {
+                                          if (conn->connected())
+                                          {
+                                              conn_ = conn;
+                                              sendMore(conn);
+                                          }
+                                          else
+                                          {
+                                              loop_->quit();
+                                          }
+                                      });
+        client_.setWriteCompleteCallback(std::bind(&SlowConsumer::sendMore, this, std::placeholders::_1));
+        client_.setMessageCallback(std::bind(&SlowConsumer::onMessage, this, std::placeholders::_1,
+                                             std::placeholders::_2));
+        client_.connect();
+        // 每 10ms 补充一次读的额度,
+        loop_->runEvery(0.01, std::bind(&SlowConsumer::onTick, this));
+    }
+
+private:
+    void sendMore(const TcpConnectionPtr &conn)
+    {
+        while (conn->connected() && conn->outputBytes() < 1024 * 1024)
+        {
+            conn->send(batch_);
+        }
+    }
+
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf)
+    {
+        size_t n = std::min(budget_, buf->readableBytes());
+        buf->retrieve(n);
+        budget_ -= n;
+        if (0 == budget_)
+        {
+            conn->stopRead();
+        }
+    }
+
+    void onTick()
+    {
+        budget_ = budgetPerTick_;
+        if (conn_ && conn_->connected())
+        {
+            conn_->startRead();
+        }
+    }
+
+private:
+    EventLoop *loop_;
+    std::string request_;
+    std::string batch_;
+    const size_t budgetPerTick_;
+    size_t budget_;
+    TcpConnectionPtr conn_;
+    TcpClient client_;
+};
+
+// 父进程: 每个请求回复 kReplySize 字节, 每秒记录积压和 RSS,
+class AmplifyServer
+{
+public:
+    AmplifyServer(EventLoop *loop, const InetAddress &addr, bool watermarks, int seconds)
+        : loop_(loop),
+          watermarks_(watermarks),
+          seconds_(seconds),
+          elapsed_(0),
+          requests_(0),
+          peakPending_(0),
+          peakRssKb_(0),
+          reply_(kReplySize - 1, 'r'),
+          server_(loop, addr, "AmplifyServer")
+    {
+        reply_ += '\n';
+        server_.setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                      {
+                                          if (conn->connected())
+                                          {
+                                              conn_ = conn;
+                                              if (watermarks_)
+                                              {
+                                                  conn->setReadPauseWatermarks(kHighMark, kLowMark);
+                                              }
+                                              baseRssKb_ = bench_util::rssKb();
+                                              loop_->runEvery(0.1, std::bind(&AmplifyServer::sample, this));
+                                          }
+                                      });
+        server_.setMessageCallback(std::bind(&AmplifyServer::onMessage, this, std::placeholders::_1,
+                                             std::placeholders::_2));
+        server_.start();
+    }
+
+private:
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf)
+    {
+        size_t n = buf->readableBytes() / kRequestSize;
+        if (0 == n)
+        {
+            return;
+        }
+        buf->retrieve(n * kRequestSize);
+        requests_ += n;
+        std::string out;
+        out.reserve(n * kReplySize);
+        for (size_t i = 0; i < n; ++i)
+        {
+            out += reply_;
+        }
+        conn->send(out);
+    }
+
+    void sample()
+    {
+        if (!conn_)
+        {
+            return;
+        }
+        size_t pending = conn_->outputBytes();
+        long rss = bench_util::rssKb();
+        peakPending_ = std::max(peakPending_, pending);
+        peakRssKb_ = std::max(peakRssKb_, rss);
+        ++elapsed_;
+        if (0 == elapsed_ % 10)
+        {
+            printf("  %2ds: pending output %7.1f MB, RSS %7.1f MB, %lu requests served\n", elapsed_ / 10,
+                   pending / 1048576.0, rss / 1024.0, requests_);
+        }
+        if (elapsed_ >= seconds_ * 10 || pending > kGiveUpBytes)
+        {
+            printf("%s: peak pending output %.1f MB, peak RSS %.1f MB (%.1f MB at connect)%s\n",
+                   watermarks_ ? "watermarks 4MB/1MB" : "no watermarks", peakPending_ / 1048576.0,
+                   peakRssKb_ / 1024.0, baseRssKb_ / 1024.0, pending > kGiveUpBytes ? ", gave up above 1 GB" : "");
+            conn_->forceClose();
+            conn_.reset();
+            loop_->runAfter(0.1, [this] { loop_->quit(); });
+        }
+    }
+
+private:
+    EventLoop *loop_;
+    const bool watermarks_;
+    const int seconds_;
+    int elapsed_; // 单位 100ms,
+    unsigned long requests_;
+    size_t peakPending_;
+    long peakRssKb_;
+    long baseRssKb_;
+    std::string reply_;
+    TcpConnectionPtr conn_;
+    TcpServer server_;
+};
+
+int main(int argc, char const *argv[])
+{
+    bool watermarks = argc > 1 ? 0 == ::strcmp(argv[1], "watermarks") : true;
+    int seconds = argc > 2 ? atoi(argv[2]) : 10;
+    double readMBps = argc > 3 ? atof(argv[3]) : 20;
+    uint16_t port = argc > 4 ? static_cast<uint16_t>(atoi(argv[4])) : 7406;
+    InetAddress addr(port, "127.0.0.1");
+
+    // 每个线程只能有一个 EventLoop, 所以先 fork 再创建, 客户端比服务器先 connect() 的话 Connector 会重试,
+    pid_t pid = ::fork();
+    if (0 == pid)
+    {
+        EventLoop loop;
+        SlowConsumer consumer(&loop, addr, readMBps);
+        loop.loop();
+        return 0;
+    }
+    EventLoop loop;
+    AmplifyServer server(&loop, addr, watermarks, seconds);
+    loop.loop();
+    ::kill(pid, SIGTERM);
+    ::waitpid(pid, nullptr, 0);
+
+    return 0;
+}
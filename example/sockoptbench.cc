@@ -0,0 +1,103 @@
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/tcp_server.h>
+
+/**
+ * TcpServer::SocketOptions 的效果: 客户端发送 1 个字节的请求, 服务器分两次 send() 回复 "hdr" 和 "body",
+ * nodelay 为 0 的时候第二次 send() 要等第一段的 ACK (Nagle 算法遇上延迟 ACK), 每个请求多等几十毫秒,
+ * deferSeconds 不为 0 的时候打开 TCP_DEFER_ACCEPT, 客户端 connect() 以后先不发数据,
+ * 打印这段时间里服务器有没有建立 TcpConnection, 然后打印 rounds 个请求的平均往返时间,
+ * ./sockoptbench [nodelay] [deferSeconds] [rounds] [port]
+ */
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const size_t kReplySize = 7; // "hdr" + "body",
+}
+
+int main(int argc, char const *argv[])
+{
+    bool noDelay = argc > 1 ? 0 != atoi(argv[1]) : true;
+    int deferSeconds = argc > 2 ? atoi(argv[2]) : 0;
+    int rounds = argc > 3 ? atoi(argv[3]) : 50;
+    uint16_t port = argc > 4 ? static_cast<uint16_t>(atoi(argv[4])) : 7410;
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port, "127.0.0.1"), "SockOptServer");
+    TcpServer::SocketOptions options;
+    options.tcpNoDelay = noDelay;
+    options.deferAcceptSeconds = deferSeconds;
+    server.setSocketOptions(options);
+    std::atomic<int> established(0);
+    server.setConnectionCallback([&established](const TcpConnectionPtr &conn)
+                                 {
+                                     if (conn->connected())
+                                     {
+                                         ++established;
+                                     }
+                                 });
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+                              {
+                                  buf->retrieveAll();
+                                  conn->send("hdr");
+                                  conn->send("body");
+                              });
+    server.start();
+
+    std::thread client([&]
+                       {
+                           std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                           int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+                           struct sockaddr_in addr;
+                           ::memset(&addr, 0, sizeof addr);
+                           addr.sin_family = AF_INET;
+                           addr.sin_port = htons(port);
+                           addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                           if (0 == ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr))
+                           {
+                               // 连接已经建立, 但是还没有发送数据,
+                               std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                               int establishedBeforeData = established.load();
+
+                               Clock::time_point start = Clock::now();
+                               char buf[64];
+                               for (int i = 0; i < rounds; ++i)
+                               {
+                                   ::write(fd, "q", 1);
+                                   size_t got = 0;
+                                   while (got < kReplySize)
+                                   {
+                                       ssize_t n = ::read(fd, buf, sizeof buf);
+                                       if (n <= 0)
+                                       {
+                                           break;
+                                       }
+                                       got += n;
+                                   }
+                               }
+                               double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+                               printf("nodelay %d, defer %ds: %s before the first byte, two-write reply RTT %.1f us\n",
+                                      noDelay, deferSeconds,
+                                      establishedBeforeData ? "connection established" : "no connection",
+                                      us / rounds);
+                           }
+                           ::close(fd);
+                           loop.runInLoop([&loop] { loop.quit(); });
+                       });
+    loop.loop();
+    client.join();
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <functional>
+#include <stdlib.h>
+#include <string>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/logger.h>
+#include <mymuduo/tcp_client.h>
+#include <mymuduo/tcp_connection.h>
+
+/**
+ * testserver 的客户端, testserver 回显以后就 shutdown(),
+ * 这里开启 enableRetry(), 连接断开以后自动重连, 一共连接 count 次, 最后打印每秒建立的连接数,
+ * ./testclient [count]
+ */
+class EchoClient
+{
+public:
+    EchoClient(EventLoop *loop, const InetAddress &serverAddr, int count)
+        : loop_(loop), client_(loop, serverAddr, "EchoClient"), count_(count), done_(0)
+    {
+        client_.setConnectionCallback(std::bind(&EchoClient::onConnection, this, std::placeholders::_1));
+        client_.setMessageCallback(std::bind(&EchoClient::onMessage, this,
+                                             std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        client_.enableRetry();
+    }
+
+    void connect()
+    {
+        start_ = Timestamp::now();
+        client_.connect();
+    }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if (conn->connected())
+        {
+            conn->send("hello");
+        }
+        else if (++done_ == count_)
+        {
+            double seconds = static_cast<double>(Timestamp::now().microSecondsSinceEpoch() - start_.microSecondsSinceEpoch()) /
+                             Timestamp::kMicroSecondsPerSecond;
+            printf("%d connections in %.3f seconds, %.0f connections/s\n", done_, seconds, done_ / seconds);
+            client_.stop();
+            loop_->quit();
+        }
+    }
+
+    void onMessage(const TcpConnectionPtr &, Buffer *buf, Timestamp)
+    {
+        buf->retrieveAll();
+    }
+
+private:
+    EventLoop *loop_;
+    TcpClient client_;
+    const int count_;
+    int done_;
+    Timestamp start_;
+};
+
+int main(int argc, char const *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 10000;
+    EventLoop loop;
+    InetAddress serverAddr(8000, "127.0.0.1");
+    EchoClient client(&loop, serverAddr, count);
+    client.connect();
+    loop.loop();
+
+    return 0;
+}
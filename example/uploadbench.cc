@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <arpa/inet.h>
+#include <functional>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+
+#include "bench_util.h"
+
+/**
+ * 大上传的接收内存: 客户端在 fork() 出来的子进程里面全速上传 sizeMB 数据, 服务器打印连接前, 上传中每 0.5 秒和上传完以后的 RSS,
+ * sink   setBodySink(sink, windowKB), sink 每秒最多消费 consumeMBps (0 不限速), 消费不了的留在 inputBuffer_ 里面,
+ *        积压达到 window 停止读, 下一个 10ms 补充额度以后 resumeBody(),
+ * buffer 原来的做法: messageCallback 不取走数据, 等整个上传都到了 inputBuffer_ 里面再处理, 积压超过 1GB 的时候放弃,
+ * ./uploadbench [sink|buffer] [sizeMB] [windowKB] [consumeMBps] [port]
+ */
+
+namespace
+{
+    const size_t kChunkSize = 64 * 1024;
+    const size_t kGiveUpBytes = 1024 * 1024 * 1024;
+
+    // 子进程: 阻塞的 socket 全速发送 total 字节, 然后关闭写, 等服务器关闭连接,
+    void runUploader(uint16_t port, size_t total)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        ::memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        // 服务器可能还没有 listen(),
+        for (int i = 0; i < 50 && 0 != ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof addr); ++i)
+        {
+            ::close(fd);
+            ::usleep(100 * 1000);
+            fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        }
+        std::string chunk(kChunkSize, 'u');
+        size_t sent = 0;
+        while (sent < total)
+        {
+            ssize_t n = ::write(fd, chunk.data(), std::min(chunk.size(), total - sent));
+            if (n <= 0)
+            {
+                break;
+            }
+            sent += n;
+        }
+        ::shutdown(fd, SHUT_WR);
+        char byte;
+        while (::read(fd, &byte, 1) > 0)
+        {
+        }
+        ::close(fd);
+    }
+}
+
+class UploadServer
+{
+public:
+    UploadServer(EventLoop *loop, const InetAddress &addr, bool sink, size_t total, size_t window, double consumeMBps)
+        : loop_(loop),
+          sink_(sink),
+          total_(total),
+          window_(window),
+          budgetPerTick_(consumeMBps > 0 ? static_cast<size_t>(consumeMBps * 1e6 / 100) : 0),
+          budget_(budgetPerTick_),
+          received_(0),
+          done_(false),
+          server_(loop, addr, "UploadServer")
+    {
+        printf("before: RSS %.1f MB\n", bench_util::rssKb() / 1024.0);
+        server_.setConnectionCallback(std::bind(&UploadServer::onConnection, this, std::placeholders::_1));
+        server_.setMessageCallback(std::bind(&UploadServer::onMessage, this, std::placeholders::_1,
+                                             std::placeholders::_2));
+        server_.start();
+    }
+
+private:
+    void onConnection(const TcpConnectionPtr &conn)
+    {
+        if (conn->connected())
+        {
+            conn_ = conn;
+            start_ = Timestamp::now();
+            if (sink_)
+            {
+                conn->setBodySink(std::bind(&UploadServer::onBody, this, std::placeholders::_1,
+                                            std::placeholders::_2, std::placeholders::_3),
+                                  window_);
+                if (budgetPerTick_ > 0)
+                {
+                    loop_->runEvery(0.01, std::bind(&UploadServer::onTick, this));
+                }
+            }
+            loop_->runEvery(0.5, std::bind(&UploadServer::sample, this));
+        }
+        else
+        {
+            conn_.reset();
+            loop_->quit();
+        }
+    }
+
+    // sink 模式: 最多消费 budget_ 字节, 剩下的留给 TcpConnection 积压,
+    size_t onBody(const TcpConnectionPtr &conn, const char *, size_t len)
+    {
+        size_t n = budgetPerTick_ > 0 ? std::min(len, budget_) : len;
+        budget_ -= budgetPerTick_ > 0 ? n : 0;
+        received_ += n;
+        if (received_ >= total_)
+        {
+            conn->clearBodySink();
+            finish(conn);
+        }
+        return n;
+    }
+
+    // buffer 模式: 整个上传都到了再一次处理, sink 模式清除 sink 以后不会再有数据,
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf)
+    {
+        if (sink_)
+        {
+            buf->retrieveAll();
+            return;
+        }
+        received_ = buf->readableBytes();
+        if (received_ >= total_ || received_ > kGiveUpBytes)
+        {
+            finish(conn);
+            buf->retrieveAll();
+        }
+    }
+
+    void onTick()
+    {
+        budget_ = budgetPerTick_;
+        if (conn_ && !done_)
+        {
+            conn_->resumeBody();
+        }
+    }
+
+    void sample()
+    {
+        if (conn_ && !done_)
+        {
+            printf("  %5.1fs: received %7.1f MB, RSS %7.1f MB\n", bench_util::secondsSince(start_),
+                   received_ / 1048576.0, bench_util::rssKb() / 1024.0);
+        }
+    }
+
+    void finish(const TcpConnectionPtr &conn)
+    {
+        if (done_)
+        {
+            return;
+        }
+        done_ = true;
+        double seconds = bench_util::secondsSince(start_);
+        printf("%s: %.1f MB in %.2f s, %.1f MB/s, RSS %.1f MB when done%s\n",
+               sink_ ? "sink" : "buffer", received_ / 1048576.0, seconds, received_ / seconds / 1e6,
+               bench_util::rssKb() / 1024.0, received_ < total_ ? ", gave up above 1 GB" : "");
+        conn->shutdown();
+        if (received_ < total_)
+        {
+            conn->forceClose();
+        }
+    }
+
+private:
+    EventLoop *loop_;
+    const bool sink_;
+    const size_t total_;
+    const size_t window_;
+    const size_t budgetPerTick_; // 每 10ms 可以消费的字节数, 0 不限速,
+    size_t budget_;
+    size_t received_;
+    bool done_;
+    Timestamp start_;
+    TcpConnectionPtr conn_;
+    TcpServer server_;
+};
+
+int main(int argc, char const *argv[])
+{
+    bool sink = argc > 1 ? 0 == ::strcmp(argv[1], "sink") : true;
+    size_t total = static_cast<size_t>(argc > 2 ? atol(argv[2]) : 2048) << 20;
+    size_t window = static_cast<size_t>(argc > 3 ? atol(argv[3]) : 256) << 10;
+    double consumeMBps = argc > 4 ? atof(argv[4]) : 0;
+    uint16_t port = argc > 5 ? static_cast<uint16_t>(atoi(argv[5])) : 7412;
+
+    // 每个线程只能有一个 EventLoop, 所以先 fork 再创建,
+    pid_t pid = ::fork();
+    if (0 == pid)
+    {
+        runUploader(port, total);
+        return 0;
+    }
+    {
+        EventLoop loop;
+        UploadServer server(&loop, InetAddress(port, "127.0.0.1"), sink, total, window, consumeMBps);
+        loop.loop();
+    }
+    // 连接和它的 inputBuffer_ 都释放了,
+    printf("after close: RSS %.1f MB, peak RSS %.1f MB\n", bench_util::rssKb() / 1024.0,
+           bench_util::peakRssKb() / 1024.0);
+    ::kill(pid, SIGTERM);
+    ::waitpid(pid, nullptr, 0);
+
+    return 0;
+}
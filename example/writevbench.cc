@@ -0,0 +1,146 @@
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/uio.h>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/tcp_client.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+
+#include "bench_util.h"
+
+/**
+ * 小头部 + 大消息体的响应: 服务器不停地发送 HTTP 风格的响应, 头部大约 120 字节, 消息体是缓存好的 bodySize 字节,
+ * concat   应用先把头部和消息体拼接到一个 std::string 里面再 send(),
+ * twosends 头部和消息体分两次 send(),
+ * iovec    send(iov, 2) 一次交给 TcpConnection, 在 loop 线程里面直接 writev(), 只拷贝没写完的部分,
+ * 客户端在同一个 loop 里面收下丢掉, 打印响应数/秒、吞吐和每 GB 的 CPU 时间,
+ * ./writevbench [concat|twosends|iovec] [bodySize] [seconds] [port]
+ */
+
+class WritevBench
+{
+public:
+    enum Mode
+    {
+        kConcat,
+        kTwoSends,
+        kIovec,
+    };
+
+    WritevBench(EventLoop *loop, const InetAddress &addr, Mode mode, size_t bodySize, double seconds)
+        : loop_(loop),
+          mode_(mode),
+          body_(bodySize, 'b'),
+          seconds_(seconds),
+          responses_(0),
+          received_(0),
+          running_(true),
+          server_(loop, addr, "WritevServer"),
+          client_(loop, addr, "WritevClient")
+    {
+        server_.setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                      {
+                                          if (conn->connected())
+                                          {
+                                              start_ = Timestamp::now();
+                                              startCpu_ = bench_util::cpuSeconds();
+                                              loop_->runAfter(seconds_, std::bind(&WritevBench::report, this));
+                                              sendResponses(conn);
+                                          }
+                                      });
+        server_.setWriteCompleteCallback(std::bind(&WritevBench::sendResponses, this, std::placeholders::_1));
+        server_.start();
+
+        client_.setMessageCallback([this](const TcpConnectionPtr &, Buffer *buf, Timestamp)
+                                   {
+                                       received_ += buf->readableBytes();
+                                       buf->retrieveAll();
+                                   });
+        client_.connect();
+    }
+
+private:
+    // 积压到 1MB 为止, 发送缓冲区清空以后 (WriteCompleteCallback) 继续,
+    void sendResponses(const TcpConnectionPtr &conn)
+    {
+        while (running_ && conn->connected() && conn->outputBytes() < 1024 * 1024)
+        {
+            char header[160];
+            int headerLen = snprintf(header, sizeof header,
+                                     "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+                                     "Content-Length: %zu\r\nX-Seq: %lu\r\n\r\n",
+                                     body_.size(), responses_);
+            if (kConcat == mode_)
+            {
+                std::string response(header, headerLen);
+                response += body_;
+                conn->send(response);
+            }
+            else if (kTwoSends == mode_)
+            {
+                conn->send(std::string(header, headerLen));
+                conn->send(body_);
+            }
+            else
+            {
+                struct iovec vec[2];
+                vec[0].iov_base = header;
+                vec[0].iov_len = headerLen;
+                vec[1].iov_base = const_cast<char *>(body_.data());
+                vec[1].iov_len = body_.size();
+                conn->send(vec, 2);
+            }
+            ++responses_;
+        }
+    }
+
+    void report()
+    {
+        running_ = false;
+        double seconds = bench_util::secondsSince(start_);
+        double cpu = bench_util::cpuSeconds() - startCpu_;
+        static const char *const kNames[] = {"concat", "twosends", "iovec"};
+        printf("%-8s body %zu bytes: %.0f responses/s, %.1f MB/s, %.2f CPU seconds per GB\n", kNames[mode_],
+               body_.size(), responses_ / seconds, received_ / seconds / 1e6, cpu / (received_ / 1e9));
+        loop_->quit();
+    }
+
+private:
+    EventLoop *loop_;
+    const Mode mode_;
+    const std::string body_;
+    const double seconds_;
+    unsigned long responses_;
+    uint64_t received_;
+    bool running_;
+    Timestamp start_;
+    double startCpu_;
+    TcpServer server_;
+    TcpClient client_;
+};
+
+int main(int argc, char const *argv[])
+{
+    WritevBench::Mode mode = WritevBench::kIovec;
+    if (argc > 1 && 0 == ::strcmp(argv[1], "concat"))
+    {
+        mode = WritevBench::kConcat;
+    }
+    else if (argc > 1 && 0 == ::strcmp(argv[1], "twosends"))
+    {
+        mode = WritevBench::kTwoSends;
+    }
+    size_t bodySize = argc > 2 ? static_cast<size_t>(atol(argv[2])) : 64 * 1024;
+    double seconds = argc > 3 ? atof(argv[3]) : 5;
+    uint16_t port = argc > 4 ? static_cast<uint16_t>(atoi(argv[4])) : 7401;
+
+    EventLoop loop;
+    WritevBench bench(&loop, InetAddress(port, "127.0.0.1"), mode, bodySize, seconds);
+    loop.loop();
+
+    return 0;
+}
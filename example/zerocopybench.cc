@@ -0,0 +1,143 @@
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <mymuduo/event_loop.h>
+#include <mymuduo/payload.h>
+#include <mymuduo/tcp_client.h>
+#include <mymuduo/tcp_connection.h>
+#include <mymuduo/tcp_server.h>
+
+#include "bench_util.h"
+
+/**
+ * 发送端每 GB 的 CPU 时间: 服务器用 send(PayloadPtr) 发送 totalMB 数据, 每个 payload messageSize 字节,
+ * copy 普通的 writev() 路径, zerocopy 打开 TcpConnection::setZeroCopy(), payload 用 MSG_ZEROCOPY 发送,
+ * 接收端在 fork() 出来的子进程里面, 父进程的 getrusage() 只包括发送端,
+ * loopback 上内核最后还是会拷贝一次 (完成通知里面带 SO_EE_CODE_ZEROCOPY_COPIED), 真正的收益要在物理网卡上测,
+ * ./zerocopybench [copy|zerocopy] [messageSize] [totalMB] [port]
+ */
+
+namespace
+{
+    // 子进程: 连接服务器, 收下数据丢掉, 服务器关闭连接以后退出,
+    void runReceiver(const InetAddress &addr)
+    {
+        EventLoop loop;
+        TcpClient client(&loop, addr, "ZeroCopyReceiver");
+        client.setConnectionCallback([&loop](const TcpConnectionPtr &conn)
+                                     {
+                                         if (!conn->connected())
+                                         {
+                                             loop.quit();
+                                         }
+                                     });
+        client.setMessageCallback([](const TcpConnectionPtr &, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+        client.connect();
+        loop.loop();
+    }
+}
+
+class ZeroCopyBench
+{
+public:
+    ZeroCopyBench(EventLoop *loop, const InetAddress &addr, bool zeroCopy, size_t messageSize, size_t total)
+        : loop_(loop),
+          zeroCopy_(zeroCopy),
+          payload_(Payload::fromString(std::string(messageSize, 'z'))),
+          total_(total),
+          sent_(0),
+          done_(false),
+          startCpu_(0),
+          server_(loop, addr, "ZeroCopyServer")
+    {
+        server_.setConnectionCallback([this](const TcpConnectionPtr &conn)
+                                      {
+                                          if (conn->connected())
+                                          {
+                                              if (zeroCopy_ && !conn->setZeroCopy(true, payload_->size()))
+                                              {
+                                                  printf("SO_ZEROCOPY is not supported, falling back to copy\n");
+                                              }
+                                              start_ = Timestamp::now();
+                                              double user = 0, sys = 0;
+                                              startCpu_ = bench_util::cpuSeconds(&user, &sys);
+                                              startUser_ = user;
+                                              startSys_ = sys;
+                                              sendMore(conn);
+                                          }
+                                      });
+        server_.setWriteCompleteCallback(std::bind(&ZeroCopyBench::sendMore, this, std::placeholders::_1));
+        server_.start();
+    }
+
+private:
+    // 积压 4 个 payload 为止, 发送缓冲区清空以后继续, 全部发完以后关闭连接,
+    void sendMore(const TcpConnectionPtr &conn)
+    {
+        while (sent_ < total_ && conn->outputBytes() < 4 * payload_->size())
+        {
+            conn->send(payload_);
+            sent_ += payload_->size();
+        }
+        // 排在后面的 WriteCompleteCallback 还会再调用一次, 只报告一次,
+        if (sent_ >= total_ && 0 == conn->outputBytes() && !done_)
+        {
+            done_ = true;
+            report();
+            conn->shutdown();
+        }
+    }
+
+    void report()
+    {
+        double seconds = bench_util::secondsSince(start_);
+        double user = 0, sys = 0;
+        double cpu = bench_util::cpuSeconds(&user, &sys) - startCpu_;
+        double gb = sent_ / 1e9;
+        printf("%-8s %zu byte payloads, %.1f GB in %.2f s: %.1f MB/s, sender CPU %.3f s/GB (user %.3f, sys %.3f)\n",
+               zeroCopy_ ? "zerocopy" : "copy", payload_->size(), gb, seconds, sent_ / seconds / 1e6, cpu / gb,
+               (user - startUser_) / gb, (sys - startSys_) / gb);
+        loop_->runAfter(0.1, [this] { loop_->quit(); });
+    }
+
+private:
+    EventLoop *loop_;
+    const bool zeroCopy_;
+    const PayloadPtr payload_;
+    const size_t total_;
+    size_t sent_;
+    bool done_;
+    Timestamp start_;
+    double startCpu_;
+    double startUser_;
+    double startSys_;
+    TcpServer server_;
+};
+
+int main(int argc, char const *argv[])
+{
+    bool zeroCopy = argc > 1 ? 0 == ::strcmp(argv[1], "zerocopy") : true;
+    size_t messageSize = argc > 2 ? static_cast<size_t>(atol(argv[2])) : 4 * 1024 * 1024;
+    size_t total = (argc > 3 ? static_cast<size_t>(atol(argv[3])) : 4096) << 20;
+    uint16_t port = argc > 4 ? static_cast<uint16_t>(atoi(argv[4])) : 7403;
+    InetAddress addr(port, "127.0.0.1");
+
+    // 每个线程只能有一个 EventLoop, 所以先 fork 再创建, 接收端比服务器先 connect() 的话 Connector 会重试,
+    pid_t pid = ::fork();
+    if (0 == pid)
+    {
+        runReceiver(addr);
+        return 0;
+    }
+    EventLoop loop;
+    ZeroCopyBench bench(&loop, addr, zeroCopy, messageSize, total);
+    loop.loop();
+    ::waitpid(pid, nullptr, 0);
+
+    return 0;
+}
@@ -0,0 +1,435 @@
+#include <algorithm>
+#include <string.h>
+
+#include "http_context.h"
+
+#include "buffer.h"
+
+namespace
+{
+    struct MethodName
+    {
+        const char *name;
+        size_t len;
+        HttpRequest::Method method;
+    };
+
+    const MethodName kMethods[] = {
+        {"GET", 3, HttpRequest::kGet},
+        {"POST", 4, HttpRequest::kPost},
+        {"HEAD", 4, HttpRequest::kHead},
+        {"PUT", 3, HttpRequest::kPut},
+        {"DELETE", 6, HttpRequest::kDelete},
+        {"OPTIONS", 7, HttpRequest::kOptions},
+        {"PATCH", 5, HttpRequest::kPatch},
+    };
+
+    bool isBlank(char c)
+    {
+        return ' ' == c || '\t' == c;
+    }
+
+    int hexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f')
+        {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F')
+        {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+}
+
+HttpContext::HttpContext(size_t maxBodyBytes)
+    : state_(kExpectRequestLine),
+      parsed_(0),
+      scanned_(0),
+      sectionBegin_(0),
+      maxBodyBytes_(maxBodyBytes),
+      errorCode_(HttpResponse::kUnknown),
+      contentLength_(-1),
+      chunkRemaining_(0)
+{
+}
+
+void HttpContext::reset()
+{
+    state_ = kExpectRequestLine;
+    parsed_ = 0;
+    scanned_ = 0;
+    sectionBegin_ = 0;
+    errorCode_ = HttpResponse::kUnknown;
+    headers_.clear();
+    contentLength_ = -1;
+    chunkRemaining_ = 0;
+
+    // 逐个字段清空, 保留 headers_ 和 chunkedBody_ 已经分配的内存, 下一个请求接着用,
+    request_.method_ = HttpRequest::kInvalid;
+    request_.version_ = HttpRequest::kUnknown;
+    request_.headers_.clear();
+    request_.body_ = StringPiece();
+    request_.chunked_ = false;
+    request_.chunkedBody_.clear();
+}
+
+HttpContext::ParseResult HttpContext::parseRequest(Buffer *buf, Timestamp receiveTime)
+{
+    Range line;
+    while (kGotAll != state_)
+    {
+        const char *base = buf->peek();
+        switch (state_)
+        {
+        case kExpectRequestLine:
+        case kExpectHeaders:
+        case kExpectChunkTrailer:
+            if (!nextLine(buf, &line))
+            {
+                // 请求头 (或者 trailer) 还没有结束, 已经收到的数据全部属于它,
+                if (buf->readableBytes() - sectionBegin_ > kMaxHeaderBytes)
+                {
+                    return fail(HttpResponse::k431RequestHeaderFieldsTooLarge);
+                }
+                return kIncomplete;
+            }
+            if (parsed_ - sectionBegin_ > kMaxHeaderBytes)
+            {
+                return fail(HttpResponse::k431RequestHeaderFieldsTooLarge);
+            }
+            if (kExpectRequestLine == state_)
+            {
+                // 请求之间多余的空行忽略掉,
+                if (0 == line.length)
+                {
+                    continue;
+                }
+                if (!processRequestLine(base, line))
+                {
+                    return kError;
+                }
+                state_ = kExpectHeaders;
+                request_.receiveTime_ = receiveTime;
+            }
+            else if (kExpectHeaders == state_)
+            {
+                if (0 == line.length)
+                {
+                    if (!processHeadersEnd())
+                    {
+                        return kError;
+                    }
+                }
+                else if (!processHeader(base, line))
+                {
+                    return kError;
+                }
+            }
+            else if (0 == line.length)
+            {
+                // chunked 的 trailer 以空行结束, trailer 里面的头部忽略,
+                state_ = kGotAll;
+            }
+            break;
+
+        case kExpectBody:
+            if (buf->readableBytes() < parsed_ + static_cast<size_t>(contentLength_))
+            {
+                return kIncomplete;
+            }
+            body_.offset = parsed_;
+            body_.length = contentLength_;
+            parsed_ += contentLength_;
+            state_ = kGotAll;
+            break;
+
+        case kExpectChunkSize:
+            // chunk-size 行可以带扩展, 没有长度限制的话对端可以一直发送不换行的数据,
+            if (!nextLine(buf, &line))
+            {
+                if (buf->readableBytes() - parsed_ > kMaxChunkLineBytes)
+                {
+                    return fail(HttpResponse::k400BadRequest);
+                }
+                return kIncomplete;
+            }
+            if (line.length > kMaxChunkLineBytes)
+            {
+                return fail(HttpResponse::k400BadRequest);
+            }
+            if (!processChunkSize(base, line))
+            {
+                return kError;
+            }
+            break;
+
+        case kExpectChunkData:
+            // chunk 的数据后面跟着 "\r\n",
+            if (buf->readableBytes() < parsed_ + chunkRemaining_ + 2)
+            {
+                return kIncomplete;
+            }
+            if ('\r' != base[parsed_ + chunkRemaining_] || '\n' != base[parsed_ + chunkRemaining_ + 1])
+            {
+                return fail(HttpResponse::k400BadRequest);
+            }
+            request_.chunkedBody_.append(base + parsed_, chunkRemaining_);
+            parsed_ += chunkRemaining_ + 2;
+            scanned_ = parsed_;
+            chunkRemaining_ = 0;
+            state_ = kExpectChunkSize;
+            break;
+
+        default:
+            break;
+        }
+    }
+    finish(buf->peek());
+    return kComplete;
+}
+
+bool HttpContext::nextLine(const Buffer *buf, Range *line)
+{
+    const char *crlf = buf->findCRLF(buf->peek() + std::max(parsed_, scanned_));
+    if (nullptr == crlf)
+    {
+        // 最后一个字节可能是 '\r', 下一次从它开始找,
+        size_t readable = buf->readableBytes();
+        scanned_ = std::max(parsed_, readable > 0 ? readable - 1 : 0);
+        return false;
+    }
+    size_t end = crlf - buf->peek();
+    line->offset = parsed_;
+    line->length = end - parsed_;
+    parsed_ = end + 2;
+    scanned_ = parsed_;
+    return true;
+}
+
+bool HttpContext::processRequestLine(const char *base, const Range &line)
+{
+    const char *begin = base + line.offset;
+    const char *end = begin + line.length;
+
+    const char *space = static_cast<const char *>(::memchr(begin, ' ', end - begin));
+    if (nullptr == space)
+    {
+        errorCode_ = HttpResponse::k400BadRequest;
+        return false;
+    }
+    method_.offset = line.offset;
+    method_.length = space - begin;
+    request_.method_ = HttpRequest::kInvalid;
+    for (const MethodName &m : kMethods)
+    {
+        if (m.len == method_.length && 0 == ::memcmp(m.name, begin, m.len))
+        {
+            request_.method_ = m.method;
+            break;
+        }
+    }
+    if (HttpRequest::kInvalid == request_.method_)
+    {
+        errorCode_ = HttpResponse::k501NotImplemented;
+        return false;
+    }
+
+    const char *targetBegin = space + 1;
+    space = static_cast<const char *>(::memchr(targetBegin, ' ', end - targetBegin));
+    if (nullptr == space || space == targetBegin)
+    {
+        errorCode_ = HttpResponse::k400BadRequest;
+        return false;
+    }
+    target_.offset = targetBegin - base;
+    target_.length = space - targetBegin;
+
+    StringPiece version(space + 1, end - space - 1);
+    if (version == "HTTP/1.1")
+    {
+        request_.version_ = HttpRequest::kHttp11;
+    }
+    else if (version == "HTTP/1.0")
+    {
+        request_.version_ = HttpRequest::kHttp10;
+    }
+    else
+    {
+        errorCode_ = HttpResponse::k400BadRequest;
+        return false;
+    }
+    return true;
+}
+
+bool HttpContext::processHeader(const char *base, const Range &line)
+{
+    const char *begin = base + line.offset;
+    const char *end = begin + line.length;
+    const char *colon = static_cast<const char *>(::memchr(begin, ':', end - begin));
+    // 头部名字不能为空, 名字和冒号之间也不能有空白 (RFC 7230 3.2.4),
+    if (nullptr == colon || colon == begin || isBlank(colon[-1]))
+    {
+        errorCode_ = HttpResponse::k400BadRequest;
+        return false;
+    }
+    const char *valueBegin = colon + 1;
+    while (valueBegin < end && isBlank(*valueBegin))
+    {
+        ++valueBegin;
+    }
+    const char *valueEnd = end;
+    while (valueEnd > valueBegin && isBlank(valueEnd[-1]))
+    {
+        --valueEnd;
+    }
+
+    Range name = {line.offset, static_cast<size_t>(colon - begin)};
+    Range value = {static_cast<size_t>(valueBegin - base), static_cast<size_t>(valueEnd - valueBegin)};
+    headers_.emplace_back(name, value);
+
+    StringPiece nameView(begin, name.length);
+    StringPiece valueView(valueBegin, value.length);
+    if (nameView.equalsIgnoreCase("Content-Length"))
+    {
+        // 重复的 Content-Length 不管值是否相同都拒绝, 和前面的代理理解不一致的话会造成请求走私 (RFC 7230 3.3.3),
+        if (contentLength_ >= 0 || valueView.empty() || valueView.size() > 18)
+        {
+            errorCode_ = HttpResponse::k400BadRequest;
+            return false;
+        }
+        int64_t length = 0;
+        for (char c : valueView)
+        {
+            if (c < '0' || c > '9')
+            {
+                errorCode_ = HttpResponse::k400BadRequest;
+                return false;
+            }
+            length = length * 10 + (c - '0');
+        }
+        contentLength_ = length;
+    }
+    else if (nameView.equalsIgnoreCase("Transfer-Encoding"))
+    {
+        // 只支持单独的 chunked, "gzip, chunked" 这样的组合解不开 gzip, 不能把编码过的消息体交给应用,
+        // 重复的 Transfer-Encoding 相当于 "chunked, chunked", 也不接受,
+        if (request_.chunked_)
+        {
+            errorCode_ = HttpResponse::k400BadRequest;
+            return false;
+        }
+        if (valueView.equalsIgnoreCase("chunked"))
+        {
+            request_.chunked_ = true;
+        }
+        else
+        {
+            errorCode_ = HttpResponse::k501NotImplemented;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HttpContext::processHeadersEnd()
+{
+    // 同时有 Transfer-Encoding 和 Content-Length 的请求拒绝掉, 不按 Transfer-Encoding 为准继续解析,
+    // 前面的代理可能按 Content-Length 切分, 同一个连接上后面的请求边界就对不上了,
+    if (request_.chunked_ && contentLength_ >= 0)
+    {
+        errorCode_ = HttpResponse::k400BadRequest;
+        return false;
+    }
+    if (request_.chunked_)
+    {
+        state_ = kExpectChunkSize;
+    }
+    else if (contentLength_ > 0)
+    {
+        if (static_cast<size_t>(contentLength_) > maxBodyBytes_)
+        {
+            errorCode_ = HttpResponse::k413PayloadTooLarge;
+            return false;
+        }
+        state_ = kExpectBody;
+    }
+    else
+    {
+        body_.offset = parsed_;
+        body_.length = 0;
+        state_ = kGotAll;
+    }
+    return true;
+}
+
+bool HttpContext::processChunkSize(const char *base, const Range &line)
+{
+    const char *p = base + line.offset;
+    const char *end = p + line.length;
+    size_t size = 0;
+    int digits = 0;
+    for (; p < end && ';' != *p && !isBlank(*p); ++p, ++digits)
+    {
+        int v = hexValue(*p);
+        if (v < 0 || digits >= 15)
+        {
+            errorCode_ = HttpResponse::k400BadRequest;
+            return false;
+        }
+        size = size * 16 + v;
+    }
+    if (0 == digits)
+    {
+        errorCode_ = HttpResponse::k400BadRequest;
+        return false;
+    }
+    if (0 == size)
+    {
+        // trailer 和请求头一样受 kMaxHeaderBytes 限制,
+        sectionBegin_ = parsed_;
+        state_ = kExpectChunkTrailer;
+        return true;
+    }
+    if (request_.chunkedBody_.size() + size > maxBodyBytes_)
+    {
+        errorCode_ = HttpResponse::k413PayloadTooLarge;
+        return false;
+    }
+    chunkRemaining_ = size;
+    state_ = kExpectChunkData;
+    return true;
+}
+
+void HttpContext::finish(const char *base)
+{
+    request_.methodString_ = StringPiece(base + method_.offset, method_.length);
+
+    const char *target = base + target_.offset;
+    const char *question = static_cast<const char *>(::memchr(target, '?', target_.length));
+    if (nullptr != question)
+    {
+        request_.path_ = StringPiece(target, question - target);
+        request_.query_ = StringPiece(question + 1, target + target_.length - question - 1);
+    }
+    else
+    {
+        request_.path_ = StringPiece(target, target_.length);
+        request_.query_ = StringPiece();
+    }
+
+    for (const auto &h : headers_)
+    {
+        request_.headers_.emplace_back(StringPiece(base + h.first.offset, h.first.length),
+                                       StringPiece(base + h.second.offset, h.second.length));
+    }
+    if (!request_.chunked_)
+    {
+        request_.body_ = StringPiece(base + body_.offset, body_.length);
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "http_request.h"
+#include "http_response.h"
+#include "timestamp.h"
+
+class Buffer;
+
+/**
+ * 一个连接上的 HTTP 请求解析状态, 增量解析: 数据没有收完的时候返回 kIncomplete, 下一次 onMessage() 从上次停下的地方继续,
+ * 已经确认过的行不会再扫描一遍,
+ * 解析的时候不从 Buffer 里面取走数据, 只记录各个字段相对于 peek() 的偏移, 因为 Buffer 在两次读之间可能重新分配内存,
+ * 整个请求收齐以后才把偏移转换成指向 Buffer 的 StringPiece, 请求处理完以后调用者再 retrieve(requestLength()),
+ */
+class HttpContext
+{
+public:
+    enum ParseResult
+    {
+        kIncomplete,
+        kComplete,
+        kError,
+    };
+
+    static const size_t kMaxHeaderBytes = 64 * 1024;
+    static const size_t kMaxChunkLineBytes = 4 * 1024;
+    static const size_t kDefaultMaxBodyBytes = 64 * 1024 * 1024;
+
+    explicit HttpContext(size_t maxBodyBytes = kDefaultMaxBodyBytes);
+
+public:
+    // 从 buf->peek() 开始解析一个请求,
+    ParseResult parseRequest(Buffer *buf, Timestamp receiveTime);
+
+    // kComplete 以后有效, 指向 buf 里面的数据,
+    const HttpRequest &request() const { return request_; }
+    // kComplete 以后, 这个请求在 buf 里面占用的字节数,
+    size_t requestLength() const { return parsed_; }
+    // kError 以后, 应该回复的状态码,
+    HttpResponse::HttpStatusCode errorCode() const { return errorCode_; }
+
+    // 准备解析下一个请求, 调用之前要先 retrieve(requestLength()),
+    void reset();
+
+private:
+    enum ParseState
+    {
+        kExpectRequestLine,
+        kExpectHeaders,
+        kExpectBody,
+        kExpectChunkSize,
+        kExpectChunkData,
+        kExpectChunkTrailer,
+        kGotAll,
+    };
+
+    // 相对于 peek() 的一段数据,
+    struct Range
+    {
+        size_t offset;
+        size_t length;
+    };
+
+    // 找到下一个 "\r\n", 返回这一行相对于 peek() 的位置, 不包括 "\r\n", 没有完整的一行返回 false,
+    bool nextLine(const Buffer *buf, Range *line);
+    bool processRequestLine(const char *base, const Range &line);
+    bool processHeader(const char *base, const Range &line);
+    // 头部结束了, 根据 Content-Length / Transfer-Encoding 决定怎么读消息体,
+    bool processHeadersEnd();
+    bool processChunkSize(const char *base, const Range &line);
+    // 把偏移转换成指向 base 的 StringPiece,
+    void finish(const char *base);
+
+    ParseResult fail(HttpResponse::HttpStatusCode code)
+    {
+        errorCode_ = code;
+        return kError;
+    }
+
+private:
+    ParseState state_;
+    size_t parsed_;       // 当前请求已经解析的字节数,
+    size_t scanned_;      // 当前行已经确认没有 "\r\n" 的字节数, 相对于 peek(),
+    size_t sectionBegin_; // 请求头或者 trailer 开始的位置, 相对于 peek(), 用来限制它们的长度,
+    size_t maxBodyBytes_;
+    HttpResponse::HttpStatusCode errorCode_;
+
+    HttpRequest request_;
+    Range method_;
+    Range target_;
+    std::vector<std::pair<Range, Range>> headers_;
+    Range body_;
+    int64_t contentLength_; // -1 表示没有 Content-Length,
+    size_t chunkRemaining_;
+};
@@ -0,0 +1,23 @@
+#include "http_request.h"
+
+StringPiece HttpRequest::header(const StringPiece &name) const
+{
+    for (const Header &h : headers_)
+    {
+        if (h.first.equalsIgnoreCase(name))
+        {
+            return h.second;
+        }
+    }
+    return StringPiece();
+}
+
+bool HttpRequest::keepAlive() const
+{
+    StringPiece connection = header("Connection");
+    if (kHttp11 == version_)
+    {
+        return !connection.equalsIgnoreCase("close");
+    }
+    return connection.equalsIgnoreCase("keep-alive");
+}
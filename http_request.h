@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "string_piece.h"
+#include "timestamp.h"
+
+class HttpContext;
+
+/**
+ * 一个解析完成的 HTTP 请求,
+ * 请求行、头部和 Content-Length 的消息体都不拷贝, 指向连接的 inputBuffer_ 里面的数据,
+ * 所以 HttpRequest 只在 HttpServer 的请求回调里面有效, 需要保存的内容要在回调里面自己拷贝 (asString()),
+ * chunked 的消息体分散在各个 chunk 里面, 解码到 HttpRequest 自己的 string 里面,
+ */
+class HttpRequest
+{
+public:
+    enum Method
+    {
+        kInvalid,
+        kGet,
+        kPost,
+        kHead,
+        kPut,
+        kDelete,
+        kOptions,
+        kPatch,
+    };
+
+    enum Version
+    {
+        kUnknown,
+        kHttp10,
+        kHttp11,
+    };
+
+    using Header = std::pair<StringPiece, StringPiece>;
+
+    HttpRequest() : method_(kInvalid), version_(kUnknown), chunked_(false) {}
+
+public:
+    Method method() const { return method_; }
+    StringPiece methodString() const { return methodString_; }
+    Version version() const { return version_; }
+    StringPiece path() const { return path_; }
+    StringPiece query() const { return query_; } // '?' 后面的部分, 没有的时候为空,
+    StringPiece body() const { return chunked_ ? StringPiece(chunkedBody_) : body_; }
+    bool chunked() const { return chunked_; }
+    Timestamp receiveTime() const { return receiveTime_; }
+
+    // 头部的名字不区分大小写, 没有这个头部的时候返回空的 StringPiece, 同名的头部返回第一个,
+    StringPiece header(const StringPiece &name) const;
+    const std::vector<Header> &headers() const { return headers_; }
+
+    // HTTP/1.1 默认长连接, 除非 "Connection: close", HTTP/1.0 默认短连接, 除非 "Connection: keep-alive",
+    bool keepAlive() const;
+
+private:
+    friend class HttpContext;
+
+    Method method_;
+    StringPiece methodString_;
+    Version version_;
+    StringPiece path_;
+    StringPiece query_;
+    std::vector<Header> headers_;
+    StringPiece body_;
+    bool chunked_;
+    std::string chunkedBody_;
+    Timestamp receiveTime_;
+};
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "http_response.h"
+
+#include "buffer.h"
+
+namespace
+{
+    const char *defaultStatusMessage(HttpResponse::HttpStatusCode code)
+    {
+        switch (code)
+        {
+        case HttpResponse::k200Ok:
+            return "OK";
+        case HttpResponse::k204NoContent:
+            return "No Content";
+        case HttpResponse::k301MovedPermanently:
+            return "Moved Permanently";
+        case HttpResponse::k304NotModified:
+            return "Not Modified";
+        case HttpResponse::k400BadRequest:
+            return "Bad Request";
+        case HttpResponse::k404NotFound:
+            return "Not Found";
+        case HttpResponse::k413PayloadTooLarge:
+            return "Payload Too Large";
+        case HttpResponse::k431RequestHeaderFieldsTooLarge:
+            return "Request Header Fields Too Large";
+        case HttpResponse::k500InternalServerError:
+            return "Internal Server Error";
+        case HttpResponse::k501NotImplemented:
+            return "Not Implemented";
+        default:
+            return "Unknown";
+        }
+    }
+}
+
+void HttpResponse::appendHeadersToBuffer(Buffer *output) const
+{
+    char line[64];
+    int n = ::snprintf(line, sizeof line, "HTTP/1.1 %d ", statusCode_);
+    output->append(line, n);
+    if (statusMessage_.empty())
+    {
+        const char *message = defaultStatusMessage(statusCode_);
+        output->append(message, ::strlen(message));
+    }
+    else
+    {
+        output->append(statusMessage_.data(), statusMessage_.size());
+    }
+    output->append("\r\n", 2);
+
+    if (closeConnection_)
+    {
+        static const char kClose[] = "Connection: close\r\n";
+        output->append(kClose, sizeof(kClose) - 1);
+    }
+    else
+    {
+        // HTTP/1.0 的客户端要求长连接的时候需要明确回复 keep-alive, HTTP/1.1 的客户端忽略它,
+        static const char kKeepAlive[] = "Connection: Keep-Alive\r\n";
+        output->append(kKeepAlive, sizeof(kKeepAlive) - 1);
+    }
+    if (hasBody())
+    {
+        n = ::snprintf(line, sizeof line, "Content-Length: %zu\r\n", body_.size());
+        output->append(line, n);
+    }
+
+    for (const auto &header : headers_)
+    {
+        output->append(header.first.data(), header.first.size());
+        output->append(": ", 2);
+        output->append(header.second.data(), header.second.size());
+        output->append("\r\n", 2);
+    }
+    output->append("\r\n", 2);
+}
+
+void HttpResponse::appendToBuffer(Buffer *output) const
+{
+    appendHeadersToBuffer(output);
+    if (hasBody())
+    {
+        output->append(body_.data(), body_.size());
+    }
+}
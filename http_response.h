@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class Buffer;
+
+/**
+ * HTTP 响应, 头部由 appendHeadersToBuffer() 写进 Buffer, 消息体单独保存,
+ * HttpServer 发送的时候头部和消息体作为 iovec 的两段一次 writev() 发出去, 消息体不再拷贝到头部后面,
+ */
+class HttpResponse
+{
+public:
+    enum HttpStatusCode
+    {
+        kUnknown,
+        k200Ok = 200,
+        k204NoContent = 204,
+        k301MovedPermanently = 301,
+        k304NotModified = 304,
+        k400BadRequest = 400,
+        k404NotFound = 404,
+        k413PayloadTooLarge = 413,
+        k431RequestHeaderFieldsTooLarge = 431,
+        k500InternalServerError = 500,
+        k501NotImplemented = 501,
+    };
+
+    explicit HttpResponse(bool close) : statusCode_(kUnknown), closeConnection_(close) {}
+
+public:
+    void setStatusCode(HttpStatusCode code) { statusCode_ = code; }
+    void setStatusMessage(const std::string &message) { statusMessage_ = message; }
+    // 发送完这个响应以后关闭连接, 后面流水线上的请求不再处理,
+    void setCloseConnection(bool on) { closeConnection_ = on; }
+    bool closeConnection() const { return closeConnection_; }
+
+    void setContentType(const std::string &contentType) { addHeader("Content-Type", contentType); }
+    void addHeader(const std::string &key, const std::string &value) { headers_.emplace_back(key, value); }
+
+    void setBody(std::string body) { body_ = std::move(body); }
+    const std::string &body() const { return body_; }
+    // 直接在消息体后面追加数据, 或者把消息体移走, 不需要拷贝,
+    std::string *mutableBody() { return &body_; }
+
+    // 1xx, 204 和 304 的响应没有消息体, 也不带 Content-Length (RFC 9110 8.6, 15.4.5), setBody() 设置的内容不发送,
+    bool hasBody() const
+    {
+        return !(statusCode_ >= 100 && statusCode_ < 200) && k204NoContent != statusCode_ &&
+               k304NotModified != statusCode_;
+    }
+
+    // 状态行和头部, 包括 Content-Length (有消息体的时候) 和 Connection, 以空行结尾,
+    void appendHeadersToBuffer(Buffer *output) const;
+    // 头部加上消息体, 写到一个 Buffer 里面,
+    void appendToBuffer(Buffer *output) const;
+
+private:
+    std::vector<std::pair<std::string, std::string>> headers_;
+    HttpStatusCode statusCode_;
+    std::string statusMessage_;
+    bool closeConnection_;
+    std::string body_;
+};
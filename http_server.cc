@@ -0,0 +1,156 @@
+#include <sys/uio.h>
+#include <vector>
+
+#include "http_server.h"
+
+#include "buffer.h"
+#include "http_context.h"
+#include "http_request.h"
+#include "http_response.h"
+#include "logger.h"
+
+namespace
+{
+    /**
+     * 一次 onMessage() 里面攒起来的响应, 所有响应的头部连续写在 headers 里面, 各自记录偏移,
+     * 最后按照 头部, 消息体, 头部, 消息体 ... 的顺序组成 iovec 一次发送,
+     * 每个 subLoop 线程一份, 发送以后清空, 已经分配的内存留给下一次用,
+     */
+    struct ResponseBatch
+    {
+        Buffer headers;
+        std::vector<std::pair<size_t, size_t>> headerRanges; // 每个响应的头部在 headers 里面的 [偏移, 长度),
+        std::vector<std::string> bodies;
+        std::vector<struct iovec> iov;
+    };
+
+    thread_local ResponseBatch t_batch;
+
+    // 一次 writev() 的段数有上限 (IOV_MAX), 攒到这么多个响应就先发送一次,
+    const size_t kMaxBatchedResponses = 128;
+
+    void defaultHttpCallback(const HttpRequest &, HttpResponse *resp)
+    {
+        resp->setStatusCode(HttpResponse::k404NotFound);
+        resp->setCloseConnection(true);
+    }
+
+    // 消息体从 resp 里面移走, 不拷贝,
+    void appendResponse(ResponseBatch *batch, HttpResponse *resp, bool withBody)
+    {
+        size_t offset = batch->headers.readableBytes();
+        resp->appendHeadersToBuffer(&batch->headers);
+        batch->headerRanges.emplace_back(offset, batch->headers.readableBytes() - offset);
+        // HEAD 请求的响应有 Content-Length, 但是没有消息体, 204/304 连 Content-Length 也没有,
+        batch->bodies.push_back(withBody && resp->hasBody() ? std::move(*resp->mutableBody()) : std::string());
+    }
+
+    void flushResponses(const TcpConnectionPtr &conn, ResponseBatch *batch)
+    {
+        if (batch->headerRanges.empty())
+        {
+            return;
+        }
+        // headers 在所有响应都写完以后才取地址, 中间 append() 重新分配内存也没有关系,
+        const char *base = batch->headers.peek();
+        batch->iov.clear();
+        for (size_t i = 0; i < batch->headerRanges.size(); ++i)
+        {
+            struct iovec vec;
+            vec.iov_base = const_cast<char *>(base + batch->headerRanges[i].first);
+            vec.iov_len = batch->headerRanges[i].second;
+            batch->iov.push_back(vec);
+            if (!batch->bodies[i].empty())
+            {
+                vec.iov_base = const_cast<char *>(batch->bodies[i].data());
+                vec.iov_len = batch->bodies[i].size();
+                batch->iov.push_back(vec);
+            }
+        }
+        // 在 loop 线程里面, send() 直接 writev(), 没写完的部分才拷贝到发送队列,
+        conn->send(batch->iov.data(), static_cast<int>(batch->iov.size()));
+
+        batch->headers.retrieveAll();
+        batch->headerRanges.clear();
+        batch->bodies.clear();
+    }
+}
+
+HttpServer::HttpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name, TcpServer::Option option)
+    : server_(loop, listenAddr, name, option),
+      httpCallback_(defaultHttpCallback),
+      maxBodyBytes_(HttpContext::kDefaultMaxBodyBytes)
+{
+    server_.setConnectionCallback(std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(std::bind(&HttpServer::onMessage, this,
+                                         std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void HttpServer::start()
+{
+    LOG_INFO("HttpServer[%s] starts listening on %s \n", server_.name().c_str(), server_.ipPort().c_str());
+    server_.start();
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setContext(std::make_shared<HttpContext>(maxBodyBytes_));
+    }
+}
+
+void HttpServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    HttpContext *context = static_cast<HttpContext *>(conn->getContext().get());
+    if (nullptr == context || !conn->connected())
+    {
+        // 已经决定关闭的连接, 后面收到的数据直接丢弃,
+        buf->retrieveAll();
+        return;
+    }
+
+    ResponseBatch *batch = &t_batch;
+    bool closing = false;
+    while (!closing)
+    {
+        HttpContext::ParseResult result = context->parseRequest(buf, receiveTime);
+        if (HttpContext::kIncomplete == result)
+        {
+            break;
+        }
+        if (HttpContext::kError == result)
+        {
+            HttpResponse resp(true);
+            resp.setStatusCode(context->errorCode());
+            appendResponse(batch, &resp, true);
+            buf->retrieveAll();
+            closing = true;
+            break;
+        }
+
+        const HttpRequest &req = context->request();
+        HttpResponse resp(!req.keepAlive());
+        httpCallback_(req, &resp);
+        appendResponse(batch, &resp, HttpRequest::kHead != req.method());
+        closing = resp.closeConnection();
+
+        // 请求处理完了, HttpRequest 里面指向 buf 的 StringPiece 失效, 取走这个请求的数据, 解析下一个,
+        buf->retrieve(context->requestLength());
+        context->reset();
+
+        if (batch->headerRanges.size() >= kMaxBatchedResponses)
+        {
+            flushResponses(conn, batch);
+        }
+    }
+    flushResponses(conn, batch);
+
+    if (closing)
+    {
+        // 流水线上后面的请求不再处理, 发送队列里面的数据发送完以后关闭写端,
+        conn->setContext(std::shared_ptr<void>());
+        buf->retrieveAll();
+        conn->shutdown();
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "noncopyable.h"
+#include "tcp_server.h"
+
+class HttpRequest;
+class HttpResponse;
+
+/**
+ * 基于 TcpServer 的 HTTP/1.1 服务器,
+ * 支持长连接, 流水线 (一次读到的多个请求按顺序处理, 响应按请求的顺序发送), Content-Length 和 chunked 的请求体,
+ * 请求回调在连接所在的 subLoop 线程里面同步执行, 回调返回以后 HttpResponse 就发送出去,
+ * 一次 onMessage() 处理的多个请求的响应攒在一起, 每个响应的头部和消息体各是一个 iovec, 最后一次 writev() 发送,
+ */
+class HttpServer : noncopyable
+{
+public:
+    using HttpCallback = std::function<void(const HttpRequest &, HttpResponse *)>;
+
+    HttpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name,
+               TcpServer::Option option = TcpServer::kNoReusePort);
+    ~HttpServer() = default;
+
+public:
+    EventLoop *getLoop() const { return server_.getLoop(); }
+    // 底层的 TcpServer, 可以在 start() 之前设置接受连接的方式、socket 选项和内存限制,
+    TcpServer &tcpServer() { return server_; }
+
+    // 没有设置的时候所有请求都回复 404,
+    void setHttpCallback(const HttpCallback &cb) { httpCallback_ = cb; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+    // 请求体的最大字节数, 超过了回复 413 并且关闭连接, 在 start() 之前设置,
+    void setMaxBodyBytes(size_t bytes) { maxBodyBytes_ = bytes; }
+
+    void start();
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+private:
+    TcpServer server_;
+    HttpCallback httpCallback_;
+    size_t maxBodyBytes_;
+};
@@ -0,0 +1,92 @@
+#include <endian.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "length_header_codec.h"
+
+#include "buffer.h"
+#include "crc32c.h"
+#include "logger.h"
+#include "tcp_connection.h"
+
+void LengthHeaderCodec::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    // 连接可能在 frameCallback_ 里面被关闭, 关闭以后剩下的帧不再处理,
+    while (buf->readableBytes() >= kHeaderLen && conn->connected())
+    {
+        const int32_t len = buf->peekInt32();
+        if (len < 0 || static_cast<size_t>(len) > maxFrameLength_)
+        {
+            LOG_ERROR("LengthHeaderCodec::onMessage [%s] invalid frame length %d \n", conn->name().c_str(), len);
+            buf->retrieveAll();
+            conn->forceClose();
+            break;
+        }
+        if (!checksum_)
+        {
+            if (buf->readableBytes() < kHeaderLen + len)
+            {
+                break; // 不完整的帧, 等下一次读,
+            }
+            buf->retrieve(kHeaderLen);
+            frameCallback_(conn, buf->peek(), len, receiveTime);
+            buf->retrieve(len);
+            continue;
+        }
+
+        // 帧头第一次完整的时候登记校验范围, 之后到达的数据由 readFd() 边读边算,
+        if (!buf->crc32cPending())
+        {
+            buf->beginCrc32c(0, kHeaderLen + len);
+        }
+        if (buf->readableBytes() < kHeaderLen + len + kChecksumLen)
+        {
+            break;
+        }
+        const uint32_t actual = buf->finishCrc32c();
+        uint32_t expected = 0;
+        ::memcpy(&expected, buf->peek() + kHeaderLen + len, sizeof expected);
+        expected = be32toh(expected);
+        if (actual != expected)
+        {
+            LOG_ERROR("LengthHeaderCodec::onMessage [%s] checksum mismatch, frame length %d, expected %08x, actual %08x \n",
+                      conn->name().c_str(), len, expected, actual);
+            buf->retrieveAll();
+            conn->forceClose();
+            break;
+        }
+        buf->retrieve(kHeaderLen);
+        frameCallback_(conn, buf->peek(), len, receiveTime);
+        buf->retrieve(len + kChecksumLen);
+    }
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr &conn, Buffer *body)
+{
+    body->prependInt32(static_cast<int32_t>(body->readableBytes()));
+    if (checksum_)
+    {
+        body->appendInt32(static_cast<int32_t>(crc32c::value(body->peek(), body->readableBytes())));
+    }
+    conn->send(body);
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr &conn, const void *data, size_t len)
+{
+    int32_t be32 = htobe32(static_cast<int32_t>(len));
+    struct iovec vec[3];
+    vec[0].iov_base = &be32;
+    vec[0].iov_len = sizeof be32;
+    vec[1].iov_base = const_cast<void *>(data);
+    vec[1].iov_len = len;
+    if (!checksum_)
+    {
+        conn->send(vec, 2);
+        return;
+    }
+    uint32_t crc = crc32c::extend(crc32c::value(&be32, sizeof be32), data, len);
+    uint32_t crcBe32 = htobe32(crc);
+    vec[2].iov_base = &crcBe32;
+    vec[2].iov_len = sizeof crcBe32;
+    conn->send(vec, 3);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <functional>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "callbacks.h"
+#include "noncopyable.h"
+
+/**
+ * 长度头部分帧, 每一帧是 4 字节网络字节序的长度 + 消息体:
+ *     | int32 length | length bytes of body |
+ * 收: 把 onMessage() 注册成 TcpConnection 的 MessageCallback, 只在收齐一整帧以后回调 frameCallback_,
+ *     回调参数直接指向 inputBuffer_ 里面的数据, 不拷贝, 只在回调期间有效,
+ *     一次读到多帧的时候循环回调, 不完整的帧留在 inputBuffer_ 里面等下一次读,
+ * 发: 消息体已经在 Buffer 里面的时候, 长度头部写到 Buffer 的 prepend 区域, 头部和消息体一次 write() 发出去,
+ *
+ * setChecksum(true) 以后每一帧后面带 4 字节网络字节序的 CRC32C, 覆盖长度头部和消息体, 长度头部不包括校验和:
+ *     | int32 length | length bytes of body | uint32 crc32c(length + body) |
+ * 收到帧头以后在 inputBuffer_ 上登记校验范围 (Buffer::beginCrc32c()), 后面的数据在 readFd() 里面边读边算,
+ * 整帧到齐的时候校验和已经算好了, 校验失败的帧不回调, 直接关闭连接, 两端必须同时打开或者同时关闭,
+ */
+class LengthHeaderCodec : noncopyable
+{
+public:
+    using FrameCallback = std::function<void(const TcpConnectionPtr &, const char *data, size_t len, Timestamp)>;
+
+    static const size_t kHeaderLen = sizeof(int32_t);
+    static const size_t kChecksumLen = sizeof(uint32_t);
+    static const size_t kDefaultMaxFrameLength = 64 * 1024 * 1024;
+
+    explicit LengthHeaderCodec(const FrameCallback &cb, size_t maxFrameLength = kDefaultMaxFrameLength)
+        : frameCallback_(cb), maxFrameLength_(maxFrameLength), checksum_(false) {}
+
+public:
+    // 在连接建立之前设置,
+    void setChecksum(bool on) { checksum_ = on; }
+    bool checksum() const { return checksum_; }
+
+    // 设置成 TcpConnection/TcpServer 的 MessageCallback,
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    // body 里面的全部可读数据作为一帧发送, 长度头部写到 body 的 prepend 区域, 发送以后 body 被清空,
+    void send(const TcpConnectionPtr &conn, Buffer *body);
+    // 头部、data (和校验和) 用 writev() 一次发出去, data 不需要先拷贝到 Buffer 里面,
+    void send(const TcpConnectionPtr &conn, const void *data, size_t len);
+    void send(const TcpConnectionPtr &conn, const std::string &message) { send(conn, message.data(), message.size()); }
+
+private:
+    FrameCallback frameCallback_;
+    const size_t maxFrameLength_; // 超过这个长度的帧认为是错误的数据, 直接关闭连接,
+    bool checksum_;               // 每一帧后面带 CRC32C,
+};
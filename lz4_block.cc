@@ -0,0 +1,260 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "lz4_block.h"
+
+namespace
+{
+    const size_t kMinMatch = 4;
+    const size_t kLastLiterals = 5; // 最后 5 个字节必须是字面量,
+    const size_t kMfLimit = 12;     // 最后一个匹配必须在结尾前 12 个字节之前开始,
+    const size_t kMaxOffset = 65535;
+    const int kHashLog = 12;
+    const int kSkipTrigger = 6; // 连续找不到匹配的时候步长逐渐变大, 不可压缩的数据很快跳过,
+
+    uint32_t read32(const char *p)
+    {
+        uint32_t v = 0;
+        ::memcpy(&v, p, sizeof v);
+        return v;
+    }
+
+    uint64_t read64(const char *p)
+    {
+        uint64_t v = 0;
+        ::memcpy(&v, p, sizeof v);
+        return v;
+    }
+
+    uint32_t hash(uint32_t sequence)
+    {
+        return (sequence * 2654435761U) >> (32 - kHashLog);
+    }
+
+    // 从 p 和 match 开始有多少个字节相同, 不超过 limit,
+    size_t countMatch(const char *p, const char *match, const char *limit)
+    {
+        const char *start = p;
+        while (p + 8 <= limit)
+        {
+            uint64_t diff = read64(p) ^ read64(match);
+            if (0 != diff)
+            {
+                return p - start + (__builtin_ctzll(diff) >> 3);
+            }
+            p += 8;
+            match += 8;
+        }
+        while (p < limit && *p == *match)
+        {
+            ++p;
+            ++match;
+        }
+        return p - start;
+    }
+
+    // 长度超过 15 的部分按照 255 一个字节编码,
+    char *writeLength(char *op, size_t len)
+    {
+        while (len >= 255)
+        {
+            *op++ = static_cast<char>(255);
+            len -= 255;
+        }
+        *op++ = static_cast<char>(len);
+        return op;
+    }
+
+    char *writeLiterals(char *op, const char *anchor, size_t litLen, char *token)
+    {
+        if (litLen >= 15)
+        {
+            *token = static_cast<char>(15 << 4);
+            op = writeLength(op, litLen - 15);
+        }
+        else
+        {
+            *token = static_cast<char>(litLen << 4);
+        }
+        ::memcpy(op, anchor, litLen);
+        return op + litLen;
+    }
+}
+
+namespace lz4
+{
+    size_t compress(const char *src, size_t srcLen, char *dst)
+    {
+        // 表里面存的是相对于 src 的偏移, 上一次压缩留下的值可能指向任何地方, 用之前检查,
+        thread_local uint32_t table[1 << kHashLog];
+
+        const char *ip = src;
+        const char *anchor = src;
+        const char *const iend = src + srcLen;
+        char *op = dst;
+
+        if (srcLen >= kMfLimit + 1 && srcLen <= UINT32_MAX)
+        {
+            const char *const mflimit = iend - kMfLimit;
+            const char *const matchLimit = iend - kLastLiterals;
+            table[hash(read32(ip))] = 0;
+            ++ip;
+            for (;;)
+            {
+                // 找下一个匹配,
+                const char *match = nullptr;
+                unsigned searched = 1 << kSkipTrigger;
+                for (;;)
+                {
+                    if (ip > mflimit)
+                    {
+                        goto lastLiterals;
+                    }
+                    uint32_t sequence = read32(ip);
+                    uint32_t h = hash(sequence);
+                    size_t pos = ip - src;
+                    size_t candidate = table[h];
+                    table[h] = static_cast<uint32_t>(pos);
+                    if (candidate < pos && pos - candidate <= kMaxOffset && read32(src + candidate) == sequence)
+                    {
+                        match = src + candidate;
+                        break;
+                    }
+                    ip += searched++ >> kSkipTrigger;
+                }
+
+                // 往前扩展匹配,
+                while (ip > anchor && match > src && ip[-1] == match[-1])
+                {
+                    --ip;
+                    --match;
+                }
+
+                char *token = op++;
+                op = writeLiterals(op, anchor, ip - anchor, token);
+
+                uint16_t offset = static_cast<uint16_t>(ip - match);
+                *op++ = static_cast<char>(offset & 0xff);
+                *op++ = static_cast<char>(offset >> 8);
+
+                size_t matchLen = countMatch(ip + kMinMatch, match + kMinMatch, matchLimit);
+                if (matchLen >= 15)
+                {
+                    *token = static_cast<char>(*token | 15);
+                    op = writeLength(op, matchLen - 15);
+                }
+                else
+                {
+                    *token = static_cast<char>(*token | matchLen);
+                }
+                ip += kMinMatch + matchLen;
+                anchor = ip;
+                if (ip > mflimit)
+                {
+                    break;
+                }
+                // 匹配里面的位置也放进表里, 提高下一次找到匹配的机会,
+                table[hash(read32(ip - 2))] = static_cast<uint32_t>(ip - 2 - src);
+            }
+        }
+
+    lastLiterals:
+        char *token = op++;
+        op = writeLiterals(op, anchor, iend - anchor, token);
+        return op - dst;
+    }
+
+    bool decompress(const char *src, size_t srcLen, char *dst, size_t dstLen)
+    {
+        const unsigned char *ip = reinterpret_cast<const unsigned char *>(src);
+        const unsigned char *const iend = ip + srcLen;
+        char *op = dst;
+        char *const oend = dst + dstLen;
+
+        while (ip < iend)
+        {
+            unsigned token = *ip++;
+            size_t litLen = token >> 4;
+            if (15 == litLen)
+            {
+                unsigned char b = 0;
+                do
+                {
+                    if (ip >= iend)
+                    {
+                        return false;
+                    }
+                    b = *ip++;
+                    litLen += b;
+                } while (255 == b);
+            }
+            if (litLen > static_cast<size_t>(iend - ip) || litLen > static_cast<size_t>(oend - op))
+            {
+                return false;
+            }
+            ::memcpy(op, ip, litLen);
+            ip += litLen;
+            op += litLen;
+            if (ip == iend)
+            {
+                break; // 最后一个序列只有字面量,
+            }
+
+            if (iend - ip < 2)
+            {
+                return false;
+            }
+            size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            if (0 == offset || offset > static_cast<size_t>(op - dst))
+            {
+                return false;
+            }
+            size_t matchLen = token & 15;
+            if (15 == matchLen)
+            {
+                unsigned char b = 0;
+                do
+                {
+                    if (ip >= iend)
+                    {
+                        return false;
+                    }
+                    b = *ip++;
+                    matchLen += b;
+                } while (255 == b);
+            }
+            matchLen += kMinMatch;
+            if (matchLen > static_cast<size_t>(oend - op))
+            {
+                return false;
+            }
+
+            const char *match = op - offset;
+            if (offset >= 8)
+            {
+                // 源和目的相隔至少 8 个字节, 每次拷贝 8 个字节不会读到还没写的数据,
+                char *end = op + matchLen;
+                while (op + 8 <= end)
+                {
+                    ::memcpy(op, match, 8);
+                    op += 8;
+                    match += 8;
+                }
+                while (op < end)
+                {
+                    *op++ = *match++;
+                }
+            }
+            else
+            {
+                // 重叠的匹配 (比如一串相同的字节), 只能逐字节拷贝,
+                for (size_t i = 0; i < matchLen; ++i)
+                {
+                    *op++ = *match++;
+                }
+            }
+        }
+        return op == oend;
+    }
+}
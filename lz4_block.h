@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * LZ4 块格式 (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md) 的压缩和解压, 和官方的 LZ4_compress_default()/
+ * LZ4_decompress_safe() 输出的格式相同, 可以互相解压, 不依赖外部的库,
+ * 压缩用 4096 项的哈希表做贪心匹配, 哈希表每个线程一张, 不需要每次清零: 候选位置都会先检查是不是在当前输入里面, 再比较字节,
+ * 解压检查所有的长度和偏移, 可以直接处理网络上收到的数据,
+ */
+namespace lz4
+{
+    // srcLen 字节的输入压缩以后最多多少字节,
+    inline size_t compressBound(size_t srcLen)
+    {
+        return srcLen + srcLen / 255 + 16;
+    }
+
+    // 把 src[0, srcLen) 压缩到 dst, dst 至少要有 compressBound(srcLen) 字节, 返回压缩以后的字节数,
+    size_t compress(const char *src, size_t srcLen, char *dst);
+
+    // 把 src[0, srcLen) 解压到 dst, 解压以后必须正好 dstLen 字节, 数据有错返回 false,
+    bool decompress(const char *src, size_t srcLen, char *dst, size_t dstLen);
+}
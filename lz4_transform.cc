@@ -0,0 +1,94 @@
+#include <algorithm>
+#include <endian.h>
+#include <string.h>
+
+#include "lz4_transform.h"
+
+#include "buffer.h"
+#include "lz4_block.h"
+
+const size_t Lz4Transform::kDefaultThreshold;
+const size_t Lz4Transform::kMaxChunk;
+const uint32_t Lz4Transform::kCompressedFlag;
+const size_t Lz4Transform::kHeaderLen;
+
+void Lz4Transform::encode(const char *data, size_t len, Buffer *output)
+{
+    encodedRawBytes_ += len;
+    size_t before = output->readableBytes();
+    for (size_t offset = 0; offset < len; offset += kMaxChunk)
+    {
+        encodeChunk(data + offset, std::min(kMaxChunk, len - offset), output);
+    }
+    encodedWireBytes_ += output->readableBytes() - before;
+}
+
+void Lz4Transform::encodeChunk(const char *data, size_t len, Buffer *output)
+{
+    if (len >= threshold_)
+    {
+        // 压缩结果直接写到帧头后面, 没有变小的话再把原始数据拷到同一个位置,
+        output->ensureWritableBytes(2 * kHeaderLen + lz4::compressBound(len));
+        char *frame = output->beginWrite();
+        size_t compressed = lz4::compress(data, len, frame + 2 * kHeaderLen);
+        if (compressed < len)
+        {
+            uint32_t header = htobe32(kCompressedFlag | static_cast<uint32_t>(compressed));
+            uint32_t rawLength = htobe32(static_cast<uint32_t>(len));
+            ::memcpy(frame, &header, sizeof header);
+            ::memcpy(frame + kHeaderLen, &rawLength, sizeof rawLength);
+            output->hasWritten(2 * kHeaderLen + compressed);
+            return;
+        }
+    }
+    output->appendInt32(static_cast<int32_t>(len));
+    output->append(data, len);
+}
+
+bool Lz4Transform::decode(Buffer *input, Buffer *output, size_t maxOutput)
+{
+    while (input->readableBytes() >= kHeaderLen && output->readableBytes() < maxOutput)
+    {
+        uint32_t header = static_cast<uint32_t>(input->peekInt32());
+        size_t len = header & ~kCompressedFlag;
+        if (0 == (header & kCompressedFlag))
+        {
+            if (len > kMaxChunk)
+            {
+                return false;
+            }
+            if (input->readableBytes() < kHeaderLen + len)
+            {
+                break;
+            }
+            output->append(input->peek() + kHeaderLen, len);
+            input->retrieve(kHeaderLen + len);
+            continue;
+        }
+
+        if (len > lz4::compressBound(kMaxChunk))
+        {
+            return false;
+        }
+        if (input->readableBytes() < 2 * kHeaderLen + len)
+        {
+            break;
+        }
+        uint32_t rawLength = 0;
+        ::memcpy(&rawLength, input->peek() + kHeaderLen, sizeof rawLength);
+        rawLength = be32toh(rawLength);
+        if (rawLength > kMaxChunk)
+        {
+            return false;
+        }
+        // 直接从接收缓冲区解压到 output 的可写区域,
+        output->ensureWritableBytes(rawLength);
+        if (!lz4::decompress(input->peek() + 2 * kHeaderLen, len, output->beginWrite(), rawLength))
+        {
+            return false;
+        }
+        output->hasWritten(rawLength);
+        input->retrieve(2 * kHeaderLen + len);
+    }
+    return true;
+}
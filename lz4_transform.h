@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stream_transform.h"
+
+/**
+ * LZ4 压缩的 StreamTransform, 每次 send() 的数据按 kMaxChunk 切块, 每块一帧:
+ *     | uint32 length | length bytes |                                              不压缩,
+ *     | uint32 kCompressedFlag | length | uint32 rawLength | length bytes of LZ4 block |  压缩,
+ * 帧头的最高位是压缩标志, 其余 31 位是后面数据的长度 (压缩帧不包括 rawLength), 整数都是网络字节序,
+ * 比 threshold 短的块不压缩, 原样发送, 小消息压缩省不了多少字节, 还要多花 CPU,
+ * 压缩以后没有变小的块 (已经压缩过的数据) 也原样发送,
+ * 压缩直接写到发送缓冲区的可写区域, 解压直接从接收缓冲区读, 写到 inputBuffer_ 的可写区域, 中间没有临时的拷贝,
+ * 统计数据不加锁, 每个连接用一个对象,
+ */
+class Lz4Transform : public StreamTransform
+{
+public:
+    static const size_t kDefaultThreshold = 256;
+    static const size_t kMaxChunk = 64 * 1024;
+
+    explicit Lz4Transform(size_t threshold = kDefaultThreshold)
+        : threshold_(threshold), encodedRawBytes_(0), encodedWireBytes_(0) {}
+
+public:
+    void encode(const char *data, size_t len, Buffer *output) override;
+    bool decode(Buffer *input, Buffer *output, size_t maxOutput) override;
+
+    // encode() 收到的字节数和编码以后的字节数 (包括帧头), 两者的比值就是省下的带宽,
+    uint64_t encodedRawBytes() const { return encodedRawBytes_; }
+    uint64_t encodedWireBytes() const { return encodedWireBytes_; }
+
+private:
+    void encodeChunk(const char *data, size_t len, Buffer *output);
+
+    static const uint32_t kCompressedFlag = 0x80000000;
+    static const size_t kHeaderLen = sizeof(uint32_t);
+
+private:
+    const size_t threshold_;
+    uint64_t encodedRawBytes_;
+    uint64_t encodedWireBytes_;
+};
@@ -0,0 +1,37 @@
+#include <algorithm>
+
+#include "memory_account.h"
+
+MemoryAccount::MemoryAccount(MemoryAccount *parent)
+    : parent_(parent),
+      inputBytes_(0),
+      outputBytes_(0),
+      limit_(0)
+{
+}
+
+void MemoryAccount::add(int64_t inputDelta, int64_t outputDelta)
+{
+    inputBytes_ += inputDelta;
+    outputBytes_ += outputDelta;
+    if (parent_)
+    {
+        parent_->add(inputDelta, outputDelta);
+    }
+
+    // 只有增长的时候才检查, 释放内存的时候不会触发淘汰,
+    if (inputDelta + outputDelta > 0 && exceededCallback_ && exceeded())
+    {
+        exceededCallback_();
+    }
+}
+
+int64_t MemoryAccount::excessBytes() const
+{
+    int64_t excess = limit_ > 0 ? totalBytes() - limit_ : 0;
+    if (parent_)
+    {
+        excess = std::max(excess, parent_->excessBytes());
+    }
+    return std::max<int64_t>(excess, 0);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+
+#include "noncopyable.h"
+
+/**
+ * 一组连接的缓冲区内存统计, 统计的是 inputBuffer_ 里面还没被应用取走的字节, 以及发送队列里面还没发送的字节,
+ * (发送队列里面的文件段不占用内存, 不统计; Buffer 底层 vector 多分配的容量也不统计),
+ * TcpServer 给每个 subLoop 一个 MemoryAccount, 它们的 parent 是整个 TcpServer 的 MemoryAccount,
+ * TcpConnection 在自己的 loop 线程里面把变化量 add() 进来, 会一直累加到 parent,
+ * 计数器是原子变量, 应用可以在任意线程读取,
+ */
+class MemoryAccount : noncopyable
+{
+public:
+    // 统计的字节数超过了自己或者上层的 limit, 在调用 add() 的线程里面执行,
+    using ExceededCallback = std::function<void()>;
+
+public:
+    explicit MemoryAccount(MemoryAccount *parent = nullptr);
+    ~MemoryAccount() = default;
+
+public:
+    void add(int64_t inputDelta, int64_t outputDelta);
+
+    int64_t inputBytes() const { return inputBytes_; }
+    int64_t outputBytes() const { return outputBytes_; }
+    int64_t totalBytes() const { return inputBytes_ + outputBytes_; }
+
+    // limit 为 0 表示不限制, 在开始统计之前设置,
+    void setLimit(int64_t limit, const ExceededCallback &cb)
+    {
+        limit_ = limit;
+        exceededCallback_ = cb;
+    }
+    int64_t limit() const { return limit_; }
+
+    // 自己或者任意一层 parent 超过了 limit, 返回超出最多的字节数, 没有超过返回 0,
+    int64_t excessBytes() const;
+    bool exceeded() const { return excessBytes() > 0; }
+
+private:
+    MemoryAccount *parent_;
+    std::atomic<int64_t> inputBytes_;
+    std::atomic<int64_t> outputBytes_;
+    int64_t limit_;
+    ExceededCallback exceededCallback_;
+};
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <endian.h>
+#include <string.h>
+#include <vector>
+
+#include "mux_session.h"
+
+#include "event_loop.h"
+#include "logger.h"
+#include "tcp_connection.h"
+
+MuxSessionPtr MuxSession::attach(const TcpConnectionPtr &conn, Role role, const Options &options)
+{
+    MuxSessionPtr session = std::make_shared<MuxSession>(conn, role, options);
+    // 连接的回调持有 MuxSession, 连接析构的时候一起释放, MuxSession 只持有连接的 weak_ptr, 没有循环引用,
+    conn->setConnectionCallback([session](const TcpConnectionPtr &c) { session->onConnection(c); });
+    conn->setMessageCallback([session](const TcpConnectionPtr &c, Buffer *buf, Timestamp receiveTime)
+                             { session->onMessage(c, buf, receiveTime); });
+    conn->setWriteCompleteCallback([session](const TcpConnectionPtr &c) { session->onWriteComplete(c); });
+    return session;
+}
+
+MuxSession::MuxSession(const TcpConnectionPtr &conn, Role role, const Options &options)
+    : loop_(conn->getLoop()),
+      conn_(conn),
+      role_(role),
+      options_(options),
+      nextStreamId_(kClient == role ? 1 : 2),
+      flushQueued_(false),
+      dispatching_(false),
+      closed_(false)
+{
+}
+
+MuxStreamPtr MuxSession::openStream()
+{
+    loop_->assertInLoopThread();
+    if (closed_)
+    {
+        return MuxStreamPtr();
+    }
+    uint32_t id = nextStreamId_;
+    nextStreamId_ += 2;
+    MuxStreamPtr stream = std::make_shared<MuxStream>(shared_from_this(), id, options_.initialWindow);
+    streams_[id] = stream;
+    // 不带数据的 SYN, 对端收到以后创建这个流, 之后的数据帧不需要再带 SYN,
+    sendWindowUpdate(stream.get(), 0, kSyn);
+    return stream;
+}
+
+void MuxSession::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected() || closed_)
+    {
+        return;
+    }
+    closed_ = true;
+    ready_.clear();
+    output_.retrieveAll();
+    // 回调里面可能操作别的流, 先整个换出来,
+    std::unordered_map<uint32_t, MuxStreamPtr> streams;
+    streams.swap(streams_);
+    for (auto &item : streams)
+    {
+        item.second->resetted_ = true;
+        item.second->notifyClose();
+    }
+    if (closeCallback_)
+    {
+        closeCallback_(shared_from_this());
+    }
+}
+
+void MuxSession::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    dispatching_ = true;
+    while (buf->readableBytes() >= kFrameHeaderLen && !closed_ && conn->connected())
+    {
+        const char *p = buf->peek();
+        uint8_t type = static_cast<uint8_t>(p[0]);
+        uint8_t flags = static_cast<uint8_t>(p[1]);
+        uint32_t streamId = 0;
+        uint32_t length = 0;
+        ::memcpy(&streamId, p + 4, sizeof streamId);
+        ::memcpy(&length, p + 8, sizeof length);
+        streamId = be32toh(streamId);
+        length = be32toh(length);
+
+        // WINDOW_UPDATE 的 length 不跟数据, DATA 的长度不会超过对端的窗口,
+        size_t dataLen = kData == type ? length : 0;
+        if ((kData != type && kWindowUpdate != type) || dataLen > options_.initialWindow)
+        {
+            LOG_ERROR("MuxSession::onMessage [%s] invalid frame type %d length %u \n",
+                      conn->name().c_str(), type, length);
+            buf->retrieveAll();
+            conn->forceClose();
+            break;
+        }
+        if (buf->readableBytes() < kFrameHeaderLen + dataLen)
+        {
+            break;
+        }
+        handleFrame(type, flags, streamId, buf->peek() + kFrameHeaderLen, length);
+        buf->retrieve(kFrameHeaderLen + dataLen);
+    }
+    dispatching_ = false;
+    flush();
+}
+
+void MuxSession::handleFrame(uint8_t type, uint8_t flags, uint32_t streamId, const char *data, size_t len)
+{
+    MuxStreamPtr stream;
+    auto it = streams_.find(streamId);
+    if (streams_.end() != it)
+    {
+        stream = it->second;
+    }
+    else if (flags & kSyn)
+    {
+        // 对端打开的流, 服务器收到的是奇数 id, 客户端收到的是偶数 id,
+        bool fromPeer = (kServer == role_) == (1 == streamId % 2);
+        if (0 == streamId || !fromPeer)
+        {
+            LOG_ERROR("MuxSession::handleFrame invalid stream id %u \n", streamId);
+            sendReset(streamId);
+            return;
+        }
+        stream = std::make_shared<MuxStream>(shared_from_this(), streamId, options_.initialWindow);
+        streams_[streamId] = stream;
+        if (newStreamCallback_)
+        {
+            newStreamCallback_(stream);
+        }
+    }
+    else
+    {
+        return; // 已经重置或者关闭的流, 对端发出这一帧的时候还不知道,
+    }
+
+    if (flags & kRst)
+    {
+        stream->resetted_ = true;
+        stream->outputBuffer_.retrieveAll();
+        stream->notifyClose();
+        removeStream(streamId);
+        return;
+    }
+
+    if (kWindowUpdate == type)
+    {
+        stream->sendWindow_ += len;
+        scheduleStream(stream);
+    }
+    else if (len > 0)
+    {
+        if (stream->remoteClosed_ || len > stream->recvWindow_)
+        {
+            // 对端不遵守窗口, 只重置这一个流,
+            LOG_ERROR("MuxSession::handleFrame stream %u receive window exceeded \n", streamId);
+            stream->resetInLoop();
+            return;
+        }
+        stream->handleData(data, len, &scratch_);
+        if (stream->resetted_)
+        {
+            return; // 在回调里面重置了,
+        }
+    }
+
+    if (flags & kFin)
+    {
+        stream->remoteClosed_ = true;
+        stream->notifyClose();
+        if (stream->localClosed_)
+        {
+            removeStream(streamId);
+        }
+    }
+}
+
+void MuxSession::onWriteComplete(const TcpConnectionPtr &)
+{
+    // 连接的发送队列空了, 之前因为超过 outputHighWaterMark 停下来的调度继续,
+    if (!ready_.empty())
+    {
+        flush();
+    }
+}
+
+void MuxSession::appendFrameHeader(uint8_t type, uint8_t flags, uint32_t streamId, uint32_t length)
+{
+    output_.appendInt8(static_cast<int8_t>(type));
+    output_.appendInt8(static_cast<int8_t>(flags));
+    output_.appendInt16(0);
+    output_.appendInt32(static_cast<int32_t>(streamId));
+    output_.appendInt32(static_cast<int32_t>(length));
+}
+
+void MuxSession::sendWindowUpdate(MuxStream *stream, uint32_t delta, uint8_t flags)
+{
+    appendFrameHeader(kWindowUpdate, flags, stream->id(), delta);
+    requestFlush();
+}
+
+void MuxSession::sendReset(uint32_t streamId)
+{
+    appendFrameHeader(kWindowUpdate, kRst, streamId, 0);
+    requestFlush();
+}
+
+bool MuxSession::sendDirectly(MuxStream *stream, const char *data, size_t len)
+{
+    if (closed_ || stream->scheduled_ || stream->outputBuffer_.readableBytes() > 0 ||
+        len > stream->sendWindow_ || len > options_.maxFrameSize)
+    {
+        return false;
+    }
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn || conn->outputBytes() + output_.readableBytes() >= options_.outputHighWaterMark)
+    {
+        return false;
+    }
+    appendFrameHeader(kData, 0, stream->id(), static_cast<uint32_t>(len));
+    output_.append(data, len);
+    stream->sendWindow_ -= len;
+    requestFlush();
+    return true;
+}
+
+void MuxSession::scheduleStream(const MuxStreamPtr &stream)
+{
+    if (closed_ || stream->scheduled_ || stream->resetted_ || stream->localClosed_)
+    {
+        return;
+    }
+    size_t pending = stream->outputBuffer_.readableBytes();
+    // 有数据而且有窗口, 或者数据都发完了只差一个 FIN,
+    if ((pending > 0 && stream->sendWindow_ > 0) || (0 == pending && stream->finPending_))
+    {
+        stream->scheduled_ = true;
+        ready_.push_back(stream);
+        requestFlush();
+    }
+}
+
+void MuxSession::requestFlush()
+{
+    if (dispatching_ || flushQueued_)
+    {
+        return;
+    }
+    flushQueued_ = true;
+    MuxSessionPtr self = shared_from_this();
+    loop_->queueInLoop([self]() { self->flush(); });
+}
+
+void MuxSession::flush()
+{
+    flushQueued_ = false;
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn || closed_)
+    {
+        output_.retrieveAll();
+        return;
+    }
+
+    std::vector<MuxStreamPtr> completed;
+    const size_t queued = conn->outputBytes();
+    while (!ready_.empty() && queued + output_.readableBytes() < options_.outputHighWaterMark)
+    {
+        MuxStreamPtr stream = std::move(ready_.front());
+        ready_.pop_front();
+        stream->scheduled_ = false;
+        if (stream->resetted_ || stream->localClosed_)
+        {
+            continue;
+        }
+
+        Buffer *out = &stream->outputBuffer_;
+        size_t n = std::min(std::min(out->readableBytes(), stream->sendWindow_), options_.maxFrameSize);
+        bool fin = stream->finPending_ && n == out->readableBytes();
+        if (0 == n && !fin)
+        {
+            continue; // 窗口用完了, 等对端的 WINDOW_UPDATE 再排进来,
+        }
+        appendFrameHeader(kData, fin ? kFin : 0, stream->id(), static_cast<uint32_t>(n));
+        output_.append(out->peek(), n);
+        out->retrieve(n);
+        stream->sendWindow_ -= n;
+
+        if (fin)
+        {
+            stream->localClosed_ = true;
+            if (stream->remoteClosed_)
+            {
+                removeStream(stream->id());
+            }
+        }
+        else if (out->readableBytes() > 0 && stream->sendWindow_ > 0)
+        {
+            stream->scheduled_ = true;
+            ready_.push_back(stream);
+        }
+        if (0 == out->readableBytes() && stream->writeCompleteCallback_)
+        {
+            completed.push_back(stream);
+        }
+    }
+
+    if (output_.readableBytes() > 0)
+    {
+        conn->send(&output_);
+    }
+    // 回调里面发送的数据排进下一轮调度,
+    for (const MuxStreamPtr &stream : completed)
+    {
+        stream->writeCompleteCallback_(stream);
+    }
+}
+
+void MuxSession::removeStream(uint32_t id)
+{
+    streams_.erase(id);
+}
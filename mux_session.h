@@ -0,0 +1,137 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+
+#include "buffer.h"
+#include "callbacks.h"
+#include "mux_stream.h"
+#include "noncopyable.h"
+
+class MuxSession;
+
+using MuxSessionPtr = std::shared_ptr<MuxSession>;
+
+/**
+ * 在一个 TcpConnection 上面复用多个 MuxStream, 帧格式和 yamux 类似, 12 字节的帧头:
+ *     | int8 type | int8 flags | int16 reserved | int32 streamId | int32 length |
+ * type:  DATA 后面跟着 length 字节的数据, WINDOW_UPDATE 的 length 是给对端增加的发送窗口,
+ * flags: SYN 打开一个流, FIN 关闭这个方向, RST 立即关闭两个方向,
+ * 客户端打开的流是奇数 id, 服务器打开的流是偶数 id, 两端的初始窗口都是 Options::initialWindow,
+ *
+ * 发送调度: 有数据而且有窗口的流排成一个轮转队列, 每次从队头的流取最多 maxFrameSize 字节组成一帧,
+ * 还有数据的话排到队尾, 所以大流量的流不会饿死其他流,
+ * 连接的发送队列超过 outputHighWaterMark 以后停止调度, 数据留在各个流里面, 连接写完以后 (WriteComplete) 继续,
+ * 一轮调度的所有帧 (包括 WINDOW_UPDATE 这样的控制帧) 攒在一个 Buffer 里面, 一次交给 TcpConnection,
+ *
+ * attach() 以后连接的 ConnectionCallback/MessageCallback/WriteCompleteCallback 由 MuxSession 接管,
+ * 连接的回调持有 MuxSession, 连接断开的时候所有的流回调 closeCallback, 然后回调 MuxSession 的 closeCallback_,
+ * 所有的函数都在连接的 loop 线程里面调用,
+ */
+class MuxSession : noncopyable, public std::enable_shared_from_this<MuxSession>
+{
+public:
+    enum Role
+    {
+        kClient,
+        kServer,
+    };
+
+    struct Options
+    {
+        Options()
+            : initialWindow(256 * 1024),
+              maxFrameSize(16 * 1024),
+              outputHighWaterMark(256 * 1024)
+        {
+        }
+
+        size_t initialWindow;       // 每个流每个方向的初始窗口, 两端需要一致,
+        size_t maxFrameSize;        // 一个 DATA 帧最多的数据, 也是轮转调度的粒度,
+        size_t outputHighWaterMark; // 连接的发送队列超过这个值就停止调度,
+    };
+
+    using SessionCallback = std::function<void(const MuxSessionPtr &)>;
+
+    // 在连接的 ConnectionCallback 里面 (loop 线程) 调用,
+    static MuxSessionPtr attach(const TcpConnectionPtr &conn, Role role, const Options &options = Options());
+
+    MuxSession(const TcpConnectionPtr &conn, Role role, const Options &options);
+    ~MuxSession() = default;
+
+public:
+    // 打开一个新的流, 对端的 newStreamCallback_ 收到它, 连接已经断开的时候返回空,
+    MuxStreamPtr openStream();
+
+    // 对端打开了一个流, 在回调里面给流设置回调,
+    void setNewStreamCallback(const MuxStreamCallback &cb) { newStreamCallback_ = cb; }
+    void setCloseCallback(const SessionCallback &cb) { closeCallback_ = cb; }
+
+    EventLoop *getLoop() const { return loop_; }
+    TcpConnectionPtr connection() const { return conn_.lock(); }
+    size_t numStreams() const { return streams_.size(); }
+    const Options &options() const { return options_; }
+
+private:
+    friend class MuxStream;
+
+    enum FrameType
+    {
+        kData = 0,
+        kWindowUpdate = 1,
+    };
+
+    enum FrameFlags
+    {
+        kSyn = 1,
+        kFin = 2,
+        kRst = 4,
+    };
+
+    static const size_t kFrameHeaderLen = 12;
+
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    void onWriteComplete(const TcpConnectionPtr &conn);
+    void handleFrame(uint8_t type, uint8_t flags, uint32_t streamId, const char *data, size_t len);
+
+    // 控制帧直接写到 output_ 里面, 排在数据帧前面,
+    void appendFrameHeader(uint8_t type, uint8_t flags, uint32_t streamId, uint32_t length);
+    void sendWindowUpdate(MuxStream *stream, uint32_t delta, uint8_t flags);
+    void sendReset(uint32_t streamId);
+
+    /**
+     * 流没有积压, 窗口也够, 而且 len 不超过一帧的时候, 直接写成一个 DATA 帧, 返回 false 表示需要排队,
+     * 一次只发一帧, 和轮转调度的一轮一样, 不会因此饿死排队的流,
+     */
+    bool sendDirectly(MuxStream *stream, const char *data, size_t len);
+    // MuxStream 有了新的数据或者窗口, 排进轮转队列,
+    void scheduleStream(const MuxStreamPtr &stream);
+    // 在这一轮 loop 的最后 flush() 一次,
+    void requestFlush();
+    // 轮转调度各个流的数据, 和 output_ 一起交给 TcpConnection,
+    void flush();
+    void removeStream(uint32_t id);
+
+private:
+    EventLoop *loop_;
+    std::weak_ptr<TcpConnection> conn_; // 连接的回调持有 MuxSession, 这里不能再持有连接,
+    const Role role_;
+    const Options options_;
+
+    std::unordered_map<uint32_t, MuxStreamPtr> streams_;
+    uint32_t nextStreamId_;
+    std::deque<MuxStreamPtr> ready_; // 有数据而且有窗口的流,
+
+    Buffer output_;     // 这一轮要发送的帧,
+    Buffer scratch_;    // 流没有积压的数据的时候, 收到的数据放在这里回调, 所有的流共用,
+    bool flushQueued_;  // 已经 queueInLoop() 了一次 flush(),
+    bool dispatching_;  // 正在 onMessage() 里面处理帧, 处理完以后统一 flush(),
+    bool closed_;
+
+    MuxStreamCallback newStreamCallback_;
+    SessionCallback closeCallback_;
+};
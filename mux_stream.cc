@@ -0,0 +1,169 @@
+#include "mux_stream.h"
+
+#include "event_loop.h"
+#include "logger.h"
+#include "mux_session.h"
+
+MuxStream::MuxStream(const std::shared_ptr<MuxSession> &session, uint32_t id, size_t initialWindow)
+    : session_(session),
+      loop_(session->getLoop()),
+      id_(id),
+      initialWindow_(initialWindow),
+      sendWindow_(initialWindow),
+      recvWindow_(initialWindow),
+      scheduled_(false),
+      finPending_(false),
+      localClosed_(false),
+      remoteClosed_(false),
+      resetted_(false),
+      closeNotified_(false)
+{
+}
+
+void MuxStream::send(const void *data, size_t len)
+{
+    if (loop_->isInLoopThread())
+    {
+        sendInLoop(static_cast<const char *>(data), len);
+    }
+    else
+    {
+        std::string message(static_cast<const char *>(data), len);
+        MuxStreamPtr self = shared_from_this();
+        loop_->runInLoop([self, message]() { self->sendInLoop(message.data(), message.size()); });
+    }
+}
+
+void MuxStream::send(const std::string &message)
+{
+    send(message.data(), message.size());
+}
+
+void MuxStream::send(Buffer *buf)
+{
+    if (loop_->isInLoopThread())
+    {
+        sendInLoop(buf->peek(), buf->readableBytes());
+        buf->retrieveAll();
+    }
+    else
+    {
+        send(buf->retrieveAllAsString());
+    }
+}
+
+void MuxStream::sendInLoop(const char *data, size_t len)
+{
+    std::shared_ptr<MuxSession> session = session_.lock();
+    if (!session || resetted_ || finPending_ || localClosed_)
+    {
+        LOG_ERROR("MuxStream::sendInLoop stream %u is closed, give up writing \n", id_);
+        return;
+    }
+    // 没有积压的小消息直接成帧, 不经过 outputBuffer_,
+    if (!session->sendDirectly(this, data, len))
+    {
+        outputBuffer_.append(data, len);
+        session->scheduleStream(shared_from_this());
+    }
+}
+
+void MuxStream::shutdown()
+{
+    MuxStreamPtr self = shared_from_this();
+    loop_->runInLoop([self]() { self->shutdownInLoop(); });
+}
+
+void MuxStream::shutdownInLoop()
+{
+    std::shared_ptr<MuxSession> session = session_.lock();
+    if (!session || resetted_ || finPending_ || localClosed_)
+    {
+        return;
+    }
+    finPending_ = true;
+    session->scheduleStream(shared_from_this());
+}
+
+void MuxStream::reset()
+{
+    MuxStreamPtr self = shared_from_this();
+    loop_->runInLoop([self]() { self->resetInLoop(); });
+}
+
+void MuxStream::resetInLoop()
+{
+    std::shared_ptr<MuxSession> session = session_.lock();
+    if (!session || resetted_ || (localClosed_ && remoteClosed_))
+    {
+        return;
+    }
+    resetted_ = true;
+    outputBuffer_.retrieveAll();
+    session->sendReset(id_);
+    notifyClose();
+    session->removeStream(id_);
+}
+
+void MuxStream::resumeRead()
+{
+    MuxStreamPtr self = shared_from_this();
+    loop_->runInLoop([self]() { self->resumeReadInLoop(); });
+}
+
+void MuxStream::resumeReadInLoop()
+{
+    std::shared_ptr<MuxSession> session = session_.lock();
+    if (!session || resetted_ || remoteClosed_)
+    {
+        return;
+    }
+    // inputBuffer_ 里面还没有取走的数据仍然占着窗口, 空出来的部分超过一半窗口才通知对端, 减少 WINDOW_UPDATE 的个数,
+    size_t buffered = inputBuffer_.readableBytes();
+    size_t available = initialWindow_ > buffered ? initialWindow_ - buffered : 0;
+    if (available > recvWindow_ && available - recvWindow_ >= initialWindow_ / 2)
+    {
+        size_t delta = available - recvWindow_;
+        recvWindow_ += delta;
+        session->sendWindowUpdate(this, static_cast<uint32_t>(delta), 0);
+    }
+}
+
+void MuxStream::handleData(const char *data, size_t len, Buffer *scratch)
+{
+    recvWindow_ -= len;
+    if (!messageCallback_)
+    {
+        resumeReadInLoop();
+        return;
+    }
+    if (0 == inputBuffer_.readableBytes())
+    {
+        // 没有积压的时候借用 MuxSession 的 Buffer 回调, 应用全部取走的话 inputBuffer_ 一直不用分配大块内存,
+        scratch->append(data, len);
+        messageCallback_(shared_from_this(), scratch);
+        if (scratch->readableBytes() > 0)
+        {
+            inputBuffer_.append(scratch->peek(), scratch->readableBytes());
+            scratch->retrieveAll();
+        }
+    }
+    else
+    {
+        inputBuffer_.append(data, len);
+        messageCallback_(shared_from_this(), &inputBuffer_);
+    }
+    resumeReadInLoop();
+}
+
+void MuxStream::notifyClose()
+{
+    if (!closeNotified_)
+    {
+        closeNotified_ = true;
+        if (closeCallback_)
+        {
+            closeCallback_(shared_from_this());
+        }
+    }
+}
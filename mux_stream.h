@@ -0,0 +1,106 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+#include "buffer.h"
+#include "noncopyable.h"
+
+class EventLoop;
+class MuxSession;
+class MuxStream;
+
+using MuxStreamPtr = std::shared_ptr<MuxStream>;
+using MuxStreamCallback = std::function<void(const MuxStreamPtr &)>;
+using MuxMessageCallback = std::function<void(const MuxStreamPtr &, Buffer *)>;
+
+/**
+ * MuxSession 上面的一个双向有序字节流, 用法和 TcpConnection 一样: 设置回调, send(), shutdown(),
+ * 所有的流共用一个 TCP 连接, 每个流有自己的 inputBuffer_/outputBuffer_ 和两个方向的流量控制窗口:
+ *   发送: 对端给的窗口 sendWindow_ 用完以后数据留在 outputBuffer_ 里面, 等对端的 WINDOW_UPDATE,
+ *   接收: inputBuffer_ 里面没有被取走的数据占用本端的窗口, 应用取走一半窗口以后才给对端 WINDOW_UPDATE,
+ *         所以应用处理得慢的流只会让这个流的对端停下来, 不会挡住同一个连接上的其他流,
+ * 流的回调和状态都在连接的 loop 线程里面, send()/shutdown()/reset() 可以在任意线程调用,
+ */
+class MuxStream : noncopyable, public std::enable_shared_from_this<MuxStream>
+{
+public:
+    MuxStream(const std::shared_ptr<MuxSession> &session, uint32_t id, size_t initialWindow);
+    ~MuxStream() = default;
+
+public:
+    uint32_t id() const { return id_; }
+    EventLoop *getLoop() const { return loop_; }
+    std::shared_ptr<MuxSession> session() const { return session_.lock(); }
+    // 还没有回调 closeCallback_,
+    bool connected() const { return !closeNotified_; }
+    // 对端已经关闭了写端, 不会再收到数据,
+    bool peerClosed() const { return remoteClosed_; }
+
+    void send(const void *data, size_t len);
+    void send(const std::string &message);
+    // 发送 buf 里面的全部可读数据, 发送以后 buf 被清空,
+    void send(Buffer *buf);
+
+    // 关闭写端, outputBuffer_ 里面的数据发送完以后带上 FIN,
+    void shutdown();
+    // 立即关闭两个方向, 没有发送的数据丢弃, 对端收到 RST,
+    void reset();
+
+    /**
+     * 在 messageCallback_ 之外从 inputBuffer() 取走了数据以后调用, 把腾出来的窗口告诉对端,
+     * 在 messageCallback_ 里面取走的数据不需要调用, 回调返回以后自动检查,
+     */
+    void resumeRead();
+    Buffer *inputBuffer() { return &inputBuffer_; }
+
+    // 还没有交给 TCP 连接的字节数, 包括等待窗口的部分,
+    size_t outputBytes() const { return outputBuffer_.readableBytes(); }
+
+    void setMessageCallback(const MuxMessageCallback &cb) { messageCallback_ = cb; }
+    // 积压在 outputBuffer_ 里面的数据全部交给 TCP 连接以后回调, 用来在流的窗口重新打开以后继续发送,
+    void setWriteCompleteCallback(const MuxStreamCallback &cb) { writeCompleteCallback_ = cb; }
+    // 对端关闭了写端、流被重置或者 TCP 连接断开的时候回调一次,
+    void setCloseCallback(const MuxStreamCallback &cb) { closeCallback_ = cb; }
+
+    void setContext(const std::shared_ptr<void> &context) { context_ = context; }
+    const std::shared_ptr<void> &getContext() const { return context_; }
+
+private:
+    // MuxSession 解析帧、调度发送的时候直接访问流的状态,
+    friend class MuxSession;
+
+    void sendInLoop(const char *data, size_t len);
+    void shutdownInLoop();
+    void resetInLoop();
+    void resumeReadInLoop();
+
+    // 收到的数据交给 messageCallback_, 回调以后按照 inputBuffer_ 里面剩下的数据计算要还给对端的窗口,
+    void handleData(const char *data, size_t len, Buffer *scratch);
+    void notifyClose();
+
+private:
+    std::weak_ptr<MuxSession> session_;
+    EventLoop *loop_;
+    const uint32_t id_;
+    const size_t initialWindow_;
+
+    Buffer inputBuffer_;
+    Buffer outputBuffer_;
+    size_t sendWindow_; // 还可以发给对端的字节数,
+    size_t recvWindow_; // 对端还可以发过来的字节数,
+
+    bool scheduled_;     // 已经在 MuxSession 的发送轮转队列里面,
+    bool finPending_;    // shutdown() 了, outputBuffer_ 发送完以后带上 FIN,
+    bool localClosed_;   // FIN 已经发送,
+    bool remoteClosed_;  // 收到了对端的 FIN,
+    bool resetted_;      // 发送或者收到了 RST,
+    bool closeNotified_; // closeCallback_ 已经回调,
+
+    MuxMessageCallback messageCallback_;
+    MuxStreamCallback writeCompleteCallback_;
+    MuxStreamCallback closeCallback_;
+    std::shared_ptr<void> context_;
+};
@@ -0,0 +1,54 @@
+#include <new>
+
+#include "object_pool.h"
+
+ObjectPool::ObjectPool(size_t maxFree)
+    : maxFree_(maxFree),
+      slotSize_(0)
+{
+}
+
+ObjectPool::~ObjectPool()
+{
+    for (void *p : freeList_)
+    {
+        ::operator delete(p);
+    }
+}
+
+void *ObjectPool::allocate(size_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (0 == slotSize_)
+        {
+            slotSize_ = size;
+        }
+        if (size == slotSize_ && !freeList_.empty())
+        {
+            void *p = freeList_.back();
+            freeList_.pop_back();
+            return p;
+        }
+    }
+    return ::operator new(size);
+}
+
+void ObjectPool::deallocate(void *p, size_t size)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (size == slotSize_ && freeList_.size() < maxFree_)
+        {
+            freeList_.push_back(p);
+            return;
+        }
+    }
+    ::operator delete(p);
+}
+
+size_t ObjectPool::freeSlots() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return freeList_.size();
+}
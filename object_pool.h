@@ -0,0 +1,71 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <vector>
+
+#include "noncopyable.h"
+
+/**
+ * 固定大小内存块的对象池, 释放的块放到空闲链表里面, 下次分配直接复用, 不再调用 operator new,
+ * 块的大小由第一次分配决定, 之后大小不一样的分配直接走 operator new/delete,
+ * TcpServer 给每个 subLoop 一个 ObjectPool, 用 std::allocate_shared() + PoolAllocator 分配 TcpConnection,
+ * shared_ptr 的控制块和 TcpConnection (内嵌 Socket 和 Channel) 在同一个块里面,
+ *
+ * 分配在 mainLoop 里面, 释放在最后一个持有 TcpConnectionPtr 的线程里面 (一般是 subLoop), 所以空闲链表需要加锁,
+ * 这把锁只有 mainLoop 和一个 subLoop 会竞争, 临界区只有一次 push_back/pop_back,
+ */
+class ObjectPool : noncopyable
+{
+public:
+    // maxFree: 空闲链表最多保留的块数, 超过的块直接还给系统, 连接数回落以后内存可以释放,
+    explicit ObjectPool(size_t maxFree = kDefaultMaxFree);
+    ~ObjectPool();
+
+public:
+    void *allocate(size_t size);
+    void deallocate(void *p, size_t size);
+
+    size_t slotSize() const { return slotSize_; }
+    size_t freeSlots() const;
+
+private:
+    static const size_t kDefaultMaxFree = 4096;
+
+    const size_t maxFree_;
+    mutable std::mutex mutex_;
+    size_t slotSize_; // 0 表示还没有分配过,
+    std::vector<void *> freeList_;
+};
+
+/**
+ * 标准库的分配器接口, 只是把分配转给 ObjectPool,
+ * 分配器持有 ObjectPool 的 shared_ptr, allocate_shared() 把分配器拷贝一份保存在控制块里面,
+ * 所以 TcpServer 析构以后还没释放的 TcpConnection 仍然可以把块还回去,
+ */
+template <typename T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    explicit PoolAllocator(const std::shared_ptr<ObjectPool> &pool) : pool_(pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) : pool_(other.pool()) {}
+
+public:
+    T *allocate(size_t n) { return static_cast<T *>(pool_->allocate(n * sizeof(T))); }
+    void deallocate(T *p, size_t n) { pool_->deallocate(p, n * sizeof(T)); }
+
+    const std::shared_ptr<ObjectPool> &pool() const { return pool_; }
+
+private:
+    std::shared_ptr<ObjectPool> pool_;
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T> &a, const PoolAllocator<U> &b) { return a.pool() == b.pool(); }
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T> &a, const PoolAllocator<U> &b) { return a.pool() != b.pool(); }
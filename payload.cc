@@ -0,0 +1,12 @@
+#include "payload.h"
+
+// make_shared 把控制块和 Payload 对象放在一次内存分配里面,
+PayloadPtr Payload::copyFrom(const void *data, size_t len)
+{
+    return std::make_shared<const Payload>(data, len);
+}
+
+PayloadPtr Payload::fromString(std::string data)
+{
+    return std::make_shared<const Payload>(std::move(data));
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "noncopyable.h"
+
+class Payload;
+
+using PayloadPtr = std::shared_ptr<const Payload>;
+
+/**
+ * 不可变的、引用计数的待发送数据,
+ * 同一条消息广播给大量的连接时, 先把消息编码一次放到 Payload 里面, 每个 TcpConnection 只持有一个 PayloadPtr,
+ * 内核一次没有写完的部分, TcpConnection 只在发送队列里面记录一个偏移量, 而不是再拷贝一份到 outputBuffer_,
+ * Payload 构造以后内容不再改变, 所以可以在多个 subLoop 之间共享, 不需要加锁,
+ */
+class Payload : noncopyable
+{
+public:
+    explicit Payload(std::string data) : data_(std::move(data)) {}
+    Payload(const void *data, size_t len) : data_(static_cast<const char *>(data), len) {}
+    ~Payload() = default;
+
+public:
+    static PayloadPtr copyFrom(const void *data, size_t len);
+    static PayloadPtr fromString(std::string data);
+
+    const char *data() const { return data_.data(); }
+    size_t size() const { return data_.size(); }
+
+private:
+    const std::string data_;
+};
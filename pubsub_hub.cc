@@ -0,0 +1,176 @@
+#include <algorithm>
+
+#include "pubsub_hub.h"
+
+#include "event_loop.h"
+#include "logger.h"
+#include "tcp_connection.h"
+
+void PubSubHub::addLoop(EventLoop *loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    shards_.emplace_back(new Shard(loop));
+}
+
+PubSubHub::Shard *PubSubHub::shardOf(EventLoop *loop) const
+{
+    // subLoop 的个数和 CPU 个数差不多, 线性查找就够了,
+    for (const auto &shard : shards_)
+    {
+        if (shard->loop == loop)
+        {
+            return shard.get();
+        }
+    }
+    return nullptr;
+}
+
+bool PubSubHub::subscribe(const std::string &topic, const TcpConnectionPtr &conn)
+{
+    Shard *shard = shardOf(conn->getLoop());
+    if (nullptr == shard)
+    {
+        LOG_ERROR("PubSubHub::subscribe [%s] loop is not registered \n", conn->name().c_str());
+        return false;
+    }
+    shard->loop->assertInLoopThread();
+
+    Subscribers &subscribers = shard->topics[topic];
+    if (!subscribers.index.emplace(conn.get(), subscribers.conns.size()).second)
+    {
+        return false;
+    }
+    subscribers.conns.push_back(conn);
+    shard->connTopics[conn.get()].push_back(topic);
+    shard->subscriptions.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool PubSubHub::unsubscribe(const std::string &topic, const TcpConnectionPtr &conn)
+{
+    Shard *shard = shardOf(conn->getLoop());
+    if (nullptr == shard)
+    {
+        return false;
+    }
+    shard->loop->assertInLoopThread();
+
+    if (!removeSubscriber(shard, topic, conn.get()))
+    {
+        return false;
+    }
+    auto it = shard->connTopics.find(conn.get());
+    if (shard->connTopics.end() != it)
+    {
+        std::vector<std::string> &topics = it->second;
+        topics.erase(std::find(topics.begin(), topics.end(), topic));
+        if (topics.empty())
+        {
+            shard->connTopics.erase(it);
+        }
+    }
+    return true;
+}
+
+void PubSubHub::unsubscribeAll(const TcpConnectionPtr &conn)
+{
+    Shard *shard = shardOf(conn->getLoop());
+    if (nullptr == shard)
+    {
+        return;
+    }
+    shard->loop->assertInLoopThread();
+
+    auto it = shard->connTopics.find(conn.get());
+    if (shard->connTopics.end() == it)
+    {
+        return;
+    }
+    for (const std::string &topic : it->second)
+    {
+        removeSubscriber(shard, topic, conn.get());
+    }
+    shard->connTopics.erase(it);
+}
+
+bool PubSubHub::removeSubscriber(Shard *shard, const std::string &topic, const TcpConnection *conn)
+{
+    auto topicIt = shard->topics.find(topic);
+    if (shard->topics.end() == topicIt)
+    {
+        return false;
+    }
+    Subscribers &subscribers = topicIt->second;
+    auto indexIt = subscribers.index.find(conn);
+    if (subscribers.index.end() == indexIt)
+    {
+        return false;
+    }
+
+    // 和最后一个交换以后删除, 订阅者的顺序不保证,
+    size_t pos = indexIt->second;
+    subscribers.index.erase(indexIt);
+    if (pos != subscribers.conns.size() - 1)
+    {
+        subscribers.conns[pos] = std::move(subscribers.conns.back());
+        subscribers.index[subscribers.conns[pos].get()] = pos;
+    }
+    subscribers.conns.pop_back();
+    if (subscribers.conns.empty())
+    {
+        shard->topics.erase(topicIt);
+    }
+    shard->subscriptions.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+size_t PubSubHub::publish(const std::string &topic, const PayloadPtr &payload)
+{
+    size_t forwarded = 0;
+    for (const auto &item : shards_)
+    {
+        Shard *shard = item.get();
+        if (0 == shard->subscriptions.load(std::memory_order_relaxed))
+        {
+            continue;
+        }
+        ++forwarded;
+        if (shard->loop->isInLoopThread())
+        {
+            deliverInLoop(shard, topic, payload);
+        }
+        else
+        {
+            // 一个分片只投递一次, 不管这个分片上有多少订阅者,
+            shard->loop->queueInLoop([shard, topic, payload]() { deliverInLoop(shard, topic, payload); });
+        }
+    }
+    return forwarded;
+}
+
+void PubSubHub::deliverInLoop(Shard *shard, const std::string &topic, const PayloadPtr &payload)
+{
+    auto it = shard->topics.find(topic);
+    if (shard->topics.end() == it)
+    {
+        return;
+    }
+    // 发送不会改变订阅表, 连接断开要等到这一轮事件处理完以后才回调, 所以可以直接遍历,
+    for (const TcpConnectionPtr &conn : it->second.conns)
+    {
+        if (conn->connected())
+        {
+            conn->send(payload);
+        }
+    }
+}
+
+size_t PubSubHub::numSubscriptions() const
+{
+    size_t total = 0;
+    for (const auto &shard : shards_)
+    {
+        total += shard->subscriptions.load(std::memory_order_relaxed);
+    }
+    return total;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "callbacks.h"
+#include "noncopyable.h"
+#include "payload.h"
+
+class EventLoop;
+class TcpConnection;
+
+/**
+ * 按主题的发布/订阅, 订阅表按照 subLoop 分片, 每个分片只保存这个 subLoop 上面的连接, 只在这个 subLoop 线程里面访问, 不加锁,
+ * publish() 不遍历订阅者, 而是给每个有订阅的分片投递一次 (queueInLoop), 由各个 subLoop 并行地发给自己的订阅者,
+ * 消息由发布者编码一次放在 Payload 里面, 所有的订阅者共享同一个 PayloadPtr, TcpConnection 内核写不完的时候也只保存引用,
+ * 所以发布一条消息的开销是 O(subLoop 个数) 次投递加上 O(订阅者) 次 send(), 没有按订阅者的拷贝,
+ *
+ * 用法: 在 TcpServer 的 ThreadInitCallback 里面 addLoop(), TcpServer::start() 返回以后所有的分片都已经注册好了,
+ *       订阅和退订在连接所在的 loop 线程里面调用 (比如 MessageCallback 里面), 连接断开的时候 unsubscribeAll(),
+ *       publish() 可以在任意线程调用,
+ */
+class PubSubHub : noncopyable
+{
+public:
+    PubSubHub() = default;
+    ~PubSubHub() = default;
+
+public:
+    // 在 loop 线程里面调用, 之后这个 loop 上面的连接才能订阅,
+    void addLoop(EventLoop *loop);
+
+    // 在 conn 的 loop 线程里面调用, 已经订阅过返回 false,
+    bool subscribe(const std::string &topic, const TcpConnectionPtr &conn);
+    // 在 conn 的 loop 线程里面调用, 没有订阅返回 false,
+    bool unsubscribe(const std::string &topic, const TcpConnectionPtr &conn);
+    void unsubscribeAll(const TcpConnectionPtr &conn);
+
+    /**
+     * 把 payload 原样发给 topic 的所有订阅者, 可以在任意线程调用, 返回投递到的分片个数,
+     * 发布者所在的 loop 的分片直接在调用里面发送, 其他分片 queueInLoop() 投递,
+     */
+    size_t publish(const std::string &topic, const PayloadPtr &payload);
+
+    // 所有分片的订阅数之和, 可以在任意线程读取,
+    size_t numSubscriptions() const;
+
+private:
+    // 一个主题在一个分片里面的订阅者, 删除的时候和最后一个交换, 订阅和退订都是 O(1),
+    struct Subscribers
+    {
+        std::vector<TcpConnectionPtr> conns;
+        std::unordered_map<const TcpConnection *, size_t> index;
+    };
+
+    struct Shard
+    {
+        explicit Shard(EventLoop *loopArg) : loop(loopArg), subscriptions(0) {}
+
+        EventLoop *loop;
+        std::unordered_map<std::string, Subscribers> topics;
+        // 每个连接订阅了哪些主题, 连接断开的时候退订,
+        std::unordered_map<const TcpConnection *, std::vector<std::string>> connTopics;
+        // 这个分片的订阅数, publish() 跳过没有订阅的分片,
+        std::atomic<size_t> subscriptions;
+    };
+
+    Shard *shardOf(EventLoop *loop) const;
+    static void deliverInLoop(Shard *shard, const std::string &topic, const PayloadPtr &payload);
+    static bool removeSubscriber(Shard *shard, const std::string &topic, const TcpConnection *conn);
+
+private:
+    // addLoop() 只在 TcpServer::start() 里面各个 subLoop 启动的时候调用, 用 mutex_ 保护,
+    // start() 返回以后 shards_ 不再修改, 各个线程直接读,
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <stdint.h>
+
+#include "rpc_client.h"
+
+#include "event_loop.h"
+#include "logger.h"
+#include "tcp_connection.h"
+
+RpcClient::RpcClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &name)
+    : loop_(loop),
+      client_(loop, serverAddr, name),
+      codec_(std::bind(&RpcClient::onFrame, this, std::placeholders::_1, std::placeholders::_2,
+                       std::placeholders::_3, std::placeholders::_4)),
+      connectionCallback_(defaultConnectionCallback),
+      nextCorrelationId_(1),
+      flushQueued_(false),
+      dispatching_(false),
+      alive_(std::make_shared<bool>(true))
+{
+    // ~TcpClient() 关闭还在的连接, 连接在之后的一轮 loop 里面才真正关闭, 那时候 RpcClient 已经析构了,
+    std::weak_ptr<bool> alive(alive_);
+    client_.setConnectionCallback([this, alive](const TcpConnectionPtr &conn)
+                                  {
+                                      if (!alive.expired())
+                                      {
+                                          onConnection(conn);
+                                      }
+                                  });
+    client_.setMessageCallback([this, alive](const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+                               {
+                                   if (!alive.expired())
+                                   {
+                                       onMessage(conn, buf, receiveTime);
+                                   }
+                               });
+}
+
+RpcClient::~RpcClient()
+{
+    for (auto &item : pending_)
+    {
+        if (item.second.hasTimer)
+        {
+            loop_->cancel(item.second.timer);
+        }
+    }
+}
+
+bool RpcClient::connected() const
+{
+    TcpConnectionPtr conn = client_.connection();
+    return conn && conn->connected();
+}
+
+void RpcClient::callRaw(int32_t methodId, const void *payload, size_t len, double timeoutSeconds,
+                        const RawCallback &cb)
+{
+    Buffer frame;
+    RpcHeader header = requestHeader(methodId, timeoutSeconds);
+    size_t frameStart = header.beginFrame(&frame);
+    frame.append(payload, len);
+    RpcHeader::endFrame(&frame, frameStart);
+    startCall(header.correlationId, &frame, timeoutSeconds, cb);
+}
+
+RpcHeader RpcClient::requestHeader(int32_t methodId, double timeoutSeconds)
+{
+    RpcHeader header;
+    header.type = RpcHeader::kRequest;
+    header.methodId = methodId;
+    // 任意线程都可以发起调用, correlationId 在发起的时候就确定, 帧头可以在调用线程里面写好,
+    header.correlationId = nextCorrelationId_.fetch_add(1, std::memory_order_relaxed);
+    if (timeoutSeconds > 0)
+    {
+        int64_t ms = static_cast<int64_t>(timeoutSeconds * 1000);
+        header.timeoutMs = static_cast<int32_t>(std::max<int64_t>(1, std::min<int64_t>(ms, INT32_MAX)));
+    }
+    return header;
+}
+
+void RpcClient::startCall(uint64_t correlationId, Buffer *frame, double timeoutSeconds, const RawCallback &cb)
+{
+    if (loop_->isInLoopThread())
+    {
+        startCallInLoop(correlationId, frame->peek(), frame->readableBytes(), timeoutSeconds, cb);
+    }
+    else
+    {
+        std::string data = frame->retrieveAllAsString();
+        std::weak_ptr<bool> alive(alive_);
+        loop_->runInLoop([this, alive, correlationId, data, timeoutSeconds, cb]()
+                         {
+                             if (!alive.expired())
+                             {
+                                 startCallInLoop(correlationId, data.data(), data.size(), timeoutSeconds, cb);
+                             }
+                         });
+    }
+}
+
+void RpcClient::startCallInLoop(uint64_t correlationId, const char *frame, size_t len, double timeoutSeconds,
+                                const RawCallback &cb)
+{
+    if (!connected())
+    {
+        // 不在 call() 里面直接回调, 回调里面再发起调用的时候不会递归,
+        loop_->queueInLoop([cb]() { cb(kRpcConnectionClosed, nullptr, 0); });
+        return;
+    }
+
+    std::weak_ptr<bool> alive(alive_);
+    PendingCall &call = pending_[correlationId];
+    call.callback = cb;
+    call.hasTimer = timeoutSeconds > 0;
+    if (call.hasTimer)
+    {
+        call.timer = loop_->runAfter(timeoutSeconds, [this, alive, correlationId]()
+                                     {
+                                         if (!alive.expired())
+                                         {
+                                             onTimeout(correlationId);
+                                         }
+                                     });
+    }
+
+    outputBuffer_.append(frame, len);
+    if (!dispatching_ && !flushQueued_)
+    {
+        flushQueued_ = true;
+        loop_->queueInLoop([this, alive]()
+                           {
+                               if (!alive.expired())
+                               {
+                                   flushInLoop();
+                               }
+                           });
+    }
+}
+
+void RpcClient::flushInLoop()
+{
+    flushQueued_ = false;
+    TcpConnectionPtr conn = client_.connection();
+    if (conn && outputBuffer_.readableBytes() > 0)
+    {
+        conn->send(&outputBuffer_);
+    }
+    outputBuffer_.retrieveAll();
+}
+
+void RpcClient::onConnection(const TcpConnectionPtr &conn)
+{
+    if (!conn->connected())
+    {
+        outputBuffer_.retrieveAll();
+        failAll(kRpcConnectionClosed);
+    }
+    connectionCallback_(conn);
+}
+
+void RpcClient::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    dispatching_ = true;
+    codec_.onMessage(conn, buf, receiveTime);
+    dispatching_ = false;
+    flushInLoop();
+}
+
+void RpcClient::onFrame(const TcpConnectionPtr &conn, const char *data, size_t len, Timestamp)
+{
+    RpcHeader header;
+    if (!header.parse(data, len) || RpcHeader::kResponse != header.type)
+    {
+        LOG_ERROR("RpcClient::onFrame [%s] invalid rpc frame \n", conn->name().c_str());
+        conn->forceClose();
+        return;
+    }
+
+    auto it = pending_.find(header.correlationId);
+    if (pending_.end() == it)
+    {
+        return; // 已经超时的调用,
+    }
+    RawCallback cb = std::move(it->second.callback);
+    if (it->second.hasTimer)
+    {
+        loop_->cancel(it->second.timer);
+    }
+    pending_.erase(it);
+
+    if (kRpcOk == header.status)
+    {
+        cb(kRpcOk, data + RpcHeader::kHeaderLen, len - RpcHeader::kHeaderLen);
+    }
+    else
+    {
+        cb(header.status, nullptr, 0);
+    }
+}
+
+void RpcClient::onTimeout(uint64_t correlationId)
+{
+    auto it = pending_.find(correlationId);
+    if (pending_.end() == it)
+    {
+        return;
+    }
+    RawCallback cb = std::move(it->second.callback);
+    pending_.erase(it);
+    cb(kRpcDeadlineExceeded, nullptr, 0);
+}
+
+void RpcClient::failAll(RpcStatus status)
+{
+    // 回调里面可能发起新的调用, 先整个换出来,
+    std::unordered_map<uint64_t, PendingCall> pending;
+    pending.swap(pending_);
+    for (auto &item : pending)
+    {
+        if (item.second.hasTimer)
+        {
+            loop_->cancel(item.second.timer);
+        }
+    }
+    for (auto &item : pending)
+    {
+        item.second.callback(status, nullptr, 0);
+    }
+}
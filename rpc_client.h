@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include "buffer.h"
+#include "callbacks.h"
+#include "length_header_codec.h"
+#include "noncopyable.h"
+#include "rpc_codec.h"
+#include "rpc_serializer.h"
+#include "tcp_client.h"
+#include "timer_id.h"
+
+/**
+ * RpcServer 的客户端, 一个 TcpClient 连接上面同时发出任意多个调用,
+ * 每个调用分配一个 correlationId, 响应按照 correlationId 找到回调, 服务器可以按任意顺序完成,
+ * timeoutSeconds > 0 的调用在 loop 上挂一个定时器, 到期还没有响应就以 kRpcDeadlineExceeded 回调, 之后的响应丢弃,
+ * 连接断开的时候所有在途的调用以 kRpcConnectionClosed 回调,
+ *
+ * call() 可以在任意线程调用, 回调都在 loop 线程里面执行,
+ * 请求先追加到 outputBuffer_, 同一轮 loop 里面发出的调用 (包括在响应回调里面发出的下一批调用) 合并成一次发送,
+ * RpcClient 和 TcpClient 一样在 loop 线程里面析构, 析构的时候在途的调用不再回调,
+ * 交给 loop 的任务 (跨线程的调用、合并发送、超时) 都带着 alive_ 的 weak_ptr, RpcClient 析构以后它们什么也不做,
+ */
+class RpcClient : noncopyable
+{
+public:
+    // data 指向响应的消息体, 只在回调期间有效, status 不是 kRpcOk 的时候没有消息体,
+    using RawCallback = std::function<void(RpcStatus status, const char *data, size_t len)>;
+
+    RpcClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &name);
+    ~RpcClient();
+
+public:
+    void connect() { client_.connect(); }
+    void disconnect() { client_.disconnect(); }
+    void enableRetry() { client_.enableRetry(); }
+    bool connected() const;
+    EventLoop *getLoop() const { return loop_; }
+
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+
+    // timeoutSeconds <= 0 表示没有截止时间,
+    void callRaw(int32_t methodId, const void *payload, size_t len, double timeoutSeconds, const RawCallback &cb);
+
+    // 请求用 RpcSerializer<Req> 序列化, 响应用 RpcSerializer<Resp> 反序列化, 失败的时候 resp 是默认构造的,
+    template <typename Req, typename Resp>
+    void call(int32_t methodId, const Req &req, double timeoutSeconds,
+              const std::function<void(RpcStatus, const Resp &)> &cb)
+    {
+        Buffer frame;
+        RpcHeader header = requestHeader(methodId, timeoutSeconds);
+        size_t frameStart = header.beginFrame(&frame);
+        RpcSerializer<Req>::serialize(req, &frame);
+        RpcHeader::endFrame(&frame, frameStart);
+        startCall(header.correlationId, &frame, timeoutSeconds, [cb](RpcStatus status, const char *data, size_t len)
+                  {
+                      Resp resp{};
+                      if (kRpcOk == status && !RpcSerializer<Resp>::deserialize(data, len, &resp))
+                      {
+                          status = kRpcBadResponse;
+                      }
+                      cb(status, resp);
+                  });
+    }
+
+    // 在途的调用数, 只在 loop 线程里面调用,
+    size_t pendingCalls() const { return pending_.size(); }
+
+private:
+    struct PendingCall
+    {
+        RawCallback callback;
+        TimerId timer;
+        bool hasTimer;
+    };
+
+    RpcHeader requestHeader(int32_t methodId, double timeoutSeconds);
+    // frame 已经是完整的一帧, 不在 loop 线程里面的时候拷贝一份交给 loop 线程,
+    void startCall(uint64_t correlationId, Buffer *frame, double timeoutSeconds, const RawCallback &cb);
+    void startCallInLoop(uint64_t correlationId, const char *frame, size_t len, double timeoutSeconds,
+                         const RawCallback &cb);
+    void flushInLoop();
+
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    void onFrame(const TcpConnectionPtr &conn, const char *data, size_t len, Timestamp receiveTime);
+    void onTimeout(uint64_t correlationId);
+    void failAll(RpcStatus status);
+
+private:
+    EventLoop *loop_;
+    TcpClient client_;
+    LengthHeaderCodec codec_;
+    ConnectionCallback connectionCallback_;
+
+    std::atomic<uint64_t> nextCorrelationId_;
+
+    // 下面的成员只在 loop 线程里面使用,
+    std::unordered_map<uint64_t, PendingCall> pending_;
+    Buffer outputBuffer_;    // 还没有交给 TcpConnection 的请求,
+    bool flushQueued_;       // 已经 queueInLoop() 了一次 flushInLoop(),
+    bool dispatching_;       // 正在处理响应, 回调里面发出的调用等处理完以后一起发送,
+
+    // 只用来判断 RpcClient 是否还活着, 析构和检查都在 loop 线程里面, 不需要加锁,
+    std::shared_ptr<bool> alive_;
+};
@@ -0,0 +1,70 @@
+#include <endian.h>
+#include <string.h>
+
+#include "rpc_codec.h"
+
+#include "buffer.h"
+
+const char *rpcStatusString(RpcStatus status)
+{
+    switch (status)
+    {
+    case kRpcOk:
+        return "ok";
+    case kRpcNoSuchMethod:
+        return "no such method";
+    case kRpcBadRequest:
+        return "bad request";
+    case kRpcBadResponse:
+        return "bad response";
+    case kRpcHandlerError:
+        return "handler error";
+    case kRpcDeadlineExceeded:
+        return "deadline exceeded";
+    case kRpcConnectionClosed:
+        return "connection closed";
+    }
+    return "unknown";
+}
+
+size_t RpcHeader::beginFrame(Buffer *buf) const
+{
+    size_t frameStart = buf->readableBytes();
+    buf->appendInt32(0); // 长度在 endFrame() 里面回填,
+    buf->appendInt8(static_cast<int8_t>(type));
+    buf->appendInt8(static_cast<int8_t>(status));
+    buf->appendInt16(0);
+    buf->appendInt32(methodId);
+    buf->appendInt64(static_cast<int64_t>(correlationId));
+    buf->appendInt32(timeoutMs);
+    return frameStart;
+}
+
+void RpcHeader::endFrame(Buffer *buf, size_t frameStart)
+{
+    size_t frameLen = buf->readableBytes() - frameStart;
+    int32_t be32 = htobe32(static_cast<int32_t>(frameLen - sizeof(int32_t)));
+    // beginWrite() 往前数 frameLen 个字节就是这一帧的长度字段,
+    ::memcpy(buf->beginWrite() - frameLen, &be32, sizeof be32);
+}
+
+bool RpcHeader::parse(const char *data, size_t len)
+{
+    if (len < kHeaderLen)
+    {
+        return false;
+    }
+    int32_t be32 = 0;
+    int64_t be64 = 0;
+
+    type = static_cast<Type>(data[0]);
+    status = static_cast<RpcStatus>(data[1]);
+    // data[2], data[3] 保留,
+    ::memcpy(&be32, data + 4, sizeof be32);
+    methodId = be32toh(be32);
+    ::memcpy(&be64, data + 8, sizeof be64);
+    correlationId = static_cast<uint64_t>(be64toh(be64));
+    ::memcpy(&be32, data + 16, sizeof be32);
+    timeoutMs = be32toh(be32);
+    return kRequest == type || kResponse == type;
+}
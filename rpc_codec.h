@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Buffer;
+
+// 调用的结果, 响应帧里面带回来, 连接断开和超时由客户端自己产生,
+enum RpcStatus
+{
+    kRpcOk = 0,
+    kRpcNoSuchMethod,     // 服务器没有注册这个 methodId,
+    kRpcBadRequest,       // 服务器反序列化请求失败,
+    kRpcBadResponse,      // 客户端反序列化响应失败,
+    kRpcHandlerError,     // 处理函数调用 RpcResponder::fail(),
+    kRpcDeadlineExceeded, // 超过了调用的截止时间还没有收到响应,
+    kRpcConnectionClosed, // 发送之前没有连接, 或者等待响应的时候连接断开,
+};
+
+const char *rpcStatusString(RpcStatus status);
+
+/**
+ * RPC 消息的帧头, 整个 RPC 帧用 LengthHeaderCodec 分帧, 长度后面是固定 20 字节的帧头, 再后面是序列化以后的消息体:
+ *     | int32 length | int8 type | int8 status | int16 reserved | int32 methodId | int64 correlationId |
+ *     | int32 timeoutMs | payload ... |
+ * 整数都是网络字节序,
+ * correlationId 由客户端分配, 服务器原样带回, 同一个连接上的多个调用靠它对应请求和响应, 响应可以按任意顺序返回,
+ * timeoutMs 是请求发出时剩余的时间, 0 表示没有截止时间, 服务器用它丢弃已经没有人等待的响应,
+ */
+struct RpcHeader
+{
+    enum Type
+    {
+        kRequest = 1,
+        kResponse = 2,
+    };
+
+    static const size_t kHeaderLen = 20;
+
+    RpcHeader() : type(kRequest), status(kRpcOk), methodId(0), correlationId(0), timeoutMs(0) {}
+
+    /**
+     * 在 buf 的可写区域开始一帧, 写入长度占位和帧头, 返回这一帧在可读区域里面的起始偏移,
+     * 接着把消息体追加到 buf 里面, 最后 endFrame() 回填长度,
+     * 一个 Buffer 里面可以连续写多帧, 一次发送,
+     */
+    size_t beginFrame(Buffer *buf) const;
+    static void endFrame(Buffer *buf, size_t frameStart);
+
+    // data 是 LengthHeaderCodec 交上来的一帧, 不包括长度, 帧太短返回 false,
+    bool parse(const char *data, size_t len);
+
+    Type type;
+    RpcStatus status;
+    int32_t methodId;
+    uint64_t correlationId;
+    int32_t timeoutMs;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+
+#include "buffer.h"
+
+/**
+ * RPC 请求和响应的序列化, 每种类型一个 RpcSerializer<T>, 提供两个静态函数:
+ *     static void serialize(const T &value, Buffer *out);                  // 追加到 out 的可写区域,
+ *     static bool deserialize(const char *data, size_t len, T *value);     // 失败返回 false,
+ * 要换成别的序列化方式 (protobuf, flatbuffers ...), 给自己的类型特化 RpcSerializer 就可以,
+ *
+ * 默认的实现是固定布局: 可以平凡拷贝 (trivially copyable) 的类型直接 memcpy 整个对象, 没有编码和解码的开销,
+ * 字节序和结构体的内存布局是本机的, 只适合两端是同样的编译器和体系结构的内部服务,
+ * 需要跨平台的消息用上面的方法特化, 字段逐个用 Buffer::appendInt32() 这样的网络字节序接口,
+ */
+template <typename T>
+struct RpcSerializer
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "RpcSerializer<T> has no fixed-layout default for this type, specialize it");
+
+    static void serialize(const T &value, Buffer *out)
+    {
+        out->append(&value, sizeof value);
+    }
+
+    static bool deserialize(const char *data, size_t len, T *value)
+    {
+        if (sizeof(T) != len)
+        {
+            return false;
+        }
+        ::memcpy(value, data, sizeof(T));
+        return true;
+    }
+};
+
+// 字符串不做任何编码, 消息体就是字符串本身,
+template <>
+struct RpcSerializer<std::string>
+{
+    static void serialize(const std::string &value, Buffer *out)
+    {
+        out->append(value.data(), value.size());
+    }
+
+    static bool deserialize(const char *data, size_t len, std::string *value)
+    {
+        value->assign(data, len);
+        return true;
+    }
+};
@@ -0,0 +1,189 @@
+#include <mutex>
+
+#include "rpc_server.h"
+
+#include "event_loop.h"
+#include "logger.h"
+#include "tcp_connection.h"
+
+/**
+ * 一个 RPC 连接的发送队列, 作为 TcpConnection 的 context, RpcResponder 持有它的 shared_ptr,
+ * 回复可能来自任意线程, 先在锁里面追加到 pending_, 由 loop 线程一次取走整个 Buffer 发送,
+ * loop 线程在 onMessage() 里面派发调用的时候 (dispatching_) 不安排发送, 派发结束以后统一 flush(),
+ * 其他时候第一个回复 queueInLoop() 一次 flush(), 之后的回复只追加, 直到那次 flush() 执行,
+ */
+class RpcSession : noncopyable, public std::enable_shared_from_this<RpcSession>
+{
+public:
+    explicit RpcSession(const TcpConnectionPtr &conn)
+        : loop_(conn->getLoop()), conn_(conn), flushQueued_(false), dispatching_(false) {}
+
+public:
+    void append(Buffer *frame);
+    // 只在 loop 线程里面调用,
+    void flush();
+    void setDispatching(bool on) { dispatching_ = on; }
+
+private:
+    EventLoop *loop_;
+    std::weak_ptr<TcpConnection> conn_;
+
+    std::mutex mutex_;
+    Buffer pending_;   // 还没有交给 TcpConnection 的回复, 由 mutex_ 保护,
+    bool flushQueued_; // 由 mutex_ 保护,
+    bool dispatching_; // 只在 loop 线程里面使用,
+};
+
+void RpcSession::append(Buffer *frame)
+{
+    bool inLoop = loop_->isInLoopThread();
+    bool queueFlush = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.append(frame->peek(), frame->readableBytes());
+        if (!flushQueued_ && !(inLoop && dispatching_))
+        {
+            flushQueued_ = true;
+            queueFlush = true;
+        }
+    }
+    frame->retrieveAll();
+
+    if (queueFlush)
+    {
+        // 连接已经断开的话 flush() 什么也不做, 回复跟着 RpcSession 一起释放,
+        std::shared_ptr<RpcSession> self = shared_from_this();
+        loop_->queueInLoop([self]() { self->flush(); });
+    }
+}
+
+void RpcSession::flush()
+{
+    Buffer out;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.swap(out);
+        flushQueued_ = false;
+    }
+    TcpConnectionPtr conn = conn_.lock();
+    if (conn && out.readableBytes() > 0)
+    {
+        conn->send(&out);
+    }
+}
+
+void RpcResponder::replyRaw(const void *data, size_t len) const
+{
+    Buffer frame;
+    size_t frameStart = responseHeader(kRpcOk).beginFrame(&frame);
+    frame.append(data, len);
+    RpcHeader::endFrame(&frame, frameStart);
+    sendFrame(&frame);
+}
+
+void RpcResponder::fail(RpcStatus status) const
+{
+    Buffer frame;
+    size_t frameStart = responseHeader(status).beginFrame(&frame);
+    RpcHeader::endFrame(&frame, frameStart);
+    sendFrame(&frame);
+}
+
+RpcHeader RpcResponder::responseHeader(RpcStatus status) const
+{
+    RpcHeader header;
+    header.type = RpcHeader::kResponse;
+    header.status = status;
+    header.methodId = methodId_;
+    header.correlationId = correlationId_;
+    return header;
+}
+
+void RpcResponder::sendFrame(Buffer *frame) const
+{
+    // 客户端已经按照超时处理了这个调用, 回复没有人等待,
+    if (expired())
+    {
+        LOG_DEBUG("RpcResponder::sendFrame drop expired reply of call %lu \n", correlationId_);
+        return;
+    }
+    session_->append(frame);
+}
+
+RpcServer::RpcServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name, TcpServer::Option option)
+    : server_(loop, listenAddr, name, option),
+      codec_(std::bind(&RpcServer::onFrame, this, std::placeholders::_1, std::placeholders::_2,
+                       std::placeholders::_3, std::placeholders::_4))
+{
+    server_.setConnectionCallback(std::bind(&RpcServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(std::bind(&RpcServer::onMessage, this,
+                                         std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void RpcServer::registerRawMethod(int32_t methodId, const MethodHandler &handler)
+{
+    methods_[methodId] = handler;
+}
+
+void RpcServer::start()
+{
+    LOG_INFO("RpcServer[%s] starts listening on %s with %zu methods \n",
+             server_.name().c_str(), server_.ipPort().c_str(), methods_.size());
+    server_.start();
+}
+
+void RpcServer::onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setContext(std::make_shared<RpcSession>(conn));
+    }
+    else
+    {
+        // 工作线程里面还没有完成的调用持有 RpcSession, 它们的回复会被丢弃,
+        conn->setContext(std::shared_ptr<void>());
+    }
+}
+
+void RpcServer::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    std::shared_ptr<RpcSession> session = std::static_pointer_cast<RpcSession>(conn->getContext());
+    if (!session)
+    {
+        buf->retrieveAll();
+        return;
+    }
+    session->setDispatching(true);
+    codec_.onMessage(conn, buf, receiveTime);
+    session->setDispatching(false);
+    session->flush();
+}
+
+void RpcServer::onFrame(const TcpConnectionPtr &conn, const char *data, size_t len, Timestamp receiveTime)
+{
+    RpcHeader header;
+    if (!header.parse(data, len) || RpcHeader::kRequest != header.type)
+    {
+        LOG_ERROR("RpcServer::onFrame [%s] invalid rpc frame \n", conn->name().c_str());
+        conn->forceClose();
+        return;
+    }
+
+    Timestamp deadline;
+    if (header.timeoutMs > 0)
+    {
+        deadline = addTime(receiveTime, header.timeoutMs / 1000.0);
+    }
+    RpcResponder responder(std::static_pointer_cast<RpcSession>(conn->getContext()),
+                           header.methodId, header.correlationId, deadline);
+
+    auto it = methods_.find(header.methodId);
+    if (methods_.end() == it)
+    {
+        responder.fail(kRpcNoSuchMethod);
+        return;
+    }
+    RpcRequest request(header, StringPiece(data + RpcHeader::kHeaderLen, len - RpcHeader::kHeaderLen),
+                       receiveTime, deadline);
+    it->second(request, responder);
+}
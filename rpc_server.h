@@ -0,0 +1,139 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include "buffer.h"
+#include "length_header_codec.h"
+#include "noncopyable.h"
+#include "rpc_codec.h"
+#include "rpc_serializer.h"
+#include "string_piece.h"
+#include "tcp_server.h"
+#include "timestamp.h"
+
+class RpcSession;
+
+/**
+ * 服务器收到的一个调用, payload 指向连接的 inputBuffer_, 只在处理函数返回之前有效,
+ * 异步处理的时候需要的数据要在处理函数里面先拷贝出来,
+ */
+class RpcRequest
+{
+public:
+    RpcRequest(const RpcHeader &header, StringPiece payload, Timestamp receiveTime, Timestamp deadline)
+        : header_(header), payload_(payload), receiveTime_(receiveTime), deadline_(deadline) {}
+
+public:
+    int32_t methodId() const { return header_.methodId; }
+    uint64_t correlationId() const { return header_.correlationId; }
+    StringPiece payload() const { return payload_; }
+    Timestamp receiveTime() const { return receiveTime_; }
+    // 客户端没有设置截止时间的时候是无效的 Timestamp,
+    Timestamp deadline() const { return deadline_; }
+
+private:
+    RpcHeader header_;
+    StringPiece payload_;
+    Timestamp receiveTime_;
+    Timestamp deadline_;
+};
+
+/**
+ * 回复一个调用, 可以拷贝, 可以在任意线程调用,
+ * 处理函数可以在 subLoop 线程里面直接回复, 也可以把 RpcResponder 带到工作线程, 处理完以后再回复,
+ * 每个调用只能回复一次, 连接已经断开或者已经过了截止时间的时候回复被丢弃,
+ */
+class RpcResponder
+{
+public:
+    RpcResponder(const std::shared_ptr<RpcSession> &session, int32_t methodId, uint64_t correlationId,
+                 Timestamp deadline)
+        : session_(session), methodId_(methodId), correlationId_(correlationId), deadline_(deadline) {}
+
+public:
+    template <typename Resp>
+    void reply(const Resp &resp) const
+    {
+        Buffer frame;
+        size_t frameStart = responseHeader(kRpcOk).beginFrame(&frame);
+        RpcSerializer<Resp>::serialize(resp, &frame);
+        RpcHeader::endFrame(&frame, frameStart);
+        sendFrame(&frame);
+    }
+    // 已经序列化好的响应,
+    void replyRaw(const void *data, size_t len) const;
+    void fail(RpcStatus status) const;
+
+    bool expired() const { return deadline_.valid() && deadline_ < Timestamp::now(); }
+    uint64_t correlationId() const { return correlationId_; }
+
+private:
+    RpcHeader responseHeader(RpcStatus status) const;
+    void sendFrame(Buffer *frame) const;
+
+private:
+    std::shared_ptr<RpcSession> session_;
+    int32_t methodId_;
+    uint64_t correlationId_;
+    Timestamp deadline_;
+};
+
+/**
+ * 基于 TcpServer 的二进制 RPC 服务器, 消息格式见 RpcHeader,
+ * 一个连接上面可以同时有任意多个调用在途, 每个调用由 methodId 找到处理函数, 响应带着请求的 correlationId,
+ * 处理函数完成的顺序就是响应的顺序, 不需要和请求的顺序一致,
+ *
+ * 处理函数在连接所在的 subLoop 线程里面调用, 通过 RpcResponder 回复, 回复先追加到连接的发送队列 (RpcSession),
+ * 一次 onMessage() 处理的所有调用的同步回复攒在一起发送一次, 工作线程的回复交给 loop 线程合并发送,
+ */
+class RpcServer : noncopyable
+{
+public:
+    using MethodHandler = std::function<void(const RpcRequest &, const RpcResponder &)>;
+
+    RpcServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &name,
+              TcpServer::Option option = TcpServer::kNoReusePort);
+    ~RpcServer() = default;
+
+public:
+    EventLoop *getLoop() const { return server_.getLoop(); }
+    // 底层的 TcpServer, 可以在 start() 之前设置接受连接的方式、socket 选项和内存限制,
+    TcpServer &tcpServer() { return server_; }
+    void setThreadNum(int numThreads) { server_.setThreadNum(numThreads); }
+
+    // 注册处理函数都在 start() 之前, 之后只读, subLoop 线程不加锁查找,
+    void registerRawMethod(int32_t methodId, const MethodHandler &handler);
+
+    // 请求用 RpcSerializer<Req> 反序列化以后交给 handler, 反序列化失败直接回复 kRpcBadRequest,
+    template <typename Req>
+    void registerMethod(int32_t methodId, const std::function<void(const Req &, const RpcResponder &)> &handler)
+    {
+        registerRawMethod(methodId, [handler](const RpcRequest &request, const RpcResponder &responder)
+                          {
+                              Req req;
+                              StringPiece payload = request.payload();
+                              if (!RpcSerializer<Req>::deserialize(payload.data(), payload.size(), &req))
+                              {
+                                  responder.fail(kRpcBadRequest);
+                                  return;
+                              }
+                              handler(req, responder);
+                          });
+    }
+
+    void start();
+
+private:
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    void onFrame(const TcpConnectionPtr &conn, const char *data, size_t len, Timestamp receiveTime);
+
+private:
+    TcpServer server_;
+    LengthHeaderCodec codec_;
+    std::unordered_map<int32_t, MethodHandler> methods_;
+};
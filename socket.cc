@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <strings.h>
@@ -11,6 +12,10 @@
 #include "logger.h"
 #include "sockets_ops.h"
 
+#ifndef TCP_NOTSENT_LOWAT
+#define TCP_NOTSENT_LOWAT 25
+#endif
+
 Socket::~Socket()
 {
     ::close(sockfd_);
@@ -96,3 +101,48 @@ void Socket::setKeepAlive(bool on)
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
 }
+
+bool Socket::setZeroCopy(bool on)
+{
+    int optval = on ? 1 : 0;
+    return 0 == ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof(optval));
+}
+void Socket::setDeferAccept(int seconds)
+{
+    if (::setsockopt(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &seconds, sizeof(seconds)) < 0)
+    {
+        LOG_ERROR("setsockopt TCP_DEFER_ACCEPT sockfd:%d fail, errno:%d \n", sockfd_, errno);
+    }
+}
+
+void Socket::setFastOpen(int qlen)
+{
+    if (::setsockopt(sockfd_, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)) < 0)
+    {
+        LOG_ERROR("setsockopt TCP_FASTOPEN sockfd:%d fail, errno:%d \n", sockfd_, errno);
+    }
+}
+
+void Socket::setNotSentLowat(int bytes)
+{
+    if (::setsockopt(sockfd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &bytes, sizeof(bytes)) < 0)
+    {
+        LOG_ERROR("setsockopt TCP_NOTSENT_LOWAT sockfd:%d fail, errno:%d \n", sockfd_, errno);
+    }
+}
+
+void Socket::setSendBufferSize(int bytes)
+{
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(bytes)) < 0)
+    {
+        LOG_ERROR("setsockopt SO_SNDBUF sockfd:%d fail, errno:%d \n", sockfd_, errno);
+    }
+}
+
+void Socket::setRecvBufferSize(int bytes)
+{
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes)) < 0)
+    {
+        LOG_ERROR("setsockopt SO_RCVBUF sockfd:%d fail, errno:%d \n", sockfd_, errno);
+    }
+}
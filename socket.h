@@ -26,6 +26,22 @@ public:
     void setReusePort(bool on);
     void setKeepAlive(bool on);
 
+    // SO_ZEROCOPY, 打开以后才能用 MSG_ZEROCOPY 发送, 内核不支持的时候返回 false,
+    bool setZeroCopy(bool on);
+
+    /**
+     * TCP_DEFER_ACCEPT, listen socket 上设置, 三次握手完成以后不马上唤醒 accept(),
+     * 等到客户端发来第一个数据字节 (或者超过 seconds 秒) 才让连接可以 accept(), 0 表示关闭,
+     */
+    void setDeferAccept(int seconds);
+    // TCP_FASTOPEN, listen socket 上设置, 在 listen() 之前调用, qlen 是还没有完成握手的 TFO 请求队列长度, 0 表示关闭,
+    void setFastOpen(int qlen);
+    // TCP_NOTSENT_LOWAT, 内核发送缓冲区里面还没有发出去的数据少于 bytes 的时候才报告可写, 0 表示使用系统默认值,
+    void setNotSentLowat(int bytes);
+    // SO_SNDBUF/SO_RCVBUF, listen socket 上设置的话 accept() 的连接会继承, 要在 listen() 之前设置才影响窗口扩大因子,
+    void setSendBufferSize(int bytes);
+    void setRecvBufferSize(int bytes);
+
 public:
 private:
     const int sockfd_;
@@ -1,6 +1,8 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <linux/errqueue.h>
+#include <linux/filter.h>
 #include <strings.h>
 #include <sys/socket.h>
 
@@ -23,6 +25,74 @@ namespace sockets_ops
         ::fcntl(sockfd, F_SETFD, flags);
     }
 
+    int createNonblockingOrDie()
+    {
+        int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+        if (sockfd < 0)
+        {
+            LOG_FATAL("%s:%s:%d createNonblockingOrDie error, errno:%d!", __FILE__, __FUNCTION__, __LINE__, errno);
+        }
+        return sockfd;
+    }
+
+    int connect(int sockfd, const struct sockaddr_in &addr)
+    {
+        return ::connect(sockfd, (const struct sockaddr *)&addr, static_cast<socklen_t>(sizeof(addr)));
+    }
+
+    bool isSelfConnect(int sockfd)
+    {
+        struct sockaddr_in localaddr = getLocalAddr(sockfd);
+        struct sockaddr_in peeraddr = getPeerAddr(sockfd);
+        return localaddr.sin_port == peeraddr.sin_port &&
+               localaddr.sin_addr.s_addr == peeraddr.sin_addr.s_addr;
+    }
+
+    int getIncomingCpu(int sockfd)
+    {
+        int cpu = -1;
+        socklen_t len = static_cast<socklen_t>(sizeof(cpu));
+        if (::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0)
+        {
+            return -1;
+        }
+        return cpu;
+    }
+
+    bool attachReusePortCpuFilter(int sockfd, const std::vector<int> &socketCpus)
+    {
+        /**
+         *     A = cpu
+         *     if (A == socketCpus[0]) return 0
+         *     if (A == socketCpus[1]) return 1
+         *     ...
+         *     A %= n
+         *     return A
+         */
+        std::vector<struct sock_filter> code;
+        code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)));
+        for (size_t i = 0; i < socketCpus.size(); ++i)
+        {
+            if (socketCpus[i] >= 0)
+            {
+                code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(socketCpus[i]), 0, 1));
+                code.push_back(BPF_STMT(BPF_RET | BPF_K, static_cast<uint32_t>(i)));
+            }
+        }
+        code.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, static_cast<uint32_t>(socketCpus.size())));
+        code.push_back(BPF_STMT(BPF_RET | BPF_A, 0));
+
+        struct sock_fprog prog;
+        prog.len = static_cast<unsigned short>(code.size());
+        prog.filter = code.data();
+        if (::setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0)
+        {
+            LOG_ERROR("SO_ATTACH_REUSEPORT_CBPF error:%d \n", errno);
+            return false;
+        }
+        return true;
+    }
+
     int getSocketError(int sockfd)
     {
         int optval;
@@ -62,4 +132,37 @@ namespace sockets_ops
         return peeraddr;
     }
 
-}
\ No newline at end of file
+    bool readZeroCopyCompletion(int sockfd, uint32_t *lo, uint32_t *hi)
+    {
+        char control[128] = {0};
+        struct msghdr msg;
+        ::bzero(&msg, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        while (::recvmsg(sockfd, &msg, MSG_ERRQUEUE) >= 0)
+        {
+            for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+            {
+                bool isRecvErr = (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                                 (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+                if (!isRecvErr)
+                {
+                    continue;
+                }
+                const struct sock_extended_err *serr = reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cm));
+                if (serr->ee_errno == 0 && serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY)
+                {
+                    // ee_code 为 SO_EE_CODE_ZEROCOPY_COPIED 说明内核最后还是拷贝了数据(比如 loopback), 同样可以释放,
+                    *lo = serr->ee_info;
+                    *hi = serr->ee_data;
+                    return true;
+                }
+            }
+            // 不是 zerocopy 的通知, 继续读下一条,
+            msg.msg_controllen = sizeof(control);
+        }
+        return false;
+    }
+
+}
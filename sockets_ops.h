@@ -1,14 +1,61 @@
 #pragma once
 
 #include <netinet/in.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <vector>
+
+// 老版本的 glibc 头文件里面没有 zerocopy 相关的定义, 值和内核保持一致,
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49
+#endif
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
 
 namespace sockets_ops
 {
     void setNonBlockAndCloseOnExec(int sockfd);
 
+    // 创建非阻塞、close-on-exec 的 TCP socket, 失败直接 LOG_FATAL,
+    int createNonblockingOrDie();
+
+    // 非阻塞 connect(), 成功返回 0, 失败返回 -1, errno 是 connect() 的错误码 (一般是 EINPROGRESS),
+    int connect(int sockfd, const struct sockaddr_in &addr);
+
+    /**
+     * 自连接: 连接本机的端口, 而这个端口正好没有监听, 内核分配的临时端口又恰好是目标端口,
+     * TCP 的同时打开会让连接自己和自己建立成功, 这种连接要关掉重连,
+     */
+    bool isSelfConnect(int sockfd);
+
+    // SO_INCOMING_CPU, 处理这个连接收到的数据包的 CPU (网卡队列中断所在的 CPU), 不知道的时候返回 -1,
+    int getIncomingCpu(int sockfd);
+
+    /**
+     * 给 SO_REUSEPORT 的 listen socket 组挂一个 classic BPF 程序, 按照处理 SYN 的 CPU 选择 socket,
+     * socketCpus[i] 是组里面第 i 个 socket (按照 listen() 的顺序) 所在 loop 绑定的 CPU,
+     * 处理 SYN 的 CPU 等于 socketCpus[i] 就选择第 i 个 socket, 都不相等的时候选择 cpu % socketCpus.size(),
+     * 挂在组里面任意一个 socket 上都对整个组生效,
+     */
+    bool attachReusePortCpuFilter(int sockfd, const std::vector<int> &socketCpus);
+
     int getSocketError(int sockfd);
 
     struct sockaddr_in getLocalAddr(int sockfd);
 
     struct sockaddr_in getPeerAddr(int sockfd);
+
+    /**
+     * 从 socket 的错误队列 (MSG_ERRQUEUE) 里面读一条 MSG_ZEROCOPY 的完成通知,
+     * 读到了返回 true, [lo, hi] 是内核已经不再引用的 send() 调用的序号区间,
+     * 错误队列空了返回 false,
+     */
+    bool readZeroCopyCompletion(int sockfd, uint32_t *lo, uint32_t *hi);
 }
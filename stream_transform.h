@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "noncopyable.h"
+
+class Buffer;
+
+/**
+ * TcpConnection 收发路径上的变换 (压缩、加密之类), 用 TcpConnection::setTransform() 设置, 两端必须用同样的变换,
+ * 发: 每次 send() 的数据调用一次 encode(), 编码结果直接写到发送缓冲区的可写区域,
+ * 收: socket 读到的数据放在一个单独的 Buffer 里面, decode() 取走完整的编码单元, 解码结果追加到 inputBuffer_,
+ * 两个函数都只在连接的 loop 线程里面调用, 有状态的实现每个连接用一个对象,
+ */
+class StreamTransform : noncopyable
+{
+public:
+    virtual ~StreamTransform() = default;
+
+    // 把 data[0, len) 编码以后追加到 output,
+    virtual void encode(const char *data, size_t len, Buffer *output) = 0;
+
+    // 从 input 里面取走完整的编码单元, 解码以后追加到 output, 不完整的留在 input 里面, 数据有错返回 false,
+    // output 的可读字节达到 maxOutput 以后不再解码, 剩下的编码单元也留在 input 里面, 流式接收用它限制解码以后的积压,
+    virtual bool decode(Buffer *input, Buffer *output, size_t maxOutput) = 0;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+
+/**
+ * 指向一段不属于自己的字符数据, 不拷贝, 不负责释放,
+ * 解析协议的时候用它指向 Buffer 里面的数据, 只在 Buffer 下一次被修改之前有效,
+ */
+class StringPiece
+{
+public:
+    StringPiece() : data_(nullptr), size_(0) {}
+    StringPiece(const char *data, size_t size) : data_(data), size_(size) {}
+    StringPiece(const char *str) : data_(str), size_(::strlen(str)) {}
+    StringPiece(const std::string &str) : data_(str.data()), size_(str.size()) {}
+
+public:
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return 0 == size_; }
+    const char *begin() const { return data_; }
+    const char *end() const { return data_ + size_; }
+    char operator[](size_t i) const { return data_[i]; }
+
+    std::string asString() const { return std::string(data_, size_); }
+
+    bool operator==(const StringPiece &rhs) const
+    {
+        return size_ == rhs.size_ && 0 == ::memcmp(data_, rhs.data_, size_);
+    }
+    bool operator!=(const StringPiece &rhs) const { return !(*this == rhs); }
+
+    // 忽略大小写比较, HTTP 的头部名字不区分大小写,
+    bool equalsIgnoreCase(const StringPiece &rhs) const
+    {
+        return size_ == rhs.size_ && 0 == ::strncasecmp(data_, rhs.data_, size_);
+    }
+
+private:
+    const char *data_;
+    size_t size_;
+};
@@ -0,0 +1,132 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "tcp_client.h"
+
+#include "connector.h"
+#include "event_loop.h"
+#include "logger.h"
+#include "sockets_ops.h"
+#include "tcp_connection.h"
+
+static EventLoop *CheckLoopNotNull(EventLoop *loop)
+{
+    if (nullptr == loop)
+    {
+        LOG_FATAL("%s:%s:%d loop is nullptr! \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    return loop;
+}
+
+TcpClient::TcpClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg)
+    : loop_(CheckLoopNotNull(loop)),
+      connector_(new Connector(loop, serverAddr)),
+      name_(nameArg),
+      connectionCallback_(defaultConnectionCallback),
+      messageCallback_(defaultMessageCallback),
+      retry_(false),
+      connect_(true),
+      nextConnId_(1)
+{
+    connector_->setNewConnectionCallback([this](int sockfd) { newConnection(sockfd); });
+    LOG_INFO("TcpClient::TcpClient[%s] - connector %p \n", name_.c_str(), connector_.get());
+}
+
+TcpClient::~TcpClient()
+{
+    LOG_INFO("TcpClient::~TcpClient[%s] - connector %p \n", name_.c_str(), connector_.get());
+    TcpConnectionPtr conn;
+    bool unique = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        unique = connection_.unique();
+        conn = connection_;
+    }
+
+    if (conn)
+    {
+        assert(loop_ == conn->getLoop());
+        // 连接还在, 关闭回调换成不访问 TcpClient 的版本, 连接关闭以后直接 connectDestroyed(),
+        EventLoop *loop = loop_;
+        CloseCallback cb = [loop](const TcpConnectionPtr &c)
+        {
+            loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, c));
+        };
+        loop_->runInLoop([conn, cb]() { conn->setCloseCallback(cb); });
+        // 没有别人持有这个连接了, 直接关闭,
+        if (unique)
+        {
+            conn->forceClose();
+        }
+    }
+    else
+    {
+        connector_->stop();
+    }
+}
+
+void TcpClient::connect()
+{
+    LOG_INFO("TcpClient::connect[%s] - connecting to %s \n", name_.c_str(),
+             connector_->serverAddress().toIpPort().c_str());
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+    connect_ = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (connection_)
+    {
+        connection_->shutdown();
+    }
+}
+
+void TcpClient::stop()
+{
+    connect_ = false;
+    connector_->stop();
+}
+
+void TcpClient::newConnection(int sockfd)
+{
+    loop_->assertInLoopThread();
+    InetAddress peerAddr(sockets_ops::getPeerAddr(sockfd));
+    char buf[64] = {0};
+    snprintf(buf, sizeof(buf), ":%s#%d", peerAddr.toIpPort().c_str(), nextConnId_);
+    ++nextConnId_;
+    std::string connName = name_ + buf;
+
+    InetAddress localAddr(sockets_ops::getLocalAddr(sockfd));
+    TcpConnectionPtr conn(new TcpConnection(loop_, connName, sockfd, localAddr, peerAddr));
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setCloseCallback([this](const TcpConnectionPtr &c) { removeConnection(c); });
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr &conn)
+{
+    loop_->assertInLoopThread();
+    assert(loop_ == conn->getLoop());
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        assert(connection_ == conn);
+        connection_.reset();
+    }
+
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    if (retry_ && connect_)
+    {
+        LOG_INFO("TcpClient::removeConnection[%s] - Reconnecting to %s \n", name_.c_str(),
+                 connector_->serverAddress().toIpPort().c_str());
+        connector_->restart();
+    }
+}
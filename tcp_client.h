@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "callbacks.h"
+#include "inet_address.h"
+#include "noncopyable.h"
+
+class Connector;
+class EventLoop;
+
+using ConnectorPtr = std::shared_ptr<Connector>;
+
+/**
+ * 客户端, 和 TcpServer 对应, 用 Connector 在 loop 上非阻塞地连接服务器,
+ * 连接成功以后和 TcpServer 一样创建 TcpConnection, 设置用户的 ConnectionCallback/MessageCallback/WriteCompleteCallback,
+ * 一个 TcpClient 同一时间只有一个连接, 连接和所有的回调都在 loop 线程里面,
+ * enableRetry() 以后连接断开会自动重新连接,
+ *
+ * TcpClient 析构的时候连接还在的话, 连接继续由 TcpConnectionPtr 的持有者管理, 关闭回调不再访问 TcpClient,
+ */
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg);
+    ~TcpClient();
+
+public:
+    // 开始连接, 失败以后 Connector 会按照指数退避一直重试, 可以在任意线程调用,
+    void connect();
+    // 关闭写端, 等待发送缓冲区里面的数据发送完以后断开,
+    void disconnect();
+    // 停止连接, 还没有连上的话取消重试,
+    void stop();
+
+    TcpConnectionPtr connection() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop *getLoop() const { return loop_; }
+    bool retry() const { return retry_; }
+    // 连接断开以后自动重新连接,
+    void enableRetry() { retry_ = true; }
+
+    const std::string &name() const { return name_; }
+
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+
+private:
+    // Connector 连接成功以后的回调, 在 loop 线程里面, 封装 TcpConnection,
+    void newConnection(int sockfd);
+    // 连接关闭的回调, 在 loop 线程里面,
+    void removeConnection(const TcpConnectionPtr &conn);
+
+private:
+    EventLoop *loop_;
+    ConnectorPtr connector_;
+    const std::string name_;
+
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+
+    std::atomic_bool retry_;
+    std::atomic_bool connect_;
+    int nextConnId_; // 只在 loop 线程里面使用,
+
+    mutable std::mutex mutex_; // 保护 connection_, connection() 可以在任意线程调用,
+    TcpConnectionPtr connection_;
+};
@@ -1,5 +1,10 @@
 #include <errno.h>
 #include <functional>
+#include <fcntl.h>
+#include <limits.h>
+#include <limits>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "tcp_connection.h"
@@ -7,9 +12,12 @@
 #include "channel.h"
 #include "event_loop.h"
 #include "logger.h"
+#include "memory_account.h"
 #include "socket.h"
 #include "sockets_ops.h"
+#include "stream_transform.h"
 #include "string.h"
+#include "tcp_relay.h"
 
 void defaultConnectionCallback(const TcpConnectionPtr &conn)
 {
@@ -31,29 +39,71 @@ static EventLoop *CheckLoopNotNull(EventLoop *loop)
 
 TcpConnection::TcpConnection(EventLoop *loop, const std::string &nameArg, int sockfd,
                              const InetAddress &localAddr, const InetAddress &peerAddr)
+    : TcpConnection(loop, 0, nullptr, sockfd, localAddr, peerAddr)
+{
+    name_ = nameArg;
+}
+
+TcpConnection::TcpConnection(EventLoop *loop, uint64_t id, const std::shared_ptr<const std::string> &namePrefix,
+                             int sockfd, const InetAddress &localAddr, const InetAddress &peerAddr)
     : loop_(CheckLoopNotNull(loop)),
-      name_(nameArg),
+      id_(id),
+      namePrefix_(namePrefix),
       state_(kConnecting),
       reading_(true),
-      socket_(new Socket(sockfd)),
-      channel_(new Channel(loop, sockfd)),
+      readPausedByOutput_(false),
+      readPausedBySink_(false),
+      readPausedByRelay_(false),
+      socket_(sockfd),
+      channel_(loop, sockfd),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64 * 1024 * 1024)
+      highWaterMark_(64 * 1024 * 1024),
+      readPauseHighMark_(0),
+      readPauseLowMark_(0),
+      queuedBytes_(0),
+      queuedFileBytes_(0),
+      zeroCopyThreshold_(0),
+      nextZeroCopyId_(0),
+      zeroCopyBlocked_(false),
+      memoryAccount_(nullptr),
+      memoryLimit_(0),
+      accountedInput_(0),
+      accountedOutput_(0),
+      outputPendingSince_(0),
+      bodyWindow_(kDefaultBodyWindow),
+      bodySinkVersion_(0),
+      dispatchingInput_(false)
 {
     // 下面给 channel 设置相应的回调函数, Poller 给 channel 通知感兴趣的事件发生了, channel 会回调相应的操作函数,
-    channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
-    channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
-    LOG_INFO("TcpConnection::ctor[ %s ] at fd=%d \n", name_.c_str(), sockfd);
-    socket_->setKeepAlive(true);
+    // 只捕获 this 的 lambda 可以放进 std::function 内部的小对象缓冲区, std::bind 的结果放不下, 每个回调都要多分配一次,
+    channel_.setReadCallback([this](Timestamp receiveTime) { handleRead(receiveTime); });
+    channel_.setWriteCallback([this]() { handleWrite(); });
+    channel_.setCloseCallback([this]() { handleClose(); });
+    channel_.setErrorCallback([this]() { handleError(); });
+    LOG_INFO("TcpConnection::ctor[ #%lu ] at fd=%d \n", id_, sockfd);
+    socket_.setKeepAlive(true);
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_INFO("TcpConnection::dtor[%s] at fd=%d, state=%s \n", name_.c_str(), channel_->fd(), stateToString());
+    LOG_INFO("TcpConnection::dtor[ #%lu ] at fd=%d, state=%s \n", id_, channel_.fd(), stateToString());
     assert(state_ == kDisconnected);
+    while (!outputQueue_.empty())
+    {
+        popOutputSegment();
+    }
+}
+
+const std::string &TcpConnection::name() const
+{
+    if (namePrefix_)
+    {
+        // 只拼接一次, 其他线程同时调用 name() 的时候也是安全的,
+        std::call_once(nameOnce_, [this]()
+                       { name_ = *namePrefix_ + std::to_string(id_); });
+    }
+    return name_;
 }
 
 void TcpConnection::send(const std::string &message)
@@ -66,11 +116,122 @@ void TcpConnection::send(const std::string &message)
         }
         else
         {
-            loop_->runInLoop(std::bind(&TcpConnection::sendInLoop, this, message.c_str(), message.size()));
+            // 跨线程发送的时候 message 可能在 loop 执行之前就析构了, 所以这里拷贝一份,
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, this, message));
+        }
+    }
+}
+
+void TcpConnection::send(Buffer *buf)
+{
+    if (kConnected == state_)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, this, buf->retrieveAllAsString()));
         }
     }
 }
 
+void TcpConnection::send(const struct iovec *iov, int iovcnt)
+{
+    if (kConnected == state_)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendvInLoop(iov, iovcnt);
+        }
+        else
+        {
+            // 不在 loop 线程, 各段数据的生命周期没法保证, 拼成一个 string 再交给 loop,
+            std::string message;
+            for (int i = 0; i < iovcnt; ++i)
+            {
+                message.append(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+            }
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, this, std::move(message)));
+        }
+    }
+}
+
+void TcpConnection::send(const PayloadPtr &payload)
+{
+    if (kConnected == state_ && payload)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendPayloadInLoop(payload);
+        }
+        else
+        {
+            // bind 持有 payload 的引用计数, 跨线程发送也不需要拷贝数据,
+            loop_->runInLoop(std::bind(&TcpConnection::sendPayloadInLoop, this, payload));
+        }
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length)
+{
+    if (kConnected == state_ && length > 0)
+    {
+        // dup() 一份, 文件段在发送队列里面排队的时候不依赖调用者的 fd,
+        int fileFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (fileFd < 0)
+        {
+            LOG_ERROR("TcpConnection::sendFile dup fd = %d error:%d \n", fd, errno);
+            return;
+        }
+        if (loop_->isInLoopThread())
+        {
+            sendFileInLoop(fileFd, offset, length);
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(&TcpConnection::sendFileInLoop, this, fileFd, offset, length));
+        }
+    }
+}
+
+int TcpConnection::incomingCpu() const
+{
+    return sockets_ops::getIncomingCpu(socket_.fd());
+}
+
+bool TcpConnection::setZeroCopy(bool on, size_t threshold)
+{
+    loop_->assertInLoopThread();
+    if (on)
+    {
+        if (!socket_.setZeroCopy(true))
+        {
+            LOG_ERROR("TcpConnection::setZeroCopy [%s] SO_ZEROCOPY not supported \n", name().c_str());
+            return false;
+        }
+        zeroCopyThreshold_ = threshold > 0 ? threshold : 1;
+    }
+    else
+    {
+        // 已经在途的 payload 仍然等完成通知再释放,
+        zeroCopyThreshold_ = 0;
+    }
+    return true;
+}
+
+void TcpConnection::setTransform(const std::shared_ptr<StreamTransform> &transform)
+{
+    loop_->assertInLoopThread();
+    transform_ = transform;
+    if (transform_ && !transformInput_)
+    {
+        transformInput_.reset(new Buffer());
+    }
+}
+
 void TcpConnection::shutdown()
 {
     if (kConnected == state_)
@@ -80,13 +241,283 @@ void TcpConnection::shutdown()
     }
 }
 
+void TcpConnection::forceClose()
+{
+    if (kConnected == state_ || kDisconnecting == state_)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, this->shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    loop_->assertInLoopThread();
+    if (kConnected == state_ || kDisconnecting == state_)
+    {
+        handleClose();
+    }
+}
+
+void TcpConnection::updateMemoryAccount()
+{
+    size_t pending = outputBytes();
+    size_t input = inputBuffer_.readableBytes() + (transformInput_ ? transformInput_->readableBytes() : 0);
+    size_t output = pending - queuedFileBytes_;
+
+    if (pending > 0 && 0 == outputPendingSince_)
+    {
+        outputPendingSince_ = Timestamp::now().microSecondsSinceEpoch();
+    }
+    else if (0 == pending)
+    {
+        outputPendingSince_ = 0;
+    }
+
+    int64_t inputDelta = static_cast<int64_t>(input) - static_cast<int64_t>(accountedInput_);
+    int64_t outputDelta = static_cast<int64_t>(output) - static_cast<int64_t>(accountedOutput_);
+    accountedInput_ = input;
+    accountedOutput_ = output;
+    if (memoryAccount_ && (inputDelta != 0 || outputDelta != 0))
+    {
+        memoryAccount_->add(inputDelta, outputDelta);
+    }
+
+    if (memoryLimit_ > 0 && input + output > memoryLimit_ && kConnected == state_)
+    {
+        LOG_WARNNING("TcpConnection [%s] holds %lu bytes, exceeds limit %lu, force close \n",
+                     name().c_str(), input + output, memoryLimit_);
+        forceClose();
+    }
+}
+
+void TcpConnection::releaseMemoryAccount()
+{
+    if (memoryAccount_ && (accountedInput_ > 0 || accountedOutput_ > 0))
+    {
+        memoryAccount_->add(-static_cast<int64_t>(accountedInput_), -static_cast<int64_t>(accountedOutput_));
+    }
+    accountedInput_ = 0;
+    accountedOutput_ = 0;
+    outputPendingSince_ = 0;
+}
+
+void TcpConnection::startRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, this));
+}
+
+void TcpConnection::stopRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, this));
+}
+
+void TcpConnection::startReadInLoop()
+{
+    loop_->assertInLoopThread();
+    reading_ = true;
+    updateReading();
+}
+
+void TcpConnection::stopReadInLoop()
+{
+    loop_->assertInLoopThread();
+    reading_ = false;
+    updateReading();
+}
+
+void TcpConnection::setBodySink(const BodySink &sink, size_t window)
+{
+    loop_->assertInLoopThread();
+    bodySink_ = sink;
+    bodyWindow_ = window > 0 ? window : kDefaultBodyWindow;
+    ++bodySinkVersion_;
+    // 在回调里面设置的时候, 剩下的数据由外面的 dispatchInput() 交给 sink, 否则这里马上交给它,
+    if (inputBuffer_.readableBytes() > 0 && !dispatchingInput_)
+    {
+        dispatchInput(Timestamp::now());
+        updateMemoryAccount();
+    }
+    updateBodyPause();
+}
+
+void TcpConnection::clearBodySink()
+{
+    loop_->assertInLoopThread();
+    bodySink_ = BodySink();
+    ++bodySinkVersion_;
+    updateBodyPause();
+}
+
+void TcpConnection::resumeBody()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::resumeBodyInLoop, shared_from_this()));
+}
+
+void TcpConnection::resumeBodyInLoop()
+{
+    loop_->assertInLoopThread();
+    if (bodySink_ && kConnected == state_)
+    {
+        Timestamp now = Timestamp::now();
+        dispatchInput(now);
+        // inputBuffer_ 取空了, 还没解码的编码单元接着交给 sink, 对端可能已经发完了, 不能等下一次可读事件,
+        if (transform_ && bodySink_ && 0 == inputBuffer_.readableBytes() && !decodeAndDispatch(now))
+        {
+            return;
+        }
+        updateMemoryAccount();
+    }
+}
+
+bool TcpConnection::decodeAndDispatch(Timestamp receiveTime)
+{
+    for (;;)
+    {
+        // 流式接收的时候最多解码到 bodyWindow_, 压缩过的数据解出来会变大很多, 不限制的话窗口就没有意义了,
+        size_t maxOutput = bodySink_ ? bodyWindow_ : std::numeric_limits<size_t>::max();
+        size_t decoded = inputBuffer_.readableBytes();
+        if (!transform_->decode(transformInput_.get(), &inputBuffer_, maxOutput))
+        {
+            LOG_ERROR("TcpConnection::decodeAndDispatch [%s] transform decode error, force close \n", name().c_str());
+            forceCloseInLoop();
+            return false;
+        }
+        if (inputBuffer_.readableBytes() == decoded)
+        {
+            // 还没有收齐一个编码单元, 或者积压已经达到窗口, 不回调,
+            return true;
+        }
+        dispatchInput(receiveTime);
+        // sink 把解出来的数据都消费掉了, transformInput_ 里面可能还有没解码的编码单元,
+        if (!bodySink_ || inputBuffer_.readableBytes() > 0 || (kConnected != state_ && kDisconnecting != state_))
+        {
+            return true;
+        }
+    }
+}
+
+void TcpConnection::dispatchInput(Timestamp receiveTime)
+{
+    TcpConnectionPtr guard(shared_from_this());
+    dispatchingInput_ = true;
+    while (kConnected == state_ || kDisconnecting == state_)
+    {
+        if (bodySink_)
+        {
+            // sink 清除了自己, 剩下的数据交回 messageCallback_,
+            if (!deliverBody())
+            {
+                break;
+            }
+        }
+        else
+        {
+            uint64_t version = bodySinkVersion_;
+            messageCallback_(guard, &inputBuffer_, receiveTime);
+            // messageCallback_ 里面设置了 sink, 剩下的数据交给 sink,
+            if (version == bodySinkVersion_ || !bodySink_ || 0 == inputBuffer_.readableBytes())
+            {
+                break;
+            }
+        }
+    }
+    dispatchingInput_ = false;
+    updateBodyPause();
+}
+
+bool TcpConnection::deliverBody()
+{
+    TcpConnectionPtr guard(shared_from_this());
+    while (bodySink_ && inputBuffer_.readableBytes() > 0)
+    {
+        // 回调里面可能换掉或者清除 bodySink_, 调用的时候先移到局部变量里面, 没有换掉的话再移回去,
+        BodySink sink;
+        sink.swap(bodySink_);
+        uint64_t version = bodySinkVersion_;
+        size_t readable = inputBuffer_.readableBytes();
+        size_t consumed = sink(guard, inputBuffer_.peek(), readable);
+        if (version == bodySinkVersion_)
+        {
+            bodySink_.swap(sink);
+        }
+        // 消费掉的空间马上回收, 全部消费完的时候 retrieve() 把读写位置都重置到开头,
+        inputBuffer_.retrieve(std::min(consumed, readable));
+        if (consumed < readable && version == bodySinkVersion_)
+        {
+            // 背压, 等 resumeBody(),
+            return false;
+        }
+    }
+    return !bodySink_ && inputBuffer_.readableBytes() > 0;
+}
+
+void TcpConnection::updateBodyPause()
+{
+    bool pause = bodySink_ && inputBuffer_.readableBytes() >= bodyWindow_;
+    if (pause != readPausedBySink_)
+    {
+        readPausedBySink_ = pause;
+        updateReading();
+    }
+}
+
+void TcpConnection::updateReading()
+{
+    // 连接还没建立或者已经关闭的时候不用管,
+    if (kConnected != state_ && kDisconnecting != state_)
+    {
+        return;
+    }
+    bool wantRead = reading_ && !readPausedByOutput_ && !readPausedBySink_ && !readPausedByRelay_;
+    if (wantRead && !channel_.isReading())
+    {
+        channel_.enableReading();
+    }
+    else if (!wantRead && channel_.isReading())
+    {
+        channel_.disableReading();
+    }
+}
+
+void TcpConnection::setReadPausedByRelay(bool paused)
+{
+    if (paused != readPausedByRelay_)
+    {
+        readPausedByRelay_ = paused;
+        updateReading();
+    }
+}
+
+void TcpConnection::checkReadPause()
+{
+    if (0 == readPauseHighMark_)
+    {
+        return;
+    }
+    size_t pending = outputBytes();
+    if (!readPausedByOutput_ && pending >= readPauseHighMark_)
+    {
+        readPausedByOutput_ = true;
+        updateReading();
+    }
+    else if (readPausedByOutput_ && pending <= readPauseLowMark_)
+    {
+        readPausedByOutput_ = false;
+        updateReading();
+    }
+}
+
 void TcpConnection::connectEstablished()
 {
     loop_->assertInLoopThread();
     assert(state_ == kConnecting);
     setState(kConnected);
-    channel_->tie(this->shared_from_this());
-    channel_->enableReading(); // 向 Poller 注册 channel 的 EPOLL_IN 事件,
+    channel_.tie(this->shared_from_this());
+    if (reading_)
+    {
+        channel_.enableReading(); // 向 Poller 注册 channel 的 EPOLL_IN 事件,
+    }
 
     // 新连接建立, 执行回调,
     connectionCallback_(this->shared_from_this());
@@ -98,24 +529,73 @@ void TcpConnection::connectDestroyed()
     if (state_ == kConnected)
     {
         setState(kDisconnected);
-        channel_->disableAll(); // 把 channel 的所有感兴趣的事件, 从 Poller 中 delete 掉,
+        channel_.disableAll(); // 把 channel 的所有感兴趣的事件, 从 Poller 中 delete 掉,
 
         connectionCallback_(this->shared_from_this());
     }
-    channel_->remove(); // 把 channel 从 Poller 中删除掉,
+    if (relay_)
+    {
+        // detach() 会把两端的 relay_ 都清掉, 局部变量保证调用期间 TcpRelay 还活着,
+        std::shared_ptr<TcpRelay> relay(relay_);
+        relay->detach();
+    }
+    releaseMemoryAccount();
+    channel_.remove(); // 把 channel 从 Poller 中删除掉,
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
     loop_->assertInLoopThread();
+    if (relay_)
+    {
+        // 转发模式, 数据直接 splice 到对端, 不读到 inputBuffer_,
+        // TcpRelay 可能在自己的函数里面 detach(), 清掉 relay_, 局部变量保证调用期间它还活着, 下同,
+        std::shared_ptr<TcpRelay> relay(relay_);
+        relay->handleRead(this);
+        return;
+    }
     int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    ssize_t n = 0;
+    // 有变换的时候 socket 上的数据先读到 transformInput_, 解码以后才进 inputBuffer_,
+    Buffer *readBuffer = transform_ ? transformInput_.get() : &inputBuffer_;
+    if (bodySink_)
+    {
+        // 流式接收, 只读到积压达到 bodyWindow_ 为止, 不用 64K 的 extrabuf, 这样积压不会超过窗口,
+        // 有变换的时候积压包括 readBuffer 里面还没解码的字节, 不然窗口限制不住真正读进来的数据,
+        size_t decoded = inputBuffer_.readableBytes();
+        if (decoded >= bodyWindow_)
+        {
+            updateBodyPause();
+            return;
+        }
+        size_t buffered = decoded + (readBuffer != &inputBuffer_ ? readBuffer->readableBytes() : 0);
+        // 没解码的字节占满了窗口, 说明一个编码单元比窗口还大, 只能接着读, 不然永远解不出来,
+        // 这时候的积压由变换的最大编码单元限制 (Lz4Transform 是 64K 多一点),
+        size_t window = buffered < bodyWindow_ ? bodyWindow_ - buffered : bodyWindow_ - decoded;
+        n = readBuffer->readFd(channel_.fd(), &savedErrno, window);
+    }
+    else
+    {
+        n = readBuffer->readFd(channel_.fd(), &savedErrno);
+    }
     if (n > 0)
     {
-        // 已建立连接的用户, 有可读事件发生, 调用用户传入的回调操作 onMessage(),
-        messageCallback_(this->shared_from_this(), &inputBuffer_, receiveTime);
+        // 已建立连接的用户, 有可读事件发生, 调用用户传入的回调操作 onMessage() 或者 bodySink_,
+        if (readBuffer != &inputBuffer_)
+        {
+            if (!decodeAndDispatch(receiveTime))
+            {
+                return;
+            }
+        }
+        else
+        {
+            dispatchInput(receiveTime);
+        }
+        // 应用没有取走的数据留在 inputBuffer_ 里面, 计入内存统计,
+        updateMemoryAccount();
     }
-    else if (0 == 0)
+    else if (0 == n)
     {
         // 客户端断开连接,
         handleClose();
@@ -132,17 +612,26 @@ void TcpConnection::handleRead(Timestamp receiveTime)
 void TcpConnection::handleWrite()
 {
     loop_->assertInLoopThread();
-    if (channel_->isWriting())
+    if (channel_.isWriting())
     {
+        if (relay_ && outputBytes() == 0)
+        {
+            // 发送队列是空的, EPOLLOUT 是 TcpRelay 注册的, 把管道里面的数据 splice 出去,
+            std::shared_ptr<TcpRelay> relay(relay_);
+            relay->handleWrite(this);
+            return;
+        }
         int savedErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
-        if (n > 0)
+        ssize_t n = writeOutput(&savedErrno);
+        if (n >= 0)
         {
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0)
+            retrieveOutput(n);
+            checkReadPause();
+            updateMemoryAccount();
+            if (outputBytes() == 0)
             {
                 // 发送完成了,
-                channel_->disableWriting();
+                channel_.disableWriting();
                 if (writeCompleteCallback_)
                 {
                     loop_->queueInLoop(std::bind(writeCompleteCallback_, this->shared_from_this()));
@@ -151,26 +640,42 @@ void TcpConnection::handleWrite()
                 {
                     shutdownInLoop();
                 }
+                if (relay_)
+                {
+                    // 发送队列发完了, 轮到管道里面等着的转发数据,
+                    std::shared_ptr<TcpRelay> relay(relay_);
+                    relay->handleWrite(this);
+                }
             }
         }
-        else
+        else if (EWOULDBLOCK != savedErrno && EINTR != savedErrno)
         {
-            LOG_ERROR("TcpConnection::handleWrite");
+            // 写出错了, EPOLLOUT 是水平触发的, 不处理的话每次 poll() 都会回到这里,
+            char t_errnobuf[512] = {0};
+            LOG_ERROR("TcpConnection::handleWrite name : %s - errno = %d, errString : %s \n", name().c_str(),
+                      savedErrno, ::strerror_r(savedErrno, t_errnobuf, sizeof(t_errnobuf)));
+            forceCloseInLoop();
         }
     }
     else
     {
-        LOG_ERROR("TcpConnection fd = %d is down, no more writing !\n", channel_->fd());
+        LOG_ERROR("TcpConnection fd = %d is down, no more writing !\n", channel_.fd());
     }
 }
 
 void TcpConnection::handleClose()
 {
     loop_->assertInLoopThread();
-    LOG_INFO("TcpConnection::handleClose fd = %d, state = %s", channel_->fd(), stateToString());
+    LOG_INFO("TcpConnection::handleClose fd = %d, state = %s", channel_.fd(), stateToString());
     assert(state_ == kConnected || state_ == kDisconnecting);
     setState(kDisconnected);
-    channel_->disableAll();
+    channel_.disableAll();
+    if (relay_)
+    {
+        std::shared_ptr<TcpRelay> relay(relay_);
+        relay->handleClose(this);
+    }
+    releaseMemoryAccount();
 
     TcpConnectionPtr connPtr(this->shared_from_this());
     connectionCallback_(connPtr); // 用户给的 ConnectionCallback 在连接成功和连接关闭都会执行到,
@@ -183,17 +688,44 @@ void TcpConnection::handleClose()
 
 void TcpConnection::handleError()
 {
-    int err = sockets_ops::getSocketError(channel_->fd());
+    // 打开 zerocopy 以后, 内核的完成通知也是通过错误队列以 EPOLLERR 上报的,
+    // setZeroCopy(false) 以后还在途的 payload 也一样, 所以按有没有在途的 payload 判断, 不看 zeroCopyThreshold_,
+    bool zeroCopyPending = !zeroCopyInflight_.empty();
+    if (zeroCopyPending)
+    {
+        handleZeroCopyCompletions();
+    }
+    int err = sockets_ops::getSocketError(channel_.fd());
+    if (0 == err && zeroCopyPending)
+    {
+        return;
+    }
     char t_errnobuf[512] = {0};
     LOG_ERROR("TcpConnection::handleError name : %s - SO_ERROR = %d, errString : %s \n",
-              name_.c_str(), err, ::strerror_r(err, t_errnobuf, sizeof(t_errnobuf)));
+              name().c_str(), err, ::strerror_r(err, t_errnobuf, sizeof(t_errnobuf)));
 }
 
 void TcpConnection::sendInLoop(const void *data, size_t len)
+{
+    struct iovec vec;
+    vec.iov_base = const_cast<void *>(data);
+    vec.iov_len = len;
+    sendvInLoop(&vec, 1);
+}
+
+void TcpConnection::sendStringInLoop(const std::string &message)
+{
+    sendInLoop(message.data(), message.size());
+}
+
+void TcpConnection::sendvInLoop(const struct iovec *iov, int iovcnt)
 {
     loop_->assertInLoopThread();
-    ssize_t nwrote = 0;
-    size_t remaining = len;  // 还没发送完的数据,
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        len += iov[i].iov_len;
+    }
     bool faultError = false; // 是否产生错误,
 
     // 之前调用过该 connection 的 shotdown(), 不能再进行发送了,
@@ -202,15 +734,239 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
         LOG_ERROR("disconnected, give up writing");
         return;
     }
+    if (transform_)
+    {
+        sendTransformedInLoop(iov, iovcnt);
+        return;
+    }
+
+    size_t nwrote = writeDirectly(iov, iovcnt, len, &faultError);
+    size_t remaining = len - nwrote; // 还没发送完的数据,
 
+    /**
+     * 走到这里说明上面的一次 writev() 并没有把数据全部发送出去, 剩余的数据需要保存到缓冲区当中,
+     * 然后给 Channel 注册 EPOLLOUT 事件,
+     * Poller 是 EPOLL_LT 模式, 如果TCP发送缓冲区空余, Poller 会不断给上层上报相应的 fd 的 EPOLLOUT 事件的,
+     * Poller 发现 TCP的发送缓冲区有空间, 会通知相应的 sock-channel, 调用相应的 handleWrite() 回调方法,
+     * 也就是调用 TcpConnection::handleWrite() 方法把发送缓冲区中的数据全部发送完成,
+     */
+    if (!faultError && remaining > 0)
+    {
+        checkHighWaterMark(remaining);
+        // 跳过已经写出去的 nwrote 个字节, 剩下的每一段都拷贝到发送队列的末尾,
+        for (int i = 0; i < iovcnt; ++i)
+        {
+            const char *base = static_cast<const char *>(iov[i].iov_base);
+            size_t segLen = iov[i].iov_len;
+            if (nwrote >= segLen)
+            {
+                nwrote -= segLen;
+                continue;
+            }
+            appendOutput(base + nwrote, segLen - nwrote);
+            nwrote = 0;
+        }
+        if (!channel_.isWriting())
+        {
+            channel_.enableWriting(); // 这里一定要注册 channel 的写事件, 否则 Poller 不会给 channel 通知 EPOLL_OUT,
+        }
+        // 发送队列太长了, 停止读对端的请求,
+        checkReadPause();
+        updateMemoryAccount();
+    }
+}
+
+void TcpConnection::sendPayloadInLoop(const PayloadPtr &payload)
+{
+    loop_->assertInLoopThread();
+    if (transform_)
+    {
+        // 编码结果是这个连接自己的, 走普通的发送路径,
+        sendInLoop(payload->data(), payload->size());
+        return;
+    }
+    bool faultError = false;
+
+    if (kDisconnected == state_)
+    {
+        LOG_ERROR("disconnected, give up writing");
+        return;
+    }
+
+    struct iovec vec;
+    vec.iov_base = const_cast<char *>(payload->data());
+    vec.iov_len = payload->size();
+    size_t nwrote = writeDirectly(&vec, 1, payload->size(), &faultError,
+                                  useZeroCopy(payload->size()) ? payload : PayloadPtr());
+    size_t remaining = payload->size() - nwrote;
+
+    // 没写完的部分只记录 payload 和偏移, 不拷贝到 outputBuffer_,
+    if (!faultError && remaining > 0)
+    {
+        checkHighWaterMark(remaining);
+        OutputSegment segment;
+        segment.kind = OutputSegment::kPayload;
+        segment.payload = payload;
+        segment.offset = nwrote;
+        outputQueue_.push_back(std::move(segment));
+        queuedBytes_ += remaining;
+        if (!channel_.isWriting())
+        {
+            channel_.enableWriting();
+        }
+        checkReadPause();
+        updateMemoryAccount();
+    }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length)
+{
+    loop_->assertInLoopThread();
+    if (kDisconnected == state_)
+    {
+        LOG_ERROR("disconnected, give up writing");
+        ::close(fd);
+        return;
+    }
+    if (transform_)
+    {
+        // sendfile() 的数据不经过用户态, 没法编码,
+        LOG_ERROR("TcpConnection::sendFileInLoop [%s] sendFile() is not supported with a transform \n", name().c_str());
+        ::close(fd);
+        return;
+    }
+
+    size_t nwrote = 0;
+    bool faultError = false;
+    // 没有待发送数据的时候直接 sendfile(), 内核接收不了的部分再排队等 EPOLLOUT,
+    if (!channel_.isWriting() && outputBytes() == 0)
+    {
+        off_t off = offset;
+        ssize_t n = ::sendfile(channel_.fd(), fd, &off, length);
+        if (n >= 0)
+        {
+            nwrote = n;
+            if (nwrote == length && writeCompleteCallback_)
+            {
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, this->shared_from_this()));
+            }
+        }
+        else if (EWOULDBLOCK != errno)
+        {
+            LOG_ERROR("TcpConnection::sendFileInLoop error!");
+            if (EPIPE == errno || ECONNRESET == errno)
+            {
+                faultError = true;
+            }
+        }
+    }
+
+    size_t remaining = length - nwrote;
+    if (faultError || remaining == 0)
+    {
+        ::close(fd);
+        return;
+    }
+
+    checkHighWaterMark(remaining);
+    OutputSegment segment;
+    segment.kind = OutputSegment::kFile;
+    segment.fileFd = fd;
+    segment.fileOffset = offset;
+    segment.fileLength = length;
+    segment.offset = nwrote;
+    outputQueue_.push_back(std::move(segment));
+    queuedBytes_ += remaining;
+    queuedFileBytes_ += remaining;
+    if (!channel_.isWriting())
+    {
+        channel_.enableWriting();
+    }
+    checkReadPause();
+    updateMemoryAccount();
+}
+
+void TcpConnection::sendTransformedInLoop(const struct iovec *iov, int iovcnt)
+{
+    size_t before = outputBytes();
+    bool idle = !channel_.isWriting() && 0 == before;
+    if (outputQueue_.empty())
+    {
+        for (int i = 0; i < iovcnt; ++i)
+        {
+            transform_->encode(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len, &outputBuffer_);
+        }
+    }
+    else
+    {
+        // setTransform() 之前排队的 payload 或者文件段还没发完, 编码结果只能排在它们后面,
+        Buffer encoded;
+        for (int i = 0; i < iovcnt; ++i)
+        {
+            transform_->encode(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len, &encoded);
+        }
+        appendOutput(encoded.peek(), encoded.readableBytes());
+    }
+
+    if (idle)
+    {
+        // 和 writeDirectly() 一样, 之前没有待发送的数据就马上写一次,
+        int savedErrno = 0;
+        ssize_t n = writeOutput(&savedErrno);
+        if (n >= 0)
+        {
+            retrieveOutput(n);
+        }
+        else if (EWOULDBLOCK != savedErrno)
+        {
+            LOG_ERROR("TcpConnection::sendTransformedInLoop error!");
+            if (EPIPE == savedErrno || ECONNRESET == savedErrno)
+            {
+                outputBuffer_.retrieveAll();
+                return;
+            }
+        }
+    }
+
+    size_t pending = outputBytes();
+    if (0 == pending)
+    {
+        if (writeCompleteCallback_)
+        {
+            loop_->queueInLoop(std::bind(writeCompleteCallback_, this->shared_from_this()));
+        }
+        return;
+    }
+    if (before < highWaterMark_ && pending >= highWaterMark_ && highWaterMarkCallback_)
+    {
+        loop_->queueInLoop(std::bind(highWaterMarkCallback_, this->shared_from_this(), pending));
+    }
+    if (!channel_.isWriting())
+    {
+        channel_.enableWriting();
+    }
+    checkReadPause();
+    updateMemoryAccount();
+}
+
+size_t TcpConnection::writeDirectly(const struct iovec *iov, int iovcnt, size_t len, bool *faultError,
+                                    const PayloadPtr &zeroCopyPayload)
+{
+    ssize_t nwrote = 0;
     // 表示 channel 第一次开始写数据, 而且缓冲区没有待发送数据,
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    if (!channel_.isWriting() && outputBytes() == 0)
     {
-        nwrote = ::write(channel_->fd(), data, len);
+        if (zeroCopyPayload)
+        {
+            nwrote = sendZeroCopy(zeroCopyPayload, 0);
+        }
+        else
+        {
+            nwrote = ::writev(channel_.fd(), iov, std::min(iovcnt, IOV_MAX));
+        }
         if (nwrote >= 0)
         {
-            remaining = len - nwrote;
-            if (remaining == 0 && writeCompleteCallback_) // 一次性发送完,
+            if (static_cast<size_t>(nwrote) == len && writeCompleteCallback_) // 一次性发送完,
             {
                 // 既然在这里数据发送完了, 就不用再给 channel 设置写回调 EPOLLOUT 事件了,
                 loop_->queueInLoop(std::bind(writeCompleteCallback_, this->shared_from_this()));
@@ -223,51 +979,205 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
             if (EWOULDBLOCK != errno)
             {
                 // EWOULDBLOCK 由于非阻塞没有数据, 正常的一个返回,
-                LOG_ERROR("TcpConnection::sendInLoop error!");
+                LOG_ERROR("TcpConnection::writeDirectly error!");
 
                 // SIGEPIPE 、 ECONNRESET 接收到对端 sockfd 的重置,
                 if (EPIPE == errno || ECONNRESET == errno)
                 {
-                    faultError = true;
+                    *faultError = true;
                 }
             }
         }
     }
+    return nwrote;
+}
 
-    assert(remaining <= len);
-    /**
-     * 走到这里说明上面的一次 write() 并没有把数据全部发送出去, 剩余的数据需要保存到缓冲区当中,
-     * 然后给 Channel 注册 EPOLLOUT 事件,
-     * Poller 是 EPOLL_LT 模式, 如果TCP发送缓冲区空余, Poller 会不断给上层上报相应的 fd 的 EPOLLOUT 事件的,
-     * Poller 发现 TCP的发送缓冲区有空间, 会通知相应的 sock-channel, 调用相应的 handleWrite() 回调方法,
-     * 也就是调用 TcpConnection::handleWrite() 方法把发送缓冲区中的数据全部发送完成,
-     */
-    if (!faultError && remaining > 0)
+void TcpConnection::appendOutput(const char *data, size_t len)
+{
+    if (outputQueue_.empty())
+    {
+        outputBuffer_.append(data, len);
+    }
+    else if (outputQueue_.back().kind == OutputSegment::kBytes)
+    {
+        // 队尾已经是自己持有的字节段, 直接追加, 小消息不会每条都产生一个新的段,
+        outputQueue_.back().bytes.append(data, len);
+        queuedBytes_ += len;
+    }
+    else
+    {
+        // 发送队列里面已经有 payload 在排队了, 为了保证发送顺序, 这次的数据只能排到队列的后面,
+        OutputSegment segment;
+        segment.kind = OutputSegment::kBytes;
+        segment.bytes.assign(data, len);
+        segment.offset = 0;
+        outputQueue_.push_back(std::move(segment));
+        queuedBytes_ += len;
+    }
+}
+
+ssize_t TcpConnection::writeOutput(int *savedErrno)
+{
+    // 队头是文件段, 用 sendfile() 直接从文件发送到 socket,
+    if (outputBuffer_.readableBytes() == 0 && !outputQueue_.empty() &&
+        outputQueue_.front().kind == OutputSegment::kFile)
+    {
+        OutputSegment &segment = outputQueue_.front();
+        size_t left = segment.fileLength - segment.offset;
+        off_t off = segment.fileOffset + segment.offset;
+        ssize_t n = ::sendfile(channel_.fd(), segment.fileFd, &off, left);
+        if (n < 0)
+        {
+            *savedErrno = errno;
+        }
+        else if (n == 0)
+        {
+            // 文件比 sendFile() 给的长度短, 剩下的部分永远发不出去了, 丢弃这一段,
+            LOG_ERROR("TcpConnection::writeOutput file fd = %d truncated, %lu bytes dropped \n", segment.fileFd, left);
+            queuedBytes_ -= left;
+            queuedFileBytes_ -= left;
+            popOutputSegment();
+        }
+        return n;
+    }
+
+    // 队头是够大的 payload 而且打开了 zerocopy, 用 MSG_ZEROCOPY 发送,
+    if (outputBuffer_.readableBytes() == 0 && !outputQueue_.empty() &&
+        outputQueue_.front().kind == OutputSegment::kPayload &&
+        useZeroCopy(outputQueue_.front().size() - outputQueue_.front().offset))
+    {
+        ssize_t n = sendZeroCopy(outputQueue_.front().payload, outputQueue_.front().offset);
+        if (n < 0)
+        {
+            *savedErrno = errno;
+        }
+        return n;
+    }
+
+    // 把 outputBuffer_ 和发送队列里面的各段数据拼成 iovec, 一次 writev() 最多 IOV_MAX 段,
+    // 遇到文件段或者要走 zerocopy 的 payload 就停下来, 等它们到了队头再单独发送,
+    struct iovec vec[IOV_MAX];
+    int iovcnt = 0;
+    if (outputBuffer_.readableBytes() > 0)
+    {
+        vec[iovcnt].iov_base = const_cast<char *>(outputBuffer_.peek());
+        vec[iovcnt].iov_len = outputBuffer_.readableBytes();
+        ++iovcnt;
+    }
+    for (const OutputSegment &segment : outputQueue_)
+    {
+        if (iovcnt == IOV_MAX || segment.kind == OutputSegment::kFile ||
+            (segment.kind == OutputSegment::kPayload && useZeroCopy(segment.size() - segment.offset)))
+        {
+            break;
+        }
+        vec[iovcnt].iov_base = const_cast<char *>(segment.data() + segment.offset);
+        vec[iovcnt].iov_len = segment.size() - segment.offset;
+        ++iovcnt;
+    }
+
+    ssize_t n = ::writev(channel_.fd(), vec, iovcnt);
+    if (n < 0)
+    {
+        *savedErrno = errno;
+    }
+    return n;
+}
+
+void TcpConnection::retrieveOutput(size_t len)
+{
+    size_t fromBuffer = std::min(len, outputBuffer_.readableBytes());
+    outputBuffer_.retrieve(fromBuffer);
+    len -= fromBuffer;
+    while (len > 0)
     {
-        // 目前发送缓冲区剩余的待发送数据的长度,
-        // 当第一次时候还没往 outputBuf_.append() 时候, outputBuf_.readableBytes() 为0,
-        // 也就是 if( remaining >= highWaterMark_),
-        size_t leftLen = outputBuffer_.readableBytes();
-        if (leftLen + remaining >= highWaterMark_ &&
-            leftLen < highWaterMark_ &&
-            highWaterMarkCallback_)
+        // 部分写只推进偏移量, 整段写完了才出队, 这时 payload 的引用计数才释放,
+        OutputSegment &segment = outputQueue_.front();
+        size_t segLeft = segment.size() - segment.offset;
+        size_t n = std::min(len, segLeft);
+        segment.offset += n;
+        queuedBytes_ -= n;
+        if (segment.kind == OutputSegment::kFile)
         {
-            loop_->queueInLoop(std::bind(highWaterMarkCallback_, this->shared_from_this(), leftLen + remaining));
+            queuedFileBytes_ -= n;
         }
-        outputBuffer_.append(static_cast<const char *>(data) + nwrote, remaining);
-        if (!channel_->isWriting())
+        len -= n;
+        if (segment.offset == segment.size())
         {
-            channel_->enableWriting(); // 这里一定要注册 channel 的写事件, 否则 Poller 不会给 channel 通知 EPOLL_OUT,
+            popOutputSegment();
         }
     }
 }
 
+void TcpConnection::popOutputSegment()
+{
+    if (outputQueue_.front().kind == OutputSegment::kFile)
+    {
+        ::close(outputQueue_.front().fileFd);
+    }
+    outputQueue_.pop_front();
+}
+
+ssize_t TcpConnection::sendZeroCopy(const PayloadPtr &payload, size_t offset)
+{
+    ssize_t n = ::send(channel_.fd(), payload->data() + offset, payload->size() - offset, MSG_ZEROCOPY);
+    if (n > 0)
+    {
+        // 内核可能还在引用 payload 的内存页, 要等完成通知才能释放,
+        zeroCopyInflight_.emplace_back(nextZeroCopyId_++, payload);
+    }
+    else if (n < 0 && ENOBUFS == errno)
+    {
+        // optmem 被在途的 payload 占满了, 不停地重试 zerocopy 只会一直 ENOBUFS,
+        // 这一段改用拷贝发送, 有在途的 payload 的时候等它们的完成通知回来以后再恢复 zerocopy,
+        if (!zeroCopyInflight_.empty())
+        {
+            zeroCopyBlocked_ = true;
+        }
+        struct iovec vec;
+        vec.iov_base = const_cast<char *>(payload->data() + offset);
+        vec.iov_len = payload->size() - offset;
+        n = ::writev(channel_.fd(), &vec, 1);
+    }
+    return n;
+}
+
+void TcpConnection::handleZeroCopyCompletions()
+{
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+    while (sockets_ops::readZeroCopyCompletion(channel_.fd(), &lo, &hi))
+    {
+        // TCP 的完成通知是按序号递增的, 释放序号不大于 hi 的 payload,
+        while (!zeroCopyInflight_.empty() &&
+               static_cast<int32_t>(zeroCopyInflight_.front().first - hi) <= 0)
+        {
+            zeroCopyInflight_.pop_front();
+        }
+        zeroCopyBlocked_ = false;
+    }
+}
+
+void TcpConnection::checkHighWaterMark(size_t newBytes)
+{
+    // 目前发送缓冲区剩余的待发送数据的长度,
+    // 当第一次时候还没往 outputBuf_.append() 时候, outputBytes() 为0,
+    // 也就是 if( newBytes >= highWaterMark_),
+    size_t leftLen = outputBytes();
+    if (leftLen + newBytes >= highWaterMark_ &&
+        leftLen < highWaterMark_ &&
+        highWaterMarkCallback_)
+    {
+        loop_->queueInLoop(std::bind(highWaterMarkCallback_, this->shared_from_this(), leftLen + newBytes));
+    }
+}
+
 void TcpConnection::shutdownInLoop()
 {
     loop_->assertInLoopThread();
-    if (!channel_->isWriting()) // 说明 outputBuf 缓冲区的数据都已经发送完成,
+    if (!channel_.isWriting()) // 说明 outputBuf 缓冲区的数据都已经发送完成,
     {
-        socket_->shutdownWrite(); // 关闭写端, 触发 EPOLL_HUP 事件,
+        socket_.shutdownWrite(); // 关闭写端, 触发 EPOLL_HUP 事件,
     }
 }
 
@@ -1,18 +1,26 @@
 #pragma once
 
 #include <atomic>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <stdint.h>
 #include <string>
 
 #include "buffer.h"
 #include "callbacks.h"
+#include "channel.h"
 #include "inet_address.h"
 #include "noncopyable.h"
+#include "payload.h"
+#include "socket.h"
 #include "timestamp.h"
 
-class Channel;
 class EventLoop;
-class Socket;
+class MemoryAccount;
+class StreamTransform;
+class TcpRelay;
+struct iovec;
 
 /**
  * 客户端和服务器已经建立连接, 打包成功连接服务器的客户端的通信链路的,
@@ -31,11 +39,19 @@ public:
      */
     TcpConnection(EventLoop *loop, const std::string &nameArg, int sockfd,
                   const InetAddress &localAddr, const InetAddress &peerAddr);
+
+    /**
+     * TcpServer 用的构造函数, 连接用 64 位的 id 标识,
+     * 名字 "namePrefix + id" 在第一次调用 name() 的时候才拼接, 接受连接的时候不需要 snprintf,
+     */
+    TcpConnection(EventLoop *loop, uint64_t id, const std::shared_ptr<const std::string> &namePrefix,
+                  int sockfd, const InetAddress &localAddr, const InetAddress &peerAddr);
     ~TcpConnection();
 
 public:
     EventLoop *getLoop() const { return loop_; }
-    const std::string &name() const { return name_; }
+    uint64_t id() const { return id_; }
+    const std::string &name() const;
     const InetAddress &localAddress() const { return localAddr_; }
     const InetAddress &peerAddress() const { return peerAddr_; }
     bool connected() const { return state_ == kConnected; }
@@ -43,6 +59,66 @@ public:
 
     void send(const std::string &message);
 
+    /**
+     * 发送 buf 里面的全部可读数据, 发送以后 buf 被清空,
+     * 在 loop 线程里面调用的时候直接从 buf 写 socket, 不需要先拷贝成 string,
+     * 配合 Buffer::prepend() 使用, 头部和消息体一次 write() 发出去,
+     */
+    void send(Buffer *buf);
+
+    /**
+     * 发送共享的不可变数据, 广播的时候同一个 payload 可以发给很多连接,
+     * 内核一次写不完的时候, 发送队列里面只保存 payload 的引用和已经发送的偏移, 不会拷贝数据,
+     * 可以在任意线程调用,
+     */
+    void send(const PayloadPtr &payload);
+
+    /**
+     * 一次发送多段数据, 比如 header + body, 应用不需要先把它们拼接起来,
+     * 在 loop 线程里面调用的时候直接 writev(), 没写完的部分才拷贝到发送队列,
+     */
+    void send(const struct iovec *iov, int iovcnt);
+
+    /**
+     * 用 sendfile() 发送文件 fd 从 offset 开始的 length 个字节, 文件数据不经过用户态,
+     * 文件段和其他数据一起排在发送队列里面, 由 EPOLLOUT ==> handleWrite() 驱动, 一次只发送内核能接收的部分,
+     * 所以大文件也只占用常量的内存, 未发送的文件字节也计入高水位线,
+     * 内部会 dup() 一份 fd, 调用返回以后调用者就可以关闭自己的 fd 了,
+     */
+    void sendFile(int fd, off_t offset, size_t length);
+
+    /**
+     * 打开/关闭 MSG_ZEROCOPY 发送, 只对 send(PayloadPtr) 发送的、剩余长度不小于 threshold 的 payload 生效,
+     * 内核直接引用 payload 的内存页, 省掉拷贝到 socket 发送缓冲区的开销, 适合几 MB 的大回复,
+     * 发送以后 payload 的引用保存在 zeroCopyInflight_ 里面, 直到从 socket 的错误队列读到内核的完成通知才释放,
+     * 小消息用 MSG_ZEROCOPY 反而更慢(要 pin 内存页, 还要处理完成通知), 所以需要阈值,
+     * 内核不支持 SO_ZEROCOPY 的时候返回 false, 仍然走拷贝的发送路径, 需要在 loop 线程里面调用,
+     */
+    bool setZeroCopy(bool on, size_t threshold = kDefaultZeroCopyThreshold);
+
+    // TCP_NODELAY, 关闭 Nagle 算法, 小消息不再等前一个包的 ACK 才发出去, 可以在任意线程调用,
+    void setTcpNoDelay(bool on) { socket_.setTcpNoDelay(on); }
+    /**
+     * TCP_NOTSENT_LOWAT, 内核里面没有发出去的数据少于 bytes 才报告 EPOLLOUT,
+     * 数据留在 outputBuffer_ 里面而不是堆积在内核发送缓冲区, 高优先级的数据可以更早发出去, 可以在任意线程调用,
+     */
+    void setNotSentLowat(int bytes) { socket_.setNotSentLowat(bytes); }
+    // SO_INCOMING_CPU, 处理这个连接数据包的 CPU, 用来检查 TcpServer::setCpuAffinity() 的效果, 不知道的时候返回 -1,
+    int incomingCpu() const;
+
+    /**
+     * 在收发路径上加一层变换 (比如 Lz4Transform), 两端必须用同样的变换,
+     * 发: send() 的数据编码以后直接写进 outputBuffer_ 的可写区域, 应用不需要先编码到临时的 string,
+     * 收: socket 读到的数据先放在 transformInput_ 里面, 解码到 inputBuffer_ 以后再交给 messageCallback_ 或者 bodySink_,
+     * 要在 loop 线程里面收发任何数据之前设置, 比如 ConnectionCallback 里面,
+     * 设置以后 send(PayloadPtr) 也要按连接编码, 不再共享 payload, sendFile() 不能用, TcpRelay 转发的数据不经过变换,
+     */
+    void setTransform(const std::shared_ptr<StreamTransform> &transform);
+    const std::shared_ptr<StreamTransform> &transform() const { return transform_; }
+
+    // 还没有发送出去的字节数, outputBuffer_ 加上发送队列里面的 payload,
+    size_t outputBytes() const { return outputBuffer_.readableBytes() + queuedBytes_; }
+
     /**
      * 关闭写端, TcpConnection::shutdownInLoop() ==> Socket::shutdownWrite() ==> ::shutdown(sockfd_, SHUT_WR) ==>
      * ::shutdown()关闭写端 ==> 触发 EPOLL_HUP 事件 ==>  channel_->closeCallback_() ==> TcpServer::removeConnection() ==>
@@ -50,6 +126,9 @@ public:
      */
     void shutdown();
 
+    // 不等发送队列发送完, 直接关闭连接, 可以在任意线程调用,
+    void forceClose();
+
     void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
 
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
@@ -64,6 +143,62 @@ public:
 
     void setCloseCallback(const CloseCallback &cb) { closeCallback_ = cb; }
 
+    /**
+     * 上层协议 (HttpServer 之类) 保存在连接上面的状态, 比如请求解析到哪里了,
+     * 只在连接的 loop 线程里面访问, 连接析构的时候一起释放,
+     */
+    void setContext(const std::shared_ptr<void> &context) { context_ = context; }
+    const std::shared_ptr<void> &getContext() const { return context_; }
+
+    /**
+     * 暂停/恢复读取, 暂停以后不再注册 EPOLLIN, 内核的接收缓冲区满了以后 TCP 的滑动窗口会让对端停止发送,
+     * 可以在任意线程调用,
+     */
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; } // 用户是否希望读, 不包括下面水位线引起的暂停,
+
+    /**
+     * 流式接收, 用来接收几百 MB 的上传, 不需要把整个消息体攒在 inputBuffer_ 里面,
+     * 设置以后收到的数据马上交给 sink, sink 消费掉的部分马上从 inputBuffer_ 里面回收,
+     * sink 消费不了的数据留在 inputBuffer_ 里面, 积压达到 window 字节就停止读 (TCP 窗口让对端停止发送),
+     * sink 可以继续处理以后调用 resumeBody(), 所以每个连接的接收内存不超过 window,
+     * 设置了 transform_ 的时候, 没解码的字节也算在 window 里面, 解码最多超出 window 一个编码单元,
+     * 在 messageCallback_ 里面设置的话 (比如 HTTP 的头部解析完了), inputBuffer_ 里面剩下的数据马上交给 sink,
+     * 在 sink 里面调用 clearBodySink() 结束流式接收 (比如消息体收完了), 剩下的数据 (流水线上的下一个请求) 交回 messageCallback_,
+     * setBodySink()/clearBodySink() 需要在 loop 线程里面调用,
+     */
+    void setBodySink(const BodySink &sink, size_t window = kDefaultBodyWindow);
+    void clearBodySink();
+    // sink 又可以接收数据了, 把积压的数据交给它, 积压降到 window 以下就恢复读, 可以在任意线程调用,
+    void resumeBody();
+
+    /**
+     * 读端背压, 发送队列的待发送数据达到 highMark 以后自动停止读 (关闭 EPOLLIN),
+     * 发送到 lowMark 以下以后自动恢复读, 这样对端请求发得快、回复收得慢的时候, 发送队列不会无限增长,
+     * highMark 为 0 表示关闭这个功能, 需要 lowMark < highMark,
+     * 和 setHighWaterMarkCallback() 不同, 后者只是通知用户, 这里是库自己做流量控制,
+     */
+    void setReadPauseWatermarks(size_t highMark, size_t lowMark)
+    {
+        readPauseHighMark_ = highMark;
+        readPauseLowMark_ = lowMark < highMark ? lowMark : highMark / 2;
+    }
+
+    /**
+     * 内存统计, TcpServer 给每个连接设置所属 subLoop 的 MemoryAccount,
+     * 连接在自己的 loop 线程里面把 inputBuffer_ 和发送队列的变化量累加进去, 连接关闭的时候全部减掉,
+     * memoryLimit 是单个连接的上限, 超过了直接 forceClose(), 0 表示不限制,
+     */
+    void setMemoryAccount(MemoryAccount *account) { memoryAccount_ = account; }
+    void setMemoryLimit(size_t memoryLimit) { memoryLimit_ = memoryLimit; }
+
+    // 最近一次统计的缓冲区字节数, 可以在任意线程读取,
+    size_t bufferedInputBytes() const { return accountedInput_; }
+    size_t bufferedOutputBytes() const { return accountedOutput_; }
+    // 发送队列从空变成非空的时间, 发送队列为空的时候是无效的 Timestamp,
+    Timestamp outputPendingSince() const { return Timestamp(outputPendingSince_); }
+
     // 连接建立了,
     void connectEstablished();
 
@@ -71,6 +206,9 @@ public:
     void connectDestroyed();
 
 private:
+    // TcpRelay 直接操作两个连接的 channel_ 和 socket, 转发的数据不经过 inputBuffer_/outputBuffer_,
+    friend class TcpRelay;
+
     enum StateE
     {
         kDisconnected,
@@ -115,20 +253,126 @@ private:
      * 而且设置了水位回调 HighWaterMarkCallback, 防止发送太快,
      */
     void sendInLoop(const void *data, size_t len);
+    void sendStringInLoop(const std::string &message);
+    void sendvInLoop(const struct iovec *iov, int iovcnt);
+    void sendPayloadInLoop(const PayloadPtr &payload);
+    void sendFileInLoop(int fd, off_t offset, size_t length);
+    // 设置了 transform_ 的时候, 每一段数据编码到 outputBuffer_, 之前没有待发送的数据就马上写一次,
+    void sendTransformedInLoop(const struct iovec *iov, int iovcnt);
     void shutdownInLoop();
 
+    // 没有待发送数据的时候直接 writev() 给内核, 返回写出去的字节数, 给了 zeroCopyPayload 的时候用 MSG_ZEROCOPY 发送它,
+    size_t writeDirectly(const struct iovec *iov, int iovcnt, size_t len, bool *faultError,
+                         const PayloadPtr &zeroCopyPayload = PayloadPtr());
+    // 把没发送完的数据追加到 outputBuffer_ 或者发送队列的末尾,
+    void appendOutput(const char *data, size_t len);
+    // 用 writev() 把 outputBuffer_ 和发送队列一起写给内核, 队头是文件段的时候改用 sendfile(),
+    ssize_t writeOutput(int *savedErrno);
+    // writev() 写出去 len 个字节以后, 依次推进 outputBuffer_ 和发送队列,
+    void retrieveOutput(size_t len);
+
+    // 待发送数据超过了水位线, 通知用户,
+    void checkHighWaterMark(size_t newBytes);
+
+    void forceCloseInLoop();
+
+    // 把 inputBuffer_ 和发送队列的变化同步到 memoryAccount_, 检查单个连接的内存上限,
+    void updateMemoryAccount();
+    // 连接关闭, 把统计的字节数从 memoryAccount_ 里面全部减掉,
+    void releaseMemoryAccount();
+
+    void startReadInLoop();
+    void stopReadInLoop();
+    void resumeBodyInLoop();
+    // 把 inputBuffer_ 里面的数据交给 bodySink_ 或者 messageCallback_, 两者之间切换的时候剩下的数据交给另一个,
+    void dispatchInput(Timestamp receiveTime);
+    // 把积压的数据交给 bodySink_, sink 在回调里面清除了自己而且还有剩下的数据的时候返回 true,
+    bool deliverBody();
+    // 有变换的时候把 transformInput_ 解码到 inputBuffer_ 交给应用, 直到没有完整的编码单元或者 sink 背压, 解码出错关闭连接返回 false,
+    bool decodeAndDispatch(Timestamp receiveTime);
+    // 流式接收的时候, 积压达到 bodyWindow_ 就暂停读,
+    void updateBodyPause();
+    // 发送队列变化以后, 根据 readPauseHighMark_/readPauseLowMark_ 暂停或者恢复读,
+    void checkReadPause();
+    // 根据 reading_, readPausedByOutput_, readPausedBySink_ 和 readPausedByRelay_ 更新 channel 的 EPOLLIN,
+    void updateReading();
+    // TcpRelay 的流量控制也通过 updateReading(), 不直接操作 channel_, 用户的 stopRead() 和水位线的暂停仍然有效,
+    void setReadPausedByRelay(bool paused);
+
     void setState(StateE s) { state_ = s; }
     const char *stateToString() const;
 
+private:
+    /**
+     * 发送队列中的一段数据, 可以是连接自己持有的字节、共享的 payload, 或者一段文件,
+     * offset 是这一段已经写到内核的字节数, 部分写的时候只推进 offset, 不拷贝数据,
+     * 文件段没有 data(), 只能在队头的时候用 sendfile() 发送, fileFd 是 dup() 出来的, 这一段发送完以后关闭,
+     */
+    struct OutputSegment
+    {
+        enum Kind
+        {
+            kBytes,
+            kPayload,
+            kFile,
+        };
+
+        const char *data() const { return kind == kBytes ? bytes.data() : payload->data(); }
+        size_t size() const
+        {
+            switch (kind)
+            {
+            case kBytes:
+                return bytes.size();
+            case kPayload:
+                return payload->size();
+            default:
+                return fileLength;
+            }
+        }
+
+        Kind kind;
+        std::string bytes;
+        PayloadPtr payload;
+        int fileFd;
+        off_t fileOffset;
+        size_t fileLength;
+        size_t offset;
+    };
+
+    // 发送队列里面的一个文件段发送完了或者被丢弃了, 关闭 dup() 出来的 fd 并出队,
+    void popOutputSegment();
+
+    // payload 剩下 len 个字节没发送, 是否走 MSG_ZEROCOPY,
+    bool useZeroCopy(size_t len) const
+    {
+        return zeroCopyThreshold_ > 0 && !zeroCopyBlocked_ && len >= zeroCopyThreshold_;
+    }
+    // 用 MSG_ZEROCOPY 发送 payload 从 offset 开始的数据, 成功以后把 payload 记到 zeroCopyInflight_,
+    // ENOBUFS (socket 的 optmem 被在途的 payload 用完了) 的时候改用普通的 writev() 发送这一段,
+    ssize_t sendZeroCopy(const PayloadPtr &payload, size_t offset);
+    // EPOLLERR ==> handleError(), 从错误队列读取内核的完成通知, 释放已经完成的 payload,
+    void handleZeroCopyCompletions();
+
+    static const size_t kDefaultZeroCopyThreshold = 256 * 1024;
+    static const size_t kDefaultBodyWindow = 256 * 1024;
+
 private:
     EventLoop *loop_; // 这里是 subLoop, 因为 TCPConnection 都是在 subLoop 管理的,
-    const std::string name_;
+    const uint64_t id_;
+    const std::shared_ptr<const std::string> namePrefix_; // 为空表示 name_ 在构造的时候就给定了,
+    mutable std::once_flag nameOnce_;
+    mutable std::string name_;
     std::atomic_int state_;
-    bool reading_;
+    bool reading_;            // 用户通过 startRead()/stopRead() 设置的读状态,
+    bool readPausedByOutput_; // 发送队列超过 readPauseHighMark_ 自动暂停了读,
+    bool readPausedBySink_;   // 流式接收的积压达到 bodyWindow_ 自动暂停了读,
+    bool readPausedByRelay_;  // TcpRelay 的管道满了或者对端写不出去, 暂停了读,
 
     // 这里和 Acceptor 类似, Acceptor 是在 mainLoop 里面的, 而 TcpConnection 是在 subLoop 里面的,
-    std::unique_ptr<Socket> socket_;
-    std::unique_ptr<Channel> channel_;
+    // 直接内嵌在 TcpConnection 里面, 不单独分配, TcpServer 用对象池分配的时候它们也在同一个块里面,
+    Socket socket_;
+    Channel channel_;
     const InetAddress localAddr_;
     const InetAddress peerAddr_;
 
@@ -138,7 +382,41 @@ private:
     HighWaterMarkCallback highWaterMarkCallback_;
     CloseCallback closeCallback_;
     size_t highWaterMark_;
+    size_t readPauseHighMark_;
+    size_t readPauseLowMark_;
 
     Buffer inputBuffer_;  // 接收数据的缓冲区,
     Buffer outputBuffer_; // 发送数据的缓冲区,
+
+    // 排在 outputBuffer_ 后面的发送队列, handleWrite() 用一次 writev() 把 outputBuffer_ 和队列里面的各段一起发送,
+    std::deque<OutputSegment> outputQueue_;
+    size_t queuedBytes_;     // outputQueue_ 里面还没有发送的字节数,
+    size_t queuedFileBytes_; // 其中文件段的字节数, 不占用内存,
+
+    // MSG_ZEROCOPY, 内核按照成功的 send() 调用依次分配序号, 完成通知给出一个序号区间 [lo, hi],
+    size_t zeroCopyThreshold_; // 0 表示没有打开 zerocopy,
+    uint32_t nextZeroCopyId_;
+    std::deque<std::pair<uint32_t, PayloadPtr>> zeroCopyInflight_;
+    bool zeroCopyBlocked_; // 遇到 ENOBUFS 以后暂停 zerocopy, 收到完成通知再恢复,
+
+    MemoryAccount *memoryAccount_;
+    size_t memoryLimit_;
+    std::atomic<size_t> accountedInput_;
+    std::atomic<size_t> accountedOutput_;
+    std::atomic<int64_t> outputPendingSince_;
+
+    std::shared_ptr<void> context_;
+
+    BodySink bodySink_;
+    size_t bodyWindow_;
+    uint64_t bodySinkVersion_; // 每次设置或者清除 bodySink_ 加一, 用来发现回调里面换掉了 sink,
+    bool dispatchingInput_;    // 正在 dispatchInput() 里面回调,
+
+    // 不为空的时候, 读写事件交给 TcpRelay 用 splice() 转发, 不再回调 messageCallback_,
+    std::shared_ptr<TcpRelay> relay_;
+
+    // 不为空的时候, 发送的数据经过 transform_ 编码, 收到的数据先读到 transformInput_, 解码到 inputBuffer_,
+    // transformInput_ 在 setTransform() 的时候才分配, 不用变换的连接不多占内存,
+    std::shared_ptr<StreamTransform> transform_;
+    std::unique_ptr<Buffer> transformInput_;
 };
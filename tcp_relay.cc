@@ -0,0 +1,257 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+
+#include "tcp_relay.h"
+
+#include "channel.h"
+#include "event_loop.h"
+#include "logger.h"
+#include "socket.h"
+#include "tcp_connection.h"
+
+TcpRelay::TcpRelay(const TcpConnectionPtr &client, const TcpConnectionPtr &upstream)
+    : pipeSize_(0),
+      pipeCapacity_(0),
+      started_(false)
+{
+    if (client->getLoop() != upstream->getLoop())
+    {
+        LOG_FATAL("%s:%s:%d TcpRelay connections must belong to the same loop! \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+
+    directions_[kToUpstream].from = client;
+    directions_[kToUpstream].to = upstream;
+    directions_[kToClient].from = upstream;
+    directions_[kToClient].to = client;
+    for (Direction &d : directions_)
+    {
+        d.pipeFds[0] = d.pipeFds[1] = -1;
+        d.inPipe = 0;
+        d.eof = false;
+        d.transferred = 0;
+    }
+}
+
+TcpRelay::~TcpRelay()
+{
+    for (Direction &d : directions_)
+    {
+        if (d.pipeFds[0] >= 0)
+        {
+            ::close(d.pipeFds[0]);
+            ::close(d.pipeFds[1]);
+        }
+    }
+}
+
+void TcpRelay::start()
+{
+    EventLoop *loop = directions_[kToUpstream].from->getLoop();
+    loop->runInLoop(std::bind(&TcpRelay::startInLoop, shared_from_this()));
+}
+
+void TcpRelay::startInLoop()
+{
+    TcpConnectionPtr client = directions_[kToUpstream].from;
+    TcpConnectionPtr upstream = directions_[kToUpstream].to;
+    client->getLoop()->assertInLoopThread();
+    if (started_ || !client->connected() || !upstream->connected())
+    {
+        LOG_ERROR("TcpRelay::startInLoop [%s] <=> [%s] connection not ready \n",
+                  client->name().c_str(), upstream->name().c_str());
+        return;
+    }
+    started_ = true;
+
+    for (Direction &d : directions_)
+    {
+        if (::pipe2(d.pipeFds, O_NONBLOCK | O_CLOEXEC) < 0)
+        {
+            LOG_FATAL("TcpRelay::startInLoop pipe2 error:%d \n", errno);
+        }
+        if (pipeSize_ > 0)
+        {
+            ::fcntl(d.pipeFds[1], F_SETPIPE_SZ, pipeSize_);
+        }
+        pipeCapacity_ = ::fcntl(d.pipeFds[1], F_GETPIPE_SZ);
+    }
+
+    for (Direction &d : directions_)
+    {
+        // 开始转发之前已经读到用户态的数据, 只能拷贝一次发出去,
+        Buffer &input = d.from->inputBuffer_;
+        if (input.readableBytes() > 0)
+        {
+            d.to->sendInLoop(input.peek(), input.readableBytes());
+            input.retrieveAll();
+        }
+        d.from->relay_ = shared_from_this();
+        d.from->setReadPausedByRelay(false);
+    }
+}
+
+void TcpRelay::handleRead(TcpConnection *conn)
+{
+    Direction &d = directions_[conn == directions_[kToUpstream].from.get() ? kToUpstream : kToClient];
+    size_t room = pipeCapacity_ - d.inPipe;
+    if (0 == room)
+    {
+        // 管道满了, 等 to 可写以后再读,
+        conn->setReadPausedByRelay(true);
+        return;
+    }
+
+    ssize_t n = ::splice(conn->channel_.fd(), nullptr, d.pipeFds[1], nullptr, room,
+                         SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n > 0)
+    {
+        d.inPipe += n;
+        flushPipe(d);
+    }
+    else if (0 == n)
+    {
+        // from 关闭了写端, 把管道里面剩下的数据发完以后关闭 to 的写端, 另一个方向继续转发,
+        d.eof = true;
+        conn->setReadPausedByRelay(true);
+        flushPipe(d);
+    }
+    else if (EAGAIN != errno)
+    {
+        LOG_ERROR("TcpRelay::handleRead [%s] splice error:%d \n", conn->name().c_str(), errno);
+        conn->handleClose();
+    }
+}
+
+void TcpRelay::handleWrite(TcpConnection *conn)
+{
+    Direction &d = directions_[conn == directions_[kToUpstream].to.get() ? kToUpstream : kToClient];
+    flushPipe(d);
+}
+
+void TcpRelay::flushPipe(Direction &d)
+{
+    TcpConnection *from = d.from.get();
+    TcpConnection *to = d.to.get();
+
+    if (d.inPipe > 0)
+    {
+        // to 自己的发送队列里面还有数据, 管道里面的数据要排在它们后面, 等 to 的 handleWrite() 发送完再来,
+        if (to->outputBytes() > 0)
+        {
+            if (!to->channel_.isWriting())
+            {
+                to->channel_.enableWriting();
+            }
+            from->setReadPausedByRelay(true);
+            return;
+        }
+
+        ssize_t n = ::splice(d.pipeFds[0], nullptr, to->channel_.fd(), nullptr, d.inPipe,
+                             SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0)
+        {
+            d.inPipe -= n;
+            d.transferred += n;
+        }
+        else if (n < 0 && EAGAIN != errno)
+        {
+            // to 出错了 (EPIPE / ECONNRESET), 关闭 to, handleClose() 里面会解除转发,
+            LOG_ERROR("TcpRelay::flushPipe [%s] splice error:%d \n", to->name().c_str(), errno);
+            to->handleClose();
+            return;
+        }
+    }
+
+    if (d.inPipe > 0)
+    {
+        // to 暂时不可写, 停止读 from, 等 to 的 EPOLLOUT,
+        from->setReadPausedByRelay(true);
+        if (!to->channel_.isWriting())
+        {
+            to->channel_.enableWriting();
+        }
+    }
+    else
+    {
+        if (to->channel_.isWriting() && to->outputBytes() == 0)
+        {
+            to->channel_.disableWriting();
+        }
+        if (d.eof)
+        {
+            to->shutdown();
+            if (directions_[kToUpstream].eof && directions_[kToClient].eof &&
+                directions_[kToUpstream].inPipe == 0 && directions_[kToClient].inPipe == 0)
+            {
+                finish();
+            }
+        }
+        else
+        {
+            from->setReadPausedByRelay(false);
+        }
+    }
+}
+
+void TcpRelay::finish()
+{
+    std::shared_ptr<TcpRelay> guard(shared_from_this());
+    TcpConnectionPtr client(directions_[kToUpstream].from);
+    TcpConnectionPtr upstream(directions_[kToUpstream].to);
+    detach();
+    /**
+     * 两个方向都读到了 EOF, 读到 EOF 的时候 TcpRelay 暂停了读, channel 没有任何事件就会从 epoll 里面删除,
+     * 所以这里撤销 TcpRelay 的暂停, 两个连接回到普通模式, 下一次 handleRead() 读到 0 就走正常的 handleClose(),
+     * 用户 stopRead() 或者水位线暂停了读的连接, 仍然等它们自己恢复,
+     */
+    for (const TcpConnectionPtr &conn : {client, upstream})
+    {
+        conn->setReadPausedByRelay(false);
+    }
+}
+
+void TcpRelay::handleClose(TcpConnection *conn)
+{
+    // detach() 以后两个连接都不再持有 TcpRelay, 这里保证函数执行完之前 this 不被析构,
+    std::shared_ptr<TcpRelay> guard(shared_from_this());
+    Direction &out = directions_[conn == directions_[kToUpstream].from.get() ? kToUpstream : kToClient];
+    TcpConnection *other = out.to.get();
+
+    // conn 发给 other 的数据还有一部分在管道里面, 读出来交给 other 的发送缓冲区,
+    char buf[65536];
+    while (out.inPipe > 0)
+    {
+        ssize_t n = ::read(out.pipeFds[0], buf, sizeof(buf));
+        if (n <= 0)
+        {
+            break;
+        }
+        out.inPipe -= n;
+        other->sendInLoop(buf, n);
+    }
+
+    TcpConnectionPtr otherPtr(out.to);
+    detach();
+    if (otherPtr->connected())
+    {
+        // other 回到普通的 messageCallback 模式, 读事件按照 other 自己的读状态恢复,
+        otherPtr->setReadPausedByRelay(false);
+        otherPtr->shutdown();
+    }
+}
+
+void TcpRelay::detach()
+{
+    for (Direction &d : directions_)
+    {
+        d.from->relay_.reset();
+    }
+    // 打破 TcpRelay 和 TcpConnection 之间的循环引用,
+    for (Direction &d : directions_)
+    {
+        d.from.reset();
+        d.to.reset();
+    }
+}
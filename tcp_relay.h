@@ -0,0 +1,84 @@
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+
+#include "callbacks.h"
+#include "noncopyable.h"
+
+class TcpConnection;
+
+/**
+ * 把两个 TcpConnection (客户端一侧和上游一侧) 连接起来做 L4 转发,
+ * 数据通过 splice(2) 从一个 socket 移动到管道, 再从管道移动到另一个 socket, 不经过 inputBuffer_/outputBuffer_,
+ * 每个方向一个管道:
+ *     from.fd ==splice==> pipe ==splice==> to.fd
+ * 流量控制: 管道里面的数据写不出去的时候 (to 不可写), 停止读 from, 给 to 注册 EPOLLOUT,
+ * to 可写以后把管道里面的数据发送完, 再恢复读 from,
+ *
+ * 两个连接必须属于同一个 subLoop, 这样转发的时候不需要跨线程, 也不需要加锁,
+ * 其中一端关闭以后, 把发往另一端的剩余数据交给另一端的发送缓冲区, 然后关闭另一端的写端, TcpRelay 随之解除,
+ */
+class TcpRelay : noncopyable,
+                 public std::enable_shared_from_this<TcpRelay>
+{
+public:
+    TcpRelay(const TcpConnectionPtr &client, const TcpConnectionPtr &upstream);
+    ~TcpRelay();
+
+public:
+    /**
+     * 开始转发, 可以在任意线程调用, 两个连接都必须已经建立,
+     * 开始之前已经读到 inputBuffer_ 里面的数据会先通过 send() 转发出去,
+     */
+    void start();
+
+    // 设置每个方向的管道容量 F_SETPIPE_SZ, 在 start() 之前调用, 默认是内核的 64K,
+    void setPipeSize(int bytes) { pipeSize_ = bytes; }
+
+    // 已经转发的字节数,
+    int64_t bytesToUpstream() const { return directions_[kToUpstream].transferred; }
+    int64_t bytesToClient() const { return directions_[kToClient].transferred; }
+
+private:
+    friend class TcpConnection;
+
+    enum DirectionE
+    {
+        kToUpstream, // client ==> upstream,
+        kToClient,   // upstream ==> client,
+    };
+
+    // 一个转发方向, from 的数据经过管道 splice 到 to,
+    struct Direction
+    {
+        TcpConnectionPtr from;
+        TcpConnectionPtr to;
+        int pipeFds[2]; // pipeFds[0] 读端, pipeFds[1] 写端,
+        size_t inPipe;  // 管道里面还没有写到 to 的字节数,
+        bool eof;       // from 已经读到 EOF,
+        int64_t transferred;
+    };
+
+    void startInLoop();
+
+    // TcpConnection::handleRead() 转到这里, conn 有数据可读, splice 到管道,
+    void handleRead(TcpConnection *conn);
+    // TcpConnection::handleWrite() 发送队列为空的时候转到这里, 把管道里面的数据 splice 给 conn,
+    void handleWrite(TcpConnection *conn);
+    // TcpConnection::handleClose() 转到这里, 一端关闭了, 解除转发,
+    void handleClose(TcpConnection *conn);
+
+    // 把 d 的管道里面的数据尽量 splice 给 d.to, 根据结果暂停/恢复读 d.from,
+    void flushPipe(Direction &d);
+    // 两个方向都读到了 EOF 而且管道都空了, 解除转发, 交给两个连接自己关闭,
+    void finish();
+    // 解除两个连接和 TcpRelay 的关联,
+    void detach();
+
+private:
+    Direction directions_[2];
+    int pipeSize_;         // 用户设置的管道容量, 0 表示使用内核默认值,
+    size_t pipeCapacity_;  // 管道实际的容量, F_GETPIPE_SZ,
+    bool started_;
+};
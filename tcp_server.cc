@@ -1,3 +1,8 @@
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
 #include "tcp_server.h"
 
 #include "acceptor.h"
@@ -47,6 +52,9 @@ TcpServer::TcpServer(EventLoop *loop, const InetAddress &listenAddr, const std::
     : loop_(CheckLoopNotNull(loop)),
       ipPort_(listenAddr.toIpPort()),
       name_(nameArg),
+      listenAddr_(listenAddr),
+      acceptMode_(kSingleAcceptor),
+      connNamePrefix_(std::make_shared<const std::string>(name_ + "-" + ipPort_ + "#")),
       acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
       threadPool_(new EventLoopThreadpool(loop, name_)),
       connectionCallback_(defaultConnectionCallback),
@@ -59,18 +67,54 @@ TcpServer::TcpServer(EventLoop *loop, const InetAddress &listenAddr, const std::
                                                   std::placeholders::_1, std::placeholders::_2));
 }
 
+/**
+ * 在 loop 线程里面执行 cb, 等它执行完再返回,
+ * 当前就是 loop 线程的话直接执行,
+ */
+static void runInLoopAndWait(EventLoop *loop, const EventLoop::Functor &cb)
+{
+    if (loop->isInLoopThread())
+    {
+        cb();
+        return;
+    }
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done = false;
+    loop->runInLoop([&]()
+                    {
+                        cb();
+                        std::lock_guard<std::mutex> lock(mutex);
+                        done = true;
+                        cond.notify_one();
+                    });
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!done)
+    {
+        cond.wait(lock);
+    }
+}
+
 TcpServer::~TcpServer()
 {
     loop_->assertInLoopThread();
     LOG_INFO("TcpServer::~TcpServer [%s] destructing", name_.c_str());
 
-    for (std::pair<const std::string, TcpConnectionPtr> &item : connections_)
+    // 分片只能在自己的 subLoop 线程里面访问, 到每个 subLoop 里面销毁它的连接,
+    // 等待执行完, 因为分片随着 TcpServer 一起析构,
+    for (auto &item : shards_)
     {
-        TcpConnectionPtr conn(item.second);
-        item.second.reset(); // item.second 不再使用强智能指针去管理资源, item.second 资源就可以释放,
-                             // 因为强智能指针引用的资源是无法释放掉的, 这样就只有 conn 管理这个 TcpConnection 对象,
-                             // 当出了作用域, 就自动释放 TcpConnection 对象,
-        conn->getLoop()->runInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+        LoopShard *shard = item.second.get();
+        runInLoopAndWait(item.first, [shard]()
+                         {
+                             shard->acceptor.reset();
+                             for (auto &conn : shard->connections)
+                             {
+                                 conn.second->connectDestroyed();
+                             }
+                             shard->connections.clear();
+                         });
     }
 }
 
@@ -87,12 +131,97 @@ void TcpServer::start()
     if (started_++ == 0)
     {
         threadPool_->start(threadInitCallback_);
+
+        // 每个 subLoop 一个分片, 分片的 MemoryAccount 累加到整个 TcpServer 的 memoryAccount_,
+        // 整个 TcpServer 超过限制的时候, 由导致超限的那个分片的回调处理,
+        memoryAccount_.setLimit(memoryLimits_.total, MemoryAccount::ExceededCallback());
+        for (EventLoop *ioLoop : threadPool_->getAllLoops())
+        {
+            std::unique_ptr<LoopShard> shard(new LoopShard(&memoryAccount_));
+            shard->memoryAccount.setLimit(memoryLimits_.perLoop, std::bind(&TcpServer::onMemoryExceeded, this, ioLoop));
+            shards_[ioLoop] = std::move(shard);
+        }
+
+        // kExclusiveSharedListen 共用的也是这个 socket, kReusePortPerLoop 的时候它下面就关闭了, 每个 Acceptor 自己设置,
+        applyListenOptions(acceptor_->socket().get());
+
+        if (kSingleAcceptor != acceptMode_)
+        {
+            // kReusePortPerLoop: 先关闭构造函数里面绑定的 socket, 它没有设置 SO_REUSEPORT 的话, 下面的 bind() 会失败,
+            // kExclusiveSharedListen: 只留下构造函数里面绑定的 socket, 所有 subLoop 的 Acceptor 共用,
+            std::shared_ptr<Socket> sharedSocket;
+            if (kExclusiveSharedListen == acceptMode_)
+            {
+                sharedSocket = acceptor_->socket();
+            }
+            acceptor_.reset();
+
+            // 按照 getAllLoops() 的顺序 listen(), SO_REUSEPORT 组里面 socket 的序号就是 loop 的序号,
+            // 挂了 BPF 程序的时候序号必须确定, 所以等前一个 listen() 完成再 listen() 下一个,
+            bool cpuFilter = kReusePortPerLoop == acceptMode_ && threadPool_->cpuAffinity();
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                LoopShard *shard = shardOf(ioLoop);
+                if (sharedSocket)
+                {
+                    shard->acceptor.reset(new Acceptor(ioLoop, sharedSocket));
+                }
+                else
+                {
+                    shard->acceptor.reset(new Acceptor(ioLoop, listenAddr_, true));
+                    applyListenOptions(shard->acceptor->socket().get());
+                }
+                shard->acceptor->setNewConnectionCallback(std::bind(&TcpServer::newConnectionInLoop, this, ioLoop,
+                                                                    std::placeholders::_1, std::placeholders::_2));
+                if (cpuFilter)
+                {
+                    runInLoopAndWait(ioLoop, std::bind(&Acceptor::listen, shard->acceptor.get()));
+                }
+                else
+                {
+                    ioLoop->runInLoop(std::bind(&Acceptor::listen, shard->acceptor.get()));
+                }
+            }
+            if (cpuFilter)
+            {
+                Acceptor *first = shardOf(threadPool_->getAllLoops().front())->acceptor.get();
+                sockets_ops::attachReusePortCpuFilter(first->socket()->fd(), threadPool_->getLoopCpus());
+            }
+            return;
+        }
+
         assert(!acceptor_->listenning());
         loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
         // 因为 loop 是主loop, 那么直接在主线程里面, 直接就执行了 Acceptor::listen() 函数了,
     }
 }
 
+void TcpServer::applyListenOptions(Socket *socket) const
+{
+    if (socketOptions_.deferAcceptSeconds > 0)
+    {
+        socket->setDeferAccept(socketOptions_.deferAcceptSeconds);
+    }
+    if (socketOptions_.fastOpenQueueLen > 0)
+    {
+        socket->setFastOpen(socketOptions_.fastOpenQueueLen);
+    }
+    if (socketOptions_.sendBufferSize > 0)
+    {
+        socket->setSendBufferSize(socketOptions_.sendBufferSize);
+    }
+    if (socketOptions_.recvBufferSize > 0)
+    {
+        socket->setRecvBufferSize(socketOptions_.recvBufferSize);
+    }
+}
+
+TcpServer::LoopShard *TcpServer::shardOf(EventLoop *ioLoop) const
+{
+    auto it = shards_.find(ioLoop);
+    return it == shards_.end() ? nullptr : it->second.get();
+}
+
 /**
  * acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection,xx)) ==>
  * TcpServer::start() ==>
@@ -103,46 +232,182 @@ void TcpServer::start()
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
     loop_->assertInLoopThread();
-    // 轮询算法选择一个 subLoop 来管理 Channel,
-    EventLoop *ioLoop = threadPool_->getNextLoop();
-    char buf[64] = {0};
-    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
-    std::string connName = name_ + buf;
+    // 打开了 CPU 亲和的时候交给绑定在处理这个连接数据包的 CPU 上的 subLoop, 否则轮询算法选择一个 subLoop 来管理 Channel,
+    EventLoop *ioLoop = loopForIncomingCpu(sockfd);
+    if (nullptr == ioLoop)
+    {
+        ioLoop = threadPool_->getNextLoop();
+    }
+    TcpConnectionPtr conn = createConnection(ioLoop, sockfd, peerAddr);
+
+    // 在 ioLoop 里面加入分片, 然后调用 TcpConnection::connectEstablished()
+    // ==> conn.channel_->enableReading();  conn.connectionCallback_();[用户预置的 onConnection_ 就会回调]
+    ioLoop->runInLoop(std::bind(&TcpServer::connectionEstablishedInLoop, this, conn));
+}
+
+void TcpServer::newConnectionInLoop(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
+    ioLoop->assertInLoopThread();
+    // kExclusiveSharedListen 的时候哪个 subLoop 先醒来就是哪个 subLoop accept(), 不一定是数据包所在的 CPU, 需要再交接一次,
+    // kReusePortPerLoop 挂了 BPF 程序, 一般已经是对应的 subLoop 了,
+    EventLoop *target = loopForIncomingCpu(sockfd);
+    if (nullptr != target && target != ioLoop)
+    {
+        TcpConnectionPtr conn = createConnection(target, sockfd, peerAddr);
+        target->runInLoop(std::bind(&TcpServer::connectionEstablishedInLoop, this, conn));
+        return;
+    }
+    connectionEstablishedInLoop(createConnection(ioLoop, sockfd, peerAddr));
+}
+
+EventLoop *TcpServer::loopForIncomingCpu(int sockfd) const
+{
+    if (!threadPool_->cpuAffinity())
+    {
+        return nullptr;
+    }
+    int cpu = sockets_ops::getIncomingCpu(sockfd);
+    return cpu < 0 ? nullptr : threadPool_->getLoopForCpu(cpu);
+}
 
-    LOG_INFO("TcpServer::newConnection [%s] - new connection [%s] from %s\n",
-             name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str())
+TcpConnectionPtr TcpServer::createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
+    // 连接的名字不在这里拼接, 只有调用 TcpConnection::name() 的时候才生成,
+    // 每个 subLoop 一个 Acceptor 的时候多个 subLoop 同时在分配 id, 所以 nextConnId_ 是原子变量,
+    uint64_t connId = nextConnId_++;
+
+    LOG_INFO("TcpServer::newConnection [%s] - new connection #%lu from %s\n",
+             name_.c_str(), connId, peerAddr.toIpPort().c_str());
 
     // sockfd 是 connect() 之后返回的, 通过 sockfd 获取其本机绑定的ip和port,
     struct sockaddr_in local = sockets_ops::getLocalAddr(sockfd);
     InetAddress localAddr(local);
-    // 根据连接成功的 sockfd, 创建 TcpConnection 连接对象,
-    TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-    connections_[connName] = conn;
+    // 根据连接成功的 sockfd, 创建 TcpConnection 连接对象, 内存从 ioLoop 的对象池里面分配,
+    LoopShard *shard = shardOf(ioLoop);
+    TcpConnectionPtr conn = std::allocate_shared<TcpConnection>(PoolAllocator<TcpConnection>(shard->connectionPool),
+                                                                ioLoop, connId, connNamePrefix_, sockfd, localAddr, peerAddr);
     // 西面的回调, 用户设置给TcpServer ==>  TcpConnection ==> Channel ==> Poller,
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setMemoryAccount(&shard->memoryAccount);
+    conn->setMemoryLimit(memoryLimits_.perConnection);
+    if (socketOptions_.tcpNoDelay)
+    {
+        conn->setTcpNoDelay(true);
+    }
+    if (socketOptions_.notSentLowat > 0)
+    {
+        conn->setNotSentLowat(socketOptions_.notSentLowat);
+    }
 
     // 设置了如何关闭连接的回调,
-    conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
-
-    // 直接让 ioLoop 直接调用 TcpConnection::connectEstablished()
-    // ==> conn.channel_->enableReading();  conn.connectionCallback_();[用户预置的 onConnection_ 就会回调]
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    conn->setCloseCallback([this](const TcpConnectionPtr &c) { removeConnection(c); });
+    return conn;
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr &conn)
+void TcpServer::connectionEstablishedInLoop(const TcpConnectionPtr &conn)
 {
-    loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+    EventLoop *ioLoop = conn->getLoop();
+    ioLoop->assertInLoopThread();
+    shardOf(ioLoop)->connections[conn->id()] = conn;
+    conn->connectEstablished();
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
+void TcpServer::removeConnection(const TcpConnectionPtr &conn)
 {
-    loop_->assertInLoopThread();
-    LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s\n", name_.c_str(), conn->name().c_str());
-    size_t n = connections_.erase(conn->name()); // 返回的是删除的个数,
-    assert(n == 1);
     EventLoop *ioLoop = conn->getLoop();
+    ioLoop->assertInLoopThread();
+    LOG_INFO("TcpServer::removeConnection [%s] - connection #%lu\n", name_.c_str(), conn->id());
+    size_t n = shardOf(ioLoop)->connections.erase(conn->id()); // 返回的是删除的个数,
+    assert(n == 1);
+    (void)n;
+    // 现在还在 TcpConnection::handleClose() 里面, connectDestroyed() 放到这一轮事件处理完以后执行,
     ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
 }
+
+const MemoryAccount *TcpServer::loopMemoryAccount(EventLoop *loop) const
+{
+    LoopShard *shard = shardOf(loop);
+    return nullptr == shard ? nullptr : &shard->memoryAccount;
+}
+
+void TcpServer::onMemoryExceeded(EventLoop *ioLoop)
+{
+    // 同一时间只需要一次淘汰, 淘汰的连接真正关闭之前, 统计的字节数还会继续超过限制,
+    LoopShard *shard = shardOf(ioLoop);
+    if (!shard->evictionPending)
+    {
+        shard->evictionPending = true;
+        ioLoop->queueInLoop(std::bind(&TcpServer::evictInLoop, this, ioLoop));
+    }
+}
+
+void TcpServer::evictInLoop(EventLoop *ioLoop)
+{
+    ioLoop->assertInLoopThread();
+    LoopShard *shard = shardOf(ioLoop);
+    shard->evictionPending = false;
+
+    // 这个 subLoop 自己的限制和整个 TcpServer 的限制, 取超出多的那个,
+    int64_t excess = shard->memoryAccount.excessBytes();
+    if (excess <= 0)
+    {
+        return;
+    }
+
+    std::vector<TcpConnectionPtr> candidates;
+    for (const auto &item : shard->connections)
+    {
+        const TcpConnectionPtr &conn = item.second;
+        if (conn->connected() && conn->bufferedInputBytes() + conn->bufferedOutputBytes() > 0)
+        {
+            candidates.push_back(conn);
+        }
+    }
+
+    if (kEvictOldestUnsent == memoryLimits_.policy)
+    {
+        // 有待发送数据的连接按等待时间排序, 没有待发送数据的 (只有 inputBuffer_) 排在最后,
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const TcpConnectionPtr &a, const TcpConnectionPtr &b)
+                  {
+                      int64_t ta = a->outputPendingSince().microSecondsSinceEpoch();
+                      int64_t tb = b->outputPendingSince().microSecondsSinceEpoch();
+                      if ((ta > 0) != (tb > 0))
+                      {
+                          return ta > 0;
+                      }
+                      if (ta != tb)
+                      {
+                          return ta < tb;
+                      }
+                      return a->bufferedInputBytes() > b->bufferedInputBytes();
+                  });
+    }
+    else
+    {
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const TcpConnectionPtr &a, const TcpConnectionPtr &b)
+                  {
+                      if (a->bufferedOutputBytes() != b->bufferedOutputBytes())
+                      {
+                          return a->bufferedOutputBytes() > b->bufferedOutputBytes();
+                      }
+                      return a->bufferedInputBytes() > b->bufferedInputBytes();
+                  });
+    }
+
+    for (const TcpConnectionPtr &conn : candidates)
+    {
+        if (excess <= 0)
+        {
+            break;
+        }
+        size_t held = conn->bufferedInputBytes() + conn->bufferedOutputBytes();
+        LOG_WARNNING("TcpServer::evictInLoop [%s] - evict connection %s holding %lu bytes \n",
+                     name_.c_str(), conn->name().c_str(), held);
+        conn->forceClose();
+        excess -= static_cast<int64_t>(held);
+    }
+}
@@ -8,7 +8,9 @@
 #include <unordered_map>
 
 #include "callbacks.h"
+#include "memory_account.h"
 #include "noncopyable.h"
+#include "object_pool.h"
 
 // class Acceptor;
 // class EventLoop;
@@ -33,6 +35,69 @@ public:
         kReusePort,
     };
 
+    /**
+     * 接受连接的方式, 在 start() 之前设置,
+     * kSingleAcceptor: mainLoop 上一个 Acceptor, accept() 以后轮询选择 subLoop, 再通过 runInLoop() 交给 subLoop,
+     * kReusePortPerLoop: 每个 subLoop 一个 Acceptor, 各自的 listen socket 都设置 SO_REUSEPORT 绑定同一个地址,
+     *     内核按照四元组的哈希把新连接分给其中一个 socket, 连接在哪个 subLoop accept() 就在哪个 subLoop 处理, 不再跨线程交接,
+     *     mainLoop 不再接受连接, setThreadNum(0) 的时候就是 mainLoop 自己一个 Acceptor,
+     * kExclusiveSharedListen: 只有一个 listen socket, 每个 subLoop 一个 Acceptor, 都用 EPOLLEXCLUSIVE 注册这个 fd,
+     *     有新连接的时候内核唤醒一个正在 epoll_wait() 的 subLoop, 空闲的 subLoop 先拿到连接,
+     *     不像 SO_REUSEPORT 按照哈希固定分配, 适合长连接、各个连接负载不均匀的场景,
+     */
+    enum AcceptMode
+    {
+        kSingleAcceptor,
+        kReusePortPerLoop,
+        kExclusiveSharedListen,
+    };
+
+    // 内存超过限制以后, 先淘汰哪些连接,
+    enum EvictionPolicy
+    {
+        kEvictLargestBacklog, // 待发送数据最多的连接,
+        kEvictOldestUnsent,   // 待发送数据等待时间最长的连接,
+    };
+
+    /**
+     * 缓冲区内存的限制, 0 表示不限制,
+     * perConnection 超过了直接关闭这个连接,
+     * perLoop / total 超过了, 按照 policy 在导致超限的那个 subLoop 的连接里面选择连接关闭, 直到回到限制以下,
+     * (每个 subLoop 只淘汰自己的连接, 不需要跨线程访问其他 subLoop 的连接表),
+     */
+    struct MemoryLimits
+    {
+        MemoryLimits() : perConnection(0), perLoop(0), total(0), policy(kEvictLargestBacklog) {}
+
+        size_t perConnection;
+        size_t perLoop;
+        size_t total;
+        EvictionPolicy policy;
+    };
+
+    /**
+     * listen socket 和 accept() 得到的连接的 socket 选项, 0/false 表示不设置, 保持系统默认值,
+     * deferAcceptSeconds: TCP_DEFER_ACCEPT, 客户端发来第一个数据字节以后才唤醒 Acceptor, 连接建立以后马上就有数据可读,
+     *     省掉一次 "accept 以后等数据" 的唤醒, 适合客户端先发请求的协议 (HTTP 之类),
+     * fastOpenQueueLen: TCP_FASTOPEN, 客户端在 SYN 里面带上数据, 省掉一个 RTT,
+     * tcpNoDelay: 每个连接设置 TCP_NODELAY,
+     * notSentLowat: 每个连接设置 TCP_NOTSENT_LOWAT,
+     * sendBufferSize/recvBufferSize: SO_SNDBUF/SO_RCVBUF, 设置在 listen socket 上, 连接继承,
+     */
+    struct SocketOptions
+    {
+        SocketOptions()
+            : deferAcceptSeconds(0), fastOpenQueueLen(0), tcpNoDelay(false), notSentLowat(0),
+              sendBufferSize(0), recvBufferSize(0) {}
+
+        int deferAcceptSeconds;
+        int fastOpenQueueLen;
+        bool tcpNoDelay;
+        int notSentLowat;
+        int sendBufferSize;
+        int recvBufferSize;
+    };
+
 public:
     TcpServer(EventLoop *loop, const InetAddress &listenAddr, const std::string &nameArg, Option option = kNoReusePort);
     ~TcpServer();
@@ -56,6 +121,29 @@ public:
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
 
+    // 在 start() 之前调用,
+    void setAcceptMode(AcceptMode mode) { acceptMode_ = mode; }
+
+    /**
+     * 每个 subLoop 绑定一个 CPU, 连接交给绑定在 "处理它的数据包的 CPU" (SO_INCOMING_CPU) 上的 subLoop,
+     * 这样协议栈处理数据包和 subLoop 读写数据在同一个 CPU 上, 缓存是热的,
+     * kSingleAcceptor/kExclusiveSharedListen: accept() 以后读 SO_INCOMING_CPU, 交给对应的 subLoop, 没有对应的就按原来的方式,
+     * kReusePortPerLoop: 给 listen socket 组挂 BPF 程序, 内核直接按照 CPU 选择 subLoop 的 socket,
+     * 在 start() 之前调用,
+     */
+    void setCpuAffinity(bool on) { threadPool_->setCpuAffinity(on); }
+
+    // 在 start() 之前调用,
+    void setSocketOptions(const SocketOptions &options) { socketOptions_ = options; }
+
+    // 在 start() 之前调用,
+    void setMemoryLimits(const MemoryLimits &limits) { memoryLimits_ = limits; }
+
+    // 所有连接的缓冲区内存统计, 可以在任意线程读取,
+    const MemoryAccount &memoryAccount() const { return memoryAccount_; }
+    // 某一个 subLoop 上面的连接的缓冲区内存统计, start() 以后才有, loop 不属于这个 TcpServer 返回 nullptr,
+    const MemoryAccount *loopMemoryAccount(EventLoop *loop) const;
+
 private:
     /**
      * 处理新用户的连接, 根据轮询算法, 选择一个 subLoop, 唤醒 subLoop,
@@ -69,19 +157,67 @@ private:
      * 参数 sockfd  peerAddr 是 Acceptor::handleRead() 给传进来的,
      */
     void newConnection(int sockfd, const InetAddress &peerAddr);
-    // 从 ConnectionMap 里面移除,
+    // kReusePortPerLoop/kExclusiveSharedListen, ioLoop 自己的 Acceptor 接受了新连接, 直接在 ioLoop 线程里面建立连接,
+    void newConnectionInLoop(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
+    // 打开了 CPU 亲和的时候, sockfd 应该交给哪个 subLoop, 没有绑定在它的 CPU 上的 subLoop 返回 nullptr,
+    EventLoop *loopForIncomingCpu(int sockfd) const;
+    // 把 socketOptions_ 里面 listen socket 的选项设置到 socket 上, 在 listen() 之前调用,
+    void applyListenOptions(Socket *socket) const;
+    // 创建 ioLoop 上面的 TcpConnection, 设置回调, 可以在 mainLoop 或者 ioLoop 里面调用,
+    TcpConnectionPtr createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
+    // 在 ioLoop 线程里面把新连接加入这个 subLoop 的分片, 然后 connectEstablished(),
+    void connectionEstablishedInLoop(const TcpConnectionPtr &conn);
+    /**
+     * 连接关闭的回调, 在连接所属的 subLoop 线程里面执行, 从这个 subLoop 的分片里面移除,
+     * 不再绕到 mainLoop 去删除再回到 subLoop 执行 connectDestroyed(),
+     */
     void removeConnection(const TcpConnectionPtr &conn);
-    void removeConnectionInLoop(const TcpConnectionPtr &conn);
+
+    // 某个 subLoop 的 MemoryAccount 超过了限制, 在这个 subLoop 线程里面回调,
+    void onMemoryExceeded(EventLoop *ioLoop);
+    // 在 ioLoop 线程里面, 按照淘汰策略关闭这个 subLoop 的连接, 直到回到限制以下,
+    void evictInLoop(EventLoop *ioLoop);
 
 private:
-    using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    using ConnectionMap = std::unordered_map<uint64_t, TcpConnectionPtr>;
+
+    /**
+     * 每个 subLoop 一个分片, 保存这个 subLoop 上面的连接和内存统计,
+     * 分片只在自己的 subLoop 线程里面访问, 不需要加锁, shards_ 本身在 start() 以后不再修改,
+     * connectionPool 例外, 它在 mainLoop 里面分配, 自己带锁,
+     */
+    struct LoopShard
+    {
+        explicit LoopShard(MemoryAccount *parent)
+            : memoryAccount(parent), evictionPending(false), connectionPool(std::make_shared<ObjectPool>()) {}
+
+        ConnectionMap connections; // 连接 id ==> TcpConnection,
+        MemoryAccount memoryAccount;
+        bool evictionPending;
+        // 这个 subLoop 的 TcpConnection 的内存块, 控制块 + TcpConnection + Socket + Channel 一次分配, 关闭以后复用,
+        std::shared_ptr<ObjectPool> connectionPool;
+        // kReusePortPerLoop/kExclusiveSharedListen 的时候这个 subLoop 自己的 Acceptor, 在这个 subLoop 线程里面 listen() 和析构,
+        std::unique_ptr<Acceptor> acceptor;
+    };
+
+    LoopShard *shardOf(EventLoop *ioLoop) const;
 
 private:
     EventLoop *loop_; // 用户定义的 baseLoop_;
     const std::string ipPort_;
     const std::string name_;
+    const InetAddress listenAddr_;
+    AcceptMode acceptMode_;
+    SocketOptions socketOptions_;
+
+    const std::shared_ptr<const std::string> connNamePrefix_; // "name-ip:port#", 连接的名字是它加上连接 id,
+
+    // 内存统计和分片放在 threadPool_ 前面, 析构的时候 subLoop 线程都退出了以后才析构,
+    MemoryLimits memoryLimits_;
+    MemoryAccount memoryAccount_; // 整个 TcpServer,
+    std::unordered_map<EventLoop *, std::unique_ptr<LoopShard>> shards_;
 
-    std::unique_ptr<Acceptor> acceptor_;              // 运行在 mianLoop 的 Accrptor, 监听新连接事件,
+    std::unique_ptr<Acceptor> acceptor_;              // 运行在 mianLoop 的 Accrptor, 监听新连接事件, 每个 subLoop 一个 Acceptor 的时候 start() 里面释放,
     std::shared_ptr<EventLoopThreadpool> threadPool_; // one loop per thread,
 
     ConnectionCallback connectionCallback_;       // 有新连接时的回调,
@@ -90,6 +226,5 @@ private:
     ThreadInitCallback threadInitCallback_;       // loop_ 线程初始化的回调,
 
     std::atomic_int started_; // 防止一个 tcpServer 对象被 start 多次,
-    int nextConnId_;
-    ConnectionMap connections_; // 保存所有的连接,
+    std::atomic<uint64_t> nextConnId_;
 };
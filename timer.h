@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+#include "callbacks.h"
+#include "noncopyable.h"
+#include "timestamp.h"
+
+/**
+ * 一个定时任务, 到期时间 expiration_ 到了以后在 loop 线程里面执行 callback_,
+ * interval_ 大于 0 表示周期任务, 每次执行完以后 restart() 计算下一次的到期时间,
+ * sequence_ 是全局递增的序号, 和 Timer* 一起组成 TimerId, 防止 Timer 释放以后地址被复用, 取消到别的定时器,
+ */
+class Timer : noncopyable
+{
+public:
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        : callback_(std::move(cb)),
+          expiration_(when),
+          interval_(interval),
+          repeat_(interval > 0.0),
+          sequence_(++s_numCreated_)
+    {
+    }
+
+public:
+    void run() const { callback_(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    // 周期任务, 从 now 开始计算下一次的到期时间,
+    void restart(Timestamp now);
+
+private:
+    const TimerCallback callback_;
+    Timestamp expiration_;
+    const double interval_; // 单位秒,
+    const bool repeat_;
+    const int64_t sequence_;
+
+    static std::atomic<int64_t> s_numCreated_;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+class Timer;
+
+/**
+ * EventLoop::runAt()/runAfter()/runEvery() 返回的定时器标识, 用来 EventLoop::cancel(),
+ * 只是一个值, 不管理 Timer 的生命期,
+ */
+class TimerId
+{
+public:
+    TimerId() : timer_(nullptr), sequence_(0) {}
+    TimerId(Timer *timer, int64_t seq) : timer_(timer), sequence_(seq) {}
+
+private:
+    friend class TimerQueue;
+
+    Timer *timer_;
+    int64_t sequence_;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <set>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "callbacks.h"
+#include "channel.h"
+#include "noncopyable.h"
+#include "timer_id.h"
+#include "timestamp.h"
+
+class EventLoop;
+class Timer;
+
+/**
+ * 每个 EventLoop 一个定时器队列, 用 timerfd 接入 Poller, 和其他 fd 一样由 Channel 通知,
+ * timerfd 只设置最早到期的那个时间, 到期以后 handleRead() 取出所有已经到期的定时器依次执行,
+ * 周期定时器重新计算到期时间放回队列, 然后把 timerfd 设置成新的最早到期时间,
+ *
+ * addTimer()/cancel() 可以在任意线程调用, 通过 runInLoop() 转到 loop 线程里面修改队列, 队列本身不加锁,
+ */
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+public:
+    // when 到期执行 cb, interval 大于 0 的话之后每隔 interval 秒执行一次,
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+
+    void cancel(TimerId timerId);
+
+private:
+    // 按照到期时间排序, 到期时间相同的用 Timer 地址区分,
+    using Entry = std::pair<Timestamp, Timer *>;
+    using TimerList = std::set<Entry>;
+    // 按照 Timer 地址排序, cancel() 的时候用来查找,
+    using ActiveTimer = std::pair<Timer *, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(TimerId timerId);
+
+    // timerfd 可读, 有定时器到期了,
+    void handleRead();
+
+    // 把所有到期的定时器从队列里面取出来,
+    std::vector<Entry> getExpired(Timestamp now);
+    // 执行完以后, 周期定时器放回队列, 其他的释放,
+    void reset(const std::vector<Entry> &expired, Timestamp now);
+
+    // 插入定时器, 返回它是不是新的最早到期的定时器,
+    bool insert(Timer *timer);
+
+private:
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+
+    TimerList timers_;
+    ActiveTimerSet activeTimers_;
+
+    // 定时器回调里面 cancel() 自己 (周期定时器), 这时候它已经不在 timers_ 里面了, 记下来, reset() 的时候不再放回去,
+    bool callingExpiredTimers_;
+    ActiveTimerSet cancelingTimers_;
+};
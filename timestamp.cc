@@ -1,4 +1,5 @@
 
+#include <sys/time.h>
 #include <time.h>
 
 #include "timestamp.h"
@@ -10,13 +11,16 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpochArg)
 
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));
+    struct timeval tv;
+    ::gettimeofday(&tv, NULL);
+    return Timestamp(static_cast<int64_t>(tv.tv_sec) * kMicroSecondsPerSecond + tv.tv_usec);
 }
 
 std::string Timestamp::toString() const
 {
     char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
+    time_t seconds = secondsSinceEpoch();
+    tm *tm_time = localtime(&seconds);
     snprintf(buf, 128, "%04d/%02d/%02d %02d:%02d:%02d",
              tm_time->tm_year + 1900, tm_time->tm_mon + 1, tm_time->tm_mday,
              tm_time->tm_hour, tm_time->tm_min, tm_time->tm_sec);
@@ -1,8 +1,15 @@
 #pragma once
 
 #include <iostream>
+#include <stdint.h>
 #include <string>
+#include <time.h>
 
+/**
+ * 时间点, 单位是微秒 (从 1970-01-01 00:00:00 UTC 开始),
+ * 最早的版本 now() 用 time(NULL) 填充, 实际保存的是秒, 和成员的名字不一致, 现在 now() 用 gettimeofday() 给出微秒,
+ * 用 Timestamp(int64_t) 自己构造时间点的代码要传微秒, 需要秒的地方用 secondsSinceEpoch(),
+ */
 class Timestamp
 {
 public:
@@ -14,6 +21,29 @@ public:
     static Timestamp now();
     std::string toString() const;
 
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    time_t secondsSinceEpoch() const { return static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond); }
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
+
 private:
     int64_t microSecondsSinceEpoch_;
 };
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// timestamp 加上 seconds 秒, 定时器用来计算到期时间,
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
@@ -0,0 +1,395 @@
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "upstream_pool.h"
+
+#include "buffer.h"
+#include "connector.h"
+#include "event_loop.h"
+#include "logger.h"
+#include "sockets_ops.h"
+#include "tcp_connection.h"
+
+namespace
+{
+    double timeDifference(Timestamp high, Timestamp low)
+    {
+        int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+        return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+    }
+}
+
+UpstreamPool::UpstreamPool(EventLoop *loop, const Options &options)
+    : loop_(loop),
+      options_(options),
+      nextId_(1),
+      nextConnId_(1)
+{
+    assert(options_.maxPipelineDepth >= 1);
+    checkTimer_ = loop_->runEvery(options_.checkInterval, [this]() { checkIdle(); });
+}
+
+UpstreamPool::~UpstreamPool()
+{
+    loop_->assertInLoopThread();
+    loop_->cancel(checkTimer_);
+
+    for (auto &item : backends_)
+    {
+        Backend *backend = item.second.get();
+        for (PendingConnect &pending : backend->connecting)
+        {
+            loop_->cancel(pending.timeout);
+            pending.connector->stop();
+        }
+        std::deque<Waiter> waiters;
+        waiters.swap(backend->waiters);
+        for (Waiter &waiter : waiters)
+        {
+            loop_->cancel(waiter.timeout);
+            waiter.callback(TcpConnectionPtr());
+        }
+    }
+
+    /**
+     * 连接可能还被上层持有, 回调换成不访问 UpstreamPool 的版本,
+     * 还连着的连接和 TcpServer 析构的时候一样直接 connectDestroyed(), 之后的 send() 不会再发送,
+     * 已经 forceClose() 的连接等它自己的 handleClose() 执行完再 connectDestroyed(),
+     */
+    EventLoop *loop = loop_;
+    std::unordered_map<TcpConnection *, ConnState> conns;
+    conns.swap(conns_);
+    for (auto &item : conns)
+    {
+        TcpConnectionPtr conn(item.second.conn);
+        conn->setConnectionCallback(connectionCallback_ ? connectionCallback_ : ConnectionCallback(defaultConnectionCallback));
+        conn->setMessageCallback(defaultMessageCallback);
+        conn->setCloseCallback([loop](const TcpConnectionPtr &c)
+                               { loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, c)); });
+        if (conn->connected())
+        {
+            conn->connectDestroyed();
+        }
+    }
+}
+
+void UpstreamPool::acquire(const InetAddress &addr, const AcquireCallback &cb)
+{
+    loop_->assertInLoopThread();
+    Backend *backend = getBackend(addr);
+
+    // 流水线, 复用已经借出、但是还没有达到 maxPipelineDepth 的连接,
+    if (!backend->pipelined.empty())
+    {
+        TcpConnectionPtr conn(backend->pipelined.front());
+        lease(backend, conn);
+        cb(conn);
+        return;
+    }
+
+    // 最近归还的连接最可能还是好的, 从队尾拿,
+    Timestamp now(Timestamp::now());
+    while (!backend->idle.empty())
+    {
+        TcpConnectionPtr conn(backend->idle.back());
+        backend->idle.pop_back();
+        if (conn->connected() && !expired(conns_[conn.get()], now))
+        {
+            lease(backend, conn);
+            cb(conn);
+            return;
+        }
+        conn->forceClose();
+    }
+
+    uint64_t id = nextId_++;
+    TimerId timeout = loop_->runAfter(options_.connectTimeout, [this, backend, id]() { onWaiterTimeout(backend, id); });
+    backend->waiters.push_back(Waiter{id, cb, timeout});
+
+    // 一个新连接可以服务 maxPipelineDepth 个等待的请求,
+    size_t capacity = backend->connecting.size() * static_cast<size_t>(options_.maxPipelineDepth);
+    if (capacity < backend->waiters.size())
+    {
+        startConnect(backend);
+    }
+}
+
+void UpstreamPool::release(const TcpConnectionPtr &conn, bool reusable)
+{
+    loop_->assertInLoopThread();
+    auto it = conns_.find(conn.get());
+    if (it == conns_.end())
+    {
+        return; // 已经关闭了,
+    }
+    ConnState &state = it->second;
+    Backend *backend = state.backend;
+    assert(state.inflight > 0);
+    --state.inflight;
+
+    if (!reusable || !conn->connected() || expired(state, Timestamp::now()))
+    {
+        eraseFrom(backend->pipelined, conn);
+        // 不能复用的连接立即关闭, 寿命到了的连接等借出的请求都归还了再关闭,
+        if (!reusable || 0 == state.inflight)
+        {
+            conn->forceClose();
+        }
+        return;
+    }
+
+    if (serveWaiter(backend, conn))
+    {
+        return;
+    }
+    if (0 == state.inflight)
+    {
+        putIdle(backend, conn);
+    }
+    updatePipelined(backend, conn);
+}
+
+size_t UpstreamPool::idleConnections(const InetAddress &addr) const
+{
+    auto it = backends_.find(addr.toIpPort());
+    return it == backends_.end() ? 0 : it->second->idle.size();
+}
+
+UpstreamPool::Backend *UpstreamPool::getBackend(const InetAddress &addr)
+{
+    std::unique_ptr<Backend> &backend = backends_[addr.toIpPort()];
+    if (!backend)
+    {
+        backend.reset(new Backend(addr));
+    }
+    return backend.get();
+}
+
+void UpstreamPool::lease(Backend *backend, const TcpConnectionPtr &conn)
+{
+    ConnState &state = conns_[conn.get()];
+    if (0 == state.inflight++)
+    {
+        eraseFrom(backend->idle, conn);
+    }
+    updatePipelined(backend, conn);
+}
+
+void UpstreamPool::updatePipelined(Backend *backend, const TcpConnectionPtr &conn)
+{
+    const ConnState &state = conns_[conn.get()];
+    bool lendable = state.inflight > 0 && state.inflight < options_.maxPipelineDepth && conn->connected();
+    auto it = std::find(backend->pipelined.begin(), backend->pipelined.end(), conn);
+    if (lendable && it == backend->pipelined.end())
+    {
+        backend->pipelined.push_back(conn);
+    }
+    else if (!lendable && it != backend->pipelined.end())
+    {
+        backend->pipelined.erase(it);
+    }
+}
+
+void UpstreamPool::startConnect(Backend *backend)
+{
+    uint64_t id = nextId_++;
+    std::shared_ptr<Connector> connector(new Connector(loop_, backend->addr));
+    connector->setNewConnectionCallback([this, backend, id](int sockfd) { newConnection(backend, id, sockfd); });
+    TimerId timeout = loop_->runAfter(options_.connectTimeout, [this, backend, id]() { onConnectTimeout(backend, id); });
+    backend->connecting.push_back(PendingConnect{id, connector, timeout});
+    connector->start();
+}
+
+bool UpstreamPool::takePending(Backend *backend, uint64_t id, PendingConnect *pending)
+{
+    for (auto it = backend->connecting.begin(); it != backend->connecting.end(); ++it)
+    {
+        if (it->id == id)
+        {
+            *pending = *it;
+            backend->connecting.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void UpstreamPool::onConnectTimeout(Backend *backend, uint64_t id)
+{
+    PendingConnect pending;
+    if (takePending(backend, id, &pending))
+    {
+        LOG_WARNNING("UpstreamPool::onConnectTimeout - connect to %s timed out \n", backend->addr.toIpPort().c_str());
+        pending.connector->stop();
+    }
+}
+
+void UpstreamPool::newConnection(Backend *backend, uint64_t id, int sockfd)
+{
+    loop_->assertInLoopThread();
+    PendingConnect pending;
+    if (!takePending(backend, id, &pending))
+    {
+        ::close(sockfd); // 已经超时了,
+        return;
+    }
+    loop_->cancel(pending.timeout);
+
+    InetAddress peerAddr(sockets_ops::getPeerAddr(sockfd));
+    InetAddress localAddr(sockets_ops::getLocalAddr(sockfd));
+    char buf[64] = {0};
+    snprintf(buf, sizeof(buf), "upstream-%s#%d", peerAddr.toIpPort().c_str(), nextConnId_);
+    ++nextConnId_;
+
+    TcpConnectionPtr conn(new TcpConnection(loop_, buf, sockfd, localAddr, peerAddr));
+    conn->setConnectionCallback([this](const TcpConnectionPtr &c) { onConnection(c); });
+    conn->setMessageCallback([this](const TcpConnectionPtr &c, Buffer *b, Timestamp t) { onMessage(c, b, t); });
+    conn->setCloseCallback([this](const TcpConnectionPtr &c) { onClose(c); });
+
+    Timestamp now(Timestamp::now());
+    conns_[conn.get()] = ConnState{conn, backend, now, now, 0};
+    conn->connectEstablished();
+
+    if (!serveWaiter(backend, conn))
+    {
+        putIdle(backend, conn);
+    }
+}
+
+void UpstreamPool::onWaiterTimeout(Backend *backend, uint64_t waiterId)
+{
+    for (auto it = backend->waiters.begin(); it != backend->waiters.end(); ++it)
+    {
+        if (it->id == waiterId)
+        {
+            AcquireCallback cb(std::move(it->callback));
+            backend->waiters.erase(it);
+            cb(TcpConnectionPtr());
+            return;
+        }
+    }
+}
+
+bool UpstreamPool::serveWaiter(Backend *backend, const TcpConnectionPtr &conn)
+{
+    bool served = false;
+    // 回调里面可能马上 release(), 所以每次都重新检查连接的状态,
+    while (!backend->waiters.empty() && conn->connected() &&
+           conns_.count(conn.get()) && conns_[conn.get()].inflight < options_.maxPipelineDepth)
+    {
+        Waiter waiter(std::move(backend->waiters.front()));
+        backend->waiters.pop_front();
+        loop_->cancel(waiter.timeout);
+        lease(backend, conn);
+        served = true;
+        waiter.callback(conn);
+    }
+    return served;
+}
+
+void UpstreamPool::putIdle(Backend *backend, const TcpConnectionPtr &conn)
+{
+    conns_[conn.get()].idleSince = Timestamp::now();
+    backend->idle.push_back(conn);
+    if (backend->idle.size() > options_.maxIdlePerBackend)
+    {
+        TcpConnectionPtr oldest(backend->idle.front());
+        backend->idle.pop_front();
+        oldest->forceClose();
+    }
+}
+
+void UpstreamPool::eraseFrom(std::deque<TcpConnectionPtr> &list, const TcpConnectionPtr &conn)
+{
+    auto it = std::find(list.begin(), list.end(), conn);
+    if (it != list.end())
+    {
+        list.erase(it);
+    }
+}
+
+void UpstreamPool::eraseFrom(std::vector<TcpConnectionPtr> &list, const TcpConnectionPtr &conn)
+{
+    auto it = std::find(list.begin(), list.end(), conn);
+    if (it != list.end())
+    {
+        list.erase(it);
+    }
+}
+
+void UpstreamPool::onConnection(const TcpConnectionPtr &conn)
+{
+    if (connectionCallback_)
+    {
+        connectionCallback_(conn);
+    }
+}
+
+void UpstreamPool::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    auto it = conns_.find(conn.get());
+    if (it == conns_.end() || 0 == it->second.inflight)
+    {
+        // 空闲的连接上不应该有数据, 协议已经错乱了, 不能再复用,
+        size_t unexpected = buf->readableBytes();
+        LOG_ERROR("UpstreamPool::onMessage - unexpected %lu bytes on idle connection %s \n",
+                  unexpected, conn->name().c_str());
+        buf->retrieveAll();
+        conn->forceClose();
+        return;
+    }
+    if (messageCallback_)
+    {
+        messageCallback_(conn, buf, receiveTime);
+    }
+    else
+    {
+        buf->retrieveAll();
+    }
+}
+
+void UpstreamPool::onClose(const TcpConnectionPtr &conn)
+{
+    loop_->assertInLoopThread();
+    auto it = conns_.find(conn.get());
+    if (it != conns_.end())
+    {
+        Backend *backend = it->second.backend;
+        eraseFrom(backend->idle, conn);
+        eraseFrom(backend->pipelined, conn);
+        conns_.erase(it);
+    }
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+void UpstreamPool::checkIdle()
+{
+    Timestamp now(Timestamp::now());
+    for (auto &item : backends_)
+    {
+        Backend *backend = item.second.get();
+        std::vector<TcpConnectionPtr> closing;
+        for (const TcpConnectionPtr &conn : backend->idle)
+        {
+            const ConnState &state = conns_[conn.get()];
+            bool idleTooLong = options_.maxIdleSeconds > 0 &&
+                               timeDifference(now, state.idleSince) > options_.maxIdleSeconds;
+            if (idleTooLong || expired(state, now) || (healthCheck_ && !healthCheck_(conn)))
+            {
+                closing.push_back(conn);
+            }
+        }
+        for (const TcpConnectionPtr &conn : closing)
+        {
+            eraseFrom(backend->idle, conn);
+            conn->forceClose();
+        }
+    }
+}
+
+bool UpstreamPool::expired(const ConnState &state, Timestamp now) const
+{
+    return options_.maxLifetimeSeconds > 0 && timeDifference(now, state.created) > options_.maxLifetimeSeconds;
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "callbacks.h"
+#include "inet_address.h"
+#include "noncopyable.h"
+#include "timer_id.h"
+#include "timestamp.h"
+
+class Connector;
+class EventLoop;
+
+/**
+ * 到后端服务的连接池, 一个 UpstreamPool 只属于一个 EventLoop, 池里面的连接也都在这个 loop 上,
+ * 每个 subLoop 建一个自己的 UpstreamPool (比如在 TcpServer 的 ThreadInitCallback 里面创建),
+ * 这样 acquire()/release() 都在同一个线程里面, 不需要加锁, 连接也不会跨线程,
+ *
+ * acquire() 优先复用空闲的连接 (最近用过的先复用), 没有空闲的连接才发起新的连接, 连上以后交给等待的请求,
+ * 连接超时 (connectTimeout) 的请求回调一个空的 TcpConnectionPtr,
+ * maxPipelineDepth 大于 1 的时候, 一个连接可以同时借给多个请求 (流水线), 回复和请求的对应关系由上层协议按照顺序处理,
+ *
+ * 空闲的连接:
+ *   超过 maxIdleSeconds 没有使用, 或者建立超过了 maxLifetimeSeconds, 由定时器关闭,
+ *   收到了数据 (不可能是回复, 协议已经错乱) 或者对端关闭, 直接关闭,
+ *   设置了 HealthCheck 的话, 定时器每次检查, 返回 false 就关闭,
+ */
+class UpstreamPool : noncopyable
+{
+public:
+    // 拿到的连接, 失败 (连接超时, 池已经销毁) 的时候是空的,
+    using AcquireCallback = std::function<void(const TcpConnectionPtr &)>;
+    // 检查空闲的连接是否还可用,
+    using HealthCheck = std::function<bool(const TcpConnectionPtr &)>;
+
+    struct Options
+    {
+        Options()
+            : maxIdlePerBackend(8),
+              maxIdleSeconds(60.0),
+              maxLifetimeSeconds(0.0),
+              maxPipelineDepth(1),
+              connectTimeout(3.0),
+              checkInterval(1.0)
+        {
+        }
+
+        size_t maxIdlePerBackend;  // 每个后端最多保留的空闲连接数,
+        double maxIdleSeconds;     // 空闲超过这个时间就关闭, 0 表示不限制,
+        double maxLifetimeSeconds; // 连接建立超过这个时间, 空闲的时候关闭, 0 表示不限制,
+        int maxPipelineDepth;      // 一个连接同时借出的次数, 1 表示不使用流水线,
+        double connectTimeout;     // 等待连接的最长时间,
+        double checkInterval;      // 检查空闲连接的定时器间隔,
+    };
+
+public:
+    explicit UpstreamPool(EventLoop *loop, const Options &options = Options());
+    ~UpstreamPool();
+
+public:
+    // 借出的连接上收到的数据, 空闲连接上的数据不会回调,
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    // 池里面的连接建立和断开, 借出的连接断开了, 上层需要让还在等待回复的请求失败,
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setHealthCheck(const HealthCheck &cb) { healthCheck_ = cb; }
+
+    // 借一个到 backend 的连接, 必须在 loop 线程里面调用, cb 可能在 acquire() 返回之前执行,
+    void acquire(const InetAddress &backend, const AcquireCallback &cb);
+    /**
+     * 归还 acquire() 拿到的连接, 每次 acquire() 成功都要对应一次 release(),
+     * reusable 为 false 表示这个连接不能再用了 (比如请求失败, 协议状态不确定), 直接关闭,
+     */
+    void release(const TcpConnectionPtr &conn, bool reusable = true);
+
+    EventLoop *getLoop() const { return loop_; }
+    size_t idleConnections(const InetAddress &backend) const;
+    size_t totalConnections() const { return conns_.size(); }
+
+private:
+    struct Waiter
+    {
+        uint64_t id;
+        AcquireCallback callback;
+        TimerId timeout;
+    };
+
+    // 正在建立的连接, 超时以后停止 Connector,
+    struct PendingConnect
+    {
+        uint64_t id;
+        std::shared_ptr<Connector> connector;
+        TimerId timeout;
+    };
+
+    struct Backend
+    {
+        explicit Backend(const InetAddress &addrArg) : addr(addrArg) {}
+
+        InetAddress addr;
+        std::deque<TcpConnectionPtr> idle;       // 队尾是最近归还的,
+        std::vector<TcpConnectionPtr> pipelined; // 已经借出、还可以再借的连接 (maxPipelineDepth > 1),
+        std::deque<Waiter> waiters;              // 等待连接的请求,
+        std::vector<PendingConnect> connecting;
+    };
+
+    struct ConnState
+    {
+        TcpConnectionPtr conn; // 借出去的连接也由池持有, 直到关闭,
+        Backend *backend;
+        Timestamp created;
+        Timestamp idleSince;
+        int inflight; // 借出的次数,
+    };
+
+    Backend *getBackend(const InetAddress &addr);
+    // 借出 conn 一次,
+    void lease(Backend *backend, const TcpConnectionPtr &conn);
+    // conn 的借出次数变化以后, 更新它是否还可以流水线地再借出,
+    void updatePipelined(Backend *backend, const TcpConnectionPtr &conn);
+    void startConnect(Backend *backend);
+    // 从 backend->connecting 里面取出 id 对应的连接, 已经不在了返回 false,
+    bool takePending(Backend *backend, uint64_t id, PendingConnect *pending);
+    void onConnectTimeout(Backend *backend, uint64_t id);
+    void newConnection(Backend *backend, uint64_t id, int sockfd);
+    void onWaiterTimeout(Backend *backend, uint64_t waiterId);
+    // conn 可以再借出了, 有等待的请求就交给它,
+    bool serveWaiter(Backend *backend, const TcpConnectionPtr &conn);
+    void putIdle(Backend *backend, const TcpConnectionPtr &conn);
+    void eraseFrom(std::deque<TcpConnectionPtr> &list, const TcpConnectionPtr &conn);
+    void eraseFrom(std::vector<TcpConnectionPtr> &list, const TcpConnectionPtr &conn);
+
+    void onConnection(const TcpConnectionPtr &conn);
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+    void onClose(const TcpConnectionPtr &conn);
+    // 定时器, 关闭空闲太久、寿命到了、健康检查失败的空闲连接,
+    void checkIdle();
+
+    bool expired(const ConnState &state, Timestamp now) const;
+
+private:
+    EventLoop *loop_;
+    const Options options_;
+    MessageCallback messageCallback_;
+    ConnectionCallback connectionCallback_;
+    HealthCheck healthCheck_;
+
+    std::unordered_map<std::string, std::unique_ptr<Backend>> backends_; // ip:port ==> Backend,
+    std::unordered_map<TcpConnection *, ConnState> conns_;               // 池里面所有的连接,
+    uint64_t nextId_; // Waiter 和 PendingConnect 的 id,
+    int nextConnId_;
+    TimerId checkTimer_;
+};